@@ -0,0 +1,72 @@
+#pragma once
+
+#include "BufferedFrameOutputDevice.h"
+
+/**
+ * @brief An output device that checks the decoder to sink path does not allocate once warmed up.
+ *
+ * Every frame is forwarded to another output device. The thread enqueueing frames (the decoder) and the thread
+ * running exec (the sink) are watched by the AllocationTracker, that is armed after the first warm-up frames:
+ * from then on any allocation made by the player on those threads is a violation. The workers of the decoder
+ * (parallel intra-only decoders, frame stage workers) watch their own threads.
+ * The check completes once the given number of frames has been enqueued after the warm-up.
+ *
+ * This is meaningful only on builds with EOD_ALLOCATION_TRACKING.
+ */
+class AllocationCheckingFrameOutputDevice : public BufferedFrameOutputDevice {
+
+public:
+    /**
+     * @param sink the output device that receives frames: MUST outlive this device
+     * @param warmupFrames the number of frames (caches, pools and queues filling up) allocations are allowed for
+     * @param checkedFrames the number of frames checked after the warm-up
+     */
+    AllocationCheckingFrameOutputDevice(BufferedFrameOutputDevice* sink, uint64_t warmupFrames, uint64_t checkedFrames) noexcept;
+
+    ~AllocationCheckingFrameOutputDevice() override;
+
+    uint32_t getPreferredWidth() const noexcept override;
+
+    uint32_t getPreferredHeight() const noexcept override;
+
+    Frame::PixelFormat getPreferredPixelFormat() const noexcept override;
+
+    void setClockRate(double rate) noexcept override;
+
+    void enqueueFrame(Frame&& frame) noexcept override;
+
+    /**
+     * @brief Run the main cycle of the sink, watching the calling thread.
+     */
+    void exec() noexcept override;
+
+    /**
+     * @brief Wait until the checked frames have been enqueued.
+     *
+     * @param timeout the longest time to wait
+     * @return true IIF the check has completed
+     */
+    bool waitForCompletion(std::chrono::milliseconds timeout) noexcept;
+
+    /**
+     * @brief Get the number of frames enqueued so far.
+     */
+    uint64_t getEnqueuedFrames() const noexcept;
+
+    bool isCompleted() const noexcept;
+
+private:
+    BufferedFrameOutputDevice* const m_Sink;
+
+    const uint64_t m_WarmupFrames;
+
+    const uint64_t m_CheckedFrames;
+
+    std::atomic<uint64_t> m_EnqueuedFrames;
+
+    mutable std::mutex m_CompletionMutex;
+
+    std::condition_variable m_Completed;
+
+    bool m_IsCompleted;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "EODPlayer.hpp"
+
+/**
+ * @brief Counts heap allocations, per thread and in total, to keep the decode to presentation path allocation-free.
+ *
+ * When the player is built with EOD_ALLOCATION_TRACKING the executable replaces the global operator new/delete and
+ * interposes malloc, calloc, realloc and the aligned allocation functions of the C library: every call is counted
+ * (for the calling thread and globally) before being forwarded to the C library.
+ * Without it every method is a no-op and counters stay at zero, so tracking calls can be left in the code.
+ *
+ * Threads of the hot path are marked as watched: once the tracker is armed every allocation made by a watched thread
+ * is a violation, and its call stack is recorded in a fixed-size table of allocation sites (recording never allocates).
+ * Allocations made by libraries (i.e. packet buffers inside ffmpeg) are told apart from the ones made by the player
+ * comparing the return address of the caller with the code of the executable: they are recorded as sites too but
+ * are not violations, as the player cannot avoid them. This relies on libraries being linked dynamically.
+ */
+class AllocationTracker {
+
+public:
+    struct Counters {
+        uint64_t allocations;
+
+        uint64_t deallocations;
+
+        uint64_t bytes;
+    };
+
+    /**
+     * @brief The maximum number of distinct allocation sites recorded.
+     */
+    static constexpr size_t MaxSites = 256;
+
+    /**
+     * @brief The number of stack frames identifying an allocation site.
+     */
+    static constexpr size_t SiteDepth = 8;
+
+    AllocationTracker() = delete;
+
+    /**
+     * @brief Check if the executable has been built with allocation tracking.
+     */
+    static bool isEnabled() noexcept;
+
+    /**
+     * @brief Get the counters of the calling thread.
+     */
+    static Counters getThreadCounters() noexcept;
+
+    /**
+     * @brief Get the counters of every thread.
+     */
+    static Counters getTotalCounters() noexcept;
+
+    /**
+     * @brief Mark the calling thread as part of the hot path.
+     */
+    static void watchThread() noexcept;
+
+    /**
+     * @brief Start reporting allocations of watched threads as violations (i.e. after warm-up).
+     */
+    static void arm() noexcept;
+
+    static void disarm() noexcept;
+
+    /**
+     * @brief Get the number of allocations made by the player on watched threads while armed.
+     */
+    static uint64_t getViolations() noexcept;
+
+    /**
+     * @brief Get the number of allocations made by libraries on watched threads while armed.
+     */
+    static uint64_t getLibraryAllocations() noexcept;
+
+    /**
+     * @brief Write the recorded allocation sites, with their symbolized call stacks.
+     *
+     * @param fd the file descriptor to write to (symbolization writes directly to it, without allocating)
+     */
+    static void report(int fd) noexcept;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "EODPlayer.hpp"
+
+/**
+ * @brief Premultiplied-alpha "source over" blending of overlay pixels onto frame pixels.
+ *
+ * Overlay samples are premultiplied by their alpha, so that blending a sample is one multiply-add:
+ * dst = src + dst * (1 - alpha). This holds for YUV as well as for RGB (premultiplied chroma keeps its offset
+ * only where the overlay is opaque), so overlays are blended on frames in their native format.
+ *
+ * Kernels process 16 bytes at a time with SSE2 or NEON when available and are exact (rounded division by 255).
+ */
+namespace AlphaBlend {
+
+    /**
+     * @brief Divide by 255 (rounding) a product of two 8-bit values.
+     */
+    inline uint32_t div255(uint32_t value) noexcept {
+        value += 128;
+        return (value + (value >> 8)) >> 8;
+    }
+
+    inline uint8_t premultiply(uint8_t value, uint8_t alpha) noexcept {
+        return static_cast<uint8_t>(div255(static_cast<uint32_t>(value) * alpha));
+    }
+
+    /**
+     * @brief Blend a row of samples having their alpha in a separate row (a plane of planar YUV, NV12 luma or chroma).
+     *
+     * @param dst the frame samples
+     * @param src the premultiplied overlay samples
+     * @param alpha the alpha of each overlay sample
+     * @param count the number of samples
+     */
+    void blendSamples(uint8_t* dst, const uint8_t* src, const uint8_t* alpha, size_t count) noexcept;
+
+    /**
+     * @brief Blend a row of RGBA32 pixels.
+     *
+     * @param dst the frame pixels
+     * @param src the premultiplied overlay pixels
+     * @param pixels the number of pixels
+     */
+    void blendRGBA32(uint8_t* dst, const uint8_t* src, size_t pixels) noexcept;
+
+    /**
+     * @brief Blend a row of RGBA64 pixels.
+     *
+     * @param dst the frame pixels
+     * @param src the premultiplied overlay pixels
+     * @param pixels the number of pixels
+     */
+    void blendRGBA64(uint16_t* dst, const uint16_t* src, size_t pixels) noexcept;
+
+}
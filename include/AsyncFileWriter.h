@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Frame.h"
+
+#include <deque>
+
+struct AVPacket;
+
+/**
+ * @brief Writes whole files with POSIX asynchronous I/O, so that the thread producing their content never waits for the disk.
+ *
+ * Every write creates (or truncates) a file and queues its content; the content is kept alive until the write
+ * completes. At most maxInFlight writes are pending: queueing one more first waits for the oldest to complete.
+ *
+ * A writer is owned by a single thread.
+ */
+class AsyncFileWriter {
+
+public:
+    /**
+     * @param maxInFlight the number of writes that can be pending at the same time
+     */
+    AsyncFileWriter(size_t maxInFlight) noexcept;
+
+    /**
+     * @brief Wait for every pending write to complete.
+     */
+    ~AsyncFileWriter();
+
+    AsyncFileWriter(const AsyncFileWriter&) = delete;
+
+    AsyncFileWriter(AsyncFileWriter&&) = delete;
+
+    AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+    AsyncFileWriter& operator=(AsyncFileWriter&&) = delete;
+
+    /**
+     * @brief Write an encoded packet to a file.
+     *
+     * @param path the file to write
+     * @param packet the content of the file: the writer takes the ownership (and frees it even when the write fails)
+     * @return true IIF the write has been queued
+     */
+    bool write(const std::string& path, AVPacket* packet) noexcept;
+
+    /**
+     * @brief Write the pixels of a frame to a file.
+     *
+     * @param path the file to write
+     * @param frame the frame, whose memory goes back to its allocator when the write completes
+     * @return true IIF the write has been queued
+     */
+    bool write(const std::string& path, Frame&& frame) noexcept;
+
+    /**
+     * @brief Wait for every pending write to complete.
+     */
+    void flush() noexcept;
+
+    /**
+     * @brief Get the number of bytes written by completed writes.
+     */
+    uint64_t getWrittenBytes() const noexcept;
+
+    /**
+     * @brief Get the number of queued writes that could not complete.
+     */
+    uint64_t getFailedWrites() const noexcept;
+
+private:
+    struct Write;
+
+    /**
+     * @brief Open the file of a write and queue its content.
+     */
+    bool submit(const std::string& path, std::unique_ptr<Write>&& write) noexcept;
+
+    /**
+     * @brief Complete the oldest pending write, waiting for it if it is still running.
+     */
+    void complete() noexcept;
+
+    const size_t m_MaxInFlight;
+
+    /**
+     * @brief Pending writes, from the oldest.
+     */
+    std::deque<std::unique_ptr<Write>> m_InFlight;
+
+    uint64_t m_WrittenBytes;
+
+    uint64_t m_FailedWrites;
+};
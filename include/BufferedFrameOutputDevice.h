@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Frame.h"
+#include "SeqlockSnapshot.h"
+
+class PresentationClock;
 
 /**
  * @brief Represents a buffered output device for image frames.
@@ -18,6 +21,47 @@ class BufferedFrameOutputDevice {
 public:
     typedef uint32_t FrameCountType;
 
+    /**
+     * @brief The number of buckets of the lateness histogram.
+     */
+    static constexpr size_t LatenessBuckets = 8;
+
+    /**
+     * @brief What the device has presented so far, as reported by the thread presenting frames.
+     */
+    struct Statistics {
+        uint64_t presentedFrames;
+
+        /**
+         * @brief Frames received and never presented (i.e. superseded by newer frames).
+         */
+        uint64_t droppedFrames;
+
+        FrameCountType queuedFrames;
+
+        /**
+         * @brief The bytes of frames held by the device (queued and presented).
+         */
+        uint64_t residentBytes;
+
+        /**
+         * @brief The timestamp of the last presented frame.
+         */
+        Frame::TimestampType pts;
+
+        /**
+         * @brief Presented frames by lateness: bucket i counts frames late by less than 1ms << i, the last one any later frame.
+         */
+        uint64_t lateness[LatenessBuckets];
+
+        Frame::TimestampType maxLateness;
+
+        /**
+         * @brief The time of the monotonic clock (microseconds) the statistics have been updated at.
+         */
+        Frame::TimestampType time;
+    };
+
     /**
      * @brief Construct a new Buffered Frame Output Device object
      * 
@@ -51,6 +95,117 @@ public:
      */
     FrameCountType getFramesCount() const noexcept;
 
+    /**
+     * @brief Get the preferred width of frames sent to this device.
+     * 
+     * A decoder scales frames to fit inside the preferred size (preserving the aspect ratio and never upscaling)
+     * so that pixels that would be thrown away by the device are never produced.
+     * 
+     * @return uint32_t the preferred width (in pixels) or 0 if any width is fine
+     */
+    virtual uint32_t getPreferredWidth() const noexcept;
+
+    /**
+     * @brief Get the preferred height of frames sent to this device.
+     * 
+     * @return uint32_t the preferred height (in pixels) or 0 if any height is fine
+     */
+    virtual uint32_t getPreferredHeight() const noexcept;
+
+    /**
+     * @brief Get the pixel format frames sent to this device should be converted to.
+     * 
+     * @return Frame::PixelFormat the preferred pixel format
+     */
+    virtual Frame::PixelFormat getPreferredPixelFormat() const noexcept;
+
+    /**
+     * @brief Set the values returned by the default implementation of the preferred size and format getters.
+     * 
+     * @param pf the preferred pixel format
+     * @param width the preferred width (0 = any)
+     * @param height the preferred height (0 = any)
+     */
+    void setPreferredFrameFormat(Frame::PixelFormat pf, uint32_t width, uint32_t height) noexcept;
+
+    /**
+     * @brief Set the speed of the clock used to decide when frames have to be shown.
+     * 
+     * This is called by the decoder when the playback is paused (rate 0), resumed or its speed changes:
+     * while the clock is stopped the device is supposed to show the most recently enqueued frame
+     * (as this is how frame stepping is presented).
+     * 
+     * @param rate the clock speed relative to frame timestamps (1.0 = real time, 0.0 = stopped)
+     */
+    virtual void setClockRate(double rate) noexcept;
+
+    double getClockRate() const noexcept;
+
+    /**
+     * @brief Make the device follow a presentation clock shared with other devices (and processes) instead of its local clock.
+     *
+     * Frames are presented when the shared clock reaches their timestamp, ahead of time by the latency of the device
+     * (the time between the presentation of a frame and its appearance on screen), so that devices with different
+     * latencies show the same frame at the same time; the clock rate set by the decoder is ignored.
+     *
+     * This MUST be called before exec.
+     *
+     * @param clock the shared clock (nullptr to follow the local clock again)
+     * @param latency the latency of the device (microseconds)
+     * @return false IIF the device cannot follow a shared clock (see isFollowingPresentationClocks): the clock is not set
+     */
+    bool setPresentationClock(std::shared_ptr<PresentationClock> clock, Frame::TimestampType latency) noexcept;
+
+    /**
+     * @brief Check if the device can present frames following a shared presentation clock.
+     *
+     * Devices that hand frames to something else as soon as they come (a consumer process, other devices) cannot:
+     * the clock has to be followed by whatever presents frames in the end.
+     */
+    virtual bool isFollowingPresentationClocks() const noexcept;
+
+    const std::shared_ptr<PresentationClock>& getPresentationClock() const noexcept;
+
+    Frame::TimestampType getPresentationLatency() const noexcept;
+
+    /**
+     * @brief Check if the device reports how many frames are waiting to be presented (see getQueuedFrames).
+     */
+    bool isReportingQueuedFrames() const noexcept;
+
+    /**
+     * @brief Get the number of frames enqueued and not presented yet.
+     * 
+     * @return FrameCountType the number of queued frames (always 0 for devices not reporting it)
+     */
+    FrameCountType getQueuedFrames() const noexcept;
+
+    /**
+     * @brief Get a consistent copy of the statistics of the device.
+     * 
+     * This can be called from any thread, it never blocks the thread presenting frames.
+     * Devices that do not report presentations give statistics that are all zero.
+     */
+    Statistics getStatistics() const noexcept;
+
+    /**
+     * @brief Sleep until no more than the given number of frames is queued or until wakeQueueWaiters is called.
+     * 
+     * This lets a decoder produce frames in bursts and sleep in between: the waiter is woken once, when the queue
+     * drains to the watermark, instead of every time a frame is presented.
+     * 
+     * @param watermark the number of queued frames that ends the wait
+     * @param generation the value of getQueueWakeGeneration read before deciding to wait (a wake-up in between is not lost)
+     */
+    void waitForQueuedFrames(FrameCountType watermark, uint64_t generation) noexcept;
+
+    uint64_t getQueueWakeGeneration() const noexcept;
+
+    /**
+     * @brief End every waitForQueuedFrames call (i.e. because the decoder has been given a command).
+     */
+    void wakeQueueWaiters() noexcept;
+
     /**
      * @brief enqueue a Frame object to be shown when the right timing comes.
      * 
@@ -77,7 +232,109 @@ public:
      */
     virtual void exec() noexcept = 0;
 
+protected:
+    /**
+     * @brief How often the shared presentation clock is looked at while waiting (microseconds).
+     */
+    static constexpr Frame::TimestampType SharedClockPollInterval = 10000;
+
+    /**
+     * @brief Hold a frame until the shared presentation clock reaches it, arriving at its start barrier while it is stopped.
+     * 
+     * This MUST be called by the thread presenting frames only (the one running exec).
+     * 
+     * @param frame the frame to be presented
+     * @param mutex the mutex the device holds when it sets shouldStop
+     * @param wakeup the condition variable the device notifies when it sets shouldStop
+     * @param shouldStop the flag telling the device has been interrupted
+     * @param lateness receives how late (microseconds) the frame has been released to be presented
+     * @return false IIF the device has been interrupted
+     */
+    bool waitSharedPresentationTime(
+        const Frame& frame,
+        std::mutex& mutex,
+        std::condition_variable& wakeup,
+        const std::atomic_bool& shouldStop,
+        Frame::TimestampType& lateness
+    ) noexcept;
+
+    /**
+     * @brief Check if a frame is already due on the shared presentation clock.
+     * 
+     * Devices use this on the frame queued after the one they are about to present: showing every frame late
+     * would keep the device behind the others, so it skips to the newest due frame instead.
+     */
+    bool isDueOnPresentationClock(const Frame& frame) const noexcept;
+
+    /**
+     * @brief Report the number of frames waiting to be presented.
+     * 
+     * Devices call this every time their queue changes; the first call marks the device as reporting queued frames.
+     * It costs an atomic store unless a waiter has to be woken up.
+     * 
+     * @param queued the number of queued frames
+     */
+    void setQueuedFrames(FrameCountType queued) noexcept;
+
+    /**
+     * @brief Report that a frame has been presented.
+     * 
+     * This MUST be called by the thread presenting frames only (the one running exec).
+     * 
+     * @param frame the presented frame
+     * @param lateness how late the frame has been presented (microseconds)
+     */
+    void reportPresentedFrame(const Frame& frame, Frame::TimestampType lateness) noexcept;
+
+    /**
+     * @brief Report frames that will never be presented.
+     * 
+     * This MUST be called by the thread presenting frames only (the one running exec).
+     */
+    void reportDroppedFrames(uint64_t frames) noexcept;
+
 private:
     FrameCountType m_FramesCount;
 
+    Frame::PixelFormat m_PreferredPixelFormat;
+
+    uint32_t m_PreferredWidth;
+
+    uint32_t m_PreferredHeight;
+
+    std::atomic<double> m_ClockRate;
+
+    std::shared_ptr<PresentationClock> m_PresentationClock;
+
+    Frame::TimestampType m_PresentationLatency;
+
+    /**
+     * @brief The generation of the last start barrier of the shared clock the device arrived at.
+     */
+    uint32_t m_ArrivedGeneration;
+
+    std::atomic_bool m_ReportingQueuedFrames;
+
+    std::atomic<FrameCountType> m_QueuedFrames;
+
+    /**
+     * @brief The watermark a waiter is sleeping for (meaningful only while m_HasQueueWaiter is set).
+     */
+    std::atomic<FrameCountType> m_QueueWatermark;
+
+    std::atomic_bool m_HasQueueWaiter;
+
+    std::atomic<uint64_t> m_QueueWakeGeneration;
+
+    std::mutex m_QueueWaitMutex;
+
+    std::condition_variable m_QueueDrained;
+
+    /**
+     * @brief The statistics being updated by the thread presenting frames.
+     */
+    Statistics m_Counters;
+
+    SeqlockSnapshot<Statistics> m_Statistics;
+
 };
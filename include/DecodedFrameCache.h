@@ -0,0 +1,209 @@
+#pragma once
+
+#include "Frame.h"
+
+struct AVFrame;
+
+/**
+ * @brief A window of recently decoded frames around the playhead.
+ *
+ * The window is ordered by presentation timestamp: new frames are appended at the back while
+ * re-decoded older frames can be prepended at the front; a cursor marks the frame currently on screen.
+ * Frames within the window can be shown again (stepping, short rewinds, A-B loops, scrubbing) without
+ * demuxing or decoding anything.
+ *
+ * The window size is governed by a byte budget: appending a frame drops the oldest ones until
+ * the new frame fits. Entries are kept in a ring that only grows: once the window covers the budget, frames
+ * are added and dropped without allocating. Frames can be stored either:
+ *   - natively, as references to the decoder buffers (compact YUV, re-display needs a conversion)
+ *   - converted, as a copy of the pixel data sent to the output device (re-display is a memcpy)
+ *
+ * A cache is owned by the decoding thread and MUST NOT be shared between threads.
+ */
+class DecodedFrameCache {
+
+public:
+    enum class StorageMode {
+        Native,
+        Converted,
+    };
+
+    /**
+     * @brief A cached frame: exactly one of native and pixels holds the frame data, depending on the storage mode.
+     */
+    struct Entry {
+        AVFrame* native;
+
+        std::vector<uint8_t> pixels;
+
+        Frame::PixelFormat pixelFormat;
+
+        uint32_t width;
+
+        uint32_t height;
+
+        Frame::TimestampType pts;
+
+        size_t bytes;
+    };
+
+    /**
+     * @brief Construct a new Decoded Frame Cache object
+     *
+     * @param budget the maximum number of bytes used by cached frames
+     * @param mode how frames are stored
+     */
+    DecodedFrameCache(size_t budget, StorageMode mode = StorageMode::Native) noexcept;
+
+    ~DecodedFrameCache();
+
+    DecodedFrameCache(const DecodedFrameCache&) = delete;
+
+    DecodedFrameCache(DecodedFrameCache&&) = delete;
+
+    DecodedFrameCache& operator=(const DecodedFrameCache&) = delete;
+
+    DecodedFrameCache& operator=(DecodedFrameCache&&) = delete;
+
+    /**
+     * @brief Change the byte budget and the storage mode, dropping every cached frame.
+     */
+    void configure(size_t budget, StorageMode mode) noexcept;
+
+    size_t getBudget() const noexcept;
+
+    StorageMode getStorageMode() const noexcept;
+
+    size_t getCount() const noexcept;
+
+    /**
+     * @brief Get the number of bytes used by cached frames.
+     */
+    size_t getResidentBytes() const noexcept;
+
+    /**
+     * @brief Drop every cached frame.
+     */
+    void clear() noexcept;
+
+    /**
+     * @brief Append the newest frame (native storage) and move the cursor on it.
+     *
+     * @param frame the decoded frame: only a new reference is taken
+     * @param pts the presentation timestamp of the frame
+     * @return true IIF the frame has been stored
+     */
+    bool pushBack(const AVFrame* frame, Frame::TimestampType pts) noexcept;
+
+    /**
+     * @brief Append the newest frame (converted storage) and move the cursor on it.
+     *
+     * @return void* the memory the caller MUST fill with the converted pixels or nullptr if the frame does not fit the budget
+     */
+    void* pushBackConverted(Frame::PixelFormat pf, uint32_t width, uint32_t height, Frame::TimestampType pts) noexcept;
+
+    /**
+     * @brief Prepend a frame (native storage) older than every cached one, without moving the cursor.
+     *
+     * Nothing happens if the frame does not fit the remaining budget.
+     *
+     * @return true IIF the frame has been stored
+     */
+    bool pushFront(const AVFrame* frame, Frame::TimestampType pts) noexcept;
+
+    /**
+     * @brief Prepend a frame (converted storage) older than every cached one, without moving the cursor.
+     *
+     * @return void* the memory the caller MUST fill with the converted pixels or nullptr if the frame does not fit the remaining budget
+     */
+    void* pushFrontConverted(Frame::PixelFormat pf, uint32_t width, uint32_t height, Frame::TimestampType pts) noexcept;
+
+    /**
+     * @brief Get the frame under the cursor.
+     *
+     * @return const Entry* the current frame or nullptr if the cache is empty
+     */
+    const Entry* current() const noexcept;
+
+    /**
+     * @brief Get the timestamp of the oldest cached frame.
+     */
+    Frame::TimestampType oldestTimestamp() const noexcept;
+
+    /**
+     * @brief Get the timestamp of the newest cached frame.
+     */
+    Frame::TimestampType newestTimestamp() const noexcept;
+
+    /**
+     * @brief Move the cursor on the frame shown at the given timestamp.
+     *
+     * @param pts the timestamp to look for
+     * @return const Entry* the frame with the greatest timestamp not after pts or nullptr if pts is outside of the cached window
+     */
+    const Entry* moveTo(Frame::TimestampType pts) noexcept;
+
+    /**
+     * @brief Move the cursor one frame back.
+     *
+     * @return const Entry* the new current frame or nullptr if the cursor is already on the oldest frame
+     */
+    const Entry* stepBackward() noexcept;
+
+    /**
+     * @brief Move the cursor one frame forward.
+     *
+     * @return const Entry* the new current frame or nullptr if the cursor is already on the newest frame
+     */
+    const Entry* stepForward() noexcept;
+
+    /**
+     * @brief Check if the cursor is on the newest cached frame.
+     */
+    bool isAtNewest() const noexcept;
+
+private:
+    static size_t nativeSizeOf(const AVFrame* frame) noexcept;
+
+    bool makeRoom(size_t bytes, bool evict) noexcept;
+
+    void release(Entry& entry) noexcept;
+
+    Entry* prepareEntry(size_t bytes, bool atBack) noexcept;
+
+    /**
+     * @brief Get a cached frame by its position in the window (0 = the oldest).
+     */
+    Entry& entryAt(size_t index) noexcept;
+
+    const Entry& entryAt(size_t index) const noexcept;
+
+    /**
+     * @brief Double the capacity of the ring, keeping the order of entries.
+     */
+    void grow() noexcept;
+
+    size_t m_Budget;
+
+    StorageMode m_Mode;
+
+    size_t m_ResidentBytes;
+
+    /**
+     * @brief The ring of entries: m_Count entries starting from m_First, oldest first.
+     */
+    std::vector<Entry> m_Entries;
+
+    size_t m_First;
+
+    size_t m_Count;
+
+    size_t m_Cursor;
+
+    /**
+     * @brief Frame structures and pixel buffers of dropped frames, reused by the next ones.
+     */
+    std::vector<AVFrame*> m_SpareFrames;
+
+    std::vector<std::vector<uint8_t>> m_SpareBuffers;
+};
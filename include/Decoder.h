@@ -2,6 +2,8 @@
 
 #include "BufferedFrameOutputDevice.h"
 
+class FrameCompositor;
+
 /**
  * @brief The decoder application logic
  * 
@@ -16,7 +18,10 @@
  * non-blocking methods).
  * 
  * Playback is done emitting frames (objects of type Frame) with actual data inside them,
- * this means that allocator and deallocator callback must also be provided.
+ * this means that a frame allocator must also be provided.
+ * 
+ * Decoders that support it can also be driven by the caller, without a playback thread: frames are
+ * then pulled one by one (nextFrame, frames or, from a coroutine, co_await decoder.next()).
  * 
  * A video decoder is not meant to be an object shared between threads: is has to be implemented as
  * its public methods are called by the creating thread and it MUST be used that way.
@@ -26,21 +31,69 @@ class Decoder {
 public:
     typedef std::string FileNameType;
 
+    /**
+     * @brief The filter used when frames are resized to the size requested by the output device.
+     * 
+     * Filters are listed from the fastest to the one giving the best quality.
+     */
+    enum class ScalingFilter {
+        Point,
+        FastBilinear,
+        Bilinear,
+        Bicubic,
+        Area,
+        Lanczos,
+    };
+
+    /**
+     * @brief What the decoder has done since it has been created, as reported by its decoding thread.
+     */
+    struct Statistics {
+        uint64_t decodedFrames;
+
+        /**
+         * @brief Frames sent to the output device (or pulled by the caller).
+         */
+        uint64_t emittedFrames;
+
+        /**
+         * @brief Decoded frames that have not been emitted as they were decoded (i.e. dropped at high rates, unchanged or decoded while seeking).
+         */
+        uint64_t skippedFrames;
+
+        /**
+         * @brief The frames per second the decoder can decode, from the average time decoding a frame takes.
+         */
+        double decodeRate;
+
+        /**
+         * @brief The frames per second the decoder can convert to the output format.
+         */
+        double convertRate;
+
+        /**
+         * @brief The timestamp of the last emitted frame.
+         */
+        Frame::TimestampType pts;
+
+        /**
+         * @brief The time of the monotonic clock (microseconds) the statistics have been updated at.
+         */
+        Frame::TimestampType time;
+    };
+
     /**
      * @brief Construct a new Decoder object
      * 
-     * Every decoder MUST call this constructor keeping in mind that lifetime of objects used inside the two provided
-     * functions must be carefully thought as there are no guarantees other than the one specified in the BufferedFrameOutputDevice
-     * as to when the deallocate function has to be called.
+     * Every decoder MUST call this constructor keeping in mind that the allocator must outlive every emitted frame
+     * as there are no guarantees other than the one specified in the BufferedFrameOutputDevice as to when frames are released.
      * 
      * @param outputDev the output device frames will be sent to
-     * @param allocate the memory allocator function that will be called to fill a new frame with pixel data
-     * @param deallocate the memory deallocator function that will be called when a decoded frame is not needed anymore
+     * @param allocator the allocator that provides memory for new frames and gets it back when a frame is not needed anymore
      */
     Decoder(
         BufferedFrameOutputDevice* outputDev,
-        const Frame::AllocatorFunctionType& allocate,
-        const Frame::DeallocatorFunctionType& deallocate
+        FrameAllocator* allocator
     ) noexcept;
 
     /**
@@ -78,7 +131,196 @@ public:
 
     virtual void stop() noexcept = 0;
 
+    /**
+     * @brief Suspend the playback keeping the loaded file and every decoder resource ready to resume.
+     * 
+     * Decoders that cannot control the playback ignore this command.
+     */
+    virtual void pause() noexcept;
+
+    /**
+     * @brief Resume a paused playback.
+     */
+    virtual void resume() noexcept;
+
+    /**
+     * @brief Change the playback speed.
+     * 
+     * Above normal speed frames that would be shown for less than their duration are not emitted and, over a certain
+     * rate, only keyframes are decoded (trick play).
+     * 
+     * @param rate the playback rate: 1.0 is the normal speed, values must be greater than zero
+     */
+    virtual void setRate(double rate) noexcept;
+
+    /**
+     * @brief Pause the playback (if not paused already) and emit the frame following the last emitted one.
+     */
+    virtual void stepForward() noexcept;
+
+    /**
+     * @brief Pause the playback (if not paused already) and emit the frame preceding the last emitted one.
+     */
+    virtual void stepBackward() noexcept;
+
+    /**
+     * @brief Move the playback to the frame shown at the given timestamp.
+     * 
+     * A paused decoder stays paused and emits the frame at the new position (scrubbing).
+     * 
+     * @param pts the target timestamp (in microseconds)
+     */
+    virtual void seek(Frame::TimestampType pts) noexcept;
+
+    /**
+     * @brief Repeat the playback between two timestamps (A-B repeat).
+     * 
+     * When the playback reaches the end timestamp it jumps back to the start timestamp.
+     * 
+     * @param start the timestamp of the loop start (in microseconds)
+     * @param end the timestamp of the loop end (in microseconds)
+     */
+    virtual void setLoop(Frame::TimestampType start, Frame::TimestampType end) noexcept;
+
+    /**
+     * @brief Stop repeating the playback between two timestamps.
+     */
+    virtual void clearLoop() noexcept;
+
+    /**
+     * @brief Select the filter used to resize frames.
+     * 
+     * The new filter is used starting from the next played file.
+     * 
+     * @param filter the scaling filter
+     */
+    void setScalingFilter(ScalingFilter filter) noexcept;
+
+    ScalingFilter getScalingFilter() const noexcept;
+
+    /**
+     * @brief Composite overlays onto every frame before it leaves the decoder (enqueued or pulled).
+     * 
+     * This MUST NOT be called while playing.
+     * 
+     * @param compositor the compositor, shared with whoever changes its layers (nullptr to stop compositing)
+     */
+    void setCompositor(std::shared_ptr<FrameCompositor> compositor) noexcept;
+
+    const std::shared_ptr<FrameCompositor>& getCompositor() const noexcept;
+
+    /**
+     * @brief Get a consistent copy of the statistics of the decoder.
+     * 
+     * Unlike every other method this can be called from any thread (i.e. by a monitoring thread) and it never
+     * blocks the decoding thread. Decoders that do not report statistics give statistics that are all zero.
+     */
+    Statistics getStatistics() const noexcept;
+
+    /**
+     * @brief Demux and decode the next frame on the calling thread, without sending it to the output device.
+     * 
+     * This is the pull counterpart of play: it MUST NOT be used while playing. Decoders that cannot
+     * be driven by the caller always return an empty value.
+     * 
+     * @return std::optional<Frame> the next frame or an empty value if there are no more frames
+     */
+    virtual std::optional<Frame> nextFrame() noexcept;
+
+    /**
+     * @brief An input iterator over pulled frames.
+     */
+    class FrameIterator {
+
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef Frame value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Frame* pointer;
+        typedef Frame& reference;
+
+        FrameIterator() noexcept;
+
+        explicit FrameIterator(Decoder* decoder) noexcept;
+
+        Frame& operator*() noexcept;
+
+        Frame* operator->() noexcept;
+
+        FrameIterator& operator++() noexcept;
+
+        bool operator==(const FrameIterator& other) const noexcept;
+
+        bool operator!=(const FrameIterator& other) const noexcept;
+
+    private:
+        Decoder* m_Decoder;
+
+        std::optional<Frame> m_Current;
+    };
+
+    /**
+     * @brief A range of pulled frames: for (auto& frame : decoder.frames()) { ... }
+     */
+    class FrameRange {
+
+    public:
+        explicit FrameRange(Decoder* decoder) noexcept;
+
+        FrameIterator begin() noexcept;
+
+        FrameIterator end() noexcept;
+
+    private:
+        Decoder* m_Decoder;
+    };
+
+    FrameRange frames() noexcept;
+
+    /**
+     * @brief The awaitable returned by next.
+     * 
+     * It never suspends the awaiting coroutine: the frame is decoded on whatever executor resumed
+     * that coroutine, with no dedicated thread and no queue in between.
+     */
+    class NextFrameAwaitable {
+
+    public:
+        explicit NextFrameAwaitable(Decoder* decoder) noexcept;
+
+        bool await_ready() const noexcept;
+
+        template <typename CoroutineHandle>
+        void await_suspend(CoroutineHandle) const noexcept {}
+
+        std::optional<Frame> await_resume() noexcept;
+
+    private:
+        Decoder* m_Decoder;
+    };
+
+    /**
+     * @brief Pull the next frame from a coroutine: auto frame = co_await decoder.next();
+     */
+    NextFrameAwaitable next() noexcept;
+
 protected:
+    BufferedFrameOutputDevice* getOutputDevice() const noexcept;
+
+    /**
+     * @brief Make emitFrame store frames in the given place instead of enqueueing them to the output device.
+     * 
+     * @param target where the next emitted frame is stored or nullptr to send frames to the output device again
+     */
+    void setPullTarget(std::optional<Frame>* target) noexcept;
+
+    /**
+     * @brief Make new statistics visible to getStatistics.
+     * 
+     * This MUST be called by one thread at a time (the decoding thread).
+     */
+    void publishStatistics(const Statistics& statistics) noexcept;
+
     /**
      * @brief Emit a frame decoded by the playback thread
      * 
@@ -88,20 +330,50 @@ protected:
      * @param pf the frame pixel format
      * @param width the frame width (in pixels)
      * @param height the frame height (in pixels)
+     * @param pts the frame presentation timestamp (in microseconds)
      * @param frameFillerFn the function that is responsible to fill the frame with provided information
+     * @param sourceIndex the index of the input the frame has been decoded from
+     * @param dirtyRect the region that changed since the previous frame (empty value = the whole frame)
      */
     void emitFrame(
         Frame::PixelFormat pf,
         uint32_t width,
         uint32_t height,
-        const Frame::FrameFillerFunctionType& frameFillerFn
+        Frame::TimestampType pts,
+        Frame::FrameFillerFunctionType frameFillerFn,
+        Frame::SourceIndexType sourceIndex = 0,
+        std::optional<Frame::Rect> dirtyRect = std::nullopt
+    ) noexcept;
+
+    /**
+     * @brief Emit a frame to an output device other than the one given at construction time.
+     * 
+     * This is used by decoders producing more than one stream of frames.
+     * 
+     * @param device the output device the frame is sent to
+     */
+    void emitFrameTo(
+        BufferedFrameOutputDevice* device,
+        Frame::PixelFormat pf,
+        uint32_t width,
+        uint32_t height,
+        Frame::TimestampType pts,
+        Frame::FrameFillerFunctionType frameFillerFn,
+        Frame::SourceIndexType sourceIndex = 0,
+        std::optional<Frame::Rect> dirtyRect = std::nullopt
     ) noexcept;
 
 private:
     BufferedFrameOutputDevice* m_OutputDevice;
 
-    Frame::AllocatorFunctionType m_AllocatorFn;
+    FrameAllocator* m_Allocator;
+
+    std::optional<Frame>* m_PullTarget;
+
+    ScalingFilter m_ScalingFilter;
+
+    std::shared_ptr<FrameCompositor> m_Compositor;
 
-    Frame::DeallocatorFunctionType m_DeallocatorFn;
+    SeqlockSnapshot<Statistics> m_Statistics;
 
 };
@@ -28,9 +28,12 @@
 // STL algorithms
 #include <algorithm>
 #include <utility>
+#include <iterator>
 #include <limits>
 
 // STL thread
+#include <atomic>
+#include <condition_variable>
 #include <future>
 #include <thread>
 #include <mutex>
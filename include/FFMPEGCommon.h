@@ -0,0 +1,144 @@
+#pragma once
+
+#include "Decoder.h"
+
+// ffmpeg
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/mathematics.h>
+#include <libavutil/pixdesc.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+#include <libavcodec/avcodec.h>
+}
+
+/**
+ * @brief Helpers shared by every ffmpeg-based decoder.
+ */
+namespace FFMPEGCommon {
+
+    /**
+     * @brief Get the ffmpeg pixel format matching the memory layout of the given frame pixel format.
+     *
+     * @param pf the frame pixel format
+     * @return AVPixelFormat the matching ffmpeg pixel format
+     */
+    inline AVPixelFormat toAVPixelFormat(Frame::PixelFormat pf) noexcept {
+        switch (pf) {
+            case Frame::PixelFormat::RGBA64:
+                return AV_PIX_FMT_RGBA64;
+
+            case Frame::PixelFormat::RGBA32:
+                return AV_PIX_FMT_RGBA;
+
+            case Frame::PixelFormat::NV12:
+                return AV_PIX_FMT_NV12;
+        }
+
+        // this MUST NOT happend
+        return AV_PIX_FMT_NONE;
+    }
+
+    /**
+     * @brief Point every plane of a frame stored in the given memory, in the layout expected by sws_scale.
+     *
+     * @param pf the frame pixel format
+     * @param mem the frame memory
+     * @param width the number of horizontal pixels
+     * @param height the number of vertical pixels
+     * @param data filled with the start of each plane
+     * @param linesize filled with the stride of each plane
+     */
+    inline void framePlanes(Frame::PixelFormat pf, void* mem, uint32_t width, uint32_t height, uint8_t* data[4], int linesize[4]) noexcept {
+        av_image_fill_arrays(data, linesize, reinterpret_cast<const uint8_t*>(mem), toAVPixelFormat(pf), static_cast<int>(width), static_cast<int>(height), 1);
+    }
+
+    /**
+     * @brief Get the swscale flags selecting the given scaling filter.
+     */
+    inline int toSwsFlags(Decoder::ScalingFilter filter) noexcept {
+        switch (filter) {
+            case Decoder::ScalingFilter::Point:
+                return SWS_POINT;
+
+            case Decoder::ScalingFilter::FastBilinear:
+                return SWS_FAST_BILINEAR;
+
+            case Decoder::ScalingFilter::Bilinear:
+                return SWS_BILINEAR;
+
+            case Decoder::ScalingFilter::Bicubic:
+                return SWS_BICUBIC;
+
+            case Decoder::ScalingFilter::Area:
+                return SWS_AREA;
+
+            case Decoder::ScalingFilter::Lanczos:
+                return SWS_LANCZOS;
+        }
+
+        return SWS_BILINEAR;
+    }
+
+    /**
+     * @brief Get the largest lowres factor (the decoder outputs frames 2^factor times smaller) the codec
+     * supports that still produces frames at least as large as the target.
+     *
+     * @param codec the codec that will decode frames
+     * @param srcWidth the width of encoded frames
+     * @param srcHeight the height of encoded frames
+     * @param dstWidth the target width
+     * @param dstHeight the target height
+     * @return int the lowres factor to be set on the codec context before opening it
+     */
+    inline int lowresFactor(const AVCodec* codec, uint32_t srcWidth, uint32_t srcHeight, uint32_t dstWidth, uint32_t dstHeight) noexcept {
+        int factor = 0;
+        while ((factor < codec->max_lowres) && ((srcWidth >> (factor + 1)) >= dstWidth) && ((srcHeight >> (factor + 1)) >= dstHeight)) {
+            ++factor;
+        }
+
+        return factor;
+    }
+
+    /**
+     * @brief Get the presentation timestamp of a decoded frame in microseconds.
+     *
+     * @param frame the decoded frame
+     * @param timeBase the time base of the stream the frame belongs to
+     * @return Frame::TimestampType the presentation timestamp or 0 if the frame carries none
+     */
+    inline Frame::TimestampType presentationTimestamp(const AVFrame* frame, AVRational timeBase) noexcept {
+        if (frame->best_effort_timestamp == AV_NOPTS_VALUE) {
+            return 0;
+        }
+
+        return av_rescale_q(frame->best_effort_timestamp, timeBase, AV_TIME_BASE_Q);
+    }
+
+    /**
+     * @brief Compute the largest size that fits inside the given box preserving the aspect ratio of the source.
+     *
+     * A box dimension of zero means "unconstrained"; the result is never larger than the source and both
+     * dimensions are even, as required by most chroma-subsampled formats.
+     */
+    inline std::pair<uint32_t, uint32_t> fitInside(uint32_t srcWidth, uint32_t srcHeight, uint32_t boxWidth, uint32_t boxHeight) noexcept {
+        if ((srcWidth == 0) || (srcHeight == 0)) {
+            return std::make_pair(srcWidth, srcHeight);
+        }
+
+        double scale = 1.0;
+        if (boxWidth != 0) {
+            scale = std::min(scale, static_cast<double>(boxWidth) / static_cast<double>(srcWidth));
+        }
+
+        if (boxHeight != 0) {
+            scale = std::min(scale, static_cast<double>(boxHeight) / static_cast<double>(srcHeight));
+        }
+
+        const uint32_t width = std::max<uint32_t>(2, static_cast<uint32_t>(srcWidth * scale) & ~1u);
+        const uint32_t height = std::max<uint32_t>(2, static_cast<uint32_t>(srcHeight * scale) & ~1u);
+
+        return std::make_pair(width, height);
+    }
+
+}
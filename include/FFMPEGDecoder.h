@@ -1,33 +1,812 @@
 #pragma once
 
 #include "Decoder.h"
+#include "DecodedFrameCache.h"
+#include "IntraFrameDecoderPool.h"
+#include "LivePlayoutBuffer.h"
+#include "FrameChangeDetector.h"
+#include "ToneMapper.h"
+#include "FramePipeline.h"
+#include "NumaTopology.h"
+#include "RenditionLoader.h"
+#include "SubtitleDecoder.h"
+#include "ProxyCache.h"
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
 
 /**
  * @brief The implementation of a decoder that uses FFMPEG.
- * 
+ *
  * Uses libavcoded, which is part of ffmpeg to decode video files.
  */
 class FFMPEGDecoder : public Decoder {
 
 public:
+    /**
+     * @brief Playback rates greater or equal to this value only decode keyframes.
+     */
+    static constexpr double KeyframesOnlyRate = 4.0;
+
+    /**
+     * @brief The default number of bytes used to keep decoded frames around the playhead.
+     */
+    static constexpr size_t DefaultFrameCacheBudget = 256 * 1024 * 1024;
+
+    /**
+     * @brief How a live input is played.
+     * 
+     * A live input can be tested against a local stand-in fed by a file, for example:
+     *   - a loopback UDP stream: ffmpeg -re -i sample.mp4 -c copy -f mpegts udp://127.0.0.1:5000
+     *     played loading "udp://127.0.0.1:5000"
+     *   - a pipe: mkfifo /tmp/live.ts && ffmpeg -re -i sample.mp4 -c copy -f mpegts -y /tmp/live.ts
+     *     played loading "/tmp/live.ts" (or "pipe:0" when the stream is written to the standard input)
+     */
+    struct LiveOptions {
+        /**
+         * @brief The minimum time (in microseconds) a frame waits in the jitter buffer.
+         */
+        Frame::TimestampType minDelay = 20000;
+
+        /**
+         * @brief The maximum time (in microseconds) a frame waits in the jitter buffer.
+         */
+        Frame::TimestampType maxDelay = 500000;
+
+        /**
+         * @brief How late (in microseconds) a frame can be before being dropped to catch up with the live edge.
+         */
+        Frame::TimestampType catchUpThreshold = 100000;
+    };
+
+    /**
+     * @brief Latency measurements of the live input being played (every time is expressed in microseconds).
+     */
+    struct LiveStatistics {
+        /**
+         * @brief The time between the capture of the last presented frame and its presentation,
+         * only known when the input carries a wall clock reference (i.e. RTSP with RTCP sender reports).
+         */
+        std::optional<Frame::TimestampType> glassToGlassLatency;
+
+        /**
+         * @brief The time between the decoding of the last presented frame and its presentation.
+         */
+        Frame::TimestampType receiveToPresentLatency;
+
+        Frame::TimestampType playoutDelay;
+
+        Frame::TimestampType jitter;
+
+        /**
+         * @brief The number of frames dropped as they were behind the live edge.
+         */
+        uint64_t droppedFrames;
+    };
+
+    /**
+     * @brief When the decoder switches between renditions of an asset.
+     *
+     * The load is the time spent decoding and converting a frame over the time the frame is shown for.
+     */
+    struct RenditionOptions {
+        /**
+         * @brief A load above this switches to the next smaller rendition.
+         */
+        double downgradeLoad = 0.85;
+
+        /**
+         * @brief The load expected on the next larger rendition (scaled by its number of pixels) has to be below this to switch to it.
+         */
+        double upgradeLoad = 0.6;
+
+        /**
+         * @brief The number of consecutive frames emitted with an empty output device queue that switches to a smaller rendition.
+         */
+        uint32_t starvedFrames = 3;
+
+        /**
+         * @brief The time (in microseconds) spent on a rendition before switching to a larger one.
+         */
+        Frame::TimestampType upgradeDelay = 10000000;
+
+        /**
+         * @brief How far ahead of the playback (in microseconds) the next rendition is prepared, as it starts from a keyframe.
+         */
+        Frame::TimestampType switchAhead = 1000000;
+    };
+
+    /**
+     * @brief The rendition being played.
+     */
+    struct RenditionStatistics {
+        std::optional<FileNameType> active;
+
+        uint32_t width;
+
+        uint32_t height;
+
+        /**
+         * @brief The average load of the last frames.
+         */
+        double load;
+
+        /**
+         * @brief The number of switches since the playback started.
+         */
+        uint64_t switches;
+
+        /**
+         * @brief Set while another rendition is being prepared.
+         */
+        bool switching;
+    };
+
+    /**
+     * @brief How the playback thread paces decoding to save power.
+     * 
+     * Instead of decoding a frame every time the output device presents one (waking up once per frame), frames are
+     * decoded in bursts until the high watermark of queued frames is reached, then the playback thread sleeps until
+     * the output device drains its queue to the low watermark. Pacing needs an output device that reports its queue
+     * (see BufferedFrameOutputDevice::isReportingQueuedFrames) and is not used on live inputs.
+     */
+    struct PacingOptions {
+        /**
+         * @brief The number of queued frames that ends a burst (0 = the frame count of the output device).
+         */
+        BufferedFrameOutputDevice::FrameCountType highWatermark = 0;
+
+        /**
+         * @brief The number of queued frames that starts a burst (0 = a quarter of the high watermark).
+         */
+        BufferedFrameOutputDevice::FrameCountType lowWatermark = 0;
+
+        /**
+         * @brief How late (in microseconds) timers of the decoding threads may expire, so that the kernel can coalesce them.
+         */
+        Frame::TimestampType timerSlack = 5000;
+    };
+
+    /**
+     * @brief The energy spent by the player since playback started.
+     */
+    struct PowerStatistics {
+        /**
+         * @brief The number of times a thread of the process has been woken up from a sleep, per second.
+         */
+        double wakeupsPerSecond;
+
+        /**
+         * @brief The CPU time (in microseconds) used by the process per second of played media.
+         */
+        double cpuTimePerPlayedSecond;
+
+        /**
+         * @brief The media time emitted (in microseconds).
+         */
+        Frame::TimestampType playedTime;
+
+        /**
+         * @brief The number of times the playback thread went to sleep at the high watermark.
+         */
+        uint64_t bursts;
+    };
+
+    /**
+     * @brief Where the threads decoding the playing file run.
+     */
+    struct PlacementStatistics {
+        /**
+         * @brief The NUMA node threads have been placed on (empty when they are not placed).
+         */
+        std::optional<NumaTopology::NodeType> node;
+
+        /**
+         * @brief The CPU the last frame has been converted on.
+         */
+        std::optional<uint32_t> cpu;
+
+        /**
+         * @brief The NUMA node of that CPU.
+         */
+        std::optional<NumaTopology::NodeType> cpuNode;
+
+        /**
+         * @brief The number of frames converted on a CPU of another node than the one threads have been placed on.
+         */
+        uint64_t offNodeFrames;
+    };
+
     FFMPEGDecoder(
         BufferedFrameOutputDevice* outputDev,
-        const Frame::AllocatorFunctionType& allocate,
-        const Frame::DeallocatorFunctionType& deallocate
+        FrameAllocator* allocator
     ) noexcept;
 
     ~FFMPEGDecoder() override;
 
     void loadFile(const FileNameType& filename) noexcept override;
 
+    /**
+     * @brief Loads a live input (pipe, UDP, RTSP, ...) to be played with the lowest possible latency.
+     * 
+     * Demuxer buffering is disabled, the stream is probed as little as possible, the codec runs in
+     * low delay mode and decoded frames are paced by an adaptive jitter buffer that drops frames
+     * when the playback falls behind the live edge.
+     * 
+     * @param filename the URL of the live input
+     * @param options the jitter buffer configuration
+     */
+    void loadFile(const FileNameType& filename, const LiveOptions& options) noexcept;
+
+    /**
+     * @brief Loads an asset available as several renditions (the same content at different resolutions or bitrates).
+     * 
+     * The playback starts from the smallest rendition covering the preferred size of the output device (renditions
+     * larger than that are never played) and moves to a smaller rendition when the decoder cannot keep up, coming
+     * back when there is enough headroom. The next rendition is opened in the background and the switch happens on one
+     * of its keyframes, while frames keep the size of the first rendition, so that the output device sees no change.
+     * 
+     * Renditions MUST share the same timeline. Stepping, seeking and loops work as usual; the frame cache holds
+     * frames of whichever rendition decoded them.
+     * 
+     * @param renditions the files of the renditions, in any order
+     * @param options when to switch
+     */
+    void loadRenditions(const std::vector<FileNameType>& renditions, const RenditionOptions& options) noexcept;
+
+    RenditionStatistics getRenditionStatistics() noexcept;
+
+    /**
+     * @brief Get the latency measurements of the live input being played.
+     */
+    LiveStatistics getLiveStatistics() noexcept;
+
+    /**
+     * @brief Check if the playback thread is running: it ends at the end of the file, on errors and when stopped.
+     */
+    bool isRunning() const noexcept;
+
     void play() noexcept override;
 
     void stop() noexcept override;
 
+    void pause() noexcept override;
+
+    void resume() noexcept override;
+
+    void setRate(double rate) noexcept override;
+
+    void stepForward() noexcept override;
+
+    void stepBackward() noexcept override;
+
+    void seek(Frame::TimestampType pts) noexcept override;
+
+    void setLoop(Frame::TimestampType start, Frame::TimestampType end) noexcept override;
+
+    void clearLoop() noexcept override;
+
+    /**
+     * @brief Configure the cache of decoded frames around the playhead.
+     * 
+     * Rewinds, loops and scrubbing within the cached window are served without demuxing or decoding.
+     * The new configuration is used starting from the next played file.
+     * 
+     * @param budget the maximum number of bytes used by cached frames (0 disables the cache)
+     * @param mode Native keeps more (compact YUV) frames, Converted makes re-displaying a frame a plain copy
+     */
+    void setFrameCache(size_t budget, DecodedFrameCache::StorageMode mode) noexcept;
+
+    /**
+     * @brief Set the number of codec contexts decoding intra-only streams (MJPEG, ProRes, DNxHD, image sequences) in parallel.
+     * 
+     * The new value is used starting from the next played file.
+     * 
+     * @param workers the number of parallel decoders (0 = number of hardware threads, 1 = decode sequentially)
+     */
+    void setIntraOnlyWorkers(size_t workers) noexcept;
+
+    /**
+     * @brief Compare every decoded frame against the previous one, skipping conversion and presentation of unchanged frames.
+     * 
+     * Emitted frames carry the region that changed as their dirty rectangle. This pays off on mostly
+     * static content (slides, signage) and is disabled by default. The new value is used starting from the next played file.
+     * 
+     * @param enable true to enable change detection
+     */
+    void setStaticFrameSkipping(bool enable) noexcept;
+
+    /**
+     * @brief Emit only the first of every stride frames played forward (i.e. to extract every Nth frame of a file).
+     * 
+     * Frames in between are decoded, as the following ones depend on them, but never converted nor emitted.
+     * The new value is used starting from the next played file.
+     * 
+     * @param stride the distance between emitted frames (1 = emit every frame)
+     */
+    void setFrameStride(uint32_t stride) noexcept;
+
+    /**
+     * @brief Show the bitmap subtitles (DVD, DVB, PGS) of played files, composited onto frames by the compositor of the decoder.
+     * 
+     * Subtitles are shown only when a compositor has been set. The new value is used starting from the next played file.
+     * 
+     * @param enable true to show subtitles
+     */
+    void setSubtitles(bool enable) noexcept;
+
+    /**
+     * @brief Play heavy assets from fast-to-decode proxies and have proxies made of assets this host cannot decode in realtime.
+     * 
+     * A file that has an up-to-date proxy in the cache is played from it (but still reported by its own name). Any other file
+     * is watched while it plays forward: once its decoding load goes over the heavy load of the cache a proxy is requested,
+     * that is used the next time the file is loaded. Live inputs and renditions never use proxies.
+     * The new value is used starting from the next played file.
+     * 
+     * @param cache the proxy cache, possibly shared by more decoders (nullptr to stop using proxies)
+     */
+    void setProxyCache(std::shared_ptr<ProxyCache> cache) noexcept;
+
+    /**
+     * @brief Select how HDR (PQ or HLG) frames are mapped to SDR when the output device prefers RGBA32 or NV12.
+     * 
+     * Tone mapping replaces the scaler for those frames, converting pixels in a single pass. It is enabled
+     * (with the BT.2390 curve) by default. The new value is used starting from the next played file.
+     * 
+     * @param curve the tone curve or an empty value to convert HDR frames as if they were SDR
+     */
+    void setToneMapping(std::optional<ToneMapper::Curve> curve) noexcept;
+
+    /**
+     * @brief Set the stages every decoded frame goes through before being converted for the output device.
+     * 
+     * Stages work on full resolution frames (the codec is not asked to decode smaller frames) and the output
+     * size is fitted to the size of processed frames. The new stages are used starting from the next played file.
+     * 
+     * @param stages the stages, in processing order (empty to disable processing)
+     * @param workers the number of frames processed at the same time, when every stage allows it
+     */
+    void setFrameStages(std::vector<std::shared_ptr<FrameStage>> stages, size_t workers = 1) noexcept;
+
+    /**
+     * @brief Run the playback thread, and every worker it starts, on the CPUs of a NUMA node.
+     * 
+     * Memory allocated by those threads (codec frames, processing buffers, cached frames) comes from the node too,
+     * while frames sent to the output device are in the memory of the allocator given to the decoder, that should
+     * be placed on the same node (see FramePool). Intra-only decoders are no more than the CPUs of the node.
+     * The new value is used starting from the next playback.
+     * 
+     * @param node the NUMA node or an empty value to let the scheduler move threads freely
+     */
+    void setPlacement(std::optional<NumaTopology::NodeType> node) noexcept;
+
+    PlacementStatistics getPlacementStatistics() const noexcept;
+
+    /**
+     * @brief Decode in bursts, sleeping while the output device has enough frames queued.
+     * 
+     * The new value is used starting from the next playback.
+     * 
+     * @param options the watermarks or an empty value to decode a frame as soon as there is room for it
+     */
+    void setPacing(std::optional<PacingOptions> options) noexcept;
+
+    PowerStatistics getPowerStatistics() const noexcept;
+
+    /**
+     * @brief Decode the next frame on the calling thread.
+     * 
+     * The first call opens the loaded file; seek, loop and step commands are honored exactly as during playback.
+     * 
+     * @return std::optional<Frame> the next frame or an empty value at the end of the stream, on error or while playing
+     */
+    std::optional<Frame> nextFrame() noexcept override;
+
 private:
+    /**
+     * @brief The commands a single playback step has to execute.
+     */
+    struct PlaybackCommand {
+        int32_t step;
+
+        double rate;
+
+        std::optional<Frame::TimestampType> seekTarget;
+
+        std::optional<std::pair<Frame::TimestampType, Frame::TimestampType>> loop;
+    };
+
+    void join() noexcept;
+
+    /**
+     * @brief Open the loaded file, its first video stream and the codec to decode it.
+     *
+     * @return true IIF everything needed to decode frames is ready
+     */
+    bool openFile() noexcept;
+
+    /**
+     * @brief Release every resource acquired by openFile.
+     */
+    void closeFile() noexcept;
+
+    /**
+     * @brief Demux and decode until the next video frame is available in m_Frame.
+     *
+     * @return false IIF the end of the stream has been reached or an error occurred
+     */
+    bool decodeNextFrame() noexcept;
+
+    /**
+     * @brief Get the next decoded frame, run through the processing stages, in m_Frame.
+     *
+     * @return false IIF the end of the stream has been reached or an error occurred
+     */
+    bool receiveNextFrame() noexcept;
+
+    /**
+     * @brief Send packets to the decoder until a frame can be received in m_Frame.
+     *
+     * @return false IIF the end of the stream has been reached or an error occurred
+     */
+    bool receiveDecodedFrame() noexcept;
+
+    /**
+     * @brief Dispatch packets to the intra-only decoder pool until the next frame in presentation order is available in m_Frame.
+     *
+     * @return false IIF the end of the stream has been reached or an error occurred
+     */
+    bool receiveNextIntraFrame() noexcept;
+
+    /**
+     * @brief Seek to the keyframe preceding the given timestamp and flush the decoder.
+     *
+     * @param pts the target timestamp (in microseconds)
+     * @return true IIF the seek succeeded
+     */
+    bool seekBefore(Frame::TimestampType pts) noexcept;
+
+    /**
+     * @brief Convert the given frame to the output format and send it to the output device.
+     *
+     * @param dirtyRect the region (in pixels of the decoded frame) that changed since the previous emitted frame
+     * @return false IIF the frame could not be converted (a frame the allocator has no memory for is dropped, not an error)
+     */
+    bool emitDecodedFrame(const AVFrame* frame, Frame::TimestampType pts, bool store, std::optional<Frame::Rect> dirtyRect = std::nullopt) noexcept;
+
+    /**
+     * @brief Send a cached frame to the output device.
+     */
+    bool emitCachedFrame(const DecodedFrameCache::Entry& entry) noexcept;
+
+    /**
+     * @brief Convert the given frame to the output format and size writing pixels in dst.
+     */
+    bool convertFrame(const AVFrame* frame, void* dst) noexcept;
+
+    /**
+     * @brief Re-decode (and cache) the frames preceding the oldest cached one.
+     *
+     * @return true IIF at least one older frame is now cached
+     */
+    bool refillFrameCache() noexcept;
+
+    /**
+     * @brief Emit the frame shown at the given timestamp, from the cache if possible.
+     *
+     * @return true IIF a frame has been emitted
+     */
+    bool jumpTo(Frame::TimestampType pts) noexcept;
+
+    void applyRate(double rate) noexcept;
+
+    /**
+     * @brief Take the pending commands.
+     * 
+     * @param command filled with pending commands
+     * @param wait true to sleep while the playback is paused and there is nothing to do
+     * @return false IIF the decoder has been stopped
+     */
+    bool takeCommand(PlaybackCommand& command, bool wait) noexcept;
+
+    /**
+     * @brief Execute the given commands or, if there are none, emit the next frame.
+     * 
+     * @return false IIF the playback has to end
+     */
+    bool playbackStep(PlaybackCommand& command) noexcept;
+
+    /**
+     * @brief Hold a decoded frame of a live input until its playout time.
+     * 
+     * @param pts the presentation timestamp of the frame
+     * @return false IIF the frame is behind the live edge and has to be dropped
+     */
+    bool waitLivePlayout(Frame::TimestampType pts) noexcept;
+
+    /**
+     * @brief Update latency measurements after a live frame has been presented.
+     */
+    void recordLiveLatency(Frame::TimestampType pts) noexcept;
+
+    void playbackLoop() noexcept;
+
+    /**
+     * @brief Record the CPU the calling (decoding) thread is running on and the media time played.
+     */
+    void recordEmission(Frame::TimestampType pts) noexcept;
+
+    /**
+     * @brief Sleep while the output device has frames up to the high watermark (at the end of a burst).
+     */
+    void pace() noexcept;
+
+    /**
+     * @brief Probe renditions and select the one to start from (setting m_LoadedFilename).
+     */
+    bool selectInitialRendition() noexcept;
+
+    /**
+     * @brief Update the load with the last decoded frame and prepare or switch to another rendition.
+     *
+     * @param pts the timestamp of the frame in m_Frame
+     * @return the timestamp of the frame in m_Frame, that is the first keyframe of the new rendition after a switch
+     */
+    Frame::TimestampType adaptRendition(Frame::TimestampType pts) noexcept;
+
+    /**
+     * @brief Update the load with the last decoded frame.
+     *
+     * @return false if the load cannot be measured at the current playback speed
+     */
+    bool updateLoad() noexcept;
+
+    /**
+     * @brief Update the load with the last decoded frame and request a proxy of the playing file if the host cannot keep up.
+     */
+    void watchProxyLoad() noexcept;
+
+    /**
+     * @brief Publish the statistics counted by the decoding thread.
+     */
+    void publishCounters() noexcept;
+
+    /**
+     * @brief Continue decoding from the prepared rendition, whose first keyframe is moved to m_Frame.
+     */
+    bool switchRendition() noexcept;
+
+    /**
+     * @brief Open the subtitle stream of the playing file, when subtitles are shown.
+     */
+    void openSubtitles() noexcept;
+
     std::unique_ptr<std::thread> m_FFMPEGThread;
 
     std::optional<Decoder::FileNameType> m_LoadedFilename;
 
     std::atomic_bool m_ShouldClose;
+
+    std::atomic_bool m_Running;
+
+    std::mutex m_ControlMutex;
+
+    std::condition_variable m_ControlCV;
+
+    bool m_Paused;
+
+    int32_t m_PendingSteps;
+
+    double m_Rate;
+
+    std::optional<Frame::TimestampType> m_PendingSeek;
+
+    std::optional<std::pair<Frame::TimestampType, Frame::TimestampType>> m_Loop;
+
+    size_t m_FrameCacheBudget;
+
+    DecodedFrameCache::StorageMode m_FrameCacheMode;
+
+    size_t m_IntraOnlyWorkers;
+
+    bool m_StaticFrameSkipping;
+
+    uint32_t m_FrameStride;
+
+    bool m_Subtitles;
+
+    std::shared_ptr<ProxyCache> m_ProxyCache;
+
+    std::optional<ToneMapper::Curve> m_ToneMapping;
+
+    std::vector<std::shared_ptr<FrameStage>> m_FrameStages;
+
+    size_t m_FrameStageWorkers;
+
+    std::optional<NumaTopology::NodeType> m_Placement;
+
+    /**
+     * @brief The node the playback thread has been placed on, read by getPlacementStatistics.
+     */
+    std::atomic<int64_t> m_PlacedNode;
+
+    std::atomic<int64_t> m_LastCpu;
+
+    std::atomic<uint64_t> m_OffNodeFrames;
+
+    std::optional<PacingOptions> m_Pacing;
+
+    /**
+     * @brief The files given to loadRenditions (empty when a single file is loaded).
+     */
+    std::vector<FileNameType> m_RenditionFiles;
+
+    RenditionOptions m_RenditionOptions;
+
+    /**
+     * @brief Renditions that can be played, from the largest to the smallest.
+     */
+    std::vector<RenditionLoader::Rendition> m_Renditions;
+
+    size_t m_ActiveRendition;
+
+    RenditionLoader m_RenditionLoader;
+
+    /**
+     * @brief The time (in microseconds) the last frame took to be decoded and converted.
+     */
+    Frame::TimestampType m_DecodeTime;
+
+    Frame::TimestampType m_ConvertTime;
+
+    std::atomic<double> m_Load;
+
+    uint32_t m_StarvedFrames;
+
+    Frame::TimestampType m_LastSwitchTime;
+
+    std::atomic<uint64_t> m_RenditionSwitches;
+
+    /**
+     * @brief The rendition being played, read by getRenditionStatistics.
+     */
+    std::optional<RenditionLoader::Rendition> m_RenditionPlaying;
+
+    bool m_RenditionSwitching;
+
+    /**
+     * @brief The watermarks used by the playback thread (0 = no pacing).
+     */
+    BufferedFrameOutputDevice::FrameCountType m_HighWatermark;
+
+    BufferedFrameOutputDevice::FrameCountType m_LowWatermark;
+
+    std::atomic<uint64_t> m_Bursts;
+
+    std::atomic<Frame::TimestampType> m_PlayedTime;
+
+    Frame::TimestampType m_PreviousEmission;
+
+    /**
+     * @brief Counted by the decoding thread and published to getStatistics.
+     */
+    Decoder::Statistics m_Counters;
+
+    /**
+     * @brief The frames emitted as they were decoded.
+     */
+    uint64_t m_DecodedEmissions;
+
+    /**
+     * @brief The average time (in microseconds) decoding a frame takes.
+     */
+    double m_AverageDecodeTime;
+
+    double m_AverageConvertTime;
+
+    /**
+     * @brief Process counters when the playback started, that power statistics are relative to.
+     */
+    Frame::TimestampType m_PowerStartTime;
+
+    Frame::TimestampType m_PowerStartCpuTime;
+
+    uint64_t m_PowerStartWakeups;
+
+    AVFormatContext* m_FormatCtx;
+
+    AVCodecContext* m_CodecCtx;
+
+    AVFrame* m_Frame;
+
+    AVPacket* m_Packet;
+
+    struct SwsContext* m_SwsCtx;
+
+    int m_VideoStream;
+
+    bool m_KeyframesOnly;
+
+    Frame::TimestampType m_FrameDuration;
+
+    std::unique_ptr<IntraFrameDecoderPool> m_IntraPool;
+
+    /**
+     * @brief The number of intra-only decoders of the playing file.
+     */
+    size_t m_IntraPoolWorkers;
+
+    bool m_IntraDraining;
+
+    std::unique_ptr<FramePipeline> m_Pipeline;
+
+    bool m_PipelineDraining;
+
+    /**
+     * @brief Set (from m_StaticFrameSkipping) when the playing file has been opened.
+     */
+    bool m_DetectChanges;
+
+    /**
+     * @brief Set (from m_FrameStride) when the playing file has been opened.
+     */
+    uint32_t m_EmitStride;
+
+    /**
+     * @brief The number of frames played forward since the playing file has been opened.
+     */
+    uint64_t m_StrideFrames;
+
+    /**
+     * @brief Set (from m_Subtitles) when the playing file has been opened.
+     */
+    bool m_ShowSubtitles;
+
+    SubtitleDecoder m_SubtitleDecoder;
+
+    /**
+     * @brief Set (from m_ProxyCache) when the playing file has been opened and it could need a proxy.
+     */
+    std::shared_ptr<ProxyCache> m_ProxyWatch;
+
+    FrameChangeDetector m_ChangeDetector;
+
+    /**
+     * @brief Set (from m_ToneMapping) when the playing file has been opened.
+     */
+    bool m_MapTones;
+
+    ToneMapper m_ToneMapper;
+
+    Frame::PixelFormat m_OutputFormat;
+
+    uint32_t m_OutputWidth;
+
+    uint32_t m_OutputHeight;
+
+    DecodedFrameCache m_FrameCache;
+
+    /**
+     * @brief When set the decoder position is not right after the newest cached frame anymore
+     * and, before decoding a new frame, frames up to this timestamp have to be skipped.
+     */
+    std::optional<Frame::TimestampType> m_ResumeAfter;
+
+    Frame::TimestampType m_LastEmitted;
+
+    /**
+     * @brief Set when frames have been pulled up to the end of the loaded file.
+     */
+    bool m_PullExhausted;
+
+    std::optional<LiveOptions> m_LiveOptions;
+
+    LivePlayoutBuffer m_LivePlayout;
+
+    Frame::TimestampType m_LiveArrival;
+
+    LiveStatistics m_LiveStatistics;
 };
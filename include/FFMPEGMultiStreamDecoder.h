@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Decoder.h"
+
+#include <deque>
+
+struct AVCodecContext;
+struct AVPacket;
+struct AVStream;
+
+/**
+ * @brief A decoder that decodes several video streams of the same file (multi-angle or multi-camera recordings).
+ *
+ * The file is read and demuxed once, by a single thread, that routes the packets of every selected stream
+ * to the worker thread of that stream: each worker owns its own codec context and sends frames to its own
+ * output device, therefore streams are decoded in parallel.
+ *
+ * Video streams are identified by their ordinal among the video streams of the file (0 is the first video stream):
+ * the output device given at construction time receives frames of the first video stream, other streams are only
+ * decoded if an output device has been assigned to them. Emitted frames carry the stream ordinal as source index.
+ *
+ * A slow output device delays the demuxer (and, with it, every other stream) only after the packet queue
+ * of its stream has been filled.
+ */
+class FFMPEGMultiStreamDecoder : public Decoder {
+
+public:
+    /**
+     * @brief The maximum number of packets waiting to be decoded for each stream.
+     */
+    static constexpr size_t PacketQueueSize = 64;
+
+    FFMPEGMultiStreamDecoder(
+        BufferedFrameOutputDevice* outputDev,
+        FrameAllocator* allocator
+    ) noexcept;
+
+    ~FFMPEGMultiStreamDecoder() override;
+
+    /**
+     * @brief Send frames of a video stream to the given output device.
+     *
+     * Output devices cannot be changed while playing.
+     *
+     * @param videoStream the ordinal of the stream among video streams of the file
+     * @param outputDev the output device or nullptr to ignore the stream
+     */
+    void setStreamOutputDevice(uint32_t videoStream, BufferedFrameOutputDevice* outputDev) noexcept;
+
+    void loadFile(const FileNameType& filename) noexcept override;
+
+    void play() noexcept override;
+
+    void stop() noexcept override;
+
+private:
+    struct StreamDecoder {
+        uint32_t ordinal;
+
+        AVStream* stream;
+
+        BufferedFrameOutputDevice* device;
+
+        AVCodecContext* codecCtx;
+
+        std::mutex mutex;
+
+        std::condition_variable changed;
+
+        /**
+         * @brief Packets waiting to be decoded: nullptr marks the end of the stream.
+         */
+        std::deque<AVPacket*> packets;
+
+        /**
+         * @brief The decoder thread has stopped (i.e. on an error): packets of the stream are dropped by the demuxer.
+         */
+        bool dead;
+
+        std::thread thread;
+    };
+
+    void join() noexcept;
+
+    void demux() noexcept;
+
+    void decodeStream(StreamDecoder& stream) noexcept;
+
+    /**
+     * @brief Wake up every thread waiting on a packet queue.
+     */
+    void notifyStreams() noexcept;
+
+    std::optional<Decoder::FileNameType> m_LoadedFilename;
+
+    std::map<uint32_t, BufferedFrameOutputDevice*> m_StreamDevices;
+
+    std::unique_ptr<std::thread> m_DemuxThread;
+
+    std::mutex m_StreamsMutex;
+
+    std::vector<std::unique_ptr<StreamDecoder>> m_Streams;
+
+    std::atomic_bool m_ShouldClose;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Decoder.h"
+
+/**
+ * @brief A decoder that extracts one keyframe every given interval from a batch of video files.
+ *
+ * Instead of decoding every frame this decoder seeks from keyframe to keyframe, asks libavcodec to discard
+ * every non-key frame and converts each selected keyframe to a small target size with a single sws_scale pass
+ * that writes directly into the frame memory.
+ *
+ * Every call to loadFile appends a file to the batch: play processes the batch with a pool of worker threads,
+ * one file per worker at a time; emitted frames carry the load-order index of their file as source index.
+ *
+ * As frames are emitted by several threads the allocate method of the frame allocator as well as the
+ * enqueueFrame method of the output device MUST be thread-safe.
+ */
+class FFMPEGThumbnailDecoder : public Decoder {
+
+public:
+    /**
+     * @brief Construct a new FFMPEG Thumbnail Decoder object
+     *
+     * @param outputDev the output device thumbnails will be sent to
+     * @param allocator the frame memory allocator
+     * @param interval the minimum distance (in microseconds) between two thumbnails of the same file
+     * @param maxWidth the maximum thumbnail width (aspect ratio is preserved)
+     * @param maxHeight the maximum thumbnail height (aspect ratio is preserved)
+     * @param maxConcurrentFiles the maximum number of files decoded at once (0 = number of hardware threads)
+     */
+    FFMPEGThumbnailDecoder(
+        BufferedFrameOutputDevice* outputDev,
+        FrameAllocator* allocator,
+        Frame::TimestampType interval,
+        uint32_t maxWidth,
+        uint32_t maxHeight,
+        uint32_t maxConcurrentFiles = 0
+    ) noexcept;
+
+    ~FFMPEGThumbnailDecoder() override;
+
+    /**
+     * @brief Append a file to the batch to be processed.
+     *
+     * Files cannot be added while the batch is being processed.
+     *
+     * @param filename the identifier of the file
+     */
+    void loadFile(const FileNameType& filename) noexcept override;
+
+    void play() noexcept override;
+
+    void stop() noexcept override;
+
+    /**
+     * @brief Check if every file of the batch has been processed (or playback has been stopped).
+     *
+     * @return true IIF no worker is running
+     */
+    bool isFinished() const noexcept;
+
+private:
+    void join() noexcept;
+
+    void extractThumbnails(Frame::SourceIndexType sourceIndex) noexcept;
+
+    Frame::TimestampType m_Interval;
+
+    uint32_t m_MaxWidth;
+
+    uint32_t m_MaxHeight;
+
+    uint32_t m_MaxConcurrentFiles;
+
+    std::vector<Decoder::FileNameType> m_Files;
+
+    std::vector<std::thread> m_Workers;
+
+    std::atomic_uint32_t m_NextFile;
+
+    std::atomic_uint32_t m_RunningWorkers;
+
+    std::atomic_bool m_ShouldClose;
+};
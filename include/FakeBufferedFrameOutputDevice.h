@@ -2,8 +2,16 @@
 
 #include "BufferedFrameOutputDevice.h"
 
-#include "DequeHM.h"
-
+/**
+ * @brief An output device that consumes frames at their presentation time without showing them.
+ *
+ * Frames wait in a fixed ring of frameCount entries (enqueueFrame blocks while it is full) and the main cycle
+ * sleeps until a frame arrives or the next one is due, so that an idle player uses no CPU. Threads are only woken
+ * when they can make progress: the decoder when a full ring has room again, the main cycle when an empty ring
+ * receives a frame.
+ *
+ * Frames are consumed following the local clock, or the shared presentation clock given to the device.
+ */
 class FakeBufferedFrameOutputDevice : public BufferedFrameOutputDevice {
 
 public:
@@ -13,8 +21,61 @@ public:
 
     void enqueueFrame(Frame&& frame) noexcept override;
 
-    void exec() noexcept;
+    /**
+     * @brief Consume frames until interrupt is called.
+     */
+    void exec() noexcept override;
+
+    void interrupt() noexcept;
+
+    bool isFollowingPresentationClocks() const noexcept override;
+
+    uint64_t getPresentedFrames() const noexcept;
 
 private:
-    DequeHM<Frame> m_Frames;
+    /**
+     * @brief Sleep until the given frame has to be presented.
+     *
+     * @return false IIF the device has been interrupted
+     */
+    bool waitPresentationTime(const Frame& frame) noexcept;
+
+    std::vector<std::optional<Frame>> m_Frames;
+
+    size_t m_Head;
+
+    size_t m_Count;
+
+    std::mutex m_QueueMutex;
+
+    /**
+     * @brief Signaled when a frame is enqueued in an empty ring.
+     */
+    std::condition_variable m_FrameQueued;
+
+    /**
+     * @brief Signaled when a frame leaves a full ring.
+     */
+    std::condition_variable m_SlotFreed;
+
+    /**
+     * @brief Signaled by interrupt only: a frame waiting for its presentation time is not woken by anything else.
+     */
+    std::condition_variable m_Stopped;
+
+    std::atomic_bool m_ShouldStop;
+
+    std::atomic<uint64_t> m_PresentedFrames;
+
+    /**
+     * @brief The timestamp and the time the clock was last anchored at.
+     */
+    std::optional<std::pair<Frame::TimestampType, std::chrono::steady_clock::time_point>> m_Anchor;
+
+    double m_AnchorRate;
+
+    /**
+     * @brief How late (microseconds) the last frame waited for has been released to be presented.
+     */
+    Frame::TimestampType m_Lateness;
 };
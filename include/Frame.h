@@ -2,6 +2,9 @@
 
 #include "EODPlayer.hpp"
 
+#include "FrameAllocator.h"
+#include "FunctionRef.h"
+
 /**
  * @brief This class represents a frame to be handled and displayed by a BufferedFrameOutputDevice.
  * 
@@ -14,30 +17,67 @@
  * system call to obtain new memory and such a slowness may compromise video player efficiency
  * and introduct randomic delays.
  * 
- * An object of this class can however be moved and that move operation will be really fast. 
+ * An object of this class can however be moved and that move operation will be really fast:
+ * ownership of pixel memory is just the allocator pointer and the slot index it returned, so a move
+ * is a copy of a few words that never allocates.
  */
 class Frame {
 
 public:
-    typedef std::function<void*(size_t)>  AllocatorFunctionType;
-    typedef std::function<void(void*)>  DeallocatorFunctionType;
-    typedef std::function<void(void*)>  FrameFillerFunctionType;
+    typedef FunctionRef<void(void*)>  FrameFillerFunctionType;
+
+    /**
+     * @brief The presentation timestamp of a frame, expressed in microseconds.
+     */
+    typedef int64_t TimestampType;
+
+    /**
+     * @brief The index of the input (in load order) a frame has been decoded from.
+     */
+    typedef uint32_t SourceIndexType;
+
+    /**
+     * @brief A rectangle of pixels.
+     */
+    struct Rect {
+        uint32_t x;
+
+        uint32_t y;
+
+        uint32_t width;
+
+        uint32_t height;
+    };
 
     enum class PixelFormat {
         RGBA64, //a pixel is a unt16_t[4]
+        RGBA32, //a pixel is a uint8_t[4]
+        NV12, //a uint8_t luma plane followed by a plane of interleaved uint8_t chroma pairs subsampled 2x2
     };
 
     /**
      * @brief Get the size of a pixel (in bytes)
      * 
      * Helper static function that given a pixel format return the dimensiont in bytes
-     * of a pixel of the given format.
+     * of a pixel of the given format; for planar formats this is the size of a pixel in the first plane.
      * 
      * @param pf the pixel format
      * @return size_t number of bytes required to store a pixel in the specified format
      */
     static size_t getPixelSizeInBytes(PixelFormat pf) noexcept;
 
+    /**
+     * @brief Get the size of a whole frame (in bytes)
+     * 
+     * Planes are stored one after the other without padding.
+     * 
+     * @param pf the pixel format
+     * @param width the number of horizontal pixels
+     * @param height the number of vertical pixels
+     * @return size_t number of bytes required to store a frame in the specified format
+     */
+    static size_t getFrameSizeInBytes(PixelFormat pf, uint32_t width, uint32_t height) noexcept;
+
     /**
      * @brief Construct a Frame object with the specified pixel format
      * 
@@ -66,6 +106,45 @@ public:
 
     uint32_t getHeight() const noexcept;
 
+    /**
+     * @brief Get the number of bytes between the start of two consecutive pixel rows (of the first plane).
+     * 
+     * @return size_t the row stride (in bytes)
+     */
+    size_t getStride() const noexcept;
+
+    /**
+     * @brief Get the number of bytes of pixel data.
+     */
+    size_t getSizeInBytes() const noexcept;
+
+    TimestampType getPresentationTimestamp() const noexcept;
+
+    void setPresentationTimestamp(TimestampType pts) noexcept;
+
+    SourceIndexType getSourceIndex() const noexcept;
+
+    void setSourceIndex(SourceIndexType index) noexcept;
+
+    /**
+     * @brief Get the region that changed since the previous frame of the same source.
+     * 
+     * Output devices can use it to upload or redraw only that part of the image; pixels outside of the region
+     * are still valid and identical to the ones of the previous frame.
+     * 
+     * @return Rect the changed region (the whole frame unless the decoder detected otherwise)
+     */
+    Rect getDirtyRect() const noexcept;
+
+    void setDirtyRect(const Rect& rect) noexcept;
+
+    /**
+     * @brief Get the raw pixel buffer
+     * 
+     * @return void* the buffer returned by the allocator or nullptr if the frame is not holding data
+     */
+    void* getRawBuffer() const noexcept;
+
     /**
      * @brief Return a value indicating the presence of filled pixel buffer
      * 
@@ -75,16 +154,32 @@ public:
     bool isHoldingData() const noexcept;
 
     /**
-     * @brief 
+     * @brief Allocate the pixel buffer and fill it.
      * 
-     * @param allocatorFn this is the function that will be called synchronously (inside the method call) that is resposible for allocating the specified amount of bytes on the heap
-     * @param deallocatorFn this is the function that will be called by the object destructor so it's importat to think about lifetime of captures
+     * @param allocator the allocator that provides the memory and that will be called by the object destructor to release it, so it MUST outlive the frame
      * @param fillerFn this is the function that will be called synchronously (inside the method call) that is resposible for filling the raw buffer
+     * 
+     * If the allocator returns nullptr the frame is left empty and fillerFn is not called.
      */
     void storeFrameData(
-        const AllocatorFunctionType& allocatorFn,
-        const DeallocatorFunctionType& deallocatorFn,
-        const FrameFillerFunctionType& fillerFn
+        FrameAllocator* allocator,
+        FrameFillerFunctionType fillerFn
+    ) noexcept;
+
+    /**
+     * @brief Make the frame hold memory that has already been filled elsewhere.
+     * 
+     * This is how the same pixels are handed to more than one consumer: the allocator is typically
+     * reference counting the buffer and the frame MUST be treated as read-only.
+     * 
+     * @param buffer the filled pixel buffer
+     * @param allocator the allocator that will be called by the object destructor to release the buffer
+     * @param slot the slot that will be given back to the allocator
+     */
+    void adoptFrameData(
+        void* buffer,
+        FrameAllocator* allocator,
+        FrameAllocator::SlotType slot
     ) noexcept;
 
     
@@ -96,8 +191,17 @@ private:
     
     uint32_t m_Height;
 
+    TimestampType m_PresentationTimestamp;
+
+    SourceIndexType m_SourceIndex;
+
+    Rect m_DirtyRect;
+
+    // declared here to avoid padding before m_RawBuffer
+    FrameAllocator::SlotType m_Slot;
+
     void* m_RawBuffer;
 
-    DeallocatorFunctionType m_DeallocatorFn;
+    FrameAllocator* m_Allocator;
 };
 
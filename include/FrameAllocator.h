@@ -0,0 +1,121 @@
+#pragma once
+
+#include "EODPlayer.hpp"
+#include "NumaTopology.h"
+
+/**
+ * @brief The owner of frame pixel memory.
+ *
+ * A Frame only stores a pointer to its allocator and the slot index returned by allocate, so that moving
+ * a frame is a plain copy of a few words and releasing it is a single virtual call that does not need
+ * to search the buffer it was given.
+ *
+ * Allocators MUST outlive every frame they have allocated memory for and, as frames are released by
+ * the output device, deallocate MUST be thread-safe.
+ */
+class FrameAllocator {
+
+public:
+    typedef uint32_t SlotType;
+
+    FrameAllocator() noexcept = default;
+
+    virtual ~FrameAllocator();
+
+    FrameAllocator(const FrameAllocator&) = delete;
+
+    FrameAllocator(FrameAllocator&&) = delete;
+
+    FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+    FrameAllocator& operator=(FrameAllocator&&) = delete;
+
+    /**
+     * @brief Obtain memory for the pixel data of a frame.
+     *
+     * @param size the number of bytes required
+     * @param slot written with an allocator-defined value that will be given back to deallocate
+     * @return void* the memory or nullptr if it could not be obtained
+     */
+    virtual void* allocate(size_t size, SlotType& slot) noexcept = 0;
+
+    /**
+     * @brief Give back memory obtained via allocate.
+     *
+     * @param mem the pointer returned by allocate
+     * @param slot the slot written by allocate
+     */
+    virtual void deallocate(void* mem, SlotType slot) noexcept = 0;
+};
+
+/**
+ * @brief A frame allocator that uses the heap: every frame is a malloc and a free.
+ */
+class HeapFrameAllocator : public FrameAllocator {
+
+public:
+    HeapFrameAllocator() noexcept = default;
+
+    ~HeapFrameAllocator() override;
+
+    void* allocate(size_t size, SlotType& slot) noexcept override;
+
+    void deallocate(void* mem, SlotType slot) noexcept override;
+};
+
+/**
+ * @brief A frame allocator handing out a fixed number of pre-allocated blocks.
+ *
+ * The slot of a frame is the index of its block: deallocation pushes it back on the free list.
+ * When every block is in use allocate waits for one to be released.
+ *
+ * Blocks can be placed on the NUMA node of the threads decoding and presenting frames: the memory is then bound
+ * to the node and touched up front, so that no page is placed (or faulted in) while frames are being written.
+ */
+class FramePool : public FrameAllocator {
+
+public:
+    /**
+     * @brief Construct a new Frame Pool object
+     *
+     * @param blocks the number of blocks
+     * @param blockSize the size (in bytes) of each block, that is the size of the largest frame
+     * @param node the NUMA node blocks are placed on (an empty value leaves placement to the first thread writing a block)
+     */
+    FramePool(SlotType blocks, size_t blockSize, std::optional<NumaTopology::NodeType> node = std::nullopt) noexcept;
+
+    ~FramePool() override;
+
+    size_t getBlockSize() const noexcept;
+
+    /**
+     * @brief Get the NUMA node blocks have been placed on.
+     */
+    std::optional<NumaTopology::NodeType> getNode() const noexcept;
+
+    /**
+     * @brief Get the number of blocks whose first page is on each NUMA node (blocks never written are not counted).
+     *
+     * @return the node and the number of blocks on it
+     */
+    std::map<NumaTopology::NodeType, SlotType> getResidentBlocks() const noexcept;
+
+    void* allocate(size_t size, SlotType& slot) noexcept override;
+
+    void deallocate(void* mem, SlotType slot) noexcept override;
+
+private:
+    size_t m_BlockSize;
+
+    size_t m_Size;
+
+    uint8_t* m_Memory;
+
+    std::optional<NumaTopology::NodeType> m_Node;
+
+    std::mutex m_FreeMutex;
+
+    std::condition_variable m_BlockFreed;
+
+    std::vector<SlotType> m_FreeBlocks;
+};
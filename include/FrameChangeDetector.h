@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Frame.h"
+
+struct AVFrame;
+
+/**
+ * @brief Finds the region of a decoded frame that changed since the previous one.
+ *
+ * Frames are compared in their native (decoder) format, before any conversion, on a grid of
+ * BlockSize x BlockSize pixel blocks: every plane is diffed with vector instructions (SSE2 or NEON
+ * when available) skipping blocks already known to be dirty, and the result is the bounding rectangle
+ * of changed blocks. Mostly static content (slides, signage) can then skip conversion and presentation.
+ *
+ * The previous frame is kept as a reference to the decoder buffer: no pixel is copied.
+ *
+ * A detector is owned by the decoding thread and MUST NOT be shared between threads.
+ */
+class FrameChangeDetector {
+
+public:
+    /**
+     * @brief The size (in pixels of the first plane) of compared blocks.
+     */
+    static constexpr uint32_t BlockSize = 16;
+
+    FrameChangeDetector() noexcept;
+
+    ~FrameChangeDetector();
+
+    FrameChangeDetector(const FrameChangeDetector&) = delete;
+
+    FrameChangeDetector(FrameChangeDetector&&) = delete;
+
+    FrameChangeDetector& operator=(const FrameChangeDetector&) = delete;
+
+    FrameChangeDetector& operator=(FrameChangeDetector&&) = delete;
+
+    /**
+     * @brief Forget the previous frame: the next one will be reported as entirely changed.
+     */
+    void reset() noexcept;
+
+    /**
+     * @brief Compare a frame against the previous one and remember it for the next comparison.
+     *
+     * @param frame the decoded frame
+     * @return std::optional<Frame::Rect> the changed region (in pixels of the decoded frame) or an empty value if nothing changed
+     */
+    std::optional<Frame::Rect> compare(const AVFrame* frame) noexcept;
+
+private:
+    AVFrame* m_Previous;
+
+    /**
+     * @brief One flag per block, set when the block changed.
+     */
+    std::vector<uint8_t> m_DirtyBlocks;
+};
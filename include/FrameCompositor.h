@@ -0,0 +1,144 @@
+#pragma once
+
+#include "OverlayImage.h"
+
+/**
+ * @brief Composites layers of overlay images (tickers, logos, subtitles) onto frames, in place, in their pixel format.
+ *
+ * Layers are blended in the order they have been added (the last one on top) with premultiplied alpha, using the
+ * raster of each image for the frame format: RGBA32 and RGBA64 frames as well as NV12 frames, that are blended
+ * in YUV with no conversion. Only the non-transparent spans of each layer are touched.
+ *
+ * The dirty rectangle of each composited frame is extended with the regions where layers appeared, moved,
+ * changed image or disappeared since the previous frame, so that output devices updating only the dirty region
+ * of frames stay correct.
+ *
+ * Layers can be changed from any thread while frames are being composited. On NV12 frames layers are placed
+ * on even coordinates (chroma is shared by 2x2 pixels).
+ */
+class FrameCompositor {
+
+public:
+    typedef uint32_t LayerType;
+
+    /**
+     * @brief The time compositing a frame should take at most (microseconds).
+     */
+    static constexpr Frame::TimestampType Budget = 1000;
+
+    struct Statistics {
+        uint64_t frames;
+
+        /**
+         * @brief The time the last frame took to composite (microseconds).
+         */
+        Frame::TimestampType lastTime;
+
+        Frame::TimestampType maxTime;
+
+        /**
+         * @brief The number of frames that took longer than Budget.
+         */
+        uint64_t overBudgetFrames;
+    };
+
+    FrameCompositor() noexcept;
+
+    ~FrameCompositor();
+
+    FrameCompositor(const FrameCompositor&) = delete;
+
+    FrameCompositor(FrameCompositor&&) = delete;
+
+    FrameCompositor& operator=(const FrameCompositor&) = delete;
+
+    FrameCompositor& operator=(FrameCompositor&&) = delete;
+
+    /**
+     * @brief Add a layer on top of the others.
+     *
+     * @param image the image shown by the layer (nullptr for an empty layer)
+     * @param x the horizontal position of the image inside frames (it may lay partially outside)
+     * @param y the vertical position of the image inside frames (it may lay partially outside)
+     * @return LayerType the identifier of the layer
+     */
+    LayerType addLayer(std::shared_ptr<OverlayImage> image, int32_t x, int32_t y) noexcept;
+
+    void setLayerImage(LayerType layer, std::shared_ptr<OverlayImage> image) noexcept;
+
+    void moveLayer(LayerType layer, int32_t x, int32_t y) noexcept;
+
+    void setLayerVisible(LayerType layer, bool visible) noexcept;
+
+    void removeLayer(LayerType layer) noexcept;
+
+    /**
+     * @brief Blend every visible layer onto a frame and extend its dirty rectangle with the layers that changed.
+     *
+     * @param frame a frame holding data that is not shared with other frames
+     */
+    void composite(Frame& frame) noexcept;
+
+    /**
+     * @brief Check if the next composited frame would differ from the previous one even if the frame did not change.
+     *
+     * This is the case when layers have been added, removed, shown, hidden, moved or given another image since the
+     * previous frame: a decoder skipping unchanged frames MUST NOT skip one while this is true.
+     */
+    bool hasPendingChanges() const noexcept;
+
+    Statistics getStatistics() const noexcept;
+
+private:
+    struct Layer {
+        LayerType id;
+
+        std::shared_ptr<OverlayImage> image;
+
+        int32_t x;
+
+        int32_t y;
+
+        bool visible;
+
+        /**
+         * @brief The region the layer has been drawn on in the previous frame (empty if it has not been drawn).
+         */
+        Frame::Rect drawn;
+
+        const OverlayImage* drawnImage;
+
+        /**
+         * @brief The position the layer had when it has been drawn.
+         */
+        int32_t drawnX;
+
+        int32_t drawnY;
+    };
+
+    Layer* findLayer(LayerType layer) noexcept;
+
+    /**
+     * @brief Blend a layer onto a frame.
+     *
+     * @return the region of the frame covered by the layer
+     */
+    Frame::Rect blend(Frame& frame, const Layer& layer) noexcept;
+
+    mutable std::mutex m_Mutex;
+
+    std::vector<Layer> m_Layers;
+
+    LayerType m_NextLayer;
+
+    /**
+     * @brief The regions of removed layers, repainted by the next frame.
+     */
+    Frame::Rect m_Removed;
+
+    uint32_t m_LastWidth;
+
+    uint32_t m_LastHeight;
+
+    Statistics m_Statistics;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "BufferedFrameOutputDevice.h"
+
+/**
+ * @brief An output device writing every frame it receives to an image file, encoded by a pool of worker threads.
+ *
+ * Frames (from any number of decoders) wait in a bounded queue of frameCount entries: enqueueFrame blocks while it
+ * is full, so that decoders never get ahead of encoders by more than the queue and frame memory stays bounded.
+ * Each worker owns its encoder (libavcodec PNG or JPEG, or none for raw pixels) and writes files with asynchronous
+ * I/O, going on encoding while previous files reach the disk.
+ *
+ * Files are named after the source of the frame and its timestamp: <directory>/<source name>_<pts>.<extension>,
+ * where the timestamp is in microseconds.
+ */
+class FrameEncoderPool : public BufferedFrameOutputDevice {
+
+public:
+    enum class ImageFormat {
+        PNG,
+        JPEG,
+        Raw, // the frame memory as is: see Frame for the layout of each pixel format
+    };
+
+    struct Statistics {
+        uint64_t encodedFrames;
+
+        /**
+         * @brief The number of frames that could not be encoded or written.
+         */
+        uint64_t failedFrames;
+
+        uint64_t writtenBytes;
+    };
+
+    /**
+     * @brief Construct a new Frame Encoder Pool object
+     *
+     * PNG and JPEG files are written from RGBA32 frames (the preferred pixel format of the device); raw files
+     * keep the pixel format frames have.
+     *
+     * @param format the format of written files
+     * @param directory the directory files are written to
+     * @param frameCount the number of frames that can wait to be encoded
+     * @param workers the number of encoding threads (0 = number of hardware threads)
+     */
+    FrameEncoderPool(ImageFormat format, const std::string& directory, BufferedFrameOutputDevice::FrameCountType frameCount, size_t workers) noexcept;
+
+    ~FrameEncoderPool() override;
+
+    static const char* getExtension(ImageFormat format) noexcept;
+
+    /**
+     * @brief Set the name used for files of frames with the given source index.
+     *
+     * This MUST be called before frames of that source are enqueued; sources without a name use their index.
+     */
+    void setSourceName(Frame::SourceIndexType index, const std::string& name) noexcept;
+
+    /**
+     * @brief Enqueue a frame to be encoded, waiting while the queue is full.
+     */
+    void enqueueFrame(Frame&& frame) noexcept override;
+
+    /**
+     * @brief Wait until finish is called and every frame has been written.
+     */
+    void exec() noexcept override;
+
+    /**
+     * @brief Encode every queued frame, wait for every file to be written and stop workers.
+     *
+     * Frames enqueued after this call are dropped.
+     */
+    void finish() noexcept;
+
+    Statistics getStatistics() const noexcept;
+
+private:
+    struct Encoder;
+
+    void work() noexcept;
+
+    /**
+     * @brief Encode a frame and queue the write of its file.
+     *
+     * @param frame the frame, released as soon as its pixels are not needed anymore
+     * @return true IIF the file write has been queued
+     */
+    bool encode(Encoder& encoder, std::optional<Frame>& frame, const std::string& path) noexcept;
+
+    /**
+     * @brief Get the file of a frame (m_QueueMutex MUST be held).
+     */
+    std::string getPath(const Frame& frame) noexcept;
+
+    const ImageFormat m_Format;
+
+    const std::string m_Directory;
+
+    std::vector<std::thread> m_Workers;
+
+    std::vector<std::optional<Frame>> m_Frames;
+
+    size_t m_Head;
+
+    size_t m_Count;
+
+    mutable std::mutex m_QueueMutex;
+
+    /**
+     * @brief Signaled when a frame is enqueued and when the pool is finishing.
+     */
+    std::condition_variable m_FrameQueued;
+
+    /**
+     * @brief Signaled when a frame leaves a full queue.
+     */
+    std::condition_variable m_SlotFreed;
+
+    /**
+     * @brief Signaled when every worker has stopped.
+     */
+    std::condition_variable m_Finished;
+
+    bool m_Finishing;
+
+    bool m_IsFinished;
+
+    std::map<Frame::SourceIndexType, std::string> m_SourceNames;
+
+    std::atomic<uint64_t> m_EncodedFrames;
+
+    std::atomic<uint64_t> m_FailedFrames;
+
+    std::atomic<uint64_t> m_WrittenBytes;
+};
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "FrameReorderBuffer.h"
+#include "Stages/FrameStage.h"
+
+struct AVFrame;
+struct AVBufferPool;
+
+/**
+ * @brief Runs decoded frames through a chain of processing stages before they are converted for the output device.
+ *
+ * When the format of decoded frames is known (and every time it changes) the chain is built from the stages:
+ *   - a format conversion is inserted in front of every stage that does not accept the format it would receive
+ *   - adjacent resample stages are fused into one and resample stages that would change nothing are dropped
+ *   - only stages writing a new image get a pool of output buffers: in-place stages work on the frame they receive,
+ *     copying it into a pooled buffer only when it is still referenced elsewhere (i.e. by the codec)
+ *
+ * Pooled buffers are reference counted, so processed frames can be kept (i.e. by a DecodedFrameCache) for as long as needed.
+ *
+ * When every stage allows it, frames are processed concurrently by a set of workers, each frame going through the whole
+ * chain on a single worker; processed frames are handed back in the order they were submitted. Otherwise frames are
+ * processed on the submitting thread.
+ *
+ * The pipeline is owned by a single decoding thread: submit, receive and flush MUST be called by that thread.
+ */
+class FramePipeline {
+
+public:
+    /**
+     * @brief The alignment (in bytes) of the rows of pooled frames.
+     */
+    static constexpr int RowAlignment = 32;
+
+    /**
+     * @param stages the stages, in processing order: they MUST NOT be used by anything else while the pipeline exists
+     * @param workers the number of frames that can be processed at the same time
+     */
+    FramePipeline(std::vector<std::shared_ptr<FrameStage>> stages, size_t workers) noexcept;
+
+    ~FramePipeline();
+
+    FramePipeline(const FramePipeline&) = delete;
+
+    FramePipeline(FramePipeline&&) = delete;
+
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    FramePipeline& operator=(FramePipeline&&) = delete;
+
+    /**
+     * @brief Check if as many frames as the pipeline can hold are being processed.
+     */
+    bool isFull() const noexcept;
+
+    /**
+     * @brief Start processing a frame.
+     *
+     * @param frame the decoded frame: only a new reference is taken
+     */
+    void submit(const AVFrame* frame) noexcept;
+
+    /**
+     * @brief Get the next processed frame in submission order.
+     *
+     * Frames dropped by a stage (or that could not be processed) are skipped.
+     *
+     * @param frame receives the processed frame (any previous content is unreferenced)
+     * @param wait true to wait for the next frame to be processed
+     * @return true IIF a frame has been received, false if it is not ready yet (or, when waiting, if no frame is left)
+     */
+    bool receive(AVFrame* frame, bool wait) noexcept;
+
+    /**
+     * @brief Discard every frame submitted so far (to be called after a seek).
+     */
+    void flush() noexcept;
+
+private:
+    struct Step {
+        FrameStage* stage;
+
+        FrameStage::Format input;
+
+        FrameStage::Format output;
+
+        /**
+         * @brief Output buffers for stages that write pixels (NULL for the others).
+         */
+        AVBufferPool* pool;
+    };
+
+    struct Job {
+        uint64_t sequence;
+
+        AVFrame* frame;
+    };
+
+    /**
+     * @brief Build the chain of steps for frames of the given format, while no frame is being processed.
+     *
+     * @return true IIF every stage can process the frames it will receive
+     */
+    bool configure(const FrameStage::Format& input) noexcept;
+
+    void releaseChain() noexcept;
+
+    /**
+     * @brief Make frame hold a pooled buffer for the output of the given step.
+     */
+    bool allocate(const Step& step, AVFrame* frame) noexcept;
+
+    /**
+     * @brief Run a frame through the whole chain.
+     *
+     * @param frame the frame to process, replaced by the processed one
+     * @param worker the index of the calling worker
+     * @return false IIF the frame has been dropped
+     */
+    bool run(AVFrame* frame, size_t worker) noexcept;
+
+    void work(size_t worker) noexcept;
+
+    const std::vector<std::shared_ptr<FrameStage>> m_Stages;
+
+    size_t m_Workers;
+
+    /**
+     * @brief Conversions inserted by the pipeline and stages built fusing adjacent ones.
+     */
+    std::vector<std::unique_ptr<FrameStage>> m_OwnedStages;
+
+    std::vector<Step> m_Chain;
+
+    std::optional<FrameStage::Format> m_Input;
+
+    bool m_Configured;
+
+    /**
+     * @brief A blank frame per worker, receiving the output of stages that write a new image.
+     */
+    std::vector<AVFrame*> m_Scratch;
+
+    std::vector<std::thread> m_Threads;
+
+    mutable std::mutex m_Mutex;
+
+    std::condition_variable m_JobQueued;
+
+    std::condition_variable m_JobDone;
+
+    bool m_ShouldStop;
+
+    size_t m_Busy;
+
+    /**
+     * @brief A ring of frames waiting for a worker: no more frames than the pipeline capacity are ever queued.
+     */
+    std::vector<Job> m_Queue;
+
+    size_t m_QueueHead;
+
+    size_t m_QueueCount;
+
+    /**
+     * @brief Processed frames waiting to be received: a sequence without a frame is a dropped frame.
+     */
+    FrameReorderBuffer m_Processed;
+};
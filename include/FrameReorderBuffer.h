@@ -0,0 +1,106 @@
+#pragma once
+
+#include "EODPlayer.hpp"
+
+struct AVFrame;
+
+/**
+ * @brief Hands back frames completed out of order (by a set of workers) in the order they were submitted.
+ *
+ * Every submitted frame gets a sequence number; workers complete sequences in any order, with a frame or
+ * without one (a packet that could not be decoded, a frame dropped by a stage) and frames are received in
+ * sequence order, skipping the missing ones. Blank frames are recycled, so that workers do not allocate one per frame.
+ *
+ * The buffer is not synchronized: its owner MUST hold the same lock on every call, as workers complete
+ * sequences on their own threads. Frames are kept in a fixed ring of capacity slots, indexed by sequence: once every
+ * slot and spare frame exists, nothing is allocated anymore.
+ */
+class FrameReorderBuffer {
+
+public:
+    FrameReorderBuffer() noexcept;
+
+    ~FrameReorderBuffer();
+
+    FrameReorderBuffer(const FrameReorderBuffer&) = delete;
+
+    FrameReorderBuffer(FrameReorderBuffer&&) = delete;
+
+    FrameReorderBuffer& operator=(const FrameReorderBuffer&) = delete;
+
+    FrameReorderBuffer& operator=(FrameReorderBuffer&&) = delete;
+
+    /**
+     * @brief Set the number of sequences that can be pending (submitted but not received yet).
+     *
+     * It MUST be called before the first submit.
+     */
+    void setCapacity(size_t capacity) noexcept;
+
+    /**
+     * @brief Check if as many sequences as the capacity are pending.
+     */
+    bool isFull() const noexcept;
+
+    /**
+     * @brief Check if every submitted sequence has been received (or flushed).
+     */
+    bool isEmpty() const noexcept;
+
+    /**
+     * @brief Get the sequence number of a newly submitted frame.
+     *
+     * It MUST NOT be called while the buffer is full: the new sequence would take the slot of a pending one.
+     */
+    uint64_t submit() noexcept;
+
+    /**
+     * @brief Get a blank frame, recycled if possible.
+     *
+     * @return AVFrame* the frame or nullptr if it could not be allocated
+     */
+    AVFrame* takeSpareFrame() noexcept;
+
+    /**
+     * @brief Store the frame of a sequence.
+     *
+     * @param sequence the sequence returned by submit
+     * @param frame the frame of the sequence (it can be nullptr when completed is false)
+     * @param completed false if the sequence has no frame: the frame is recycled and the sequence skipped
+     */
+    void complete(uint64_t sequence, AVFrame* frame, bool completed) noexcept;
+
+    /**
+     * @brief Get the frame of the next sequence, skipping the ones completed without a frame.
+     *
+     * @param frame receives the frame (any previous content is unreferenced)
+     * @return true IIF a frame has been received, false if the next sequence has not been completed yet
+     */
+    bool receive(AVFrame* frame) noexcept;
+
+    /**
+     * @brief Discard every submitted sequence: the ones still being worked on are recycled when completed.
+     */
+    void flush() noexcept;
+
+private:
+    struct Slot {
+        /**
+         * @brief The frame of the sequence (nullptr for a sequence without one).
+         */
+        AVFrame* frame;
+
+        bool completed;
+    };
+
+    uint64_t m_SubmittedSequence;
+
+    uint64_t m_NextSequence;
+
+    /**
+     * @brief Completed sequences waiting to be received: a sequence is in the slot at sequence % capacity.
+     */
+    std::vector<Slot> m_Slots;
+
+    std::vector<AVFrame*> m_SpareFrames;
+};
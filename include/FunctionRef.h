@@ -0,0 +1,45 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+template <typename Signature>
+class FunctionRef;
+
+/**
+ * @brief A non-owning reference to a callable object.
+ *
+ * Unlike std::function it never allocates and it is just two pointers wide: it is meant to pass
+ * callbacks that are only invoked during the call that receives them (as frame fillers are).
+ *
+ * The referenced callable MUST outlive the FunctionRef object: never store one.
+ */
+template <typename R, typename... Args>
+class FunctionRef<R(Args...)> {
+
+public:
+    template <
+        typename Callable,
+        typename = std::enable_if_t<!std::is_same_v<std::decay_t<Callable>, FunctionRef>>
+    >
+    FunctionRef(Callable&& callable) noexcept
+        : m_Callable(const_cast<void*>(static_cast<const void*>(std::addressof(callable)))),
+        m_Invoke([](void* callable, Args... args) -> R {
+            return (*static_cast<std::add_pointer_t<std::remove_reference_t<Callable>>>(callable))(std::forward<Args>(args)...);
+        }) {
+
+    }
+
+    FunctionRef(const FunctionRef&) noexcept = default;
+
+    FunctionRef& operator=(const FunctionRef&) noexcept = default;
+
+    R operator()(Args... args) const {
+        return m_Invoke(m_Callable, std::forward<Args>(args)...);
+    }
+
+private:
+    void* m_Callable;
+
+    R (*m_Invoke)(void*, Args...);
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "FrameReorderBuffer.h"
+
+struct AVCodec;
+struct AVCodecContext;
+struct AVCodecParameters;
+struct AVFrame;
+struct AVPacket;
+
+/**
+ * @brief A pool of independent codec contexts decoding the packets of an intra-only stream in parallel.
+ *
+ * Intra-only codecs (MJPEG, ProRes, DNxHD, PNG, TIFF, ...) have no dependencies between frames, therefore
+ * every packet can be decoded by a different codec context: packets are dispatched round-robin to the
+ * workers and decoded frames are handed back in the order packets were submitted, that for an intra-only
+ * stream is the presentation order.
+ *
+ * The pool is owned by a single decoding thread: submit, receive and flush MUST be called by that thread.
+ */
+class IntraFrameDecoderPool {
+
+public:
+    IntraFrameDecoderPool() noexcept;
+
+    ~IntraFrameDecoderPool();
+
+    IntraFrameDecoderPool(const IntraFrameDecoderPool&) = delete;
+
+    IntraFrameDecoderPool(IntraFrameDecoderPool&&) = delete;
+
+    IntraFrameDecoderPool& operator=(const IntraFrameDecoderPool&) = delete;
+
+    IntraFrameDecoderPool& operator=(IntraFrameDecoderPool&&) = delete;
+
+    /**
+     * @brief Check if frames of the given codec can be decoded independently of each other.
+     */
+    static bool isIntraOnly(const AVCodecParameters* codecpar) noexcept;
+
+    /**
+     * @brief Open one codec context per worker and start workers.
+     *
+     * @param codec the codec that decodes the stream
+     * @param codecpar the parameters of the stream
+     * @param lowres the lowres factor every context has to use
+     * @param workers the number of codec contexts (and threads)
+     * @return true IIF every codec context has been opened
+     */
+    bool open(const AVCodec* codec, const AVCodecParameters* codecpar, int lowres, size_t workers) noexcept;
+
+    /**
+     * @brief Check if as many packets as the pool can hold are being decoded.
+     */
+    bool isFull() const noexcept;
+
+    /**
+     * @brief Dispatch a packet to the next worker.
+     *
+     * @param packet the packet: its data is moved inside the pool, leaving packet blank
+     */
+    void submit(AVPacket* packet) noexcept;
+
+    /**
+     * @brief Get the next decoded frame in submission order.
+     *
+     * Packets that could not be decoded are skipped.
+     *
+     * @param frame receives the decoded frame (any previous content is unreferenced)
+     * @param wait true to wait for the next frame to be decoded
+     * @return true IIF a frame has been received, false if it is not ready yet (or, when waiting, if no packet is left)
+     */
+    bool receive(AVFrame* frame, bool wait) noexcept;
+
+    /**
+     * @brief Discard every packet submitted so far (to be called after a seek).
+     */
+    void flush() noexcept;
+
+private:
+    struct Job {
+        uint64_t sequence;
+
+        AVPacket* packet;
+    };
+
+    struct Worker {
+        AVCodecContext* context;
+
+        /**
+         * @brief A ring of jobs waiting for the worker: a worker never has more jobs than the pool capacity.
+         */
+        std::vector<Job> jobs;
+
+        size_t head;
+
+        size_t count;
+
+        std::thread thread;
+    };
+
+    void work(Worker& worker) noexcept;
+
+    std::vector<std::unique_ptr<Worker>> m_Workers;
+
+    mutable std::mutex m_Mutex;
+
+    std::condition_variable m_JobQueued;
+
+    std::condition_variable m_FrameDecoded;
+
+    bool m_ShouldStop;
+
+    size_t m_NextWorker;
+
+    /**
+     * @brief Decoded frames waiting to be received: a sequence without a frame is a packet that failed.
+     */
+    FrameReorderBuffer m_Decoded;
+
+    std::vector<AVPacket*> m_SparePackets;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Frame.h"
+
+/**
+ * @brief The adaptive jitter buffer of live inputs.
+ *
+ * Frames of a live input arrive with a variable delay (network, sender and decoder jitter). Every decoded
+ * frame is given a playout time computed from its presentation timestamp: the offset between the local clock
+ * and timestamps is the smallest one observed in the last one or two windows (the fastest recent frame), to which
+ * a playout delay is added. As old observations expire, the offset follows the drift between the clock of the
+ * sender and the local one. The playout delay follows the measured jitter (an RFC 3550 style running estimate)
+ * within the configured bounds, so that the buffer is as short as the input allows.
+ *
+ * A frame whose playout time has already passed by more than the catch-up threshold is behind the live edge
+ * and should be dropped. When frames keep being that late for longer than the re-anchor time (the input became
+ * slower for good) the offset is moved to the transit time of the current frame.
+ *
+ * Times are expressed in microseconds of a monotonic clock.
+ */
+class LivePlayoutBuffer {
+
+public:
+    /**
+     * @brief Transit time variations larger than this are treated as timestamp discontinuities.
+     */
+    static constexpr Frame::TimestampType DiscontinuityThreshold = 5000000;
+
+    /**
+     * @brief The length of the windows the smallest transit time is taken over.
+     */
+    static constexpr Frame::TimestampType MinimumWindow = 10000000;
+
+    /**
+     * @brief How long frames can be behind the live edge before the offset is moved to the current transit time.
+     */
+    static constexpr Frame::TimestampType ReanchorTime = 1000000;
+
+    /**
+     * @brief Construct a new Live Playout Buffer object
+     *
+     * @param minDelay the minimum playout delay
+     * @param maxDelay the maximum playout delay
+     * @param catchUpThreshold how late a frame can be before being dropped
+     */
+    LivePlayoutBuffer(Frame::TimestampType minDelay, Frame::TimestampType maxDelay, Frame::TimestampType catchUpThreshold) noexcept;
+
+    /**
+     * @brief Forget every observation (to be called when the input is opened again).
+     */
+    void reset() noexcept;
+
+    /**
+     * @brief Register the arrival of a frame.
+     *
+     * @param pts the presentation timestamp of the frame
+     * @param arrival the time the frame has been decoded
+     * @return Frame::TimestampType the time the frame has to be presented
+     */
+    Frame::TimestampType schedule(Frame::TimestampType pts, Frame::TimestampType arrival) noexcept;
+
+    /**
+     * @brief Check if a frame scheduled for the given time is too late to be presented.
+     */
+    bool isBehindLiveEdge(Frame::TimestampType playout, Frame::TimestampType now) const noexcept;
+
+    Frame::TimestampType getPlayoutDelay() const noexcept;
+
+    Frame::TimestampType getJitter() const noexcept;
+
+private:
+    Frame::TimestampType m_MinDelay;
+
+    Frame::TimestampType m_MaxDelay;
+
+    Frame::TimestampType m_CatchUpThreshold;
+
+    /**
+     * @brief The smallest transit time of the current window.
+     */
+    std::optional<Frame::TimestampType> m_WindowMinimum;
+
+    /**
+     * @brief The smallest transit time of the previous window.
+     */
+    std::optional<Frame::TimestampType> m_PreviousWindowMinimum;
+
+    Frame::TimestampType m_WindowStart;
+
+    std::optional<Frame::TimestampType> m_LastTransit;
+
+    /**
+     * @brief The arrival of the first frame of the current run of frames behind the live edge.
+     */
+    std::optional<Frame::TimestampType> m_LateSince;
+
+    double m_Jitter;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "BufferedFrameOutputDevice.h"
+
+/**
+ * @brief An output device that only ever presents the newest frame (latest-frame mailbox).
+ *
+ * Frames are exchanged through a lock-free triple buffer:
+ *   - the back slot is owned by the thread calling enqueueFrame
+ *   - the pending slot holds the most recent complete frame, not yet picked up
+ *   - the front slot is owned by the presenting thread (exec)
+ *
+ * enqueueFrame never blocks: it swaps the new frame with the pending one and, if the presenter did not
+ * pick the previous frame up in time, that frame is destroyed right away (giving its memory back to the
+ * allocator) instead of being queued. The latency between decode and presentation is bounded to one frame.
+ *
+ * Frame timestamps are ignored: frames are presented as soon as they arrive, so the device cannot follow
+ * a shared presentation clock.
+ */
+class MailboxFrameOutputDevice : public BufferedFrameOutputDevice {
+
+public:
+    MailboxFrameOutputDevice() noexcept;
+
+    ~MailboxFrameOutputDevice() override;
+
+    void enqueueFrame(Frame&& frame) noexcept override;
+
+    /**
+     * @brief Present every newest frame until interrupt is called.
+     */
+    void exec() noexcept override;
+
+    void interrupt() noexcept;
+
+    /**
+     * @brief Take the most recent complete frame, if one arrived since the last call.
+     *
+     * This is meant to be called by the presenting thread only (exec does it); the returned frame stays
+     * valid until the next call.
+     *
+     * @return const Frame* the newest frame or nullptr if no new frame has been enqueued
+     */
+    const Frame* acquireLatestFrame() noexcept;
+
+    /**
+     * @brief Get the number of frames replaced by a newer one before being presented.
+     */
+    uint64_t getDroppedFrames() const noexcept;
+
+protected:
+    /**
+     * @brief Show a frame: called by exec for every acquired frame.
+     */
+    virtual void present(const Frame& frame) noexcept;
+
+private:
+    // the pending slot index lives in the low bits of m_Pending, along with a flag telling if it holds a fresh frame
+    static constexpr uint32_t SlotMask = 0x3;
+
+    static constexpr uint32_t FreshFlag = 0x4;
+
+    std::optional<Frame> m_Slots[3];
+
+    uint32_t m_BackSlot;
+
+    uint32_t m_FrontSlot;
+
+    std::atomic<uint32_t> m_Pending;
+
+    /**
+     * @brief Signalled (without ever blocking) on every publication and on interrupt, polled by the presenter.
+     */
+    int m_WakeFd;
+
+    std::atomic_bool m_ShouldStop;
+
+    std::atomic<uint64_t> m_Dropped;
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "EODPlayer.hpp"
+
+/**
+ * @brief The NUMA nodes of the host, their CPUs and memory, and the means to place threads and memory on them.
+ *
+ * On hosts with more than one socket a frame written by a thread of one node and read by a thread of another
+ * crosses the interconnect: the threads working on a stream and the memory of its frames are kept on one node.
+ *
+ * Threads inherit the placement of the thread creating them: placing the decoding thread places every worker
+ * it starts (pipeline workers, intra-only decoders and codec threads) as well as the memory they allocate.
+ *
+ * The topology is read from sysfs; on hosts without NUMA support it is a single node with every CPU.
+ */
+class NumaTopology {
+
+public:
+    typedef uint32_t NodeType;
+
+    struct Node {
+        NodeType id;
+
+        std::vector<uint32_t> cpus;
+
+        /**
+         * @brief The memory attached to the node (bytes, 0 if unknown).
+         */
+        uint64_t memory;
+    };
+
+    /**
+     * @brief Get the topology of the host, read the first time it is requested.
+     */
+    static const NumaTopology& get() noexcept;
+
+    NumaTopology(const NumaTopology&) = delete;
+
+    NumaTopology(NumaTopology&&) = delete;
+
+    NumaTopology& operator=(const NumaTopology&) = delete;
+
+    NumaTopology& operator=(NumaTopology&&) = delete;
+
+    const std::vector<Node>& getNodes() const noexcept;
+
+    /**
+     * @brief Check if the host has more than one node (placement has no effect otherwise).
+     */
+    bool isNuma() const noexcept;
+
+    /**
+     * @brief Get the node a CPU belongs to.
+     */
+    std::optional<NodeType> getNodeOfCpu(uint32_t cpu) const noexcept;
+
+    /**
+     * @brief Get the CPU the calling thread is running on.
+     */
+    static std::optional<uint32_t> getCurrentCpu() noexcept;
+
+    /**
+     * @brief Run the calling thread (and threads it creates from now on) on the CPUs of a node only,
+     * allocating memory from that node whenever it has free memory.
+     *
+     * @return true IIF the thread has been placed
+     */
+    bool bindThread(NodeType node) const noexcept;
+
+    /**
+     * @brief Place the pages of a memory range on a node, moving the ones already touched.
+     *
+     * Pages not touched yet are placed when first written (by any thread).
+     *
+     * @param mem the start of the range (page aligned)
+     * @param size the size of the range (bytes)
+     * @return true IIF the placement policy has been set
+     */
+    bool bindMemory(void* mem, size_t size, NodeType node) const noexcept;
+
+    /**
+     * @brief Get the node the page holding the given address is on.
+     *
+     * @return the node or an empty value if the page has never been touched
+     */
+    static std::optional<NodeType> getMemoryNode(const void* address) noexcept;
+
+private:
+    NumaTopology() noexcept;
+
+    std::vector<Node> m_Nodes;
+};
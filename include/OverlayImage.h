@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Frame.h"
+
+/**
+ * @brief An image (a logo, a ticker, a subtitle) to be composited over frames, with its rasters cached per frame format.
+ *
+ * The image is given once as straight-alpha RGBA32 and converted, the first time frames of a format need it
+ * (or up front with prepare), to premultiplied samples laid out as frame pixels: RGBA32 or RGBA64 pixels, or NV12
+ * luma and chroma planes with their alpha at the resolution of each plane (chroma is subsampled with premultiplied
+ * averages). Each row also records the span of samples that are not fully transparent: blending never touches
+ * the pixels outside of it.
+ *
+ * Rasters are built once and never change: an image can be shared by compositors on different threads.
+ */
+class OverlayImage {
+
+public:
+    /**
+     * @brief The samples of a row that are not fully transparent: [begin, end).
+     */
+    struct Span {
+        uint32_t begin;
+
+        uint32_t end;
+    };
+
+    /**
+     * @brief A plane of a raster.
+     */
+    struct Plane {
+        /**
+         * @brief Premultiplied samples (pixels for RGBA formats, bytes for NV12 planes), row after row.
+         */
+        std::vector<uint8_t> samples;
+
+        /**
+         * @brief The alpha of each sample, empty for RGBA formats (alpha is a component of the pixel).
+         */
+        std::vector<uint8_t> alpha;
+
+        std::vector<Span> spans;
+
+        /**
+         * @brief The number of samples of a row.
+         */
+        uint32_t width;
+
+        uint32_t height;
+    };
+
+    /**
+     * @brief The image converted for frames of a pixel format.
+     */
+    struct Raster {
+        Frame::PixelFormat format;
+
+        /**
+         * @brief One plane for RGBA formats, luma and interleaved chroma for NV12.
+         */
+        std::vector<Plane> planes;
+    };
+
+    /**
+     * @param rgba the image pixels (RGBA32, not premultiplied), copied inside the image
+     * @param width the number of horizontal pixels of the image
+     * @param height the number of vertical pixels of the image
+     */
+    OverlayImage(const uint8_t* rgba, uint32_t width, uint32_t height) noexcept;
+
+    ~OverlayImage();
+
+    OverlayImage(const OverlayImage&) = delete;
+
+    OverlayImage(OverlayImage&&) = delete;
+
+    OverlayImage& operator=(const OverlayImage&) = delete;
+
+    OverlayImage& operator=(OverlayImage&&) = delete;
+
+    uint32_t getWidth() const noexcept;
+
+    uint32_t getHeight() const noexcept;
+
+    /**
+     * @brief Build the raster for frames of a pixel format, so that the first frame composited does not pay for it.
+     *
+     * @param pf the frame pixel format
+     * @param bt709 for NV12: convert with the BT.709 matrix instead of BT.601 (frames at least 720 lines high use BT.709)
+     */
+    void prepare(Frame::PixelFormat pf, bool bt709) noexcept;
+
+    /**
+     * @brief Get the raster for frames of a pixel format, building it if needed.
+     */
+    const Raster& getRaster(Frame::PixelFormat pf, bool bt709) noexcept;
+
+private:
+    void rasterizeRGBA32(Raster& raster) const noexcept;
+
+    void rasterizeRGBA64(Raster& raster) const noexcept;
+
+    void rasterizeNV12(Raster& raster, bool bt709) const noexcept;
+
+    std::vector<uint8_t> m_Image;
+
+    const uint32_t m_Width;
+
+    const uint32_t m_Height;
+
+    std::mutex m_RasterMutex;
+
+    /**
+     * @brief Rasters by format: RGBA64, RGBA32, NV12 (BT.601) and NV12 (BT.709).
+     */
+    std::unique_ptr<Raster> m_Rasters[4];
+};
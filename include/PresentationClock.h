@@ -0,0 +1,195 @@
+#pragma once
+
+#include "Frame.h"
+
+/**
+ * @brief A presentation clock shared by every player process of a host (i.e. one process per screen of a video wall).
+ *
+ * The clock is a timeline in shared memory mapping frame timestamps to times of the monotonic clock of the host
+ * (steady_clock, that is CLOCK_MONOTONIC: the same in every process):
+ *
+ *     time(pts) = anchorTime + (pts - anchorMedia) / rate
+ *
+ * Output devices given the clock present every frame at the time of its timestamp (minus their own latency)
+ * instead of following their local clock, so that every screen shows the same frame at the same time.
+ * A stopped timeline (rate 0) holds frames.
+ *
+ * The clock is created by its authority (the process controlling the wall, or a PresentationClockFollower mirroring
+ * the authority of another host) and opened by every other process: only the authority changes the timeline,
+ * except for the start of an armed barrier. The timeline is protected by a sequence lock, so readers never block
+ * writers; its sequence word is also the futex waiters sleep on.
+ *
+ * A start barrier makes playback start on the same frame everywhere: the authority arms it with the number of
+ * participants and the timestamp of the first frame, then every participant (an output device holding its first
+ * frame) arrives; the last arrival starts the timeline StartDelay in the future, leaving every device the time to wake up.
+ */
+class PresentationClock {
+
+public:
+    /**
+     * @brief The delay between the last arrival at the start barrier and the start of the timeline.
+     */
+    static constexpr Frame::TimestampType StartDelay = 100000;
+
+    /**
+     * @brief The mapping of frame timestamps to the monotonic clock.
+     */
+    struct Timeline {
+        /**
+         * @brief The time (in microseconds of the monotonic clock) anchorMedia is presented at.
+         */
+        Frame::TimestampType anchorTime;
+
+        Frame::TimestampType anchorMedia;
+
+        /**
+         * @brief The speed of the timeline (1.0 = real time, 0.0 = stopped).
+         */
+        double rate;
+    };
+
+    /**
+     * @brief The state of the start barrier.
+     */
+    struct Barrier {
+        /**
+         * @brief Incremented every time the barrier is armed (0 = never armed).
+         */
+        uint32_t generation;
+
+        /**
+         * @brief The number of participants that have to arrive (0 = the barrier is not armed).
+         */
+        uint32_t expected;
+
+        uint32_t arrived;
+
+        Frame::TimestampType startMedia;
+    };
+
+    /**
+     * @brief Get the current time of the monotonic clock shared by every process of the host.
+     *
+     * @return Frame::TimestampType the time in microseconds
+     */
+    static Frame::TimestampType now() noexcept;
+
+    /**
+     * @brief Construct a new Presentation Clock object
+     *
+     * @param name the name of the shared memory object (i.e. "/eod-wall-clock")
+     * @param authority true to create the clock (and be the only one allowed to change it), false to open an existing clock
+     */
+    PresentationClock(const std::string& name, bool authority) noexcept;
+
+    ~PresentationClock();
+
+    PresentationClock(const PresentationClock&) = delete;
+
+    PresentationClock(PresentationClock&&) = delete;
+
+    PresentationClock& operator=(const PresentationClock&) = delete;
+
+    PresentationClock& operator=(PresentationClock&&) = delete;
+
+    bool isValid() const noexcept;
+
+    bool isAuthority() const noexcept;
+
+    /**
+     * @brief Get a consistent copy of the timeline.
+     */
+    Timeline getTimeline() const noexcept;
+
+    /**
+     * @brief Get a value that changes every time the timeline changes.
+     */
+    uint32_t getEpoch() const noexcept;
+
+    /**
+     * @brief Wait for the timeline to change (or for an arrival at the start barrier).
+     *
+     * @param epoch the epoch observed before deciding to wait
+     * @param timeout the maximum wait (in microseconds)
+     * @return true IIF the epoch is not the given one anymore
+     */
+    bool waitForChange(uint32_t epoch, Frame::TimestampType timeout) const noexcept;
+
+    /**
+     * @brief Get the timestamp being presented at the given time.
+     */
+    Frame::TimestampType getMediaTime(Frame::TimestampType time) const noexcept;
+
+    /**
+     * @brief Get the time a frame has to be presented at.
+     *
+     * @param pts the timestamp of the frame
+     * @return std::optional<Frame::TimestampType> the time or nothing if the timeline is stopped
+     */
+    std::optional<Frame::TimestampType> getPresentationTime(Frame::TimestampType pts) const noexcept;
+
+    /**
+     * @brief Replace the timeline (authority only).
+     */
+    void setTimeline(const Timeline& timeline) noexcept;
+
+    /**
+     * @brief Stop the timeline on the timestamp being presented (authority only).
+     */
+    void pause() noexcept;
+
+    /**
+     * @brief Start the timeline again, from the timestamp it was stopped on (authority only).
+     *
+     * @param rate the new speed
+     * @param delay how far in the future the timeline starts (microseconds)
+     */
+    void resume(double rate = 1.0, Frame::TimestampType delay = StartDelay) noexcept;
+
+    /**
+     * @brief Stop the timeline on a timestamp and wait for participants to be ready to present it (authority only).
+     *
+     * @param participants the number of arrivals that start the timeline
+     * @param startMedia the timestamp of the first frame
+     */
+    void armStart(uint32_t participants, Frame::TimestampType startMedia) noexcept;
+
+    Barrier getBarrier() const noexcept;
+
+    /**
+     * @brief Report participants ready at the start barrier.
+     *
+     * Arrivals for an old generation are ignored. The last arrival starts the timeline.
+     *
+     * @param generation the generation of the barrier the participants are ready for
+     * @param count the number of participants
+     */
+    void arrive(uint32_t generation, uint32_t count = 1) noexcept;
+
+    /**
+     * @brief Copy the barrier of another clock, keeping the local arrivals of the same generation (authority only).
+     *
+     * A mirrored barrier never starts the timeline: arrivals are reported to the clock it is mirrored from.
+     */
+    void mirrorBarrier(uint32_t generation, Frame::TimestampType startMedia) noexcept;
+
+private:
+    struct SharedState;
+
+    /**
+     * @brief Write the timeline and notify waiters.
+     */
+    void publish(const Timeline& timeline) noexcept;
+
+    void wake() noexcept;
+
+    const std::string m_Name;
+
+    const bool m_Authority;
+
+    int m_Fd;
+
+    SharedState* m_State;
+
+    std::mutex m_WriterMutex;
+};
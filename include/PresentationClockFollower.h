@@ -0,0 +1,127 @@
+#pragma once
+
+#include "PresentationClock.h"
+
+#include <deque>
+
+/**
+ * @brief Mirrors the presentation clock of another host on a local presentation clock.
+ *
+ * The monotonic clocks of two hosts differ by an offset that changes over time (drift). The follower exchanges
+ * timestamps with a PresentationClockServer every SyncInterval and estimates both:
+ *   - every exchange is a sample of the offset, whose error is bounded by half its round trip time, so only samples
+ *     with a round trip close to the shortest one observed are trusted
+ *   - the offset and the drift are the intercept and the slope of a least squares fit of the trusted samples
+ *
+ * The timeline of the server is translated to the local clock (anchor time moved by the offset, rate scaled by
+ * the drift) and published on the local clock, that local output devices follow as if it were the authority.
+ * Local arrivals at the start barrier are reported to the server.
+ */
+class PresentationClockFollower {
+
+public:
+    /**
+     * @brief The time between two sync requests (microseconds).
+     */
+    static constexpr Frame::TimestampType SyncInterval = 100000;
+
+    /**
+     * @brief The number of samples the estimate is computed from.
+     */
+    static constexpr size_t SampleWindow = 64;
+
+    /**
+     * @param local the clock to publish on, created as authority: MUST outlive the follower
+     * @param serverPath the path of the socket of the server (or of a relay to it)
+     */
+    PresentationClockFollower(PresentationClock& local, const std::string& serverPath) noexcept;
+
+    ~PresentationClockFollower();
+
+    PresentationClockFollower(const PresentationClockFollower&) = delete;
+
+    PresentationClockFollower(PresentationClockFollower&&) = delete;
+
+    PresentationClockFollower& operator=(const PresentationClockFollower&) = delete;
+
+    PresentationClockFollower& operator=(PresentationClockFollower&&) = delete;
+
+    bool isValid() const noexcept;
+
+    /**
+     * @brief Synchronize until interrupt is called.
+     */
+    void exec() noexcept;
+
+    void interrupt() noexcept;
+
+    /**
+     * @brief Check if enough samples have been collected for the estimate to be used.
+     */
+    bool isSynchronized() const noexcept;
+
+    /**
+     * @brief Get the estimated server clock minus the local clock, now (microseconds).
+     */
+    Frame::TimestampType getOffset() const noexcept;
+
+    /**
+     * @brief Get the estimated drift of the server clock relative to the local one (parts per million).
+     */
+    double getDrift() const noexcept;
+
+    /**
+     * @brief Get the shortest round trip time observed (microseconds).
+     */
+    Frame::TimestampType getRoundTrip() const noexcept;
+
+private:
+    struct Sample {
+        /**
+         * @brief The local time in the middle of the exchange.
+         */
+        Frame::TimestampType time;
+
+        Frame::TimestampType offset;
+
+        Frame::TimestampType roundTrip;
+    };
+
+    /**
+     * @brief Exchange timestamps with the server and update the local clock.
+     */
+    bool synchronize() noexcept;
+
+    /**
+     * @brief Fit offset and drift to the trusted samples.
+     */
+    void estimate() noexcept;
+
+    PresentationClock& m_Local;
+
+    const std::string m_ServerPath;
+
+    int m_Socket;
+
+    std::atomic_bool m_ShouldStop;
+
+    std::deque<Sample> m_Samples;
+
+    /**
+     * @brief The estimate: offset(t) = m_Offset + m_Slope * (t - m_ReferenceTime).
+     */
+    std::atomic<Frame::TimestampType> m_ReferenceTime;
+
+    std::atomic<double> m_Offset;
+
+    std::atomic<double> m_Slope;
+
+    std::atomic<Frame::TimestampType> m_RoundTrip;
+
+    std::atomic_bool m_Synchronized;
+
+    /**
+     * @brief The server timeline last published on the local clock.
+     */
+    std::optional<PresentationClock::Timeline> m_Published;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Messages exchanged between a PresentationClockServer and its followers.
+ *
+ * Every message is a single datagram; only fixed-size types are used, so that the layout is the same on both ends.
+ * A follower sends a Request every sync interval and the server answers with a Reply carrying four timestamps
+ * of the exchange (NTP style) along with the timeline and the start barrier of the authority:
+ *
+ *   - t1: the request is sent (follower clock)
+ *   - t2: the request is received (server clock)
+ *   - t3: the reply is sent (server clock)
+ *   - t4: the reply is received (follower clock)
+ *
+ * Requests also carry the arrivals at the start barrier counted by the follower, for the server to add them
+ * to the barrier of the authority.
+ */
+namespace PresentationClockProtocol {
+
+    constexpr uint32_t Magic = 0x454F4453; // "EODS"
+
+    constexpr uint32_t Version = 1;
+
+    struct Request {
+        uint32_t magic;
+        uint32_t version;
+
+        /**
+         * @brief t1
+         */
+        int64_t sendTime;
+
+        /**
+         * @brief The barrier generation arrivals refer to.
+         */
+        uint32_t barrierGeneration;
+
+        /**
+         * @brief The participants arrived on the follower host so far (for the given generation).
+         */
+        uint32_t arrived;
+    };
+
+    struct Reply {
+        uint32_t magic;
+        uint32_t version;
+
+        /**
+         * @brief t1, copied from the request
+         */
+        int64_t requestSendTime;
+
+        /**
+         * @brief t2
+         */
+        int64_t receiveTime;
+
+        /**
+         * @brief t3
+         */
+        int64_t sendTime;
+
+        int64_t anchorTime;
+        int64_t anchorMedia;
+        double rate;
+
+        uint32_t barrierGeneration;
+        uint32_t reserved;
+        int64_t barrierStartMedia;
+    };
+
+}
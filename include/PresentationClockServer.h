@@ -0,0 +1,63 @@
+#pragma once
+
+#include "PresentationClock.h"
+
+/**
+ * @brief Publishes the timeline of a presentation clock to followers on other hosts.
+ *
+ * The server answers the sync requests of PresentationClockFollower objects on a local datagram socket:
+ * a relay forwarding datagrams between hosts (or a socket of the same host, for testing) stands in
+ * for the network transport. Arrivals at the start barrier reported by followers are added to the barrier
+ * of the clock, so the timeline starts when every participant of every host is ready.
+ */
+class PresentationClockServer {
+
+public:
+    /**
+     * @param clock the clock to publish: MUST outlive the server
+     * @param socketPath the path of the socket to bind
+     */
+    PresentationClockServer(PresentationClock& clock, const std::string& socketPath) noexcept;
+
+    ~PresentationClockServer();
+
+    PresentationClockServer(const PresentationClockServer&) = delete;
+
+    PresentationClockServer(PresentationClockServer&&) = delete;
+
+    PresentationClockServer& operator=(const PresentationClockServer&) = delete;
+
+    PresentationClockServer& operator=(PresentationClockServer&&) = delete;
+
+    bool isValid() const noexcept;
+
+    /**
+     * @brief Answer sync requests until interrupt is called.
+     */
+    void exec() noexcept;
+
+    void interrupt() noexcept;
+
+private:
+    /**
+     * @brief The arrivals already added to the barrier for a follower.
+     */
+    struct FollowerArrivals {
+        uint32_t generation;
+
+        uint32_t arrived;
+    };
+
+    PresentationClock& m_Clock;
+
+    const std::string m_SocketPath;
+
+    int m_Socket;
+
+    std::atomic_bool m_ShouldStop;
+
+    /**
+     * @brief Followers are identified by the address of their socket.
+     */
+    std::unordered_map<std::string, FollowerArrivals> m_Arrivals;
+};
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "Decoder.h"
+
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
+
+struct AVFormatContext;
+struct AVCodecContext;
+
+/**
+ * @brief Keeps fast-to-decode proxies of the assets this host cannot decode in realtime, next to the originals.
+ *
+ * A proxy is the video of an asset scaled down and encoded intra-only (MJPEG in Matroska): it keeps the timestamps
+ * of the original, so seeks and loops behave the same, and it is decoded in parallel by the intra-only decoder pool.
+ * Proxies are sidecar files, hidden in the directory of the original (".<name>.proxy.mkv"), and are considered
+ * only while they are newer than the original.
+ *
+ * Assets are transcoded in the background, one at a time, by a thread that is scheduled only when the CPU would
+ * otherwise be idle (SCHED_IDLE), so that transcoding never slows playback down.
+ *
+ * Proxies are evicted, least recently used first, to keep the bytes they take within a disk budget. Only proxies
+ * the cache has seen (transcoded or looked up) are accounted for.
+ */
+class ProxyCache {
+
+public:
+    struct Options {
+        /**
+         * @brief The bytes proxies can take on disk.
+         */
+        uint64_t budget = 8ull * 1024 * 1024 * 1024;
+
+        /**
+         * @brief Proxies fit inside this size (preserving the aspect ratio of originals).
+         */
+        uint32_t maxWidth = 1280;
+
+        uint32_t maxHeight = 720;
+
+        /**
+         * @brief The JPEG quantizer of proxy frames (2 = best, 31 = worst).
+         */
+        int quality = 4;
+
+        /**
+         * @brief The decoding load (time to decode and convert a frame over the time it is shown for) above which an asset needs a proxy.
+         */
+        double heavyLoad = 0.9;
+    };
+
+    struct Statistics {
+        /**
+         * @brief The proxies known to the cache.
+         */
+        uint64_t proxies;
+
+        uint64_t bytes;
+
+        uint64_t transcoded;
+
+        uint64_t failed;
+
+        uint64_t evicted;
+
+        /**
+         * @brief The assets waiting to be transcoded.
+         */
+        uint64_t pending;
+    };
+
+    ProxyCache(const Options& options) noexcept;
+
+    ~ProxyCache();
+
+    ProxyCache(const ProxyCache&) = delete;
+
+    ProxyCache(ProxyCache&&) = delete;
+
+    ProxyCache& operator=(const ProxyCache&) = delete;
+
+    ProxyCache& operator=(ProxyCache&&) = delete;
+
+    const Options& getOptions() const noexcept;
+
+    /**
+     * @brief Get the name of the sidecar file holding the proxy of an asset.
+     */
+    static Decoder::FileNameType getProxyFilename(const Decoder::FileNameType& original) noexcept;
+
+    /**
+     * @brief Get the proxy of an asset, marking it as recently used.
+     *
+     * @param original the file name of the asset
+     * @return the file name of the proxy, or an empty value if there is no up-to-date proxy
+     */
+    std::optional<Decoder::FileNameType> lookup(const Decoder::FileNameType& original) noexcept;
+
+    /**
+     * @brief Queue an asset for transcoding (nothing is done if it is already queued or has an up-to-date proxy).
+     */
+    void request(const Decoder::FileNameType& original) noexcept;
+
+    Statistics getStatistics() const noexcept;
+
+private:
+    struct Entry {
+        Decoder::FileNameType proxy;
+
+        uint64_t bytes;
+
+        /**
+         * @brief The time (seconds since the epoch) the proxy has last been used: its modification time.
+         */
+        int64_t lastUse;
+    };
+
+    void transcodingLoop() noexcept;
+
+    /**
+     * @brief Transcode an asset into a proxy.
+     *
+     * @return true IIF the proxy has been completely written
+     */
+    bool transcode(const Decoder::FileNameType& original, const Decoder::FileNameType& proxy) noexcept;
+
+    /**
+     * @brief Write every packet the encoder has ready.
+     */
+    bool writePackets(AVCodecContext* encoderCtx, AVFormatContext* outputCtx) noexcept;
+
+    /**
+     * @brief Delete least recently used proxies until the budget is respected.
+     *
+     * MUST be called with m_Mutex held.
+     */
+    void evict() noexcept;
+
+    /**
+     * @brief Remember an existing proxy, forgetting it if it is older than its asset.
+     *
+     * MUST be called with m_Mutex held.
+     *
+     * @return the entry of the proxy, nullptr if there is no up-to-date proxy
+     */
+    Entry* track(const Decoder::FileNameType& original) noexcept;
+
+    void forget(const Decoder::FileNameType& original) noexcept;
+
+    const Options m_Options;
+
+    mutable std::mutex m_Mutex;
+
+    std::condition_variable m_Wakeup;
+
+    std::deque<Decoder::FileNameType> m_Requests;
+
+    /**
+     * @brief Proxies by the file name of their asset.
+     */
+    std::unordered_map<Decoder::FileNameType, Entry> m_Entries;
+
+    /**
+     * @brief The asset being transcoded (empty if none).
+     */
+    Decoder::FileNameType m_Transcoding;
+
+    std::atomic_bool m_Stopping;
+
+    Statistics m_Statistics;
+
+    std::thread m_Thread;
+};
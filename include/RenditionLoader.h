@@ -0,0 +1,134 @@
+#pragma once
+
+#include "Decoder.h"
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVFrame;
+
+/**
+ * @brief Opens a rendition of the playing asset in the background, so that the decoder can switch to it seamlessly.
+ *
+ * Renditions are encodings of the same content at different resolutions (or bitrates) sharing the same timeline.
+ * A rendition is prepared starting from a timestamp ahead of the playback: the file is opened, the decoder is
+ * positioned on the first keyframe at or after that timestamp and the keyframe is decoded. When the playback
+ * reaches it the decoder takes the prepared contexts over and goes on decoding from the keyframe, so that no frame
+ * is lost or shown twice.
+ *
+ * The loader is owned by a single decoding thread: prepare, take and cancel MUST be called by that thread.
+ */
+class RenditionLoader {
+
+public:
+    /**
+     * @brief The video stream of a rendition.
+     */
+    struct Rendition {
+        Decoder::FileNameType filename;
+
+        uint32_t width;
+
+        uint32_t height;
+
+        /**
+         * @brief The bitrate of the video stream (bits per second, 0 if unknown).
+         */
+        int64_t bitRate;
+    };
+
+    /**
+     * @brief A rendition ready to be decoded: the ownership of every resource goes to whoever takes it.
+     */
+    struct Prepared {
+        size_t index;
+
+        AVFormatContext* formatCtx;
+
+        AVCodecContext* codecCtx;
+
+        int videoStream;
+
+        /**
+         * @brief The decoded keyframe the rendition starts from.
+         */
+        AVFrame* keyframe;
+
+        Frame::TimestampType pts;
+    };
+
+    RenditionLoader() noexcept;
+
+    ~RenditionLoader();
+
+    RenditionLoader(const RenditionLoader&) = delete;
+
+    RenditionLoader(RenditionLoader&&) = delete;
+
+    RenditionLoader& operator=(const RenditionLoader&) = delete;
+
+    RenditionLoader& operator=(RenditionLoader&&) = delete;
+
+    /**
+     * @brief Read the size of the video stream of a rendition.
+     *
+     * @return the rendition or an empty value if it has no video stream
+     */
+    static std::optional<Rendition> probe(const Decoder::FileNameType& filename) noexcept;
+
+    /**
+     * @brief Start preparing a rendition, discarding the one being prepared (if any).
+     *
+     * @param index the identifier of the rendition, given back with the prepared rendition
+     * @param filename the file of the rendition
+     * @param from the rendition starts from the first keyframe at or after this timestamp (microseconds)
+     */
+    void prepare(size_t index, const Decoder::FileNameType& filename, Frame::TimestampType from) noexcept;
+
+    /**
+     * @brief Get the identifier of the rendition being prepared (or prepared and not taken yet).
+     */
+    std::optional<size_t> getPending() const noexcept;
+
+    /**
+     * @brief Check if the pending rendition is ready to be taken.
+     *
+     * @return the timestamp of its first keyframe or an empty value if it is not ready yet
+     */
+    std::optional<Frame::TimestampType> getReadyTimestamp() const noexcept;
+
+    /**
+     * @brief Take the ready rendition.
+     *
+     * @param prepared filled with the rendition
+     * @return true IIF a rendition was ready
+     */
+    bool take(Prepared& prepared) noexcept;
+
+    /**
+     * @brief Discard the rendition being prepared (i.e. after a seek).
+     */
+    void cancel() noexcept;
+
+    /**
+     * @brief Free every resource of a prepared rendition.
+     */
+    static void release(Prepared& prepared) noexcept;
+
+private:
+    void load(Decoder::FileNameType filename, Frame::TimestampType from) noexcept;
+
+    std::thread m_Thread;
+
+    std::atomic_bool m_Cancel;
+
+    std::optional<size_t> m_Pending;
+
+    /**
+     * @brief Set by the loading thread when m_Prepared can be read, or when loading failed.
+     */
+    std::atomic_bool m_Done;
+
+    bool m_Failed;
+
+    Prepared m_Prepared;
+};
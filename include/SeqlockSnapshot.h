@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * @brief A value published by a single thread and read, as a consistent copy, by any thread.
+ *
+ * The value is protected by a sequence lock: the writer never waits (it bumps the sequence to an odd value,
+ * stores the value and bumps it again) and readers never block the writer, they copy the value again when
+ * a store overlapped their copy. The value is kept in atomic words, so torn copies are detected and never
+ * a data race.
+ *
+ * store MUST be called by one thread at a time (i.e. the thread owning the statistics).
+ */
+template <typename T>
+class SeqlockSnapshot {
+    static_assert(std::is_trivially_copyable_v<T>, "snapshots are copied word by word");
+
+    static constexpr size_t Words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+public:
+    SeqlockSnapshot() noexcept
+     : m_Sequence(0) {
+        store(T{});
+    }
+
+    SeqlockSnapshot(const SeqlockSnapshot&) = delete;
+
+    SeqlockSnapshot(SeqlockSnapshot&&) = delete;
+
+    SeqlockSnapshot& operator=(const SeqlockSnapshot&) = delete;
+
+    SeqlockSnapshot& operator=(SeqlockSnapshot&&) = delete;
+
+    void store(const T& value) noexcept {
+        uint64_t words[Words] = {};
+        std::memcpy(words, &value, sizeof(T));
+
+        const uint32_t sequence = m_Sequence.load(std::memory_order_relaxed);
+        m_Sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < Words; ++i) {
+            m_Words[i].store(words[i], std::memory_order_relaxed);
+        }
+
+        m_Sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    T load() const noexcept {
+        uint64_t words[Words];
+
+        while (true) {
+            const uint32_t begin = m_Sequence.load(std::memory_order_acquire);
+            if ((begin & 1) != 0) {
+                continue;
+            }
+
+            for (size_t i = 0; i < Words; ++i) {
+                words[i] = m_Words[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_Sequence.load(std::memory_order_relaxed) == begin) {
+                break;
+            }
+        }
+
+        T value;
+        std::memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+private:
+    alignas(64) std::atomic<uint32_t> m_Sequence;
+
+    std::atomic<uint64_t> m_Words[Words];
+};
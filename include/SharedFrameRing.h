@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Memory layout of a shared-memory ring of frame slots.
+ *
+ * The layout is shared between the producer (a SharedMemoryFrameOutputDevice) and any consumer process
+ * that maps the same memory file descriptor: only fixed-size types and lock-free atomics are used so that
+ * the layout is identical in every process mapping it.
+ *
+ * The mapping starts with a SharedFrameRingHeader, followed by slotCount SharedFrameSlotHeader objects;
+ * pixel data for slot i starts at dataOffset + i * slotStride bytes from the beginning of the mapping.
+ *
+ * Every slot moves through the following states:
+ *   - Free      -> the producer can hand the slot to the decoder as frame memory
+ *   - Writing   -> the decoder is writing pixel data inside the slot (or the producer is reclaiming it)
+ *   - Published -> metadata and pixel data are valid, the consumer can read the slot
+ *   - Reading   -> the consumer is reading the slot (a consumer CAS Published -> Reading before touching pixels)
+ *   - Released  -> the consumer is done with the slot, the producer will bring it back to Free
+ *
+ * A consumer is notified of newly published frames via the "ready" eventfd and MUST write to
+ * the "release" eventfd after marking one or more slots as Released.
+ */
+namespace SharedFrameRing {
+
+    constexpr uint32_t Magic = 0x454F4446; // "EODF"
+
+    constexpr uint32_t Version = 1;
+
+    enum class SlotState : uint32_t {
+        Free = 0,
+        Writing = 1,
+        Published = 2,
+        Reading = 3,
+        Released = 4,
+    };
+
+    struct alignas(64) Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slotCount;
+        uint32_t reserved;
+        uint64_t slotStride;
+        uint64_t dataOffset;
+
+        /**
+         * @brief The sequence number of the most recently published frame (0 = none yet)
+         */
+        std::atomic<uint64_t> publishedSequence;
+    };
+
+    struct alignas(64) SlotHeader {
+        std::atomic<uint32_t> state;
+        uint32_t pixelFormat;
+        uint32_t width;
+        uint32_t height;
+        uint64_t stride;
+        uint64_t size;
+        uint64_t sequence;
+        int64_t pts;
+    };
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared memory slot state must be lock-free");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory sequence must be lock-free");
+
+    inline Header* header(void* mapping) noexcept {
+        return reinterpret_cast<Header*>(mapping);
+    }
+
+    inline SlotHeader* slot(void* mapping, uint32_t index) noexcept {
+        return reinterpret_cast<SlotHeader*>(reinterpret_cast<uint8_t*>(mapping) + sizeof(Header)) + index;
+    }
+
+    inline uint8_t* pixels(void* mapping, uint32_t index) noexcept {
+        const Header* hdr = header(mapping);
+        return reinterpret_cast<uint8_t*>(mapping) + hdr->dataOffset + (hdr->slotStride * index);
+    }
+
+}
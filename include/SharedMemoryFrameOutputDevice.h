@@ -0,0 +1,137 @@
+#pragma once
+
+#include "BufferedFrameOutputDevice.h"
+
+#include "SharedFrameRing.h"
+#include "FrameAllocator.h"
+
+#include <atomic>
+#include <condition_variable>
+
+/**
+ * @brief A buffered output device that publishes frames to other processes via shared memory.
+ *
+ * Frame memory lives inside a ring of fixed-size slots allocated in a memfd (or in a named POSIX shared memory
+ * object when the given name starts with '/'), described by the layout in SharedFrameRing.h.
+ *
+ * To avoid every copy the device is also the frame allocator of the decoder, so that frames are decoded
+ * directly into shared slots (the slot index of a frame is its ring slot):
+ *
+ *     SharedMemoryFrameOutputDevice sink(8, maxFrameBytes);
+ *     FFMPEGDecoder decoder(&sink, &sink);
+ *
+ * Frames allocated elsewhere are still accepted, but are copied inside a free slot.
+ *
+ * When the consumer falls behind, published frames that have been superseded by a newer one and that
+ * the consumer has not started reading are recycled to make room for the newest frames.
+ *
+ * Frames are published as soon as they are enqueued: consumers present them when their timestamp comes,
+ * so a shared presentation clock has to be followed by the consumer, not by this device.
+ */
+class SharedMemoryFrameOutputDevice : public BufferedFrameOutputDevice, public FrameAllocator {
+
+public:
+    /**
+     * @brief Construct a new Shared Memory Frame Output Device object
+     *
+     * @param frameCount the number of shared slots
+     * @param maxFrameSize the maximum size (in bytes) of pixel data for a single frame
+     * @param name the memfd label or, if it starts with '/', the name of the POSIX shared memory object to create
+     */
+    SharedMemoryFrameOutputDevice(
+        BufferedFrameOutputDevice::FrameCountType frameCount,
+        size_t maxFrameSize,
+        const std::string& name = "eodplayer-frames"
+    ) noexcept;
+
+    ~SharedMemoryFrameOutputDevice() override;
+
+    /**
+     * @brief Check if the shared memory and notification objects have been successfully created.
+     *
+     * @return true IIF the device can be used
+     */
+    bool isValid() const noexcept;
+
+    /**
+     * @brief Obtain the memory of a free shared slot.
+     *
+     * This is a blocking call that waits for the consumer to release a slot if none is available.
+     *
+     * @param size the number of bytes required
+     * @param slot written with the index of the obtained ring slot
+     * @return void* pointer to slot memory or nullptr if size exceeds the slot capacity or the device is stopped
+     */
+    void* allocate(size_t size, SlotType& slot) noexcept override;
+
+    /**
+     * @brief Give a slot obtained via allocate back to the ring.
+     *
+     * @param mem the pointer returned by allocate
+     * @param slot the ring slot index written by allocate
+     */
+    void deallocate(void* mem, SlotType slot) noexcept override;
+
+    void enqueueFrame(Frame&& frame) noexcept override;
+
+    /**
+     * @brief Reclaims slots released by the consumer until interrupt is called.
+     */
+    void exec() noexcept override;
+
+    /**
+     * @brief Make exec return and wake up every thread waiting inside allocate.
+     */
+    void interrupt() noexcept;
+
+    int getMemoryFileDescriptor() const noexcept;
+
+    int getReadyFileDescriptor() const noexcept;
+
+    int getReleaseFileDescriptor() const noexcept;
+
+    size_t getMappingSize() const noexcept;
+
+    /**
+     * @brief Send the memory, ready and release file descriptors (in this order) over a connected unix socket.
+     *
+     * @param unixSocket the connected AF_UNIX socket
+     * @return true IIF the file descriptors have been sent
+     */
+    bool sendFileDescriptors(int unixSocket) const noexcept;
+
+private:
+    std::optional<uint32_t> slotIndexOf(const void* mem) const noexcept;
+
+    void reclaimSlot(uint32_t index) noexcept;
+
+    bool reclaimSupersededSlot() noexcept;
+
+    void reclaimReleasedSlots() noexcept;
+
+    std::string m_Name;
+
+    int m_MemoryFd;
+
+    int m_ReadyFd;
+
+    int m_ReleaseFd;
+
+    void* m_Mapping;
+
+    size_t m_MappingSize;
+
+    size_t m_MaxFrameSize;
+
+    uint64_t m_NextSequence;
+
+    std::atomic_bool m_ShouldStop;
+
+    std::mutex m_SlotsMutex;
+
+    std::condition_variable m_SlotFreed;
+
+    std::mutex m_InFlightMutex;
+
+    std::vector<std::optional<Frame>> m_InFlight;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Stages/FrameStage.h"
+
+/**
+ * @brief Keeps a rectangle of the frame.
+ *
+ * Cropping only moves plane pointers: no pixel is copied. With chroma-subsampled formats the top-left
+ * corner should have even coordinates, otherwise chroma ends up shifted by half a sample.
+ */
+class CropFrameStage : public FrameStage {
+
+public:
+    /**
+     * @param rect the rectangle to keep (in pixels of the decoded frame), clipped to the frame size
+     */
+    CropFrameStage(const Frame::Rect& rect) noexcept;
+
+    ~CropFrameStage() override;
+
+    Access getAccess() const noexcept override;
+
+    bool accepts(int pixelFormat) const noexcept override;
+
+    int getPreferredInput() const noexcept override;
+
+    std::optional<Format> configure(const Format& input, size_t workers) noexcept override;
+
+    bool process(AVFrame* in, AVFrame* out, size_t worker) noexcept override;
+
+private:
+    const Frame::Rect m_Rect;
+
+    /**
+     * @brief The rectangle clipped to the size of frames being processed.
+     */
+    Frame::Rect m_Clipped;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Stages/FrameStage.h"
+
+/**
+ * @brief Removes combing from interlaced frames, in place.
+ *
+ * The fast path keeps the top field and rebuilds every line of the bottom field as the average of the
+ * lines above and below it (a spatial-only deinterlacer, that needs no previous frame and therefore
+ * lets frames go through it concurrently). Progressive frames are left untouched.
+ *
+ * Motion-adaptive deinterlacing (yadif, bwdif) is available through a FilterGraphFrameStage.
+ */
+class DeinterlaceFrameStage : public FrameStage {
+
+public:
+    DeinterlaceFrameStage() noexcept;
+
+    ~DeinterlaceFrameStage() override;
+
+    Access getAccess() const noexcept override;
+
+    bool accepts(int pixelFormat) const noexcept override;
+
+    int getPreferredInput() const noexcept override;
+
+    std::optional<Format> configure(const Format& input, size_t workers) noexcept override;
+
+    bool process(AVFrame* in, AVFrame* out, size_t worker) noexcept override;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Stages/FrameStage.h"
+
+struct AVFilterGraph;
+struct AVFilterContext;
+
+/**
+ * @brief Runs frames through a libavfilter graph, for everything the native stages do not cover
+ * (motion-adaptive deinterlacing, denoising, text rendering, LUTs, ...).
+ *
+ * The graph is described with the ffmpeg filter syntax, i.e. "yadif=mode=send_frame:deint=interlaced,hqdn3d".
+ * Filters can keep state between frames, so frames go through the graph one at a time; filters that need
+ * more than one input frame before producing an output (or produce more outputs than inputs) make the
+ * pipeline drop the frames that have no output. Timestamps go through the graph unchanged, in the time base
+ * of the stream, so filters changing the timing (fps, setpts) are not supported.
+ */
+class FilterGraphFrameStage : public FrameStage {
+
+public:
+    /**
+     * @param description the filter graph, with a single video input and a single video output
+     */
+    FilterGraphFrameStage(const std::string& description) noexcept;
+
+    ~FilterGraphFrameStage() override;
+
+    Access getAccess() const noexcept override;
+
+    bool isConcurrent() const noexcept override;
+
+    bool accepts(int pixelFormat) const noexcept override;
+
+    int getPreferredInput() const noexcept override;
+
+    std::optional<Format> configure(const Format& input, size_t workers) noexcept override;
+
+    bool process(AVFrame* in, AVFrame* out, size_t worker) noexcept override;
+
+private:
+    const std::string m_Description;
+
+    AVFilterGraph* m_Graph;
+
+    AVFilterContext* m_Source;
+
+    AVFilterContext* m_Sink;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Frame.h"
+
+struct AVFrame;
+
+/**
+ * @brief The interface of a processing step applied to decoded frames before they are converted for the output device.
+ *
+ * Stages are chained by a FramePipeline: every stage declares how it accesses pixel memory, which input
+ * formats it accepts and whether frames can go through it concurrently, so that the pipeline can insert
+ * format conversions, fuse adjacent stages and only allocate the intermediate buffers that are really needed.
+ *
+ * Frames are ffmpeg frames in their native pixel format: pixel formats are AVPixelFormat values.
+ */
+class FrameStage {
+
+public:
+    /**
+     * @brief The layout of frames entering or leaving a stage.
+     */
+    struct Format {
+        /**
+         * @brief An AVPixelFormat.
+         */
+        int pixelFormat;
+
+        uint32_t width;
+
+        uint32_t height;
+    };
+
+    /**
+     * @brief How a stage accesses pixel memory.
+     */
+    enum class Access {
+        /**
+         * @brief Only changes which pixels the frame refers to (i.e. crop): pixel memory is never touched.
+         */
+        View,
+
+        /**
+         * @brief Overwrites the pixels of its input: the output has the input format.
+         */
+        InPlace,
+
+        /**
+         * @brief Writes a new image in a (pooled) frame provided by the pipeline.
+         */
+        Output,
+
+        /**
+         * @brief Provides its own output frames (i.e. filters running inside libavfilter).
+         */
+        Allocates,
+    };
+
+    FrameStage() noexcept;
+
+    FrameStage(const FrameStage&) = delete;
+
+    FrameStage(FrameStage&&) = delete;
+
+    FrameStage& operator=(const FrameStage&) = delete;
+
+    FrameStage& operator=(FrameStage&&) = delete;
+
+    virtual ~FrameStage();
+
+    virtual Access getAccess() const noexcept = 0;
+
+    /**
+     * @brief Check if different frames can go through the stage at the same time, from different workers.
+     */
+    virtual bool isConcurrent() const noexcept;
+
+    /**
+     * @brief Check if the stage can process frames of the given pixel format.
+     */
+    virtual bool accepts(int pixelFormat) const noexcept = 0;
+
+    /**
+     * @brief Get the pixel format frames are converted to when the stage does not accept them.
+     */
+    virtual int getPreferredInput() const noexcept = 0;
+
+    /**
+     * @brief Prepare the stage for frames of the given format.
+     *
+     * Called while no frame is going through the stage, every time the format of decoded frames changes.
+     *
+     * @param input the format of frames that will be processed (accepted by the stage)
+     * @param workers the number of workers that will call process (each one with its own index)
+     * @return std::optional<Format> the format of processed frames or an empty value if the stage cannot process them
+     */
+    virtual std::optional<Format> configure(const Format& input, size_t workers) noexcept = 0;
+
+    /**
+     * @brief If the stage only scales and/or converts frames, get the format it produces.
+     *
+     * @return std::optional<Format> the produced format, where a zero size or AV_PIX_FMT_NONE means unchanged, or an empty value
+     */
+    virtual std::optional<Format> getResampleTarget() const noexcept;
+
+    /**
+     * @brief Build a single stage doing the work of this stage followed by the given one.
+     *
+     * @return std::unique_ptr<FrameStage> the fused stage or nullptr if the two stages cannot be fused
+     */
+    virtual std::unique_ptr<FrameStage> fuse(const FrameStage& next) const noexcept;
+
+    /**
+     * @brief Process a frame.
+     *
+     * @param in the input frame: for View and InPlace stages it is also the output and, for InPlace stages, it is writable
+     * @param out the output frame: allocated with the output format for Output stages, blank for Allocates stages, in for the others
+     * @param worker the index of the calling worker, less than the number given to configure
+     * @return false IIF the frame has to be dropped
+     */
+    virtual bool process(AVFrame* in, AVFrame* out, size_t worker) noexcept = 0;
+};
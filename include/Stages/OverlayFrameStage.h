@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Stages/FrameStage.h"
+
+/**
+ * @brief Alpha-blends a still RGBA image (a logo, a bug, a caption) over every frame, in place.
+ *
+ * The image is converted once, when the stage is configured, to the planes of the frame format together
+ * with its alpha at luma and chroma resolution: blending is then a per-plane integer lerp on 8-bit planar YUV,
+ * with no colour conversion per frame.
+ */
+class OverlayFrameStage : public FrameStage {
+
+public:
+    /**
+     * @param rgba the image pixels (RGBA32, not premultiplied), copied inside the stage
+     * @param width the number of horizontal pixels of the image
+     * @param height the number of vertical pixels of the image
+     * @param x the horizontal position of the image inside the frame (it may lay partially outside)
+     * @param y the vertical position of the image inside the frame (it may lay partially outside)
+     */
+    OverlayFrameStage(const uint8_t* rgba, uint32_t width, uint32_t height, int32_t x, int32_t y) noexcept;
+
+    ~OverlayFrameStage() override;
+
+    Access getAccess() const noexcept override;
+
+    bool accepts(int pixelFormat) const noexcept override;
+
+    int getPreferredInput() const noexcept override;
+
+    std::optional<Format> configure(const Format& input, size_t workers) noexcept override;
+
+    bool process(AVFrame* in, AVFrame* out, size_t worker) noexcept override;
+
+private:
+    struct Plane {
+        /**
+         * @brief Samples premultiplied by their alpha.
+         */
+        std::vector<uint8_t> samples;
+
+        std::vector<uint8_t> alpha;
+
+        uint32_t width;
+
+        uint32_t height;
+
+        /**
+         * @brief The position of the image inside the plane.
+         */
+        int32_t x;
+
+        int32_t y;
+    };
+
+    std::vector<uint8_t> m_Image;
+
+    const uint32_t m_Width;
+
+    const uint32_t m_Height;
+
+    const int32_t m_X;
+
+    const int32_t m_Y;
+
+    Plane m_Planes[3];
+};
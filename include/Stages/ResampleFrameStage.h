@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Stages/FrameStage.h"
+#include "Decoder.h"
+
+struct SwsContext;
+
+/**
+ * @brief Scales frames and/or converts their pixel format with swscale.
+ *
+ * Adjacent resample stages (including the conversions the pipeline inserts in front of stages that
+ * do not accept a format) are fused into a single one, so frames are scaled and converted in one pass.
+ * Every worker has its own scaling context.
+ */
+class ResampleFrameStage : public FrameStage {
+
+public:
+    /**
+     * @param width the width of produced frames (0 keeps the input width)
+     * @param height the height of produced frames (0 keeps the input height)
+     * @param pixelFormat the AVPixelFormat of produced frames (AV_PIX_FMT_NONE keeps the input format)
+     * @param filter the scaling filter
+     */
+    ResampleFrameStage(uint32_t width, uint32_t height, int pixelFormat, Decoder::ScalingFilter filter = Decoder::ScalingFilter::Bicubic) noexcept;
+
+    ~ResampleFrameStage() override;
+
+    Access getAccess() const noexcept override;
+
+    bool accepts(int pixelFormat) const noexcept override;
+
+    int getPreferredInput() const noexcept override;
+
+    std::optional<Format> configure(const Format& input, size_t workers) noexcept override;
+
+    std::optional<Format> getResampleTarget() const noexcept override;
+
+    std::unique_ptr<FrameStage> fuse(const FrameStage& next) const noexcept override;
+
+    bool process(AVFrame* in, AVFrame* out, size_t worker) noexcept override;
+
+private:
+    void releaseContexts() noexcept;
+
+    const Format m_Target;
+
+    const Decoder::ScalingFilter m_Filter;
+
+    Format m_Output;
+
+    std::vector<SwsContext*> m_Contexts;
+};
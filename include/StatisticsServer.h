@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Decoder.h"
+
+class FFMPEGDecoder;
+
+/**
+ * @brief Exports the statistics of decoders and output devices to a monitoring agent on a local stream socket.
+ *
+ * Every connection to the socket is answered with one JSON document holding a snapshot of every source, then
+ * closed (i.e. "socat - UNIX-CONNECT:/run/eod-stats.sock"). Snapshots are taken with getStatistics: the
+ * server never blocks decoding nor presentation, however often it is queried.
+ *
+ *     {"time":...,"decoders":{"<name>":{...}},"outputDevices":{"<name>":{...,"lateness":[...]}}}
+ *
+ * FFMPEG decoders also export their "placement", "power" and "rendition" statistics as objects inside their own;
+ * values that are not known (i.e. the node of a decoder that has not been placed) are null.
+ *
+ * Times are in microseconds; the lateness histogram has BufferedFrameOutputDevice::LatenessBuckets buckets.
+ */
+class StatisticsServer {
+
+public:
+    /**
+     * @param socketPath the path of the socket to bind
+     */
+    StatisticsServer(const std::string& socketPath) noexcept;
+
+    ~StatisticsServer();
+
+    StatisticsServer(const StatisticsServer&) = delete;
+
+    StatisticsServer(StatisticsServer&&) = delete;
+
+    StatisticsServer& operator=(const StatisticsServer&) = delete;
+
+    StatisticsServer& operator=(StatisticsServer&&) = delete;
+
+    bool isValid() const noexcept;
+
+    /**
+     * @brief Export the statistics of a decoder.
+     *
+     * This MUST be called before exec.
+     *
+     * @param name the name of the decoder in the exported document
+     * @param decoder the decoder: MUST outlive the server
+     */
+    void addDecoder(const std::string& name, const Decoder& decoder) noexcept;
+
+    /**
+     * @brief Export the statistics of an FFMPEG decoder, together with its placement, power and rendition statistics.
+     *
+     * This MUST be called before exec.
+     *
+     * @param name the name of the decoder in the exported document
+     * @param decoder the decoder: MUST outlive the server
+     */
+    void addDecoder(const std::string& name, FFMPEGDecoder& decoder) noexcept;
+
+    /**
+     * @brief Export the statistics of an output device.
+     *
+     * This MUST be called before exec.
+     *
+     * @param name the name of the output device in the exported document
+     * @param device the output device: MUST outlive the server
+     */
+    void addOutputDevice(const std::string& name, const BufferedFrameOutputDevice& device) noexcept;
+
+    /**
+     * @brief Get the document sent to clients.
+     */
+    std::string report() const noexcept;
+
+    /**
+     * @brief Answer connections until interrupt is called.
+     */
+    void exec() noexcept;
+
+    void interrupt() noexcept;
+
+private:
+    struct DecoderEntry {
+        std::string name;
+
+        const Decoder* decoder;
+
+        /**
+         * @brief The same decoder when its FFMPEG specific statistics are exported too (nullptr otherwise).
+         */
+        FFMPEGDecoder* ffmpegDecoder;
+    };
+
+    const std::string m_SocketPath;
+
+    int m_Socket;
+
+    /**
+     * @brief Signalled by interrupt, polled together with the socket: exec sleeps until a client connects.
+     */
+    int m_WakeFd;
+
+    std::atomic_bool m_ShouldStop;
+
+    std::vector<DecoderEntry> m_Decoders;
+
+    std::vector<std::pair<std::string, const BufferedFrameOutputDevice*>> m_OutputDevices;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "FrameCompositor.h"
+
+#include <deque>
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVPacket;
+struct SwsContext;
+
+/**
+ * @brief Decodes the bitmap subtitle stream (DVD, DVB, PGS) of a file and shows its cues in a compositor layer.
+ *
+ * Subtitle packets are handed over by the decoder demuxing the file and decoded on its thread; every cue becomes
+ * an OverlayImage scaled from the video size to the size of output frames. Before a frame is emitted the layer
+ * is updated with the cue to be shown at its timestamp, so that subtitles are composited in sync with the video.
+ *
+ * A subtitle decoder is owned by the decoding thread and MUST NOT be shared between threads.
+ */
+class SubtitleDecoder {
+
+public:
+    SubtitleDecoder() noexcept;
+
+    ~SubtitleDecoder();
+
+    SubtitleDecoder(const SubtitleDecoder&) = delete;
+
+    SubtitleDecoder(SubtitleDecoder&&) = delete;
+
+    SubtitleDecoder& operator=(const SubtitleDecoder&) = delete;
+
+    SubtitleDecoder& operator=(SubtitleDecoder&&) = delete;
+
+    /**
+     * @brief Open the best bitmap subtitle stream of a file.
+     *
+     * @param formatCtx the file, demuxed by the caller
+     * @param videoWidth the width of the video (cue positions are relative to it)
+     * @param videoHeight the height of the video
+     * @param outputWidth the width of emitted frames
+     * @param outputHeight the height of emitted frames
+     * @param compositor the compositor cues are shown with
+     * @return true IIF the file has a bitmap subtitle stream that can be decoded
+     */
+    bool open(AVFormatContext* formatCtx, uint32_t videoWidth, uint32_t videoHeight, uint32_t outputWidth, uint32_t outputHeight, std::shared_ptr<FrameCompositor> compositor) noexcept;
+
+    /**
+     * @brief Close the stream, removing the layer from the compositor.
+     */
+    void close() noexcept;
+
+    /**
+     * @brief Get the index of the subtitle stream (-1 if none is open).
+     */
+    int getStream() const noexcept;
+
+    /**
+     * @brief Decode a packet of the subtitle stream.
+     */
+    void decode(const AVPacket* packet) noexcept;
+
+    /**
+     * @brief Forget decoded cues (i.e. after a seek).
+     */
+    void flush() noexcept;
+
+    /**
+     * @brief Show the cue (if any) that has to be shown with the frame at the given timestamp.
+     *
+     * @param pts the timestamp of the next emitted frame (in microseconds)
+     */
+    void show(Frame::TimestampType pts) noexcept;
+
+private:
+    struct Cue {
+        Frame::TimestampType start;
+
+        /**
+         * @brief An empty value when the cue lasts until the next one (i.e. PGS).
+         */
+        std::optional<Frame::TimestampType> end;
+
+        /**
+         * @brief The image of the cue (nullptr for a cue clearing the screen).
+         */
+        std::shared_ptr<OverlayImage> image;
+
+        int32_t x;
+
+        int32_t y;
+    };
+
+    std::shared_ptr<OverlayImage> rasterize(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t scaledWidth, uint32_t scaledHeight) noexcept;
+
+    AVCodecContext* m_CodecCtx;
+
+    SwsContext* m_ScaleCtx;
+
+    int m_Stream;
+
+    uint32_t m_VideoWidth;
+
+    uint32_t m_VideoHeight;
+
+    uint32_t m_OutputWidth;
+
+    uint32_t m_OutputHeight;
+
+    std::shared_ptr<FrameCompositor> m_Compositor;
+
+    std::optional<FrameCompositor::LayerType> m_Layer;
+
+    /**
+     * @brief Decoded cues, sorted by start time.
+     */
+    std::deque<Cue> m_Cues;
+
+    const OverlayImage* m_Shown;
+};
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "BufferedFrameOutputDevice.h"
+#include "FrameAllocator.h"
+
+#include <deque>
+
+/**
+ * @brief An output device that forwards every frame to several other output devices.
+ *
+ * A frame is decoded once and its pixels are shared, read-only, among every sink: the tee keeps the
+ * enqueued frame in a reference-counted block and hands each sink a frame referencing the same memory
+ * (the tee acts as the allocator of those frames). When the last sink releases its frame the original
+ * one is destroyed, giving the memory back to the allocator of the decoder.
+ *
+ * Every sink has its own queue, drained by its own thread, and its own drop policy: a slow sink only
+ * loses its own frames and never stalls the decoder or the other sinks (unless its policy is Block).
+ *
+ * Sinks MUST be added before exec is called and MUST NOT modify the pixels of received frames;
+ * the tee MUST outlive every frame it has forwarded.
+ *
+ * The tee presents nothing itself: a shared presentation clock is given to each sink, with its own latency.
+ */
+class TeeFrameOutputDevice : public BufferedFrameOutputDevice, public FrameAllocator {
+
+public:
+    /**
+     * @brief What happens to a new frame when the queue of a sink is full.
+     */
+    enum class DropPolicy {
+        Block,          // wait for the sink to accept a frame (stalls the decoder)
+        DropOldest,     // discard the oldest queued frame (live preview)
+        DropNewest,     // discard the new frame
+    };
+
+    typedef uint32_t SinkIndexType;
+
+    /**
+     * @brief Construct a new Tee Frame Output Device object
+     *
+     * @param frameCount the number of frames queued for each sink when not specified otherwise
+     */
+    TeeFrameOutputDevice(BufferedFrameOutputDevice::FrameCountType frameCount) noexcept;
+
+    ~TeeFrameOutputDevice() override;
+
+    /**
+     * @brief Add a device that will receive every enqueued frame.
+     *
+     * @param sink the output device (its exec method still has to be run by the caller)
+     * @param policy what to do when the sink falls behind
+     * @param queueSize the maximum number of frames waiting for the sink (0 = the frame count of the tee)
+     * @return SinkIndexType the index of the new sink
+     */
+    SinkIndexType addSink(BufferedFrameOutputDevice* sink, DropPolicy policy, size_t queueSize = 0) noexcept;
+
+    /**
+     * @brief Get the number of frames a sink has lost because of its drop policy.
+     */
+    uint64_t getDroppedFrames(SinkIndexType sink) const noexcept;
+
+    /**
+     * @brief The largest preferred width among sinks (0 if any of them accepts any width).
+     */
+    uint32_t getPreferredWidth() const noexcept override;
+
+    /**
+     * @brief The largest preferred height among sinks (0 if any of them accepts any height).
+     */
+    uint32_t getPreferredHeight() const noexcept override;
+
+    /**
+     * @brief The preferred pixel format of the first sink.
+     */
+    Frame::PixelFormat getPreferredPixelFormat() const noexcept override;
+
+    void setClockRate(double rate) noexcept override;
+
+    void enqueueFrame(Frame&& frame) noexcept override;
+
+    /**
+     * @brief Forward frames to sinks until interrupt is called.
+     */
+    void exec() noexcept override;
+
+    void interrupt() noexcept;
+
+    /**
+     * @brief Shared frames cannot be allocated: frames to be forwarded are obtained via enqueueFrame.
+     */
+    void* allocate(size_t size, SlotType& slot) noexcept override;
+
+    /**
+     * @brief Release the reference a sink frame holds on a shared block.
+     */
+    void deallocate(void* mem, SlotType slot) noexcept override;
+
+private:
+    struct Sink {
+        BufferedFrameOutputDevice* device;
+
+        DropPolicy policy;
+
+        size_t queueSize;
+
+        std::mutex mutex;
+
+        std::condition_variable changed;
+
+        std::deque<Frame> queue;
+
+        std::atomic<uint64_t> dropped;
+    };
+
+    struct SharedBlock {
+        std::optional<Frame> frame;
+
+        std::atomic<uint32_t> references;
+    };
+
+    void forward(Sink& sink) noexcept;
+
+    std::vector<std::unique_ptr<Sink>> m_Sinks;
+
+    std::atomic_bool m_ShouldStop;
+
+    std::mutex m_BlocksMutex;
+
+    std::vector<std::unique_ptr<SharedBlock>> m_Blocks;
+
+    std::vector<SlotType> m_FreeBlocks;
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "Frame.h"
+
+#include <array>
+
+struct AVFrame;
+
+/**
+ * @brief Converts decoded HDR frames (PQ or HLG, 10 to 16 bits per component) to 8-bit SDR BT.709 pixels.
+ *
+ * Tone mapping is fused with the format conversion: every output pixel reads its source YUV samples once,
+ * converts them to R'G'B', linearizes them with a lookup table, converts primaries from BT.2020 to BT.709
+ * and maps the result with a second lookup table embedding both the tone curve and the display encoding.
+ * Arithmetic runs on vectors of four pixels (SSE2 or NEON when available); lookups are scalar.
+ *
+ * Output frames are either RGBA32 or NV12 and can have a different size than the source: source pixels are
+ * then point sampled, so the decoder should pick a lowres factor bringing frames close to the output size.
+ *
+ * Lookup tables are rebuilt only when the transfer, the content peak or the curve change, so a mapper
+ * is owned by the decoding thread and MUST NOT be shared between threads.
+ */
+class ToneMapper {
+
+public:
+    enum class Curve {
+        /**
+         * @brief Extended Reinhard: cheap, preserves midtones but compresses highlights heavily.
+         */
+        Reinhard,
+
+        /**
+         * @brief Hable (Uncharted 2) filmic curve: a toe and a long shoulder.
+         */
+        Hable,
+
+        /**
+         * @brief The ITU-R BT.2390 EETF: linear up to a knee, then a hermite spline in the PQ domain.
+         */
+        BT2390,
+    };
+
+    /**
+     * @brief The luminance (in nits) mapped to SDR white, the HDR reference white of ITU-R BT.2408.
+     */
+    static constexpr float ReferenceWhite = 203.0f;
+
+    /**
+     * @brief The content peak luminance (in nits) assumed when the stream does not carry one.
+     */
+    static constexpr float DefaultPeak = 1000.0f;
+
+    /**
+     * @brief Check if the given frame has to be (and can be) tone mapped to the given pixel format.
+     *
+     * @param frame the decoded frame
+     * @param pf the output pixel format
+     * @return true IIF the frame uses the PQ or HLG transfer, its layout is supported and pf is RGBA32 or NV12
+     */
+    static bool isApplicable(const AVFrame* frame, Frame::PixelFormat pf) noexcept;
+
+    ToneMapper(Curve curve = Curve::BT2390) noexcept;
+
+    ~ToneMapper() = default;
+
+    ToneMapper(const ToneMapper&) = delete;
+
+    ToneMapper(ToneMapper&&) = delete;
+
+    ToneMapper& operator=(const ToneMapper&) = delete;
+
+    ToneMapper& operator=(ToneMapper&&) = delete;
+
+    void setCurve(Curve curve) noexcept;
+
+    Curve getCurve() const noexcept;
+
+    /**
+     * @brief Tone map a frame writing pixels in dst.
+     *
+     * @param frame the decoded frame, isApplicable MUST return true for it
+     * @param pf the output pixel format (RGBA32 or NV12)
+     * @param width the number of horizontal output pixels
+     * @param height the number of vertical output pixels
+     * @param dst the output frame memory
+     * @return false IIF the frame could not be tone mapped
+     */
+    bool map(const AVFrame* frame, Frame::PixelFormat pf, uint32_t width, uint32_t height, void* dst) noexcept;
+
+private:
+    /**
+     * @brief The number of entries of the table linearizing normalized R'G'B' values.
+     */
+    static constexpr size_t LinearizeTableSize = 4096;
+
+    /**
+     * @brief The number of entries of the tone table, indexed by the square root of linear light
+     * to spend more entries on the shadows.
+     */
+    static constexpr size_t ToneTableSize = 4096;
+
+    enum class Transfer {
+        PQ,
+        HLG,
+    };
+
+    /**
+     * @brief Rebuild the lookup tables if the frame needs different ones than the current ones.
+     */
+    void prepare(const AVFrame* frame) noexcept;
+
+    /**
+     * @brief Tone map a row of output pixels into three planes of 8-bit R'G'B' values.
+     */
+    void mapRow(const AVFrame* frame, uint32_t srcRow, uint32_t width, uint8_t* r, uint8_t* g, uint8_t* b) noexcept;
+
+    Curve m_Curve;
+
+    bool m_Prepared;
+
+    Transfer m_Transfer;
+
+    float m_Peak;
+
+    Curve m_PreparedCurve;
+
+    /**
+     * @brief Normalized R'G'B' to linear light normalized to the content peak.
+     */
+    std::array<float, LinearizeTableSize> m_Linearize;
+
+    /**
+     * @brief Square root of linear BT.709 light normalized to the content peak to 8-bit display-encoded values.
+     */
+    std::array<uint8_t, ToneTableSize> m_Tone;
+
+    /**
+     * @brief YUV to R'G'B' and gamut conversion coefficients for the frame being mapped.
+     */
+    float m_YOffset, m_YScale, m_COffset, m_CScale;
+
+    float m_CrR, m_CbG, m_CrG, m_CbB;
+
+    std::array<float, 9> m_Gamut;
+
+    /**
+     * @brief The source column (of each component) sampled by every output column.
+     */
+    std::vector<uint32_t> m_Columns[3];
+
+    /**
+     * @brief Two rows of tone mapped R'G'B' planes.
+     */
+    std::vector<uint8_t> m_Rows;
+};
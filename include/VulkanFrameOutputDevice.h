@@ -0,0 +1,280 @@
+#pragma once
+
+#include "BufferedFrameOutputDevice.h"
+#include "FrameAllocator.h"
+
+#include <chrono>
+#include <deque>
+
+/**
+ * @brief An offscreen Vulkan output device: frames are uploaded to device images and NV12 frames are
+ * converted to RGBA by a sampler YCbCr conversion, so the decoder does not convert pixels on the CPU.
+ *
+ * To avoid every copy the device is also the frame allocator of the decoder: frame memory is a slice of a
+ * persistently mapped, host-visible staging buffer, so decoded pixels are written directly in upload memory
+ * and a transfer command copies them to an image:
+ *
+ *     VulkanFrameOutputDevice sink(8, maxFrameBytes);
+ *     FFMPEGDecoder decoder(&sink, &sink);
+ *
+ * Frames allocated elsewhere are still accepted, but are copied inside a free slice first.
+ *
+ * Every submission signals the next value of a timeline semaphore: at most InFlightSubmissions submissions
+ * are pending, and the staging slice of a frame goes back to the decoder when the submission reading it completes.
+ *
+ * No surface is needed, so the device runs on any Vulkan 1.2 implementation, including the lavapipe software
+ * rasterizer (select it with VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json on hosts without a GPU).
+ * Frames are presented when their timestamp comes, according to the clock rate or to the shared presentation clock
+ * given to the device; a device late on the shared clock skips frames to catch up.
+ */
+class VulkanFrameOutputDevice : public BufferedFrameOutputDevice, public FrameAllocator {
+
+public:
+    /**
+     * @brief The number of submissions (and presented images) that can be in flight at the same time.
+     */
+    static constexpr uint32_t InFlightSubmissions = 2;
+
+    /**
+     * @brief Construct a new Vulkan Frame Output Device object
+     *
+     * @param frameCount the number of staging slices
+     * @param maxFrameSize the maximum size (in bytes) of pixel data for a single frame
+     */
+    VulkanFrameOutputDevice(
+        BufferedFrameOutputDevice::FrameCountType frameCount,
+        size_t maxFrameSize
+    ) noexcept;
+
+    ~VulkanFrameOutputDevice() override;
+
+    /**
+     * @brief Check if the Vulkan device and the staging memory have been successfully created.
+     *
+     * @return true IIF the device can be used
+     */
+    bool isValid() const noexcept;
+
+    /**
+     * @brief Check if NV12 frames are converted to RGBA on the device (the preferred pixel format is then NV12).
+     */
+    bool isConvertingYCbCr() const noexcept;
+
+    /**
+     * @brief Obtain a free staging slice.
+     *
+     * This is a blocking call that waits for an upload to complete if every slice is in use.
+     *
+     * @param size the number of bytes required
+     * @param slot written with the index of the obtained slice
+     * @return void* pointer to the mapped slice or nullptr if size exceeds the slice capacity or the device is stopped
+     */
+    void* allocate(size_t size, SlotType& slot) noexcept override;
+
+    void deallocate(void* mem, SlotType slot) noexcept override;
+
+    void enqueueFrame(Frame&& frame) noexcept override;
+
+    /**
+     * @brief Upload and present frames until interrupt is called.
+     */
+    void exec() noexcept override;
+
+    void interrupt() noexcept;
+
+    bool isFollowingPresentationClocks() const noexcept override;
+
+    uint64_t getPresentedFrames() const noexcept;
+
+    /**
+     * @brief Read back the pixels of the most recently presented image.
+     *
+     * @param pixels receives the pixels, tightly packed (RGBA with 8 bits per component, 16 for RGBA64 frames)
+     * @param width receives the image width
+     * @param height receives the image height
+     * @return true IIF an image has been presented and read
+     */
+    bool readPresentedImage(std::vector<uint8_t>& pixels, uint32_t& width, uint32_t& height) noexcept;
+
+protected:
+    /**
+     * @brief Show an image: called by exec for every uploaded frame.
+     *
+     * The image is in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL layout and holds the frame once the timeline semaphore
+     * reaches the given value; it stays untouched until InFlightSubmissions more frames have been presented.
+     */
+    virtual void present(VkImage image, uint32_t width, uint32_t height, uint64_t timelineValue) noexcept;
+
+private:
+    /**
+     * @brief The device images of a submission.
+     */
+    struct Target {
+        /**
+         * @brief The image frames are copied to: RGBA, or NV12 sampled through the YCbCr conversion.
+         */
+        VkImage upload;
+
+        VkDeviceMemory uploadMemory;
+
+        VkImageView uploadView;
+
+        /**
+         * @brief The RGBA image NV12 frames are converted to (VK_NULL_HANDLE for RGBA frames).
+         */
+        VkImage output;
+
+        VkDeviceMemory outputMemory;
+
+        VkImageView outputView;
+
+        VkFramebuffer framebuffer;
+
+        VkDescriptorSet descriptorSet;
+    };
+
+    bool createDevice() noexcept;
+
+    bool createStaging(size_t frameCount, size_t maxFrameSize) noexcept;
+
+    bool createConversion() noexcept;
+
+    bool createTargets(Frame::PixelFormat pf, uint32_t width, uint32_t height) noexcept;
+
+    void destroyTargets() noexcept;
+
+    std::optional<uint32_t> findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const noexcept;
+
+    bool createImage(VkFormat format, uint32_t width, uint32_t height, VkImageUsageFlags usage, VkImage& image, VkDeviceMemory& memory) noexcept;
+
+    std::optional<uint32_t> slotIndexOf(const void* mem) const noexcept;
+
+    /**
+     * @brief Wait for the timeline semaphore to reach the given value.
+     */
+    bool waitTimeline(uint64_t value) noexcept;
+
+    /**
+     * @brief Hold the frame until its presentation time.
+     *
+     * @return false IIF the device has been interrupted
+     */
+    bool waitPresentationTime(const Frame& frame) noexcept;
+
+    /**
+     * @brief Check if the next queued frame is already due on the shared presentation clock.
+     */
+    bool isNextFrameDue() noexcept;
+
+    /**
+     * @brief Record and submit the upload (and conversion) of a frame.
+     */
+    bool upload(Frame&& frame) noexcept;
+
+    VkInstance m_Instance;
+
+    VkPhysicalDevice m_PhysicalDevice;
+
+    VkDevice m_Device;
+
+    uint32_t m_QueueFamily;
+
+    VkQueue m_Queue;
+
+    bool m_Valid;
+
+    /**
+     * @brief Staging memory: a single buffer divided in equal slices, mapped for the whole device lifetime.
+     */
+    VkBuffer m_StagingBuffer;
+
+    VkDeviceMemory m_StagingMemory;
+
+    uint8_t* m_Staging;
+
+    size_t m_SliceSize;
+
+    size_t m_SliceCount;
+
+    std::mutex m_SlicesMutex;
+
+    std::condition_variable m_SliceFreed;
+
+    std::vector<uint32_t> m_FreeSlices;
+
+    /**
+     * @brief Queue submissions and readbacks are serialized.
+     */
+    std::mutex m_SubmitMutex;
+
+    VkSemaphore m_Timeline;
+
+    uint64_t m_TimelineValue;
+
+    VkCommandPool m_CommandPool;
+
+    VkCommandBuffer m_CommandBuffers[InFlightSubmissions];
+
+    VkCommandBuffer m_ReadbackCommandBuffer;
+
+    /**
+     * @brief Frames whose staging slice is read by a pending submission, with the timeline value signaled when it completes.
+     */
+    std::optional<Frame> m_Submitted[InFlightSubmissions];
+
+    uint64_t m_SubmittedValues[InFlightSubmissions];
+
+    uint64_t m_Submissions;
+
+    /**
+     * @brief YCbCr to RGBA conversion resources (VK_NULL_HANDLE when the device cannot sample NV12 images).
+     */
+    VkSamplerYcbcrConversion m_Conversion;
+
+    VkSampler m_Sampler;
+
+    VkDescriptorSetLayout m_SetLayout;
+
+    VkDescriptorPool m_DescriptorPool;
+
+    VkPipelineLayout m_PipelineLayout;
+
+    VkRenderPass m_RenderPass;
+
+    VkPipeline m_Pipeline;
+
+    Target m_Targets[InFlightSubmissions];
+
+    std::optional<Frame::PixelFormat> m_TargetFormat;
+
+    uint32_t m_TargetWidth;
+
+    uint32_t m_TargetHeight;
+
+    /**
+     * @brief The target of the most recently presented frame.
+     */
+    std::optional<uint32_t> m_Presented;
+
+    std::mutex m_QueueMutex;
+
+    std::condition_variable m_QueueCV;
+
+    std::deque<Frame> m_Frames;
+
+    std::atomic_bool m_ShouldStop;
+
+    std::atomic<uint64_t> m_PresentedFrames;
+
+    /**
+     * @brief The frame timestamp and the time the presentation clock is anchored to.
+     */
+    std::optional<std::pair<Frame::TimestampType, std::chrono::steady_clock::time_point>> m_Anchor;
+
+    double m_AnchorRate;
+
+    /**
+     * @brief How late (microseconds) the last frame waited for has been released to be presented.
+     */
+    Frame::TimestampType m_Lateness;
+};
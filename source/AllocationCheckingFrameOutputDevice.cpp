@@ -0,0 +1,76 @@
+#include "AllocationCheckingFrameOutputDevice.h"
+#include "AllocationTracker.h"
+
+AllocationCheckingFrameOutputDevice::AllocationCheckingFrameOutputDevice(BufferedFrameOutputDevice* sink, uint64_t warmupFrames, uint64_t checkedFrames) noexcept
+ : BufferedFrameOutputDevice(sink->getFramesCount()),
+ m_Sink(sink),
+ m_WarmupFrames(warmupFrames),
+ m_CheckedFrames(checkedFrames),
+ m_EnqueuedFrames(0),
+ m_IsCompleted(false) {
+    m_Sink->setClockRate(getClockRate());
+}
+
+AllocationCheckingFrameOutputDevice::~AllocationCheckingFrameOutputDevice() {
+    AllocationTracker::disarm();
+}
+
+uint32_t AllocationCheckingFrameOutputDevice::getPreferredWidth() const noexcept {
+    return m_Sink->getPreferredWidth();
+}
+
+uint32_t AllocationCheckingFrameOutputDevice::getPreferredHeight() const noexcept {
+    return m_Sink->getPreferredHeight();
+}
+
+Frame::PixelFormat AllocationCheckingFrameOutputDevice::getPreferredPixelFormat() const noexcept {
+    return m_Sink->getPreferredPixelFormat();
+}
+
+void AllocationCheckingFrameOutputDevice::setClockRate(double rate) noexcept {
+    BufferedFrameOutputDevice::setClockRate(rate);
+
+    m_Sink->setClockRate(rate);
+}
+
+void AllocationCheckingFrameOutputDevice::enqueueFrame(Frame&& frame) noexcept {
+    // frames are enqueued by a single decoder thread
+    if (m_EnqueuedFrames == 0) {
+        AllocationTracker::watchThread();
+    }
+
+    m_Sink->enqueueFrame(std::move(frame));
+
+    const uint64_t enqueued = ++m_EnqueuedFrames;
+
+    if (enqueued == m_WarmupFrames) {
+        AllocationTracker::arm();
+    } else if (enqueued == m_WarmupFrames + m_CheckedFrames) {
+        // what happens after the check (i.e. tearing down) is allowed to allocate
+        AllocationTracker::disarm();
+
+        std::lock_guard<std::mutex> guard(m_CompletionMutex);
+        m_IsCompleted = true;
+        m_Completed.notify_all();
+    }
+}
+
+void AllocationCheckingFrameOutputDevice::exec() noexcept {
+    AllocationTracker::watchThread();
+
+    m_Sink->exec();
+}
+
+bool AllocationCheckingFrameOutputDevice::waitForCompletion(std::chrono::milliseconds timeout) noexcept {
+    std::unique_lock<std::mutex> lock(m_CompletionMutex);
+    return m_Completed.wait_for(lock, timeout, [this]() { return m_IsCompleted; });
+}
+
+uint64_t AllocationCheckingFrameOutputDevice::getEnqueuedFrames() const noexcept {
+    return m_EnqueuedFrames;
+}
+
+bool AllocationCheckingFrameOutputDevice::isCompleted() const noexcept {
+    std::lock_guard<std::mutex> guard(m_CompletionMutex);
+    return m_IsCompleted;
+}
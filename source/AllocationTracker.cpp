@@ -0,0 +1,389 @@
+#include "AllocationTracker.h"
+
+#if defined(EOD_ALLOCATION_TRACKING)
+
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+// backtrace, backtrace_symbols_fd
+#include <execinfo.h>
+#include <unistd.h>
+
+// the allocator of the C library, that interposed functions forward to
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+
+// the bounds of the code of the executable, defined by the linker
+extern "C" char __executable_start;
+extern "C" char etext;
+
+namespace {
+
+    struct Site {
+        std::atomic<uint64_t> hash;
+
+        std::atomic<uint64_t> count;
+
+        std::atomic<uint64_t> bytes;
+
+        void* frames[AllocationTracker::SiteDepth];
+
+        uint32_t depth;
+
+        bool library;
+    };
+
+    std::atomic<uint64_t> s_Allocations(0);
+
+    std::atomic<uint64_t> s_Deallocations(0);
+
+    std::atomic<uint64_t> s_Bytes(0);
+
+    std::atomic<uint64_t> s_Violations(0);
+
+    std::atomic<uint64_t> s_LibraryAllocations(0);
+
+    std::atomic_bool s_Armed(false);
+
+    Site s_Sites[AllocationTracker::MaxSites];
+
+    // the executable has static TLS: accessing these never allocates
+    thread_local AllocationTracker::Counters t_Counters = { 0, 0, 0 };
+
+    thread_local bool t_Watched = false;
+
+    // set while the tracker itself runs, so that allocations it causes (i.e. the first backtrace) are not tracked
+    thread_local bool t_Inside = false;
+
+    bool isInExecutable(const void* address) noexcept {
+        const auto ptr = reinterpret_cast<const char*>(address);
+        return (ptr >= &__executable_start) && (ptr < &etext);
+    }
+
+    // not inlined, so that the number of frames to skip is known
+    __attribute__((noinline)) void recordSite(size_t size, const void* caller) noexcept {
+        void* frames[AllocationTracker::SiteDepth + 3];
+
+        // the first frames are the tracker and the interposed function
+        const int captured = backtrace(frames, static_cast<int>(AllocationTracker::SiteDepth + 3));
+        const int skip = std::min(captured, 3);
+        const int depth = captured - skip;
+
+        uint64_t hash = 1469598103934665603ull;
+        for (int i = skip; i < captured; ++i) {
+            hash = (hash ^ reinterpret_cast<uintptr_t>(frames[i])) * 1099511628211ull;
+        }
+
+        // 0 marks a free entry
+        hash |= 1;
+
+        // open addressing: a site is claimed once and never released
+        for (size_t probe = 0; probe < AllocationTracker::MaxSites; ++probe) {
+            Site& site = s_Sites[(hash + probe) % AllocationTracker::MaxSites];
+
+            uint64_t expected = 0;
+            if (site.hash.compare_exchange_strong(expected, hash, std::memory_order_acq_rel)) {
+                std::memcpy(site.frames, frames + skip, sizeof(void*) * static_cast<size_t>(depth));
+                site.depth = static_cast<uint32_t>(depth);
+                site.library = !isInExecutable(caller);
+                expected = hash;
+            }
+
+            if (expected == hash) {
+                site.count.fetch_add(1, std::memory_order_release);
+                site.bytes.fetch_add(size, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+    __attribute__((noinline)) void onAllocation(size_t size, const void* caller) noexcept {
+        if (t_Inside) {
+            return;
+        }
+
+        t_Inside = true;
+
+        ++t_Counters.allocations;
+        t_Counters.bytes += size;
+        s_Allocations.fetch_add(1, std::memory_order_relaxed);
+        s_Bytes.fetch_add(size, std::memory_order_relaxed);
+
+        if ((t_Watched) && (s_Armed.load(std::memory_order_relaxed))) {
+            if (isInExecutable(caller)) {
+                s_Violations.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                s_LibraryAllocations.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            recordSite(size, caller);
+        }
+
+        t_Inside = false;
+    }
+
+    void onDeallocation(void* ptr) noexcept {
+        if ((ptr == nullptr) || (t_Inside)) {
+            return;
+        }
+
+        ++t_Counters.deallocations;
+        s_Deallocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // backtrace loads the unwinder (allocating) the first time it is called: that happens here, at startup
+    struct BacktracePrimer {
+        BacktracePrimer() noexcept {
+            void* frames[1];
+            t_Inside = true;
+            backtrace(frames, 1);
+            t_Inside = false;
+        }
+    } s_BacktracePrimer;
+
+    void* allocateOrAbort(void* ptr) noexcept {
+        // exceptions are disabled: a failed operator new cannot throw std::bad_alloc
+        if (ptr == nullptr) {
+            std::abort();
+        }
+
+        return ptr;
+    }
+
+}
+
+extern "C" {
+
+void* malloc(size_t size) {
+    void* ptr = __libc_malloc(size);
+    onAllocation(size, __builtin_return_address(0));
+    return ptr;
+}
+
+void* calloc(size_t count, size_t size) {
+    void* ptr = __libc_calloc(count, size);
+    onAllocation(count * size, __builtin_return_address(0));
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t size) {
+    void* result = __libc_realloc(ptr, size);
+    onAllocation(size, __builtin_return_address(0));
+    return result;
+}
+
+void free(void* ptr) {
+    onDeallocation(ptr);
+    __libc_free(ptr);
+}
+
+int posix_memalign(void** memptr, size_t alignment, size_t size) {
+    void* ptr = __libc_memalign(alignment, size);
+    onAllocation(size, __builtin_return_address(0));
+
+    if (ptr == nullptr) {
+        return ENOMEM;
+    }
+
+    *memptr = ptr;
+    return 0;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    void* ptr = __libc_memalign(alignment, size);
+    onAllocation(size, __builtin_return_address(0));
+    return ptr;
+}
+
+void* memalign(size_t alignment, size_t size) {
+    void* ptr = __libc_memalign(alignment, size);
+    onAllocation(size, __builtin_return_address(0));
+    return ptr;
+}
+
+}
+
+void* operator new(size_t size) {
+    void* ptr = __libc_malloc(size);
+    onAllocation(size, __builtin_return_address(0));
+    return allocateOrAbort(ptr);
+}
+
+void* operator new[](size_t size) {
+    void* ptr = __libc_malloc(size);
+    onAllocation(size, __builtin_return_address(0));
+    return allocateOrAbort(ptr);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    void* ptr = __libc_malloc(size);
+    onAllocation(size, __builtin_return_address(0));
+    return ptr;
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    void* ptr = __libc_malloc(size);
+    onAllocation(size, __builtin_return_address(0));
+    return ptr;
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    void* ptr = __libc_memalign(static_cast<size_t>(alignment), size);
+    onAllocation(size, __builtin_return_address(0));
+    return allocateOrAbort(ptr);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    void* ptr = __libc_memalign(static_cast<size_t>(alignment), size);
+    onAllocation(size, __builtin_return_address(0));
+    return allocateOrAbort(ptr);
+}
+
+void operator delete(void* ptr) noexcept {
+    onDeallocation(ptr);
+    __libc_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    onDeallocation(ptr);
+    __libc_free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    onDeallocation(ptr);
+    __libc_free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    onDeallocation(ptr);
+    __libc_free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    onDeallocation(ptr);
+    __libc_free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    onDeallocation(ptr);
+    __libc_free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+    onDeallocation(ptr);
+    __libc_free(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+    onDeallocation(ptr);
+    __libc_free(ptr);
+}
+
+bool AllocationTracker::isEnabled() noexcept {
+    return true;
+}
+
+AllocationTracker::Counters AllocationTracker::getThreadCounters() noexcept {
+    return t_Counters;
+}
+
+AllocationTracker::Counters AllocationTracker::getTotalCounters() noexcept {
+    return Counters{
+        s_Allocations.load(std::memory_order_relaxed),
+        s_Deallocations.load(std::memory_order_relaxed),
+        s_Bytes.load(std::memory_order_relaxed)
+    };
+}
+
+void AllocationTracker::watchThread() noexcept {
+    t_Watched = true;
+}
+
+void AllocationTracker::arm() noexcept {
+    s_Armed = true;
+}
+
+void AllocationTracker::disarm() noexcept {
+    s_Armed = false;
+}
+
+uint64_t AllocationTracker::getViolations() noexcept {
+    return s_Violations;
+}
+
+uint64_t AllocationTracker::getLibraryAllocations() noexcept {
+    return s_LibraryAllocations;
+}
+
+void AllocationTracker::report(int fd) noexcept {
+    t_Inside = true;
+
+    char line[128];
+    for (const auto& site : s_Sites) {
+        const uint64_t count = site.count.load(std::memory_order_acquire);
+        if (count == 0) {
+            continue;
+        }
+
+        // snprintf into a stack buffer: the report is written without allocating
+        const int length = std::snprintf(line, sizeof(line), "%s allocation site: %llu allocations, %llu bytes\n",
+            site.library ? "Library" : "Player",
+            static_cast<unsigned long long>(count),
+            static_cast<unsigned long long>(site.bytes.load(std::memory_order_relaxed)));
+
+        if (length > 0) {
+            ssize_t written = write(fd, line, static_cast<size_t>(length));
+            (void)written;
+        }
+
+        backtrace_symbols_fd(const_cast<void* const*>(site.frames), static_cast<int>(site.depth), fd);
+    }
+
+    t_Inside = false;
+}
+
+#else
+
+bool AllocationTracker::isEnabled() noexcept {
+    return false;
+}
+
+AllocationTracker::Counters AllocationTracker::getThreadCounters() noexcept {
+    return Counters{ 0, 0, 0 };
+}
+
+AllocationTracker::Counters AllocationTracker::getTotalCounters() noexcept {
+    return Counters{ 0, 0, 0 };
+}
+
+void AllocationTracker::watchThread() noexcept {
+
+}
+
+void AllocationTracker::arm() noexcept {
+
+}
+
+void AllocationTracker::disarm() noexcept {
+
+}
+
+uint64_t AllocationTracker::getViolations() noexcept {
+    return 0;
+}
+
+uint64_t AllocationTracker::getLibraryAllocations() noexcept {
+    return 0;
+}
+
+void AllocationTracker::report(int fd) noexcept {
+
+}
+
+#endif
@@ -0,0 +1,115 @@
+#include "AlphaBlend.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#if defined(__SSE2__)
+/**
+ * @brief Blend 16 samples: s + d * (255 - a) / 255, saturated.
+ */
+static inline __m128i blend16(__m128i d, __m128i s, __m128i a) noexcept {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i inverse = _mm_xor_si128(a, _mm_set1_epi8(-1));
+
+    __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(inverse, zero));
+    __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(inverse, zero));
+
+    lo = _mm_add_epi16(lo, bias);
+    hi = _mm_add_epi16(hi, bias);
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+    return _mm_adds_epu8(s, _mm_packus_epi16(lo, hi));
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+/**
+ * @brief Blend 16 samples: s + d * (255 - a) / 255, saturated.
+ */
+static inline uint8x16_t blend16(uint8x16_t d, uint8x16_t s, uint8x16_t a) noexcept {
+    const uint8x16_t inverse = vmvnq_u8(a);
+
+    const uint16x8_t lo = vmull_u8(vget_low_u8(d), vget_low_u8(inverse));
+    const uint16x8_t hi = vmull_high_u8(d, inverse);
+
+    // (x + ((x + 128) >> 8) + 128) >> 8 is the rounded division by 255
+    const uint8x8_t l = vraddhn_u16(lo, vrshrq_n_u16(lo, 8));
+    const uint8x8_t h = vraddhn_u16(hi, vrshrq_n_u16(hi, 8));
+
+    return vqaddq_u8(s, vcombine_u8(l, h));
+}
+#endif
+
+static inline uint8_t blend1(uint8_t d, uint8_t s, uint8_t a) noexcept {
+    return static_cast<uint8_t>(std::min<uint32_t>(s + AlphaBlend::div255(static_cast<uint32_t>(d) * (255 - a)), 255));
+}
+
+void AlphaBlend::blendSamples(uint8_t* dst, const uint8_t* src, const uint8_t* alpha, size_t count) noexcept {
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 16 <= count; i += 16) {
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(alpha + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), blend16(d, s, a));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 16 <= count; i += 16) {
+        vst1q_u8(dst + i, blend16(vld1q_u8(dst + i), vld1q_u8(src + i), vld1q_u8(alpha + i)));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        dst[i] = blend1(dst[i], src[i], alpha[i]);
+    }
+}
+
+void AlphaBlend::blendRGBA32(uint8_t* dst, const uint8_t* src, size_t pixels) noexcept {
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 4 <= pixels; i += 4) {
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + (i * 4)));
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i * 4)));
+
+        // the alpha of each pixel (its last byte) in every byte of the pixel
+        __m128i a = _mm_srli_epi32(s, 24);
+        a = _mm_or_si128(a, _mm_slli_epi32(a, 8));
+        a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (i * 4)), blend16(d, s, a));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 16 <= pixels; i += 16) {
+        uint8x16x4_t d = vld4q_u8(dst + (i * 4));
+        const uint8x16x4_t s = vld4q_u8(src + (i * 4));
+
+        for (int c = 0; c < 4; ++c) {
+            d.val[c] = blend16(d.val[c], s.val[c], s.val[3]);
+        }
+
+        vst4q_u8(dst + (i * 4), d);
+    }
+#endif
+
+    for (; i < pixels; ++i) {
+        const uint8_t a = src[(i * 4) + 3];
+        for (size_t c = 0; c < 4; ++c) {
+            dst[(i * 4) + c] = blend1(dst[(i * 4) + c], src[(i * 4) + c], a);
+        }
+    }
+}
+
+void AlphaBlend::blendRGBA64(uint16_t* dst, const uint16_t* src, size_t pixels) noexcept {
+    for (size_t i = 0; i < pixels; ++i) {
+        const uint64_t inverse = 65535 - src[(i * 4) + 3];
+        for (size_t c = 0; c < 4; ++c) {
+            const uint64_t blended = src[(i * 4) + c] + (((dst[(i * 4) + c] * inverse) + 32767) / 65535);
+            dst[(i * 4) + c] = static_cast<uint16_t>(std::min<uint64_t>(blended, 65535));
+        }
+    }
+}
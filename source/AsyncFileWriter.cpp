@@ -0,0 +1,155 @@
+#include "AsyncFileWriter.h"
+
+#include "FFMPEGCommon.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <aio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+struct AsyncFileWriter::Write {
+    struct aiocb cb;
+
+    /**
+     * @brief The content of the file: either an encoded packet or the pixels of a frame.
+     */
+    AVPacket* packet;
+
+    std::optional<Frame> frame;
+
+    const uint8_t* data;
+
+    size_t size;
+
+    /**
+     * @brief The number of bytes already written (a write can complete partially).
+     */
+    size_t written;
+
+    std::string path;
+};
+
+AsyncFileWriter::AsyncFileWriter(size_t maxInFlight) noexcept
+ : m_MaxInFlight(std::max<size_t>(maxInFlight, 1)),
+ m_WrittenBytes(0),
+ m_FailedWrites(0) {
+
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+    flush();
+}
+
+bool AsyncFileWriter::write(const std::string& path, AVPacket* packet) noexcept {
+    std::unique_ptr<Write> write(new Write());
+    write->packet = packet;
+    write->data = packet->data;
+    write->size = static_cast<size_t>(packet->size);
+
+    return submit(path, std::move(write));
+}
+
+bool AsyncFileWriter::write(const std::string& path, Frame&& frame) noexcept {
+    std::unique_ptr<Write> write(new Write());
+    write->packet = nullptr;
+    write->data = static_cast<const uint8_t*>(frame.getRawBuffer());
+    write->size = frame.getSizeInBytes();
+    write->frame.emplace(std::move(frame));
+
+    return submit(path, std::move(write));
+}
+
+bool AsyncFileWriter::submit(const std::string& path, std::unique_ptr<Write>&& write) noexcept {
+    while (m_InFlight.size() >= m_MaxInFlight) {
+        complete();
+    }
+
+    write->path = path;
+    write->written = 0;
+
+    std::memset(&write->cb, 0, sizeof(write->cb));
+    write->cb.aio_fildes = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    write->cb.aio_buf = const_cast<uint8_t*>(write->data);
+    write->cb.aio_nbytes = write->size;
+    write->cb.aio_offset = 0;
+    write->cb.aio_sigevent.sigev_notify = SIGEV_NONE;
+
+    if (write->cb.aio_fildes < 0) {
+        std::cerr << "Could not create " << path << ": " << std::strerror(errno) << std::endl;
+        av_packet_free(&write->packet);
+        return false;
+    }
+
+    if (aio_write(&write->cb) != 0) {
+        std::cerr << "Could not queue the write of " << path << ": " << std::strerror(errno) << std::endl;
+        close(write->cb.aio_fildes);
+        av_packet_free(&write->packet);
+        return false;
+    }
+
+    m_InFlight.push_back(std::move(write));
+    return true;
+}
+
+void AsyncFileWriter::complete() noexcept {
+    if (m_InFlight.empty()) {
+        return;
+    }
+
+    std::unique_ptr<Write> write = std::move(m_InFlight.front());
+    m_InFlight.pop_front();
+
+    bool failed = false;
+    while (true) {
+        const struct aiocb* pending[1] = { &write->cb };
+        while (aio_error(&write->cb) == EINPROGRESS) {
+            aio_suspend(pending, 1, nullptr);
+        }
+
+        const ssize_t written = aio_return(&write->cb);
+        if (written <= 0) {
+            failed = (write->size != write->written);
+            break;
+        }
+
+        write->written += static_cast<size_t>(written);
+        if (write->written >= write->size) {
+            break;
+        }
+
+        // the rest of a partially completed write is queued again
+        write->cb.aio_buf = const_cast<uint8_t*>(write->data + write->written);
+        write->cb.aio_nbytes = write->size - write->written;
+        write->cb.aio_offset = static_cast<off_t>(write->written);
+        if (aio_write(&write->cb) != 0) {
+            failed = true;
+            break;
+        }
+    }
+
+    close(write->cb.aio_fildes);
+    av_packet_free(&write->packet);
+
+    if (failed) {
+        std::cerr << "Could not write " << write->path << std::endl;
+        ++m_FailedWrites;
+    } else {
+        m_WrittenBytes += write->written;
+    }
+}
+
+void AsyncFileWriter::flush() noexcept {
+    while (!m_InFlight.empty()) {
+        complete();
+    }
+}
+
+uint64_t AsyncFileWriter::getWrittenBytes() const noexcept {
+    return m_WrittenBytes;
+}
+
+uint64_t AsyncFileWriter::getFailedWrites() const noexcept {
+    return m_FailedWrites;
+}
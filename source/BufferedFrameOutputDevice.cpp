@@ -1,9 +1,22 @@
 #include "BufferedFrameOutputDevice.h"
+#include "PresentationClock.h"
 
 BufferedFrameOutputDevice::BufferedFrameOutputDevice(
     FrameCountType frames
 ) noexcept
-    : m_FramesCount(frames) {
+    : m_FramesCount(frames),
+    m_PreferredPixelFormat(Frame::PixelFormat::RGBA64),
+    m_PreferredWidth(0),
+    m_PreferredHeight(0),
+    m_ClockRate(1.0),
+    m_PresentationLatency(0),
+    m_ArrivedGeneration(0),
+    m_ReportingQueuedFrames(false),
+    m_QueuedFrames(0),
+    m_QueueWatermark(std::numeric_limits<FrameCountType>::max()),
+    m_HasQueueWaiter(false),
+    m_QueueWakeGeneration(0),
+    m_Counters{} {
 
 }
 
@@ -13,4 +26,200 @@ BufferedFrameOutputDevice::~BufferedFrameOutputDevice() {
 
 BufferedFrameOutputDevice::FrameCountType BufferedFrameOutputDevice::getFramesCount() const noexcept {
     return m_FramesCount;
-}
\ No newline at end of file
+}
+
+uint32_t BufferedFrameOutputDevice::getPreferredWidth() const noexcept {
+    return m_PreferredWidth;
+}
+
+uint32_t BufferedFrameOutputDevice::getPreferredHeight() const noexcept {
+    return m_PreferredHeight;
+}
+
+Frame::PixelFormat BufferedFrameOutputDevice::getPreferredPixelFormat() const noexcept {
+    return m_PreferredPixelFormat;
+}
+
+void BufferedFrameOutputDevice::setPreferredFrameFormat(Frame::PixelFormat pf, uint32_t width, uint32_t height) noexcept {
+    m_PreferredPixelFormat = pf;
+    m_PreferredWidth = width;
+    m_PreferredHeight = height;
+}
+
+void BufferedFrameOutputDevice::setClockRate(double rate) noexcept {
+    m_ClockRate = rate;
+}
+
+double BufferedFrameOutputDevice::getClockRate() const noexcept {
+    return m_ClockRate;
+}
+
+bool BufferedFrameOutputDevice::setPresentationClock(std::shared_ptr<PresentationClock> clock, Frame::TimestampType latency) noexcept {
+    if ((clock) && (!isFollowingPresentationClocks())) {
+        std::cerr << "This output device cannot follow a shared presentation clock" << std::endl;
+        return false;
+    }
+
+    m_PresentationClock = std::move(clock);
+    m_PresentationLatency = latency;
+    return true;
+}
+
+bool BufferedFrameOutputDevice::isFollowingPresentationClocks() const noexcept {
+    return false;
+}
+
+const std::shared_ptr<PresentationClock>& BufferedFrameOutputDevice::getPresentationClock() const noexcept {
+    return m_PresentationClock;
+}
+
+Frame::TimestampType BufferedFrameOutputDevice::getPresentationLatency() const noexcept {
+    return m_PresentationLatency;
+}
+
+bool BufferedFrameOutputDevice::waitSharedPresentationTime(
+    const Frame& frame,
+    std::mutex& mutex,
+    std::condition_variable& wakeup,
+    const std::atomic_bool& shouldStop,
+    Frame::TimestampType& lateness
+) noexcept {
+    const auto& clock = getPresentationClock();
+    const Frame::TimestampType latency = getPresentationLatency();
+
+    lateness = 0;
+
+    while (!shouldStop) {
+        const uint32_t epoch = clock->getEpoch();
+        const auto due = clock->getPresentationTime(frame.getPresentationTimestamp());
+
+        if (!due.has_value()) {
+            // the device holds a frame: it is ready for the clock to start
+            const auto barrier = clock->getBarrier();
+            if (barrier.generation != m_ArrivedGeneration) {
+                m_ArrivedGeneration = barrier.generation;
+                clock->arrive(barrier.generation);
+            }
+
+            clock->waitForChange(epoch, SharedClockPollInterval);
+            continue;
+        }
+
+        const Frame::TimestampType deadline = due.value() - latency;
+        const Frame::TimestampType now = PresentationClock::now();
+        if (deadline <= now) {
+            lateness = now - deadline;
+            return true;
+        }
+
+        // the timeline can change while waiting (i.e. the wall is paused): it is looked at again every poll interval
+        std::unique_lock<std::mutex> lk(mutex);
+        wakeup.wait_for(lk, std::chrono::microseconds(std::min(deadline - now, SharedClockPollInterval)), [&shouldStop]() {
+            return shouldStop.load();
+        });
+    }
+
+    return false;
+}
+
+bool BufferedFrameOutputDevice::isDueOnPresentationClock(const Frame& frame) const noexcept {
+    const auto due = getPresentationClock()->getPresentationTime(frame.getPresentationTimestamp());
+    return (due.has_value()) && ((due.value() - getPresentationLatency()) <= PresentationClock::now());
+}
+
+bool BufferedFrameOutputDevice::isReportingQueuedFrames() const noexcept {
+    return m_ReportingQueuedFrames;
+}
+
+BufferedFrameOutputDevice::FrameCountType BufferedFrameOutputDevice::getQueuedFrames() const noexcept {
+    return m_QueuedFrames;
+}
+
+void BufferedFrameOutputDevice::setQueuedFrames(FrameCountType queued) noexcept {
+    m_ReportingQueuedFrames = true;
+    m_QueuedFrames = queued;
+
+    // nobody waiting costs a load: only the crossing of the watermark a waiter sleeps for wakes it up
+    if ((!m_HasQueueWaiter) || (queued > m_QueueWatermark)) {
+        return;
+    }
+
+    // taking the mutex makes sure the waiter is either sleeping or yet to look at the number of queued frames
+    {
+        std::lock_guard<std::mutex> guard(m_QueueWaitMutex);
+    }
+
+    m_QueueDrained.notify_all();
+}
+
+void BufferedFrameOutputDevice::waitForQueuedFrames(FrameCountType watermark, uint64_t generation) noexcept {
+    // a device that does not report its queue would never wake the waiter up
+    if (!m_ReportingQueuedFrames) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lk(m_QueueWaitMutex);
+    m_QueueWatermark = watermark;
+
+    // the flag is published before the number of queued frames is looked at (both sequentially consistent):
+    // either the device sees the waiter or the waiter sees the number of frames the device has stored
+    m_HasQueueWaiter = true;
+
+    m_QueueDrained.wait(lk, [this, watermark, generation]() {
+        return (m_QueuedFrames <= watermark) || (m_QueueWakeGeneration != generation);
+    });
+
+    m_HasQueueWaiter = false;
+}
+
+uint64_t BufferedFrameOutputDevice::getQueueWakeGeneration() const noexcept {
+    return m_QueueWakeGeneration;
+}
+
+void BufferedFrameOutputDevice::wakeQueueWaiters() noexcept {
+    {
+        std::lock_guard<std::mutex> guard(m_QueueWaitMutex);
+        ++m_QueueWakeGeneration;
+    }
+
+    m_QueueDrained.notify_all();
+}
+
+BufferedFrameOutputDevice::Statistics BufferedFrameOutputDevice::getStatistics() const noexcept {
+    return m_Statistics.load();
+}
+
+void BufferedFrameOutputDevice::reportPresentedFrame(const Frame& frame, Frame::TimestampType lateness) noexcept {
+    lateness = std::max<Frame::TimestampType>(lateness, 0);
+
+    size_t bucket = 0;
+    while ((bucket + 1 < LatenessBuckets) && (lateness >= (static_cast<Frame::TimestampType>(1000) << bucket))) {
+        ++bucket;
+    }
+
+    ++m_Counters.presentedFrames;
+    ++m_Counters.lateness[bucket];
+    m_Counters.maxLateness = std::max(m_Counters.maxLateness, lateness);
+    m_Counters.pts = frame.getPresentationTimestamp();
+
+    // frames of a stream have the same size: the queued ones are as large as the presented one
+    m_Counters.queuedFrames = m_QueuedFrames.load(std::memory_order_relaxed);
+    m_Counters.residentBytes = (static_cast<uint64_t>(m_Counters.queuedFrames) + 1) *
+        Frame::getFrameSizeInBytes(frame.getPixelFormat(), frame.getWidth(), frame.getHeight());
+
+    m_Counters.time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    m_Statistics.store(m_Counters);
+}
+
+void BufferedFrameOutputDevice::reportDroppedFrames(uint64_t frames) noexcept {
+    if (frames == 0) {
+        return;
+    }
+
+    m_Counters.droppedFrames += frames;
+    m_Counters.queuedFrames = m_QueuedFrames.load(std::memory_order_relaxed);
+    m_Counters.time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    m_Statistics.store(m_Counters);
+}
@@ -0,0 +1,318 @@
+#include "DecodedFrameCache.h"
+
+// ffmpeg
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+}
+
+DecodedFrameCache::DecodedFrameCache(size_t budget, StorageMode mode) noexcept
+ : m_Budget(budget),
+ m_Mode(mode),
+ m_ResidentBytes(0),
+ m_First(0),
+ m_Count(0),
+ m_Cursor(0) {
+
+}
+
+DecodedFrameCache::~DecodedFrameCache() {
+    clear();
+
+    for (auto& frame : m_SpareFrames) {
+        av_frame_free(&frame);
+    }
+}
+
+void DecodedFrameCache::configure(size_t budget, StorageMode mode) noexcept {
+    clear();
+
+    m_Budget = budget;
+    m_Mode = mode;
+}
+
+size_t DecodedFrameCache::getBudget() const noexcept {
+    return m_Budget;
+}
+
+DecodedFrameCache::StorageMode DecodedFrameCache::getStorageMode() const noexcept {
+    return m_Mode;
+}
+
+size_t DecodedFrameCache::getCount() const noexcept {
+    return m_Count;
+}
+
+size_t DecodedFrameCache::getResidentBytes() const noexcept {
+    return m_ResidentBytes;
+}
+
+size_t DecodedFrameCache::nativeSizeOf(const AVFrame* frame) noexcept {
+    size_t bytes = 0;
+    for (size_t i = 0; i < AV_NUM_DATA_POINTERS; ++i) {
+        if (frame->buf[i] != NULL) {
+            bytes += frame->buf[i]->size;
+        }
+    }
+
+    if (bytes == 0) {
+        bytes = static_cast<size_t>(std::max(av_image_get_buffer_size(static_cast<AVPixelFormat>(frame->format), frame->width, frame->height, 1), 0));
+    }
+
+    return bytes;
+}
+
+void DecodedFrameCache::release(Entry& entry) noexcept {
+    if (entry.native != nullptr) {
+        av_frame_unref(entry.native);
+        m_SpareFrames.push_back(entry.native);
+        entry.native = nullptr;
+    }
+
+    if (entry.pixels.capacity() != 0) {
+        m_SpareBuffers.push_back(std::move(entry.pixels));
+    }
+
+    m_ResidentBytes -= entry.bytes;
+}
+
+DecodedFrameCache::Entry& DecodedFrameCache::entryAt(size_t index) noexcept {
+    return m_Entries[(m_First + index) % m_Entries.size()];
+}
+
+const DecodedFrameCache::Entry& DecodedFrameCache::entryAt(size_t index) const noexcept {
+    return m_Entries[(m_First + index) % m_Entries.size()];
+}
+
+void DecodedFrameCache::grow() noexcept {
+    std::vector<Entry> entries(std::max<size_t>(m_Entries.size() * 2, 16));
+    for (size_t i = 0; i < m_Count; ++i) {
+        entries[i] = std::move(entryAt(i));
+    }
+
+    m_Entries.swap(entries);
+    m_First = 0;
+}
+
+void DecodedFrameCache::clear() noexcept {
+    for (size_t i = 0; i < m_Count; ++i) {
+        release(entryAt(i));
+    }
+
+    // the ring is kept: the next window is built without allocating
+    m_First = 0;
+    m_Count = 0;
+    m_Cursor = 0;
+}
+
+bool DecodedFrameCache::makeRoom(size_t bytes, bool evict) noexcept {
+    if (bytes > m_Budget) {
+        return false;
+    }
+
+    while (m_ResidentBytes + bytes > m_Budget) {
+        // only frames farther from the playhead than the new one can be dropped
+        if ((!evict) || (m_Count == 0)) {
+            return false;
+        }
+
+        release(entryAt(0));
+        m_First = (m_First + 1) % m_Entries.size();
+        --m_Count;
+
+        if (m_Cursor > 0) {
+            --m_Cursor;
+        }
+    }
+
+    return true;
+}
+
+DecodedFrameCache::Entry* DecodedFrameCache::prepareEntry(size_t bytes, bool atBack) noexcept {
+    if (!makeRoom(bytes, atBack)) {
+        return nullptr;
+    }
+
+    // the ring grows until the window covers the budget, then entries are reused
+    if (m_Count == m_Entries.size()) {
+        grow();
+    }
+
+    Entry* entry = nullptr;
+    if (atBack) {
+        entry = &entryAt(m_Count);
+        ++m_Count;
+        m_Cursor = m_Count - 1;
+    } else {
+        m_First = (m_First + m_Entries.size() - 1) % m_Entries.size();
+        ++m_Count;
+        entry = &entryAt(0);
+
+        // the cursor keeps pointing to the same frame
+        if (m_Count > 1) {
+            ++m_Cursor;
+        }
+    }
+
+    // released entries hold no buffer: resetting them does not free anything
+    *entry = Entry{};
+    entry->bytes = bytes;
+    m_ResidentBytes += bytes;
+
+    return entry;
+}
+
+bool DecodedFrameCache::pushBack(const AVFrame* frame, Frame::TimestampType pts) noexcept {
+    // a disabled cache does not even take a reference
+    if (m_Budget == 0) {
+        return false;
+    }
+
+    AVFrame* ref = NULL;
+    if (m_SpareFrames.empty()) {
+        ref = av_frame_alloc();
+    } else {
+        ref = m_SpareFrames.back();
+        m_SpareFrames.pop_back();
+    }
+
+    if ((ref == NULL) || (av_frame_ref(ref, frame) < 0)) {
+        if (ref != NULL) {
+            m_SpareFrames.push_back(ref);
+        }
+
+        return false;
+    }
+
+    Entry* entry = prepareEntry(nativeSizeOf(ref), true);
+    if (entry == nullptr) {
+        av_frame_unref(ref);
+        m_SpareFrames.push_back(ref);
+        return false;
+    }
+
+    entry->native = ref;
+    entry->width = static_cast<uint32_t>(frame->width);
+    entry->height = static_cast<uint32_t>(frame->height);
+    entry->pts = pts;
+    return true;
+}
+
+bool DecodedFrameCache::pushFront(const AVFrame* frame, Frame::TimestampType pts) noexcept {
+    if (m_ResidentBytes + nativeSizeOf(frame) > m_Budget) {
+        return false;
+    }
+
+    // build the entry at the back, where it can be added without reordering, then move it at the front
+    const size_t cursor = m_Cursor;
+    if (!pushBack(frame, pts)) {
+        return false;
+    }
+
+    Entry entry = std::move(entryAt(m_Count - 1));
+    --m_Count;
+
+    m_First = (m_First + m_Entries.size() - 1) % m_Entries.size();
+    ++m_Count;
+    entryAt(0) = std::move(entry);
+
+    m_Cursor = (m_Count > 1) ? cursor + 1 : 0;
+    return true;
+}
+
+void* DecodedFrameCache::pushBackConverted(Frame::PixelFormat pf, uint32_t width, uint32_t height, Frame::TimestampType pts) noexcept {
+    const size_t bytes = Frame::getFrameSizeInBytes(pf, width, height);
+
+    Entry* entry = prepareEntry(bytes, true);
+    if (entry == nullptr) {
+        return nullptr;
+    }
+
+    if (!m_SpareBuffers.empty()) {
+        entry->pixels = std::move(m_SpareBuffers.back());
+        m_SpareBuffers.pop_back();
+    }
+
+    entry->pixels.resize(bytes);
+    entry->pixelFormat = pf;
+    entry->width = width;
+    entry->height = height;
+    entry->pts = pts;
+    return entry->pixels.data();
+}
+
+void* DecodedFrameCache::pushFrontConverted(Frame::PixelFormat pf, uint32_t width, uint32_t height, Frame::TimestampType pts) noexcept {
+    const size_t bytes = Frame::getFrameSizeInBytes(pf, width, height);
+
+    Entry* entry = prepareEntry(bytes, false);
+    if (entry == nullptr) {
+        return nullptr;
+    }
+
+    if (!m_SpareBuffers.empty()) {
+        entry->pixels = std::move(m_SpareBuffers.back());
+        m_SpareBuffers.pop_back();
+    }
+
+    entry->pixels.resize(bytes);
+    entry->pixelFormat = pf;
+    entry->width = width;
+    entry->height = height;
+    entry->pts = pts;
+    return entry->pixels.data();
+}
+
+const DecodedFrameCache::Entry* DecodedFrameCache::current() const noexcept {
+    return (m_Count == 0) ? nullptr : &entryAt(m_Cursor);
+}
+
+Frame::TimestampType DecodedFrameCache::oldestTimestamp() const noexcept {
+    return (m_Count == 0) ? 0 : entryAt(0).pts;
+}
+
+Frame::TimestampType DecodedFrameCache::newestTimestamp() const noexcept {
+    return (m_Count == 0) ? 0 : entryAt(m_Count - 1).pts;
+}
+
+const DecodedFrameCache::Entry* DecodedFrameCache::moveTo(Frame::TimestampType pts) noexcept {
+    if ((m_Count == 0) || (pts < entryAt(0).pts) || (pts > entryAt(m_Count - 1).pts)) {
+        return nullptr;
+    }
+
+    // entries are sorted by timestamp: find the first one after pts, the cursor goes on the one before
+    size_t low = 0;
+    size_t high = m_Count;
+    while (low < high) {
+        const size_t middle = (low + high) / 2;
+        if (pts < entryAt(middle).pts) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+
+    m_Cursor = low - 1;
+    return current();
+}
+
+const DecodedFrameCache::Entry* DecodedFrameCache::stepBackward() noexcept {
+    if ((m_Count == 0) || (m_Cursor == 0)) {
+        return nullptr;
+    }
+
+    --m_Cursor;
+    return current();
+}
+
+const DecodedFrameCache::Entry* DecodedFrameCache::stepForward() noexcept {
+    if (isAtNewest()) {
+        return nullptr;
+    }
+
+    ++m_Cursor;
+    return current();
+}
+
+bool DecodedFrameCache::isAtNewest() const noexcept {
+    return (m_Count == 0) || (m_Cursor == m_Count - 1);
+}
@@ -1,13 +1,14 @@
 #include "Decoder.h"
+#include "FrameCompositor.h"
 
 Decoder::Decoder(
     BufferedFrameOutputDevice* outputDev,
-    const Frame::AllocatorFunctionType& allocate,
-    const Frame::DeallocatorFunctionType& deallocate
+    FrameAllocator* allocator
 ) noexcept 
  : m_OutputDevice(outputDev),
- m_AllocatorFn(allocate),
- m_DeallocatorFn(deallocate) {
+ m_Allocator(allocator),
+ m_PullTarget(nullptr),
+ m_ScalingFilter(ScalingFilter::Bilinear) {
 
 }
 
@@ -15,17 +16,190 @@ Decoder::~Decoder() {
     
 }
 
+void Decoder::pause() noexcept {
+
+}
+
+void Decoder::resume() noexcept {
+
+}
+
+void Decoder::setRate(double rate) noexcept {
+
+}
+
+void Decoder::stepForward() noexcept {
+
+}
+
+void Decoder::stepBackward() noexcept {
+
+}
+
+void Decoder::seek(Frame::TimestampType pts) noexcept {
+
+}
+
+void Decoder::setLoop(Frame::TimestampType start, Frame::TimestampType end) noexcept {
+
+}
+
+void Decoder::clearLoop() noexcept {
+
+}
+
+void Decoder::setScalingFilter(ScalingFilter filter) noexcept {
+    m_ScalingFilter = filter;
+}
+
+Decoder::ScalingFilter Decoder::getScalingFilter() const noexcept {
+    return m_ScalingFilter;
+}
+
+void Decoder::setCompositor(std::shared_ptr<FrameCompositor> compositor) noexcept {
+    m_Compositor = std::move(compositor);
+}
+
+const std::shared_ptr<FrameCompositor>& Decoder::getCompositor() const noexcept {
+    return m_Compositor;
+}
+
+Decoder::Statistics Decoder::getStatistics() const noexcept {
+    return m_Statistics.load();
+}
+
+void Decoder::publishStatistics(const Statistics& statistics) noexcept {
+    m_Statistics.store(statistics);
+}
+
+std::optional<Frame> Decoder::nextFrame() noexcept {
+    return std::nullopt;
+}
+
+Decoder::FrameRange Decoder::frames() noexcept {
+    return FrameRange(this);
+}
+
+Decoder::NextFrameAwaitable Decoder::next() noexcept {
+    return NextFrameAwaitable(this);
+}
+
+BufferedFrameOutputDevice* Decoder::getOutputDevice() const noexcept {
+    return m_OutputDevice;
+}
+
+void Decoder::setPullTarget(std::optional<Frame>* target) noexcept {
+    m_PullTarget = target;
+}
+
 void Decoder::emitFrame(
     Frame::PixelFormat pf,
     uint32_t width,
     uint32_t height,
-    const Frame::FrameFillerFunctionType& frameFillerFn
+    Frame::TimestampType pts,
+    Frame::FrameFillerFunctionType frameFillerFn,
+    Frame::SourceIndexType sourceIndex,
+    std::optional<Frame::Rect> dirtyRect
+) noexcept {
+    emitFrameTo(m_OutputDevice, pf, width, height, pts, frameFillerFn, sourceIndex, dirtyRect);
+}
+
+void Decoder::emitFrameTo(
+    BufferedFrameOutputDevice* device,
+    Frame::PixelFormat pf,
+    uint32_t width,
+    uint32_t height,
+    Frame::TimestampType pts,
+    Frame::FrameFillerFunctionType frameFillerFn,
+    Frame::SourceIndexType sourceIndex,
+    std::optional<Frame::Rect> dirtyRect
 ) noexcept {
     // create the frame and fill it with actual data
     Frame frame(pf, width, height);
-    frame.storeFrameData(m_AllocatorFn, m_DeallocatorFn, frameFillerFn);
+    frame.setPresentationTimestamp(pts);
+    frame.setSourceIndex(sourceIndex);
+    if (dirtyRect.has_value()) {
+        frame.setDirtyRect(dirtyRect.value());
+    }
+    frame.storeFrameData(m_Allocator, frameFillerFn);
+
+    // the allocator could not provide memory for this frame: drop it
+    if (!frame.isHoldingData()) {
+        return;
+    }
+
+    // overlays are blended while the pixels just written are still in cache
+    if (m_Compositor) {
+        m_Compositor->composite(frame);
+    }
+
+    // frames pulled by the caller are handed back instead of being enqueued
+    if (m_PullTarget != nullptr) {
+        m_PullTarget->emplace(std::move(frame));
+        return;
+    }
 
     // move the frame (fast operation) to the output device as here it's not needed anymore
-    m_OutputDevice->enqueueFrame(std::move(frame));
+    device->enqueueFrame(std::move(frame));
+}
+
+
+
+Decoder::FrameIterator::FrameIterator() noexcept
+ : m_Decoder(nullptr) {
+
+}
+
+Decoder::FrameIterator::FrameIterator(Decoder* decoder) noexcept
+ : m_Decoder(decoder),
+ m_Current(decoder->nextFrame()) {
+
+}
+
+Frame& Decoder::FrameIterator::operator*() noexcept {
+    return m_Current.value();
+}
+
+Frame* Decoder::FrameIterator::operator->() noexcept {
+    return &m_Current.value();
+}
+
+Decoder::FrameIterator& Decoder::FrameIterator::operator++() noexcept {
+    m_Current = m_Decoder->nextFrame();
+    return *this;
+}
+
+bool Decoder::FrameIterator::operator==(const FrameIterator& other) const noexcept {
+    // only the end of the range can be compared: an iterator is at the end when it has no frame
+    return m_Current.has_value() == other.m_Current.has_value();
+}
+
+bool Decoder::FrameIterator::operator!=(const FrameIterator& other) const noexcept {
+    return !(*this == other);
+}
+
+Decoder::FrameRange::FrameRange(Decoder* decoder) noexcept
+ : m_Decoder(decoder) {
+
+}
+
+Decoder::FrameIterator Decoder::FrameRange::begin() noexcept {
+    return FrameIterator(m_Decoder);
+}
+
+Decoder::FrameIterator Decoder::FrameRange::end() noexcept {
+    return FrameIterator();
+}
+
+Decoder::NextFrameAwaitable::NextFrameAwaitable(Decoder* decoder) noexcept
+ : m_Decoder(decoder) {
+
+}
+
+bool Decoder::NextFrameAwaitable::await_ready() const noexcept {
+    return true;
 }
 
+std::optional<Frame> Decoder::NextFrameAwaitable::await_resume() noexcept {
+    return m_Decoder->nextFrame();
+}
\ No newline at end of file
@@ -3,6 +3,10 @@
 // for memcpy
 #include <cstring>
 
+// getrusage, PR_SET_TIMERSLACK
+#include <sys/resource.h>
+#include <sys/prctl.h>
+
 #include <chrono>
 using namespace std::chrono;
 
@@ -32,390 +36,1641 @@ extern "C" {
 #include <libavcodec/avcodec.h>
 }
 
-void writeDataToFrameMemory(void* dst, AVFrame *avFrame, int width, int height, int frameIndex) noexcept {
-    std::memcpy(dst, avFrame->data[0], Frame::getPixelSizeInBytes(Frame::PixelFormat::RGBA64) * width * height);
-}
+#include "FFMPEGCommon.h"
 
 FFMPEGDecoder::FFMPEGDecoder(
     BufferedFrameOutputDevice* const outputDev,
-    const Frame::AllocatorFunctionType& allocate,
-    const Frame::DeallocatorFunctionType& deallocate
+    FrameAllocator* allocator
 ) noexcept
     : Decoder(
         outputDev,
-        allocate,
-        deallocate
+        allocator
     ),
-    m_ShouldClose(false) {
-        
+    m_ShouldClose(false),
+    m_Running(false),
+    m_Paused(false),
+    m_PendingSteps(0),
+    m_Rate(1.0),
+    m_FrameCacheBudget(DefaultFrameCacheBudget),
+    m_FrameCacheMode(DecodedFrameCache::StorageMode::Native),
+    m_IntraOnlyWorkers(std::max<size_t>(std::thread::hardware_concurrency(), 1)),
+    m_StaticFrameSkipping(false),
+    m_FrameStride(1),
+    m_Subtitles(false),
+    m_ToneMapping(ToneMapper::Curve::BT2390),
+    m_FrameStageWorkers(1),
+    m_PlacedNode(-1),
+    m_LastCpu(-1),
+    m_OffNodeFrames(0),
+    m_ActiveRendition(0),
+    m_DecodeTime(0),
+    m_ConvertTime(0),
+    m_Load(0.0),
+    m_StarvedFrames(0),
+    m_LastSwitchTime(0),
+    m_RenditionSwitches(0),
+    m_RenditionSwitching(false),
+    m_HighWatermark(0),
+    m_LowWatermark(0),
+    m_Bursts(0),
+    m_PlayedTime(0),
+    m_PreviousEmission(std::numeric_limits<Frame::TimestampType>::min()),
+    m_Counters{},
+    m_DecodedEmissions(0),
+    m_AverageDecodeTime(0.0),
+    m_AverageConvertTime(0.0),
+    m_PowerStartTime(0),
+    m_PowerStartCpuTime(0),
+    m_PowerStartWakeups(0),
+    m_FormatCtx(NULL),
+    m_CodecCtx(NULL),
+    m_Frame(NULL),
+    m_Packet(NULL),
+    m_SwsCtx(NULL),
+    m_VideoStream(-1),
+    m_KeyframesOnly(false),
+    m_FrameDuration(0),
+    m_IntraPoolWorkers(1),
+    m_IntraDraining(false),
+    m_PipelineDraining(false),
+    m_DetectChanges(false),
+    m_EmitStride(1),
+    m_StrideFrames(0),
+    m_ShowSubtitles(false),
+    m_MapTones(false),
+    m_OutputFormat(Frame::PixelFormat::RGBA64),
+    m_OutputWidth(0),
+    m_OutputHeight(0),
+    m_FrameCache(DefaultFrameCacheBudget),
+    m_LastEmitted(std::numeric_limits<Frame::TimestampType>::min()),
+    m_PullExhausted(false),
+    m_LivePlayout(0, 0, 0),
+    m_LiveArrival(0),
+    m_LiveStatistics() {
+
     }
 
 FFMPEGDecoder::~FFMPEGDecoder() {
+    stop();
+    join();
+    closeFile();
+}
 
+void FFMPEGDecoder::join() noexcept {
+    if ((m_FFMPEGThread) && (m_FFMPEGThread->joinable())) {
+        m_FFMPEGThread->join();
+    }
+
+    m_FFMPEGThread.reset();
 }
 
 void FFMPEGDecoder::loadFile(const Decoder::FileNameType& filename) noexcept {
+    stop();
+    join();
+
+    // a file opened to pull frames is closed here
+    closeFile();
+    m_PullExhausted = false;
+
     m_LoadedFilename = filename;
+    m_LiveOptions.reset();
+    m_RenditionFiles.clear();
+}
+
+void FFMPEGDecoder::loadFile(const Decoder::FileNameType& filename, const LiveOptions& options) noexcept {
+    loadFile(filename);
+
+    m_LiveOptions = options;
+    m_LivePlayout = LivePlayoutBuffer(options.minDelay, options.maxDelay, options.catchUpThreshold);
+}
+
+void FFMPEGDecoder::loadRenditions(const std::vector<FileNameType>& renditions, const RenditionOptions& options) noexcept {
+    if (renditions.empty()) {
+        std::cerr << "No rendition to load" << std::endl;
+        return;
+    }
+
+    // the rendition actually played first is selected when the playback starts, as that needs to open every file
+    loadFile(renditions.front());
+
+    m_RenditionFiles = renditions;
+    m_RenditionOptions = options;
+}
+
+FFMPEGDecoder::RenditionStatistics FFMPEGDecoder::getRenditionStatistics() noexcept {
+    RenditionStatistics statistics = {};
+
+    {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        if (m_RenditionPlaying.has_value()) {
+            statistics.active = m_RenditionPlaying->filename;
+            statistics.width = m_RenditionPlaying->width;
+            statistics.height = m_RenditionPlaying->height;
+            statistics.switching = m_RenditionSwitching;
+        }
+    }
+
+    statistics.load = m_Load;
+    statistics.switches = m_RenditionSwitches;
+
+    return statistics;
+}
+
+FFMPEGDecoder::LiveStatistics FFMPEGDecoder::getLiveStatistics() noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    return m_LiveStatistics;
+}
+
+bool FFMPEGDecoder::isRunning() const noexcept {
+    return m_Running;
 }
 
 void FFMPEGDecoder::stop() noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
     m_ShouldClose = true;
+    m_ControlCV.notify_all();
+    getOutputDevice()->wakeQueueWaiters();
+}
+
+void FFMPEGDecoder::pause() noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_Paused = true;
+    getOutputDevice()->setClockRate(0.0);
+    getOutputDevice()->wakeQueueWaiters();
+}
+
+void FFMPEGDecoder::resume() noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_Paused = false;
+    getOutputDevice()->setClockRate(m_Rate);
+    m_ControlCV.notify_all();
+    getOutputDevice()->wakeQueueWaiters();
+}
+
+void FFMPEGDecoder::setRate(double rate) noexcept {
+    if (rate <= 0.0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_Rate = rate;
+    if (!m_Paused) {
+        getOutputDevice()->setClockRate(m_Rate);
+    }
+}
+
+void FFMPEGDecoder::stepForward() noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_Paused = true;
+    ++m_PendingSteps;
+    getOutputDevice()->setClockRate(0.0);
+    m_ControlCV.notify_all();
+    getOutputDevice()->wakeQueueWaiters();
+}
+
+void FFMPEGDecoder::stepBackward() noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_Paused = true;
+    --m_PendingSteps;
+    getOutputDevice()->setClockRate(0.0);
+    m_ControlCV.notify_all();
+    getOutputDevice()->wakeQueueWaiters();
+}
+
+void FFMPEGDecoder::seek(Frame::TimestampType pts) noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_PendingSeek = pts;
+    m_ControlCV.notify_all();
+    getOutputDevice()->wakeQueueWaiters();
+}
+
+void FFMPEGDecoder::setLoop(Frame::TimestampType start, Frame::TimestampType end) noexcept {
+    if (end <= start) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_Loop = std::make_pair(start, end);
+}
+
+void FFMPEGDecoder::clearLoop() noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_Loop.reset();
+}
+
+void FFMPEGDecoder::setIntraOnlyWorkers(size_t workers) noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_IntraOnlyWorkers = (workers == 0) ? std::max<size_t>(std::thread::hardware_concurrency(), 1) : workers;
+}
+
+void FFMPEGDecoder::setStaticFrameSkipping(bool enable) noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_StaticFrameSkipping = enable;
+}
+
+void FFMPEGDecoder::setFrameStride(uint32_t stride) noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_FrameStride = std::max<uint32_t>(stride, 1);
+}
+
+void FFMPEGDecoder::setSubtitles(bool enable) noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_Subtitles = enable;
+}
+
+void FFMPEGDecoder::setProxyCache(std::shared_ptr<ProxyCache> cache) noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_ProxyCache = std::move(cache);
+}
+
+void FFMPEGDecoder::setToneMapping(std::optional<ToneMapper::Curve> curve) noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_ToneMapping = curve;
+}
+
+void FFMPEGDecoder::setFrameStages(std::vector<std::shared_ptr<FrameStage>> stages, size_t workers) noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_FrameStages = std::move(stages);
+    m_FrameStageWorkers = std::max<size_t>(workers, 1);
+}
+
+void FFMPEGDecoder::setPlacement(std::optional<NumaTopology::NodeType> node) noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_Placement = node;
+}
+
+FFMPEGDecoder::PlacementStatistics FFMPEGDecoder::getPlacementStatistics() const noexcept {
+    PlacementStatistics statistics = {};
+
+    const int64_t node = m_PlacedNode;
+    if (node >= 0) {
+        statistics.node = static_cast<NumaTopology::NodeType>(node);
+    }
+
+    const int64_t cpu = m_LastCpu;
+    if (cpu >= 0) {
+        statistics.cpu = static_cast<uint32_t>(cpu);
+        statistics.cpuNode = NumaTopology::get().getNodeOfCpu(static_cast<uint32_t>(cpu));
+    }
+
+    statistics.offNodeFrames = m_OffNodeFrames;
+
+    return statistics;
+}
+
+/**
+ * @brief Get the CPU time used by the process and the number of times its threads went to sleep (and woke up).
+ */
+static std::pair<Frame::TimestampType, uint64_t> processUsage() noexcept {
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+
+    const Frame::TimestampType cpuTime =
+        (static_cast<Frame::TimestampType>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000) +
+        static_cast<Frame::TimestampType>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+
+    return std::make_pair(cpuTime, static_cast<uint64_t>(usage.ru_nvcsw));
+}
+
+static Frame::TimestampType monotonicTime() noexcept {
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void FFMPEGDecoder::setPacing(std::optional<PacingOptions> options) noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_Pacing = options;
+}
+
+FFMPEGDecoder::PowerStatistics FFMPEGDecoder::getPowerStatistics() const noexcept {
+    PowerStatistics statistics = {};
+
+    const auto usage = processUsage();
+    const double elapsed = static_cast<double>(monotonicTime() - m_PowerStartTime) / 1000000.0;
+    const Frame::TimestampType played = m_PlayedTime;
+
+    if (elapsed > 0.0) {
+        statistics.wakeupsPerSecond = static_cast<double>(usage.second - m_PowerStartWakeups) / elapsed;
+    }
+
+    if (played > 0) {
+        statistics.cpuTimePerPlayedSecond = static_cast<double>(usage.first - m_PowerStartCpuTime) / (static_cast<double>(played) / 1000000.0);
+    }
+
+    statistics.playedTime = played;
+    statistics.bursts = m_Bursts;
+
+    return statistics;
+}
+
+void FFMPEGDecoder::pace() noexcept {
+    if (m_HighWatermark == 0) {
+        return;
+    }
+
+    auto* const device = getOutputDevice();
+    if (device->getQueuedFrames() < m_HighWatermark) {
+        return;
+    }
+
+    // read before looking at commands: a command given from now on ends the wait
+    const uint64_t generation = device->getQueueWakeGeneration();
+    {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        if ((m_ShouldClose) || (m_Paused) || (m_PendingSteps != 0) || (m_PendingSeek.has_value())) {
+            return;
+        }
+    }
+
+    ++m_Bursts;
+
+    device->waitForQueuedFrames(m_LowWatermark, generation);
+}
+
+void FFMPEGDecoder::recordEmission(Frame::TimestampType pts) noexcept {
+    // media time is played when frames follow each other (seeks and loops are not played time)
+    if ((m_PreviousEmission != std::numeric_limits<Frame::TimestampType>::min()) && (pts > m_PreviousEmission) && (pts - m_PreviousEmission <= 1000000)) {
+        m_PlayedTime += pts - m_PreviousEmission;
+    }
+
+    m_PreviousEmission = pts;
+
+    const auto cpu = NumaTopology::getCurrentCpu();
+    if (!cpu.has_value()) {
+        return;
+    }
+
+    m_LastCpu = cpu.value();
+
+    const int64_t placed = m_PlacedNode;
+    if (placed >= 0) {
+        const auto node = NumaTopology::get().getNodeOfCpu(cpu.value());
+        if ((node.has_value()) && (static_cast<int64_t>(node.value()) != placed)) {
+            ++m_OffNodeFrames;
+        }
+    }
+}
+
+void FFMPEGDecoder::publishCounters() noexcept {
+    m_Counters.skippedFrames = (m_Counters.decodedFrames > m_DecodedEmissions) ? m_Counters.decodedFrames - m_DecodedEmissions : 0;
+    m_Counters.decodeRate = (m_AverageDecodeTime > 0.0) ? 1000000.0 / m_AverageDecodeTime : 0.0;
+    m_Counters.convertRate = (m_AverageConvertTime > 0.0) ? 1000000.0 / m_AverageConvertTime : 0.0;
+    m_Counters.time = monotonicTime();
+
+    publishStatistics(m_Counters);
+}
+
+void FFMPEGDecoder::setFrameCache(size_t budget, DecodedFrameCache::StorageMode mode) noexcept {
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_FrameCacheBudget = budget;
+    m_FrameCacheMode = mode;
 }
 
 void FFMPEGDecoder::play() noexcept {
+    // play on a running (possibly paused) decoder just resumes it
+    if (m_Running) {
+        resume();
+        return;
+    }
+
+    join();
+
+    m_ShouldClose = false;
+    m_Running = true;
+
+    std::optional<NumaTopology::NodeType> placement;
+    {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        placement = m_Placement;
+    }
+
+    std::optional<PacingOptions> pacing;
+    {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        pacing = m_Pacing;
+    }
+
+    m_PlacedNode = -1;
+    m_OffNodeFrames = 0;
+
+    // live inputs are paced by their source
+    m_HighWatermark = 0;
+    m_LowWatermark = 0;
+    if ((pacing.has_value()) && (!m_LiveOptions.has_value())) {
+        const auto frames = getOutputDevice()->getFramesCount();
+        m_HighWatermark = (pacing->highWatermark == 0) ? frames : std::min(pacing->highWatermark, frames);
+        m_LowWatermark = (pacing->lowWatermark == 0) ? (m_HighWatermark / 4) : std::min(pacing->lowWatermark, m_HighWatermark - 1);
+    }
+
+    m_Bursts = 0;
+    m_PlayedTime = 0;
+    m_PreviousEmission = std::numeric_limits<Frame::TimestampType>::min();
+
+    const auto usage = processUsage();
+    m_PowerStartTime = monotonicTime();
+    m_PowerStartCpuTime = usage.first;
+    m_PowerStartWakeups = usage.second;
+
     m_FFMPEGThread.reset(
-        new std::thread([this]() {
-            // with ffmpeg, you have to first initialize the library.
-            // 'av_register_all' is deprecated just omit this function call in ffmpeg
-            // 4.0 and later.
-            // av_register_all();  // [0]
-
-            
-            // declare the AVFormatContext
-            AVFormatContext * pFormatCtx = NULL; // [1]
-
-            // now we can actually open the file:
-            // the minimum information required to open a file is its URL, which is
-            // passed to avformat_open_input(), as in the following code:
-            int ret = avformat_open_input(&pFormatCtx, this->m_LoadedFilename->c_str(), NULL, NULL);    // [2]
-            if (ret < 0)
-            {
-                // couldn't open file
-                std::cerr << "Could not open file " << this->m_LoadedFilename->c_str() << std::endl;
-
-                // exit with error
-                return -1;
+        new std::thread([this, placement, pacing]() {
+            // timers of this thread and of threads it starts can be coalesced by the kernel
+            if (pacing.has_value()) {
+                prctl(PR_SET_TIMERSLACK, static_cast<unsigned long>(std::max<Frame::TimestampType>(pacing->timerSlack, 1)) * 1000, 0, 0, 0);
             }
 
-            // The call to avformat_open_input(), only looks at the header, so next we
-            // need to check out the stream information in the file.:
-            // Retrieve stream information
-            ret = avformat_find_stream_info(pFormatCtx, NULL);  //[3]
-            if (ret < 0)
-            {
-                // couldn't find stream information
-                std::cerr << "Could not find stream information " << this->m_LoadedFilename->c_str() << std::endl;
-
-                // exit with error
-                return -1;
+            // workers (and codec threads) started by this thread inherit its placement
+            if ((placement.has_value()) && (NumaTopology::get().bindThread(placement.value()))) {
+                m_PlacedNode = placement.value();
             }
 
-            // We introduce a handy debugging function to show us what's inside dumping
-            // information about file onto standard error
-            av_dump_format(pFormatCtx, 0, this->m_LoadedFilename->c_str(), 0);  // [4]
-
-            // Now pFormatCtx->streams is just an array of pointers, of size
-            // pFormatCtx->nb_streams, so let's walk through it until we find a video
-            // stream.
-            int i;
-
-            // The stream's information about the codec is in what we call the
-            // "codec context." This contains all the information about the codec that
-            // the stream is using
-            AVCodecContext * pCodecCtxOrig = NULL;
-            AVCodecContext * pCodecCtx = NULL;
-
-            // Find the first video stream
-            int videoStream = -1;
-            for (i = 0; i < pFormatCtx->nb_streams; i++)
-            {
-                // check the General type of the encoded data to match
-            // AVMEDIA_TYPE_VIDEO
-                if (pFormatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) // [5]
-                {
-                    videoStream = i;
-                    break;
-                }
-            }
+            playbackLoop();
 
-            if (videoStream == -1)
-            {
-                // didn't find a video stream
-                return -1;
-            }
+            m_Running = false;
+        })
+    );
+}
 
-            /**
-             * New API.
-             * This implementation uses the new API.
-             * Please refer to tutorial01-deprecated.c for an implementation using the
-             * deprecated FFmpeg API.
-             */
-
-            // Get a pointer to the codec context for the video stream.
-            // AVStream::codec deprecated
-            // https://ffmpeg.org/pipermail/libav-user/2016-October/009801.html
-            // pCodecCtxOrig = pFormatCtx->streams[videoStream]->codec;
-
-            // Find the decoder for the video stream
-            auto pCodec = avcodec_find_decoder(pFormatCtx->streams[videoStream]->codecpar->codec_id); // [6]
-            if (pCodec == nullptr)
-            {
-                // codec not found
-                std::cerr << "Unsupported codec for " << this->m_LoadedFilename->c_str() << std::endl;
-                
-
-                // exit with error
-                return -1;
-            }
+bool FFMPEGDecoder::selectInitialRendition() noexcept {
+    m_Renditions.clear();
+    for (const auto& filename : m_RenditionFiles) {
+        auto rendition = RenditionLoader::probe(filename);
+        if (rendition.has_value()) {
+            m_Renditions.push_back(std::move(rendition.value()));
+        }
+    }
 
-            pCodecCtxOrig = avcodec_alloc_context3(pCodec); // [7]
-            ret = avcodec_parameters_to_context(pCodecCtxOrig, pFormatCtx->streams[videoStream]->codecpar);
-
-            /**
-             * Note that we must not use the AVCodecContext from the video stream
-             * directly! So we have to use avcodec_copy_context() to copy the
-             * context to a new location (after allocating memory for it, of
-             * course).
-             */
-
-            // Copy context
-            // avcodec_copy_context deprecation
-            // http://ffmpeg.org/pipermail/libav-user/2017-September/010615.html
-            //ret = avcodec_copy_context(pCodecCtx, pCodecCtxOrig);
-            pCodecCtx = avcodec_alloc_context3(pCodec); // [7]
-            ret = avcodec_parameters_to_context(pCodecCtx, pFormatCtx->streams[videoStream]->codecpar);
-            if (ret != 0)
-            {
-                // error copying codec context
-                std::cerr << "Could not copy codec context for " << this->m_LoadedFilename->c_str() << std::endl;
-
-                // exit with error
-                return -1;
-            }
+    if (m_Renditions.empty()) {
+        std::cerr << "No rendition can be played" << std::endl;
+        return false;
+    }
 
-            // Open codec
-            ret = avcodec_open2(pCodecCtx, pCodec, NULL);   // [8]
-            if (ret < 0)
-            {
-                // Could not open codec
-                std::cerr << "Could not open codec for " << this->m_LoadedFilename->c_str() << std::endl;
+    // from the largest to the smallest (then from the highest bitrate to the lowest)
+    std::stable_sort(m_Renditions.begin(), m_Renditions.end(), [](const RenditionLoader::Rendition& a, const RenditionLoader::Rendition& b) {
+        const uint64_t pixelsA = static_cast<uint64_t>(a.width) * a.height;
+        const uint64_t pixelsB = static_cast<uint64_t>(b.width) * b.height;
+        return (pixelsA != pixelsB) ? (pixelsA > pixelsB) : (a.bitRate > b.bitRate);
+    });
+
+    // pixels of renditions larger than the output device wants would be thrown away: the smallest rendition
+    // covering the preferred size is the largest one ever played
+    const uint32_t preferredWidth = this->getOutputDevice()->getPreferredWidth();
+    const uint32_t preferredHeight = this->getOutputDevice()->getPreferredHeight();
+
+    size_t ceiling = 0;
+    for (size_t i = 1; i < m_Renditions.size(); ++i) {
+        const bool coversWidth = (preferredWidth != 0) && (m_Renditions[i].width >= preferredWidth);
+        const bool coversHeight = (preferredHeight != 0) && (m_Renditions[i].height >= preferredHeight);
+        const bool covers = ((preferredWidth == 0) || (coversWidth)) && ((preferredHeight == 0) || (coversHeight));
+
+        if ((covers) && ((preferredWidth != 0) || (preferredHeight != 0))) {
+            ceiling = i;
+        }
+    }
 
-                // exit with error
-                return -1;
-            }
+    m_Renditions.erase(m_Renditions.begin(), m_Renditions.begin() + static_cast<std::ptrdiff_t>(ceiling));
 
-            // Now we need a place to actually store the frame:
-            AVFrame * pFrame = NULL;
+    m_ActiveRendition = 0;
+    m_LoadedFilename = m_Renditions.front().filename;
 
-            // Allocate video frame
-            pFrame = av_frame_alloc();  // [9]
-            if (pFrame == NULL)
-            {
-                // Could not allocate frame
-                std::cerr << "Could not allocate frame for " << this->m_LoadedFilename->c_str() << std::endl;
+    m_Load = 0.0;
+    m_StarvedFrames = 0;
+    m_LastSwitchTime = monotonicTime();
+    m_RenditionSwitches = 0;
 
-                // exit with error
-                return -1;
-            }
+    {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        m_RenditionPlaying = m_Renditions.front();
+        m_RenditionSwitching = false;
+    }
+
+    return true;
+}
+
+Frame::TimestampType FFMPEGDecoder::adaptRendition(Frame::TimestampType pts) noexcept {
+    const auto& options = m_RenditionOptions;
+
+    // a prepared rendition takes over on its first keyframe
+    const auto ready = m_RenditionLoader.getReadyTimestamp();
+    if (ready.has_value()) {
+        if ((pts >= ready.value()) && (pts - ready.value() <= 2 * m_FrameDuration) && (switchRendition())) {
+            return ready.value();
+        }
+
+        // the playback went past the keyframe (or moved back, far from it): the rendition has to be prepared again
+        if ((pts > ready.value()) || (ready.value() - pts > 4 * options.switchAhead)) {
+            m_RenditionLoader.cancel();
+        }
+    }
+
+    if (!updateLoad()) {
+        return pts;
+    }
+
+    if (m_RenditionLoader.getPending().has_value()) {
+        return pts;
+    }
+
+    std::optional<size_t> target;
+
+    const bool overloaded = (m_Load > options.downgradeLoad) || (m_StarvedFrames >= options.starvedFrames);
+    if ((overloaded) && (m_ActiveRendition + 1 < m_Renditions.size())) {
+        target = m_ActiveRendition + 1;
+    } else if ((!overloaded) && (m_ActiveRendition > 0) && (monotonicTime() - m_LastSwitchTime >= options.upgradeDelay)) {
+        // the load grows with the number of pixels
+        const auto& active = m_Renditions[m_ActiveRendition];
+        const auto& larger = m_Renditions[m_ActiveRendition - 1];
+        const double ratio = static_cast<double>(static_cast<uint64_t>(larger.width) * larger.height) /
+            static_cast<double>(std::max<uint64_t>(static_cast<uint64_t>(active.width) * active.height, 1));
+
+        if (m_Load * ratio < options.upgradeLoad) {
+            target = m_ActiveRendition - 1;
+        }
+    }
+
+    if (target.has_value()) {
+        m_RenditionLoader.prepare(target.value(), m_Renditions[target.value()].filename, pts + options.switchAhead);
+
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        m_RenditionSwitching = true;
+    }
+
+    return pts;
+}
+
+bool FFMPEGDecoder::updateLoad() noexcept {
+    // the time a frame is shown for: at high rates (and when only keyframes are decoded) loads are not comparable
+    const double rate = getOutputDevice()->getClockRate();
+    if ((m_KeyframesOnly) || (rate <= 0.0) || (m_FrameDuration <= 0)) {
+        return false;
+    }
+
+    const double budget = static_cast<double>(m_FrameDuration) / rate;
+    const double frameLoad = static_cast<double>(m_DecodeTime + m_ConvertTime) / budget;
+    m_Load = (m_Load * 0.95) + (frameLoad * 0.05);
+
+    // a drained output device queue means frames arrive later than they are presented
+    auto* const device = getOutputDevice();
+    if ((device->isReportingQueuedFrames()) && (device->getQueuedFrames() == 0)) {
+        ++m_StarvedFrames;
+    } else {
+        m_StarvedFrames = 0;
+    }
+
+    return true;
+}
+
+void FFMPEGDecoder::watchProxyLoad() noexcept {
+    // the load starts from zero when the file is opened: a few seconds of heavy decoding are needed to go over the threshold
+    if ((!updateLoad()) || (m_Load <= m_ProxyWatch->getOptions().heavyLoad)) {
+        return;
+    }
+
+    m_ProxyWatch->request(m_LoadedFilename.value());
+    m_ProxyWatch.reset();
+}
+
+bool FFMPEGDecoder::switchRendition() noexcept {
+    RenditionLoader::Prepared prepared;
+    if (!m_RenditionLoader.take(prepared)) {
+        return false;
+    }
+
+    // the output size is not changed: the output device keeps receiving frames of the same size
+    m_IntraPool.reset();
+    m_IntraDraining = false;
+
+    avcodec_free_context(&m_CodecCtx);
+    avformat_close_input(&m_FormatCtx);
+
+    m_FormatCtx = prepared.formatCtx;
+    m_CodecCtx = prepared.codecCtx;
+    m_VideoStream = prepared.videoStream;
+
+    AVStream* pStream = m_FormatCtx->streams[m_VideoStream];
+    m_FrameDuration = (pStream->avg_frame_rate.num > 0) ?
+        av_rescale_q(1, AVRational{ pStream->avg_frame_rate.den, pStream->avg_frame_rate.num }, AV_TIME_BASE_Q) :
+        AV_TIME_BASE / 25;
+
+    m_CodecCtx->skip_frame = m_KeyframesOnly ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+
+    // the keyframe has been decoded by the codec context: the parallel decoders start from the packet after it
+    if ((m_IntraPoolWorkers > 1) && (IntraFrameDecoderPool::isIntraOnly(pStream->codecpar))) {
+        m_IntraPool.reset(new IntraFrameDecoderPool());
+        if (!m_IntraPool->open(m_CodecCtx->codec, pStream->codecpar, 0, m_IntraPoolWorkers)) {
+            m_IntraPool.reset();
+        }
+    }
+
+    av_frame_unref(m_Frame);
+    av_frame_move_ref(m_Frame, prepared.keyframe);
+    av_frame_free(&prepared.keyframe);
+
+    // frames of the previous rendition still being processed are dropped, the keyframe goes through stages as well
+    if (m_Pipeline) {
+        m_Pipeline->flush();
+        m_PipelineDraining = false;
+        m_Pipeline->submit(m_Frame);
+        if (!m_Pipeline->receive(m_Frame, true)) {
+            return false;
+        }
+    }
+
+    m_ChangeDetector.reset();
+
+    // the stream index refers to the file of the previous rendition
+    openSubtitles();
+
+    m_ActiveRendition = prepared.index;
+    m_LoadedFilename = m_Renditions[m_ActiveRendition].filename;
+    m_StarvedFrames = 0;
+    m_LastSwitchTime = monotonicTime();
+    ++m_RenditionSwitches;
+
+    {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        m_RenditionPlaying = m_Renditions[m_ActiveRendition];
+        m_RenditionSwitching = false;
+    }
+
+    return true;
+}
+
+void FFMPEGDecoder::openSubtitles() noexcept {
+    m_SubtitleDecoder.close();
+
+    if ((!m_ShowSubtitles) || (!this->getCompositor())) {
+        return;
+    }
+
+    // cues are scaled from the video size (not reduced by lowres decoding) to the size of output frames
+    const AVCodecParameters* codecpar = m_FormatCtx->streams[m_VideoStream]->codecpar;
+    m_SubtitleDecoder.open(m_FormatCtx, codecpar->width, codecpar->height, m_OutputWidth, m_OutputHeight, this->getCompositor());
+}
+
+bool FFMPEGDecoder::openFile() noexcept {
+    if ((!m_RenditionFiles.empty()) && (!selectInitialRendition())) {
+        return false;
+    }
+
+    if (!m_LoadedFilename.has_value()) {
+        std::cerr << "No file loaded" << std::endl;
+        return false;
+    }
+
+    // heavy assets are played from their proxy, if one has been made
+    Decoder::FileNameType openedFilename = m_LoadedFilename.value();
+    std::shared_ptr<ProxyCache> proxyCache;
+    {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        proxyCache = m_ProxyCache;
+    }
+
+    m_ProxyWatch.reset();
+    if ((proxyCache) && (!m_LiveOptions.has_value()) && (m_Renditions.empty())) {
+        const auto proxy = proxyCache->lookup(openedFilename);
+        if (proxy.has_value()) {
+            openedFilename = proxy.value();
+        } else {
+            m_ProxyWatch = std::move(proxyCache);
+            m_Load = 0.0;
+            m_StarvedFrames = 0;
+        }
+    }
+
+    const char* filename = openedFilename.c_str();
+
+    // Live inputs are opened without demuxer buffering and probed as little as possible,
+    // so that the first frame is shown as soon as it arrives.
+    const bool live = m_LiveOptions.has_value();
+    AVDictionary* formatOptions = NULL;
+    if (live)
+    {
+        m_FormatCtx = avformat_alloc_context();
+        if (m_FormatCtx == NULL)
+        {
+            std::cerr << "Could not allocate format context for " << filename << std::endl;
+            return false;
+        }
+
+        m_FormatCtx->flags |= AVFMT_FLAG_NOBUFFER | AVFMT_FLAG_FLUSH_PACKETS;
+        av_dict_set(&formatOptions, "probesize", "32768", 0);
+        av_dict_set(&formatOptions, "analyzeduration", "500000", 0);
+        av_dict_set(&formatOptions, "max_delay", "0", 0);
+    }
+
+    // now we can actually open the file:
+    // the minimum information required to open a file is its URL, which is
+    // passed to avformat_open_input(), as in the following code:
+    int ret = avformat_open_input(&m_FormatCtx, filename, NULL, &formatOptions);    // [2]
+    av_dict_free(&formatOptions);
+    if (ret < 0)
+    {
+        // couldn't open file
+        std::cerr << "Could not open file " << filename << std::endl;
+        return false;
+    }
+
+    // The call to avformat_open_input(), only looks at the header, so next we
+    // need to check out the stream information in the file.:
+    // Retrieve stream information
+    ret = avformat_find_stream_info(m_FormatCtx, NULL);  //[3]
+    if (ret < 0)
+    {
+        // couldn't find stream information
+        std::cerr << "Could not find stream information " << filename << std::endl;
+        return false;
+    }
+
+    // We introduce a handy debugging function to show us what's inside dumping
+    // information about file onto standard error
+    av_dump_format(m_FormatCtx, 0, filename, 0);  // [4]
+
+    // Now m_FormatCtx->streams is just an array of pointers, of size
+    // m_FormatCtx->nb_streams, so let's walk through it until we find a video
+    // stream.
+    m_VideoStream = -1;
+    for (unsigned int i = 0; i < m_FormatCtx->nb_streams; i++)
+    {
+        // check the General type of the encoded data to match
+        // AVMEDIA_TYPE_VIDEO
+        if (m_FormatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) // [5]
+        {
+            m_VideoStream = i;
+            break;
+        }
+    }
+
+    if (m_VideoStream == -1)
+    {
+        // didn't find a video stream
+        std::cerr << "No video stream in " << filename << std::endl;
+        return false;
+    }
+
+    AVStream* pStream = m_FormatCtx->streams[m_VideoStream];
+
+    // Find the decoder for the video stream
+    auto pCodec = avcodec_find_decoder(pStream->codecpar->codec_id); // [6]
+    if (pCodec == nullptr)
+    {
+        // codec not found
+        std::cerr << "Unsupported codec for " << filename << std::endl;
+        return false;
+    }
 
-            /**
-             * Since we're planning to output PPM files, which are stored in 24-bit
-             * RGB, we're going to have to convert our frame from its native format
-             * to RGB. ffmpeg will do these conversions for us. For most projects
-             * (including ours) we're going to want to convert our initial frame to
-             * a specific format. Let's allocate a frame for the converted frame
-             * now.
-             */
-
-            // Allocate an AVFrame structure
-            AVFrame * pFrameRGB = NULL;
-            pFrameRGB = av_frame_alloc();
-            if (pFrameRGB == NULL)
-            {
-                // Could not allocate frame
-                std::cerr << "Could not allocate frame for " << this->m_LoadedFilename->c_str() << std::endl;
-
-                // exit with error
-                return -1;
+    // Note that we must not use the AVCodecContext from the video stream
+    // directly: the codec context is created from the stream codec parameters.
+    m_CodecCtx = avcodec_alloc_context3(pCodec); // [7]
+    ret = avcodec_parameters_to_context(m_CodecCtx, pStream->codecpar);
+    if (ret != 0)
+    {
+        // error copying codec context
+        std::cerr << "Could not copy codec context for " << filename << std::endl;
+        return false;
+    }
+
+    // The output device tells which size and format frames should have: frames are
+    // scaled once, directly to that size, so that no pixel that would be thrown away
+    // by the output device is ever converted or copied.
+    m_OutputFormat = this->getOutputDevice()->getPreferredPixelFormat();
+    const auto outputSize = FFMPEGCommon::fitInside(
+        m_CodecCtx->width,
+        m_CodecCtx->height,
+        this->getOutputDevice()->getPreferredWidth(),
+        this->getOutputDevice()->getPreferredHeight()
+    );
+    m_OutputWidth = outputSize.first;
+    m_OutputHeight = outputSize.second;
+
+    // Processing stages run on full resolution frames.
+    std::vector<std::shared_ptr<FrameStage>> frameStages;
+    size_t frameStageWorkers = 1;
+    {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        frameStages = m_FrameStages;
+        frameStageWorkers = m_FrameStageWorkers;
+    }
+
+    // When the codec supports it, let the decoder itself produce smaller frames.
+    m_CodecCtx->lowres = frameStages.empty() ?
+        FFMPEGCommon::lowresFactor(pCodec, m_CodecCtx->width, m_CodecCtx->height, m_OutputWidth, m_OutputHeight) : 0;
+
+    // Live inputs: frames are output as soon as they are decoded (frame threading delays
+    // the output of one frame per thread, slice threading does not).
+    if (live)
+    {
+        m_CodecCtx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+        m_CodecCtx->thread_type = FF_THREAD_SLICE;
+    }
+
+    // Open codec
+    ret = avcodec_open2(m_CodecCtx, pCodec, NULL);   // [8]
+    if (ret < 0)
+    {
+        // Could not open codec
+        std::cerr << "Could not open codec for " << filename << std::endl;
+        return false;
+    }
+
+    // Intra-only streams have no dependencies between frames: packets are decoded
+    // in parallel by a pool of codec contexts, each one on its own thread.
+    size_t intraOnlyWorkers = 1;
+    {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        intraOnlyWorkers = m_IntraOnlyWorkers;
+        m_DetectChanges = m_StaticFrameSkipping;
+        m_EmitStride = m_FrameStride;
+        m_StrideFrames = 0;
+        m_ShowSubtitles = m_Subtitles;
+        m_MapTones = m_ToneMapping.has_value();
+        if (m_MapTones) {
+            m_ToneMapper.setCurve(m_ToneMapping.value());
+        }
+    }
+
+    m_ChangeDetector.reset();
+
+    openSubtitles();
+
+    // a placed decoder has the CPUs of its node only
+    const int64_t placedNode = m_PlacedNode;
+    if (placedNode >= 0) {
+        for (const auto& node : NumaTopology::get().getNodes()) {
+            if (static_cast<int64_t>(node.id) == placedNode) {
+                intraOnlyWorkers = std::min(intraOnlyWorkers, std::max<size_t>(node.cpus.size(), 1));
             }
+        }
+    }
+
+    m_IntraPool.reset();
+    m_IntraDraining = false;
+    m_IntraPoolWorkers = intraOnlyWorkers;
+    if ((intraOnlyWorkers > 1) && (IntraFrameDecoderPool::isIntraOnly(pStream->codecpar))) {
+        m_IntraPool.reset(new IntraFrameDecoderPool());
+        if (!m_IntraPool->open(pCodec, pStream->codecpar, m_CodecCtx->lowres, intraOnlyWorkers)) {
+            // fall back to the sequential decoder
+            std::cerr << "Could not open parallel decoders for " << filename << std::endl;
+            m_IntraPool.reset();
+        }
+    }
+
+    m_Pipeline.reset();
+    m_PipelineDraining = false;
+    if (!frameStages.empty()) {
+        m_Pipeline.reset(new FramePipeline(std::move(frameStages), frameStageWorkers));
+    }
+
+    // Now we need a place to actually store the frame:
+    m_Frame = av_frame_alloc();  // [9]
+    if (m_Frame == NULL)
+    {
+        // Could not allocate frame
+        std::cerr << "Could not allocate frame for " << filename << std::endl;
+        return false;
+    }
+
+    m_Packet = av_packet_alloc();
+    if (m_Packet == NULL)
+    {
+        // couldn't allocate packet
+        std::cerr << "Could not allocate packet for " << filename << std::endl;
+        return false;
+    }
+
+    // The nominal frame duration is used to decide which frames are skipped at high playback rates.
+    m_FrameDuration = (pStream->avg_frame_rate.num > 0) ?
+        av_rescale_q(1, AVRational{ pStream->avg_frame_rate.den, pStream->avg_frame_rate.num }, AV_TIME_BASE_Q) :
+        AV_TIME_BASE / 25;
+
+    // The SWS context for software scaling is (re)initialized when the first frame
+    // arrives, as its size depends on the lowres factor and can change mid-stream.
+    m_SwsCtx = NULL;
+
+    m_KeyframesOnly = false;
+    m_ResumeAfter.reset();
+    m_LastEmitted = std::numeric_limits<Frame::TimestampType>::min();
 
-            // Even though we've allocated the frame, we still need a place to put
-            // the raw data when we convert it. We use avpicture_get_size to get
-            // the size we need, and allocate the space manually:
-            uint8_t * buffer = NULL;
-            int numBytes;
-
-            // Determine required buffer size and allocate buffer
-            // numBytes = avpicture_get_size(AV_PIX_FMT_RGB24, pCodecCtx->width, pCodecCtx->height); // changed to AV_PIX_FMT_AYUV64LE
-            // https://ffmpeg.org/pipermail/ffmpeg-devel/2016-January/187299.html
-            // what is 'linesize alignment' meaning?:
-            // https://stackoverflow.com/questions/35678041/what-is-linesize-alignment-meaning
-            numBytes = av_image_get_buffer_size(AV_PIX_FMT_RGBA64, pCodecCtx->width, pCodecCtx->height, 32); // [10]
-            buffer = (uint8_t *) av_malloc(numBytes * sizeof(uint8_t));    // [11]
-
-            /**
-            * Now we use avpicture_fill() to associate the frame with our newly
-            * allocated buffer. About the AVPicture cast: the AVPicture struct is
-            * a subset of the AVFrame struct - the beginning of the AVFrame struct
-            * is identical to the AVPicture struct.
-            */
-            // Assign appropriate parts of buffer to image planes in pFrameRGB
-            // Note that pFrameRGB is an AVFrame, but AVFrame is a superset
-            // of AVPicture
-            // Picture data structure - Deprecated: use AVFrame or imgutils functions
-            // instead
-            // https://www.ffmpeg.org/doxygen/3.0/structAVPicture.html#a40dfe654d0f619d05681aed6f99af21b
-            // avpicture_fill( // [12]
-            //     (AVPicture *)pFrameRGB,
-            //     buffer,
-            //     AV_PIX_FMT_RGB24,
-            //     pCodecCtx->width,
-            //     pCodecCtx->height
-            // );
-            av_image_fill_arrays( // [12]
-                pFrameRGB->data,
-                pFrameRGB->linesize,
-                buffer,
-                AV_PIX_FMT_RGBA64,
-                pCodecCtx->width,
-                pCodecCtx->height,
-                32
+    m_LivePlayout.reset();
+    {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        m_LiveStatistics = LiveStatistics();
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        m_FrameCache.configure(m_FrameCacheBudget, m_FrameCacheMode);
+    }
+
+    return true;
+}
+
+void FFMPEGDecoder::closeFile() noexcept {
+    m_FrameCache.clear();
+
+    m_SubtitleDecoder.close();
+    m_ProxyWatch.reset();
+
+    m_RenditionLoader.cancel();
+    m_Renditions.clear();
+    {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        m_RenditionPlaying.reset();
+        m_RenditionSwitching = false;
+    }
+
+    // Stop parallel decoders and processing stages
+    m_IntraPool.reset();
+    m_Pipeline.reset();
+
+    // Free the scaling context
+    sws_freeContext(m_SwsCtx);
+    m_SwsCtx = NULL;
+
+    av_packet_free(&m_Packet);
+
+    // Free the YUV frame
+    av_frame_free(&m_Frame);
+
+    // Close the codec
+    avcodec_free_context(&m_CodecCtx);
+
+    // Close the video file
+    avformat_close_input(&m_FormatCtx);
+
+    m_VideoStream = -1;
+}
+
+bool FFMPEGDecoder::receiveNextFrame() noexcept {
+    if (!m_Pipeline) {
+        if (!receiveDecodedFrame()) {
+            return false;
+        }
+
+        ++m_Counters.decodedFrames;
+        return true;
+    }
+
+    while (true)
+    {
+        // the next processed frame is waited for only when no more frames can be submitted
+        if (m_Pipeline->receive(m_Frame, (m_PipelineDraining) || (m_Pipeline->isFull())))
+        {
+            // stages can change the frame size (i.e. crop): the output keeps the aspect ratio of processed frames
+            const auto outputSize = FFMPEGCommon::fitInside(
+                m_Frame->width,
+                m_Frame->height,
+                this->getOutputDevice()->getPreferredWidth(),
+                this->getOutputDevice()->getPreferredHeight()
             );
 
-            // Finally! Now we're ready to read from the stream!
+            m_OutputWidth = outputSize.first;
+            m_OutputHeight = outputSize.second;
+
+            ++m_Counters.decodedFrames;
+            return true;
+        }
+        else if (m_PipelineDraining)
+        {
+            // every frame has been processed
+            return false;
+        }
+
+        if (!receiveDecodedFrame())
+        {
+            // end of the stream: wait for frames still being processed
+            m_PipelineDraining = true;
+            continue;
+        }
+
+        m_Pipeline->submit(m_Frame);
+    }
+}
+
+bool FFMPEGDecoder::receiveDecodedFrame() noexcept {
+    if (m_IntraPool) {
+        return receiveNextIntraFrame();
+    }
+
+    while (true)
+    {
+        int ret = avcodec_receive_frame(m_CodecCtx, m_Frame);   // [15]
+        if (ret >= 0)
+        {
+            return true;
+        }
+        else if (ret == AVERROR_EOF)
+        {
+            // every frame has been decoded
+            return false;
+        }
+        else if (ret != AVERROR(EAGAIN))
+        {
+            // could not decode packet
+            std::cerr << "Error while decoding " << m_LoadedFilename->c_str() << std::endl;
+            return false;
+        }
+
+        // the decoder needs more input
+        if (m_ShouldClose)
+        {
+            return false;
+        }
+
+        if (av_read_frame(m_FormatCtx, m_Packet) < 0)  // [14]
+        {
+            // end of file: enter draining mode to get frames still buffered inside the decoder
+            avcodec_send_packet(m_CodecCtx, NULL);
+            continue;
+        }
+
+        // Is this a packet from the video stream? When only keyframes are decoded
+        // the other packets are not even sent to the decoder.
+        const bool wanted = (m_Packet->stream_index == m_VideoStream) &&
+            ((!m_KeyframesOnly) || ((m_Packet->flags & AV_PKT_FLAG_KEY) != 0));
+
+        ret = wanted ? avcodec_send_packet(m_CodecCtx, m_Packet) : 0;    // [15]
+
+        if (m_Packet->stream_index == m_SubtitleDecoder.getStream())
+        {
+            m_SubtitleDecoder.decode(m_Packet);
+        }
+
+        // Free the packet that was allocated by av_read_frame
+        av_packet_unref(m_Packet);
+
+        if ((ret < 0) && (ret != AVERROR(EAGAIN)))
+        {
+            // could not send packet for decoding
+            std::cerr << "Error sending packet for decoding " << m_LoadedFilename->c_str() << std::endl;
+            return false;
+        }
+    }
+}
+
+bool FFMPEGDecoder::receiveNextIntraFrame() noexcept {
+    while (true)
+    {
+        // the next frame in presentation order is waited for only when no more packets can be dispatched
+        if (m_IntraPool->receive(m_Frame, (m_IntraDraining) || (m_IntraPool->isFull())))
+        {
+            return true;
+        }
+        else if (m_IntraDraining)
+        {
+            // every frame has been decoded
+            return false;
+        }
+
+        if (m_ShouldClose)
+        {
+            return false;
+        }
+
+        if (av_read_frame(m_FormatCtx, m_Packet) < 0)  // [14]
+        {
+            // end of file: wait for frames still being decoded
+            m_IntraDraining = true;
+            continue;
+        }
+
+        // every frame of an intra-only stream is a keyframe
+        if (m_Packet->stream_index == m_VideoStream)
+        {
+            m_IntraPool->submit(m_Packet);
+        }
+        else if (m_Packet->stream_index == m_SubtitleDecoder.getStream())
+        {
+            m_SubtitleDecoder.decode(m_Packet);
+        }
+
+        av_packet_unref(m_Packet);
+    }
+}
+
+bool FFMPEGDecoder::decodeNextFrame() noexcept {
+    if (!m_ResumeAfter.has_value()) {
+        return receiveNextFrame();
+    }
+
+    // the decoder was moved back to re-decode old frames: bring it right after the newest frame
+    const auto after = m_ResumeAfter.value();
+    m_ResumeAfter.reset();
+
+    if (!seekBefore(after)) {
+        return false;
+    }
+
+    while (receiveNextFrame()) {
+        if (FFMPEGCommon::presentationTimestamp(m_Frame, m_FormatCtx->streams[m_VideoStream]->time_base) > after) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool FFMPEGDecoder::seekBefore(Frame::TimestampType pts) noexcept {
+    const int64_t ts = av_rescale_q(pts, AV_TIME_BASE_Q, m_FormatCtx->streams[m_VideoStream]->time_base);
+    if (av_seek_frame(m_FormatCtx, m_VideoStream, ts, AVSEEK_FLAG_BACKWARD) < 0) {
+        return false;
+    }
+
+    avcodec_flush_buffers(m_CodecCtx);
+    m_SubtitleDecoder.flush();
+
+    if (m_IntraPool) {
+        m_IntraPool->flush();
+        m_IntraDraining = false;
+    }
+
+    if (m_Pipeline) {
+        m_Pipeline->flush();
+        m_PipelineDraining = false;
+    }
+
+    return true;
+}
+
+bool FFMPEGDecoder::convertFrame(const AVFrame* frame, void* dst) noexcept {
+    // HDR frames going to an 8-bit output are tone mapped while being converted
+    if ((m_MapTones) && (ToneMapper::isApplicable(frame, m_OutputFormat))) {
+        return m_ToneMapper.map(frame, m_OutputFormat, m_OutputWidth, m_OutputHeight, dst);
+    }
+
+    m_SwsCtx = sws_getCachedContext(  // [13]
+        m_SwsCtx,
+        frame->width,
+        frame->height,
+        static_cast<AVPixelFormat>(frame->format),
+        m_OutputWidth,
+        m_OutputHeight,
+        FFMPEGCommon::toAVPixelFormat(m_OutputFormat),   // sws_scale destination color scheme
+        FFMPEGCommon::toSwsFlags(this->getScalingFilter()),
+        NULL,
+        NULL,
+        NULL
+    );
+
+    if (m_SwsCtx == NULL)
+    {
+        // could not convert frames
+        std::cerr << "Could not create the scaling context for " << m_LoadedFilename->c_str() << std::endl;
+        return false;
+    }
 
-            /**
-             * What we're going to do is read through the entire video stream by
-             * reading in the packet, decoding it into our frame, and once our
-             * frame is complete, we will convert and save it.
-             */
+    uint8_t* dstData[4];
+    int dstStride[4];
+    FFMPEGCommon::framePlanes(m_OutputFormat, dst, m_OutputWidth, m_OutputHeight, dstData, dstStride);
+
+    sws_scale(  // [16]
+        m_SwsCtx,
+        (uint8_t const * const *)frame->data,
+        frame->linesize,
+        0,
+        frame->height,
+        dstData,
+        dstStride
+    );
 
-            struct SwsContext * sws_ctx = NULL;
+    return true;
+}
+
+bool FFMPEGDecoder::emitDecodedFrame(const AVFrame* frame, Frame::TimestampType pts, bool store, std::optional<Frame::Rect> dirtyRect) noexcept {
+    bool filled = false;
+    bool converted = false;
+
+    recordEmission(pts);
+    m_SubtitleDecoder.show(pts);
+
+    // the changed region is scaled (rounding outward) as the frame is
+    if ((dirtyRect.has_value()) && (frame->width > 0) && (frame->height > 0)) {
+        const auto& rect = dirtyRect.value();
+        const uint64_t x0 = (static_cast<uint64_t>(rect.x) * m_OutputWidth) / frame->width;
+        const uint64_t y0 = (static_cast<uint64_t>(rect.y) * m_OutputHeight) / frame->height;
+        const uint64_t x1 = ((static_cast<uint64_t>(rect.x + rect.width) * m_OutputWidth) + frame->width - 1) / frame->width;
+        const uint64_t y1 = ((static_cast<uint64_t>(rect.y + rect.height) * m_OutputHeight) + frame->height - 1) / frame->height;
+
+        dirtyRect = Frame::Rect{
+            static_cast<uint32_t>(x0),
+            static_cast<uint32_t>(y0),
+            static_cast<uint32_t>(std::min<uint64_t>(x1, m_OutputWidth) - x0),
+            static_cast<uint32_t>(std::min<uint64_t>(y1, m_OutputHeight) - y0)
+        };
+    }
 
-            AVPacket * pPacket = av_packet_alloc();
-            if (pPacket == NULL)
-            {
-                // couldn't allocate packet
-                std::cerr << "Could not allocate packet for " << this->m_LoadedFilename->c_str() << std::endl;
+    // send frame to FrameCollection: the image is converted from its native format
+    // (and scaled) directly into the frame memory
+    this->emitFrame(m_OutputFormat, m_OutputWidth, m_OutputHeight, pts, [&](void* frameMemory) {
+        filled = true;
 
-                // exit with error
-                return -1;
+        const Frame::TimestampType convertStart = monotonicTime();
+        converted = convertFrame(frame, frameMemory);
+        m_ConvertTime = monotonicTime() - convertStart;
+
+        // a converted copy is kept while the pixels are still hot in cache
+        if ((converted) && (store) && (m_FrameCache.getStorageMode() == DecodedFrameCache::StorageMode::Converted)) {
+            void* cached = m_FrameCache.pushBackConverted(m_OutputFormat, m_OutputWidth, m_OutputHeight, pts);
+            if (cached != nullptr) {
+                std::memcpy(cached, frameMemory, Frame::getFrameSizeInBytes(m_OutputFormat, m_OutputWidth, m_OutputHeight));
             }
+        }
+    }, 0, dirtyRect);
 
-            // initialize SWS context for software scaling
-            sws_ctx = sws_getContext(   // [13]
-                pCodecCtx->width,
-                pCodecCtx->height,
-                pCodecCtx->pix_fmt,
-                pCodecCtx->width,
-                pCodecCtx->height,
-                AV_PIX_FMT_BGRA64,   // sws_scale destination color scheme
-                SWS_BILINEAR,
-                NULL,
-                NULL,
-                NULL
-            );
+    if ((store) && (m_FrameCache.getStorageMode() == DecodedFrameCache::StorageMode::Native)) {
+        m_FrameCache.pushBack(frame, pts);
+    }
+
+    if (converted) {
+        m_AverageConvertTime = (m_AverageConvertTime * 0.95) + (static_cast<double>(m_ConvertTime) * 0.05);
+        ++m_Counters.emittedFrames;
+        m_Counters.pts = pts;
+        if (store) {
+            ++m_DecodedEmissions;
+        }
+
+        publishCounters();
+    }
+
+    // the allocator had no memory for the frame (i.e. a pool exhausted by a late output device): the frame is
+    // dropped and counted as skipped, the next one is emitted whole since the device never got this one
+    if (!filled) {
+        m_ChangeDetector.reset();
+        publishCounters();
+        return true;
+    }
+
+    return converted;
+}
+
+bool FFMPEGDecoder::emitCachedFrame(const DecodedFrameCache::Entry& entry) noexcept {
+    if (entry.native != nullptr) {
+        return emitDecodedFrame(entry.native, entry.pts, false);
+    }
+
+    recordEmission(entry.pts);
+    m_SubtitleDecoder.show(entry.pts);
+
+    // converted frames only need to be copied
+    bool filled = false;
+    this->emitFrame(entry.pixelFormat, entry.width, entry.height, entry.pts, [&entry, &filled](void* frameMemory) {
+        filled = true;
+        std::memcpy(frameMemory, entry.pixels.data(), entry.pixels.size());
+    });
+
+    // as for decoded frames, a frame the allocator had no memory for is dropped
+    if (!filled) {
+        m_ChangeDetector.reset();
+        return true;
+    }
+
+    ++m_Counters.emittedFrames;
+    m_Counters.pts = entry.pts;
+    publishCounters();
+
+    return true;
+}
 
-            /**
-             * The process, again, is simple: av_read_frame() reads in a packet and
-             * stores it in the AVPacket struct. Note that we've only allocated the
-             * packet structure - ffmpeg allocates the internal data for us, which
-             * is pointed to by packet.data. This is freed by the av_free_packet()
-             * later. avcodec_decode_video() converts the packet to a frame for us.
-             * However, we might not have all the information we need for a frame
-             * after decoding a packet, so avcodec_decode_video() sets
-             * frameFinished for us when we have decoded enough packets the next
-             * frame.
-             * Finally, we use sws_scale() to convert from the native format
-             * (pCodecCtx->pix_fmt) to RGB. Remember that you can cast an AVFrame
-             * pointer to an AVPicture pointer. Finally, we pass the frame and
-             * height and width information to our SaveFrame function.
-             */
-
-            i = 0;
-            uint32_t frame_index = 0;
-
-            auto start = high_resolution_clock::now();
-            
-
-            while ((av_read_frame(pFormatCtx, pPacket) >= 0) && (!m_ShouldClose))  // [14]
-            {
-                // Is this a packet from the video stream?
-                if (pPacket->stream_index == videoStream)
-                {
-                    // Decode video frame
-                    // avcodec_decode_video2(pCodecCtx, pFrame, &frameFinished, &pPacket);
-                    // Deprecated: Use avcodec_send_packet() and avcodec_receive_frame().
-                    ret = avcodec_send_packet(pCodecCtx, pPacket);    // [15]
-                    if (ret < 0)
-                    {
-                        // could not send packet for decoding
-                        printf("Error sending packet for decoding.\n");
-
-                        // exit with eror
-                        return -1;
-                    }
-
-                    while (ret >= 0)
-                    {
-                        ret = avcodec_receive_frame(pCodecCtx, pFrame);   // [15]
-
-                        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
-                        {
-                            // EOF exit loop
-                            break;
-                        }
-                        else if (ret < 0)
-                        {
-                            // could not decode packet
-                            printf("Error while decoding.\n");
-
-                            // exit with error
-                            return -1;
-                        }
-
-                        // Convert the image from its native format to RGB
-                        sws_scale(  // [16]
-                            sws_ctx,
-                            (uint8_t const * const *)pFrame->data,
-                            pFrame->linesize,
-                            0,
-                            pCodecCtx->height,
-                            pFrameRGB->data,
-                            pFrameRGB->linesize
-                        );
-
-                        // send frame to FrameCollection
-                        this->emitFrame(Frame::PixelFormat::RGBA64, pCodecCtx->width, pCodecCtx->height, [&](void* frameMemory) {
-                            writeDataToFrameMemory(frameMemory, pFrameRGB, pCodecCtx->width, pCodecCtx->height, frame_index++);
-                        });
-                    }
-                }
-
-                // Free the packet that was allocated by av_read_frame
-                // [FFmpeg-cvslog] avpacket: Replace av_free_packet with
-                // av_packet_unref
-                // https://lists.ffmpeg.org/pipermail/ffmpeg-cvslog/2015-October/094920.html
-                av_packet_unref(pPacket);
+bool FFMPEGDecoder::refillFrameCache() noexcept {
+    if (m_FrameCache.getCount() == 0) {
+        return false;
+    }
+
+    const auto oldest = m_FrameCache.oldestTimestamp();
+    const auto newest = m_FrameCache.newestTimestamp();
+
+    // frames preceding the oldest cached one are decoded again starting from the keyframe before it
+    if (!seekBefore(oldest - 1)) {
+        return false;
+    }
+
+    // older frames are first collected as references, keeping only the ones closest to the cached window
+    DecodedFrameCache older(m_FrameCache.getBudget() - m_FrameCache.getResidentBytes());
+    while (receiveNextFrame()) {
+        const auto pts = FFMPEGCommon::presentationTimestamp(m_Frame, m_FormatCtx->streams[m_VideoStream]->time_base);
+        if (pts >= oldest) {
+            break;
+        }
+
+        older.pushBack(m_Frame, pts);
+    }
+
+    // the decoder is not positioned after the newest cached frame anymore
+    m_ResumeAfter = newest;
+
+    bool refilled = false;
+    for (auto entry = older.current(); entry != nullptr; entry = older.stepBackward()) {
+        if (m_FrameCache.getStorageMode() == DecodedFrameCache::StorageMode::Native) {
+            if (!m_FrameCache.pushFront(entry->native, entry->pts)) {
+                break;
+            }
+        } else {
+            void* cached = m_FrameCache.pushFrontConverted(m_OutputFormat, m_OutputWidth, m_OutputHeight, entry->pts);
+            if ((cached == nullptr) || (!convertFrame(entry->native, cached))) {
+                break;
             }
+        }
+
+        refilled = true;
+    }
+
+    return refilled;
+}
 
-            auto stop = high_resolution_clock::now();
+bool FFMPEGDecoder::jumpTo(Frame::TimestampType pts) noexcept {
+    if (auto entry = m_FrameCache.moveTo(pts)) {
+        return emitCachedFrame(*entry);
+    }
 
-            auto duration = duration_cast<seconds>(stop - start);
+    // outside of the cached window: seek and decode up to the target, caching frames on the way
+    m_FrameCache.clear();
+    m_ResumeAfter.reset();
 
-            std::cout << "Decoding frames and making them arrive at the framebuffer took " << duration.count() << "s" << std::endl;
+    if (!seekBefore(pts)) {
+        return false;
+    }
 
-            /**
-             * Cleanup.
-             */
+    const AVRational timeBase = m_FormatCtx->streams[m_VideoStream]->time_base;
+    while (receiveNextFrame()) {
+        const auto framePts = FFMPEGCommon::presentationTimestamp(m_Frame, timeBase);
+        if (framePts >= pts) {
+            return emitDecodedFrame(m_Frame, framePts, true);
+        }
+
+        // references are cheap: keep them to serve rewinds right after the jump
+        if (m_FrameCache.getStorageMode() == DecodedFrameCache::StorageMode::Native) {
+            m_FrameCache.pushBack(m_Frame, framePts);
+        }
+    }
 
-            // Free the RGB image
-            av_free(buffer);
-            av_frame_free(&pFrameRGB);
-            av_free(pFrameRGB);
+    return false;
+}
 
-            // Free the YUV frame
-            av_frame_free(&pFrame);
-            av_free(pFrame);
+void FFMPEGDecoder::applyRate(double rate) noexcept {
+    // above the trick play threshold the decoder itself discards every non-key frame
+    const bool keyframesOnly = rate >= KeyframesOnlyRate;
+    if (keyframesOnly != m_KeyframesOnly) {
+        m_KeyframesOnly = keyframesOnly;
+        m_CodecCtx->skip_frame = keyframesOnly ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+    }
+}
 
-            // Close the codecs
-            avcodec_close(pCodecCtx);
-            avcodec_close(pCodecCtxOrig);
+bool FFMPEGDecoder::takeCommand(PlaybackCommand& command, bool wait) noexcept {
+    std::unique_lock<std::mutex> lk(m_ControlMutex);
 
-            // Close the video file
-            avformat_close_input(&pFormatCtx);
+    // a paused decoder sleeps here, keeping every resource ready, until a command arrives
+    if (wait) {
+        m_ControlCV.wait(lk, [this]() {
+            return (m_ShouldClose) || (!m_Paused) || (m_PendingSteps != 0) || (m_PendingSeek.has_value());
+        });
+    }
 
-            m_ShouldClose = false;
-        })
-    );
-}
\ No newline at end of file
+    command.step = 0;
+    command.seekTarget.reset();
+    command.seekTarget.swap(m_PendingSeek);
+
+    if (command.seekTarget.has_value()) {
+        // a seek is served before steps
+    } else if (m_PendingSteps > 0) {
+        command.step = 1;
+        --m_PendingSteps;
+    } else if (m_PendingSteps < 0) {
+        command.step = -1;
+        ++m_PendingSteps;
+    }
+
+    command.rate = m_Rate;
+    command.loop = m_Loop;
+
+    return !m_ShouldClose;
+}
+
+bool FFMPEGDecoder::playbackStep(PlaybackCommand& command) noexcept {
+    const int32_t step = command.step;
+    const double rate = command.rate;
+    auto& seekTarget = command.seekTarget;
+    const auto& loop = command.loop;
+
+    // stepping and seeking show every single frame
+    applyRate(((step == 0) && (!seekTarget.has_value())) ? rate : 1.0);
+
+    // the end of an A-B loop (as well as a seek) jumps to the target frame, served from the cache when possible
+    if ((!seekTarget.has_value()) && (step == 0) && (loop.has_value()) && (m_LastEmitted >= loop->second)) {
+        seekTarget = loop->first;
+    }
+
+    // frames emitted without being compared break the chain of changed regions
+    if ((seekTarget.has_value()) || (step < 0) || (!m_FrameCache.isAtNewest())) {
+        m_ChangeDetector.reset();
+    }
+
+    // a rendition prepared ahead of the playback is of no use once the playback moves elsewhere
+    if ((seekTarget.has_value()) || (step < 0)) {
+        m_RenditionLoader.cancel();
+
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        m_RenditionSwitching = false;
+    }
+
+    if (seekTarget.has_value()) {
+        if (jumpTo(seekTarget.value())) {
+            // the cache (when enabled) holds the frame just emitted
+            const auto shown = m_FrameCache.current();
+            m_LastEmitted = (shown != nullptr) ? shown->pts : seekTarget.value();
+        }
+
+        return true;
+    }
+
+    if (step < 0) {
+        auto previous = m_FrameCache.stepBackward();
+        if ((previous == nullptr) && (refillFrameCache())) {
+            previous = m_FrameCache.stepBackward();
+        }
+
+        if (previous != nullptr) {
+            m_LastEmitted = previous->pts;
+            emitCachedFrame(*previous);
+        }
+
+        return true;
+    }
+
+    // after rewinding frames already decoded are shown again before decoding new ones
+    if (!m_FrameCache.isAtNewest()) {
+        auto next = m_FrameCache.stepForward();
+        m_LastEmitted = next->pts;
+        emitCachedFrame(*next);
+        return true;
+    }
+
+    const Frame::TimestampType decodeStart = monotonicTime();
+
+    if (!decodeNextFrame()) {
+        // at the end of the stream only stepping backward is still possible
+        return step != 0;
+    }
+
+    m_DecodeTime = monotonicTime() - decodeStart;
+    m_AverageDecodeTime = (m_AverageDecodeTime * 0.95) + (static_cast<double>(m_DecodeTime) * 0.05);
+    publishCounters();
+
+    // presentation timestamp in microseconds
+    Frame::TimestampType pts = FFMPEGCommon::presentationTimestamp(m_Frame, m_FormatCtx->streams[m_VideoStream]->time_base);
+
+    // the frame can be replaced by the first keyframe of another rendition
+    if ((!m_Renditions.empty()) && (step == 0)) {
+        pts = adaptRendition(pts);
+    } else if ((m_ProxyWatch) && (step == 0)) {
+        watchProxyLoad();
+    }
+
+    // above normal speed a frame is shown only if it would last at least half of its nominal duration
+    if ((step == 0) && (rate > 1.0) && (!m_KeyframesOnly) && (m_LastEmitted != std::numeric_limits<Frame::TimestampType>::min())) {
+        const auto mediaAdvance = static_cast<double>(pts - m_LastEmitted);
+        if (mediaAdvance < (rate - 0.5) * static_cast<double>(m_FrameDuration)) {
+            return true;
+        }
+    }
+
+    // frames between two strides are only decoded
+    if ((step == 0) && (m_EmitStride > 1) && ((m_StrideFrames++ % m_EmitStride) != 0)) {
+        m_LastEmitted = pts;
+        return true;
+    }
+
+    // live frames wait for their playout time, unless they are already too late to be shown
+    if ((m_LiveOptions.has_value()) && (step == 0) && (!waitLivePlayout(pts))) {
+        return true;
+    }
+
+    // static content: an unchanged frame is neither converted nor presented, the output device keeps showing the previous one,
+    // unless layers composited onto it (subtitles, tickers, logos) changed
+    std::optional<Frame::Rect> dirtyRect;
+    if (m_DetectChanges) {
+        dirtyRect = m_ChangeDetector.compare(m_Frame);
+        if ((!dirtyRect.has_value()) && (step == 0)) {
+            // the subtitle cue of this frame is a layer change too
+            m_SubtitleDecoder.show(pts);
+
+            const auto& compositor = this->getCompositor();
+            if ((!compositor) || (!compositor->hasPendingChanges())) {
+                m_LastEmitted = pts;
+                return true;
+            }
+        }
+
+        if (!dirtyRect.has_value()) {
+            dirtyRect = Frame::Rect{ 0, 0, 0, 0 };
+        }
+    }
+
+    if (!emitDecodedFrame(m_Frame, pts, true, dirtyRect)) {
+        return false;
+    }
+
+    if (m_LiveOptions.has_value()) {
+        recordLiveLatency(pts);
+    }
+
+    m_LastEmitted = pts;
+    return true;
+}
+
+bool FFMPEGDecoder::waitLivePlayout(Frame::TimestampType pts) noexcept {
+    m_LiveArrival = av_gettime_relative();
+
+    const auto playout = m_LivePlayout.schedule(pts, m_LiveArrival);
+    if (m_LivePlayout.isBehindLiveEdge(playout, m_LiveArrival)) {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        ++m_LiveStatistics.droppedFrames;
+        return false;
+    }
+
+    // the jitter buffer: the frame waits here while later packets keep arriving in the input buffer
+    std::unique_lock<std::mutex> lk(m_ControlMutex);
+    m_ControlCV.wait_for(lk, microseconds(std::max<Frame::TimestampType>(playout - m_LiveArrival, 0)), [this]() {
+        return m_ShouldClose.load();
+    });
+
+    return !m_ShouldClose;
+}
+
+void FFMPEGDecoder::recordLiveLatency(Frame::TimestampType pts) noexcept {
+    std::optional<Frame::TimestampType> glassToGlass;
+
+    // the capture time is known only when the sender relates timestamps to its wall clock
+    if (m_FormatCtx->start_time_realtime != AV_NOPTS_VALUE) {
+        const auto startTime = (m_FormatCtx->start_time != AV_NOPTS_VALUE) ? m_FormatCtx->start_time : 0;
+        glassToGlass = av_gettime() - (m_FormatCtx->start_time_realtime + (pts - startTime));
+    }
+
+    std::lock_guard<std::mutex> guard(m_ControlMutex);
+    m_LiveStatistics.glassToGlassLatency = glassToGlass;
+    m_LiveStatistics.receiveToPresentLatency = av_gettime_relative() - m_LiveArrival;
+    m_LiveStatistics.playoutDelay = m_LivePlayout.getPlayoutDelay();
+    m_LiveStatistics.jitter = m_LivePlayout.getJitter();
+}
+
+void FFMPEGDecoder::playbackLoop() noexcept {
+    if (!openFile()) {
+        closeFile();
+        return;
+    }
+
+    auto start = high_resolution_clock::now();
+
+    PlaybackCommand command;
+    while (true) {
+        pace();
+
+        if ((!takeCommand(command, true)) || (!playbackStep(command))) {
+            break;
+        }
+    }
+
+    auto stop = high_resolution_clock::now();
+
+    auto duration = duration_cast<seconds>(stop - start);
+
+    std::cout << "Decoding frames and making them arrive at the framebuffer took " << duration.count() << "s" << std::endl;
+
+    closeFile();
+}
+
+std::optional<Frame> FFMPEGDecoder::nextFrame() noexcept {
+    // frames are either pulled or pushed by the playback thread, never both
+    if ((m_Running) || (m_PullExhausted)) {
+        return std::nullopt;
+    }
+
+    if (m_FormatCtx == NULL) {
+        m_ShouldClose = false;
+
+        if (!openFile()) {
+            closeFile();
+            m_PullExhausted = true;
+            return std::nullopt;
+        }
+    }
+
+    // the same steps of the playback thread run on the calling thread, with frames captured instead of enqueued
+    std::optional<Frame> frame;
+    setPullTarget(&frame);
+
+    PlaybackCommand command;
+    while (!frame.has_value()) {
+        takeCommand(command, false);
+
+        // pulling never pauses: a stepping command only decides the direction of the next frame
+        command.rate = 1.0;
+
+        if (!playbackStep(command)) {
+            closeFile();
+            m_PullExhausted = true;
+            break;
+        }
+    }
+
+    setPullTarget(nullptr);
+
+    return frame;
+}
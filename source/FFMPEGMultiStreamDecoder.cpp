@@ -0,0 +1,322 @@
+#include "FFMPEGMultiStreamDecoder.h"
+
+#include "FFMPEGCommon.h"
+
+FFMPEGMultiStreamDecoder::FFMPEGMultiStreamDecoder(
+    BufferedFrameOutputDevice* const outputDev,
+    FrameAllocator* allocator
+) noexcept
+    : Decoder(
+        outputDev,
+        allocator
+    ),
+    m_ShouldClose(false) {
+
+    }
+
+FFMPEGMultiStreamDecoder::~FFMPEGMultiStreamDecoder() {
+    stop();
+    join();
+}
+
+void FFMPEGMultiStreamDecoder::setStreamOutputDevice(uint32_t videoStream, BufferedFrameOutputDevice* outputDev) noexcept {
+    m_StreamDevices[videoStream] = outputDev;
+}
+
+void FFMPEGMultiStreamDecoder::loadFile(const Decoder::FileNameType& filename) noexcept {
+    stop();
+    join();
+
+    m_LoadedFilename = filename;
+}
+
+void FFMPEGMultiStreamDecoder::play() noexcept {
+    join();
+
+    m_ShouldClose = false;
+
+    m_DemuxThread.reset(
+        new std::thread([this]() {
+            demux();
+        })
+    );
+}
+
+void FFMPEGMultiStreamDecoder::stop() noexcept {
+    m_ShouldClose = true;
+    notifyStreams();
+}
+
+void FFMPEGMultiStreamDecoder::join() noexcept {
+    if ((m_DemuxThread) && (m_DemuxThread->joinable())) {
+        m_DemuxThread->join();
+    }
+
+    m_DemuxThread.reset();
+}
+
+void FFMPEGMultiStreamDecoder::notifyStreams() noexcept {
+    std::lock_guard<std::mutex> guard(m_StreamsMutex);
+    for (auto& stream : m_Streams) {
+        // taking the lock makes sure no thread is between the predicate check and the wait
+        std::lock_guard<std::mutex> streamGuard(stream->mutex);
+        stream->changed.notify_all();
+    }
+}
+
+void FFMPEGMultiStreamDecoder::demux() noexcept {
+    if (!m_LoadedFilename.has_value()) {
+        std::cerr << "No file loaded" << std::endl;
+        return;
+    }
+
+    const char* filename = m_LoadedFilename->c_str();
+
+    AVFormatContext* pFormatCtx = NULL;
+    if (avformat_open_input(&pFormatCtx, filename, NULL, NULL) < 0) {
+        std::cerr << "Could not open file " << filename << std::endl;
+        return;
+    }
+
+    if (avformat_find_stream_info(pFormatCtx, NULL) < 0) {
+        std::cerr << "Could not find stream information " << filename << std::endl;
+        avformat_close_input(&pFormatCtx);
+        return;
+    }
+
+    // the stream decoder of every file stream (nullptr for streams that are not decoded)
+    std::vector<StreamDecoder*> routes(pFormatCtx->nb_streams, nullptr);
+
+    uint32_t ordinal = 0;
+    for (unsigned int i = 0; i < pFormatCtx->nb_streams; ++i) {
+        AVStream* pStream = pFormatCtx->streams[i];
+
+        // the demuxer skips every stream nobody is interested in
+        pStream->discard = AVDISCARD_ALL;
+
+        if (pStream->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
+            continue;
+        }
+
+        const uint32_t videoOrdinal = ordinal++;
+
+        auto assigned = m_StreamDevices.find(videoOrdinal);
+        BufferedFrameOutputDevice* device = (assigned != m_StreamDevices.end()) ? assigned->second :
+            ((videoOrdinal == 0) ? this->getOutputDevice() : nullptr);
+        if (device == nullptr) {
+            continue;
+        }
+
+        const AVCodec* pCodec = avcodec_find_decoder(pStream->codecpar->codec_id);
+        if (pCodec == nullptr) {
+            std::cerr << "Unsupported codec for video stream " << videoOrdinal << " of " << filename << std::endl;
+            continue;
+        }
+
+        AVCodecContext* pCodecCtx = avcodec_alloc_context3(pCodec);
+        if ((pCodecCtx == NULL) || (avcodec_parameters_to_context(pCodecCtx, pStream->codecpar) < 0)) {
+            std::cerr << "Could not copy codec context for video stream " << videoOrdinal << " of " << filename << std::endl;
+            avcodec_free_context(&pCodecCtx);
+            continue;
+        }
+
+        // let the decoder produce frames close to the size wanted by the output device of this stream
+        const auto outputSize = FFMPEGCommon::fitInside(
+            pCodecCtx->width,
+            pCodecCtx->height,
+            device->getPreferredWidth(),
+            device->getPreferredHeight()
+        );
+        pCodecCtx->lowres = FFMPEGCommon::lowresFactor(pCodec, pCodecCtx->width, pCodecCtx->height, outputSize.first, outputSize.second);
+
+        if (avcodec_open2(pCodecCtx, pCodec, NULL) < 0) {
+            std::cerr << "Could not open codec for video stream " << videoOrdinal << " of " << filename << std::endl;
+            avcodec_free_context(&pCodecCtx);
+            continue;
+        }
+
+        pStream->discard = AVDISCARD_DEFAULT;
+
+        std::unique_ptr<StreamDecoder> stream(new StreamDecoder());
+        stream->ordinal = videoOrdinal;
+        stream->stream = pStream;
+        stream->device = device;
+        stream->codecCtx = pCodecCtx;
+        stream->dead = false;
+
+        routes[i] = stream.get();
+
+        std::lock_guard<std::mutex> guard(m_StreamsMutex);
+        m_Streams.push_back(std::move(stream));
+    }
+
+    for (auto& stream : m_Streams) {
+        StreamDecoder* decoder = stream.get();
+        decoder->thread = std::thread([this, decoder]() {
+            decodeStream(*decoder);
+        });
+    }
+
+    AVPacket* pPacket = av_packet_alloc();
+
+    // read the file once, routing every packet to the stream decoder it belongs to
+    while ((!m_ShouldClose) && (pPacket != NULL) && (av_read_frame(pFormatCtx, pPacket) >= 0)) {
+        StreamDecoder* stream = routes[pPacket->stream_index];
+
+        AVPacket* routed = (stream != nullptr) ? av_packet_alloc() : NULL;
+        if (routed == NULL) {
+            av_packet_unref(pPacket);
+            continue;
+        }
+
+        av_packet_move_ref(routed, pPacket);
+
+        bool dead = false;
+        {
+            std::unique_lock<std::mutex> lk(stream->mutex);
+            stream->changed.wait(lk, [this, stream]() {
+                return (m_ShouldClose) || (stream->dead) || (stream->packets.size() < PacketQueueSize);
+            });
+
+            dead = stream->dead;
+            if (!dead) {
+                stream->packets.push_back(routed);
+            }
+        }
+
+        if (dead) {
+            // nobody would ever take packets of this stream: the demuxer stops reading them
+            routes[routed->stream_index] = nullptr;
+            stream->stream->discard = AVDISCARD_ALL;
+            av_packet_free(&routed);
+            continue;
+        }
+
+        stream->changed.notify_all();
+    }
+
+    av_packet_free(&pPacket);
+
+    // mark the end of every stream so that decoders drain frames still buffered inside them
+    for (auto& stream : m_Streams) {
+        {
+            std::lock_guard<std::mutex> guard(stream->mutex);
+            stream->packets.push_back(nullptr);
+        }
+
+        stream->changed.notify_all();
+    }
+
+    for (auto& stream : m_Streams) {
+        if (stream->thread.joinable()) {
+            stream->thread.join();
+        }
+
+        for (auto& packet : stream->packets) {
+            av_packet_free(&packet);
+        }
+
+        avcodec_free_context(&stream->codecCtx);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_StreamsMutex);
+        m_Streams.clear();
+    }
+
+    avformat_close_input(&pFormatCtx);
+}
+
+void FFMPEGMultiStreamDecoder::decodeStream(StreamDecoder& stream) noexcept {
+    AVFrame* pFrame = av_frame_alloc();
+    struct SwsContext* sws_ctx = NULL;
+
+    const auto outputFormat = stream.device->getPreferredPixelFormat();
+    const auto swsFlags = FFMPEGCommon::toSwsFlags(this->getScalingFilter());
+
+    bool finished = (pFrame == NULL);
+    while (!finished) {
+        AVPacket* pPacket = NULL;
+
+        {
+            std::unique_lock<std::mutex> lk(stream.mutex);
+            stream.changed.wait(lk, [this, &stream]() {
+                return (m_ShouldClose) || (!stream.packets.empty());
+            });
+
+            if ((m_ShouldClose) || (stream.packets.empty())) {
+                break;
+            }
+
+            pPacket = stream.packets.front();
+            stream.packets.pop_front();
+        }
+
+        // room has been made for the demuxer
+        stream.changed.notify_all();
+
+        // a null packet puts the decoder in draining mode
+        finished = (pPacket == NULL);
+        int ret = avcodec_send_packet(stream.codecCtx, pPacket);
+        av_packet_free(&pPacket);
+
+        if ((ret < 0) && (ret != AVERROR_EOF)) {
+            continue;
+        }
+
+        while ((!m_ShouldClose) && (avcodec_receive_frame(stream.codecCtx, pFrame) >= 0)) {
+            const auto pts = FFMPEGCommon::presentationTimestamp(pFrame, stream.stream->time_base);
+            const auto size = FFMPEGCommon::fitInside(
+                pFrame->width,
+                pFrame->height,
+                stream.device->getPreferredWidth(),
+                stream.device->getPreferredHeight()
+            );
+
+            sws_ctx = sws_getCachedContext(
+                sws_ctx,
+                pFrame->width,
+                pFrame->height,
+                static_cast<AVPixelFormat>(pFrame->format),
+                size.first,
+                size.second,
+                FFMPEGCommon::toAVPixelFormat(outputFormat),
+                swsFlags,
+                NULL,
+                NULL,
+                NULL
+            );
+
+            if (sws_ctx == NULL) {
+                std::cerr << "Could not create the scaling context for video stream " << stream.ordinal << std::endl;
+                finished = true;
+                break;
+            }
+
+            this->emitFrameTo(stream.device, outputFormat, size.first, size.second, pts, [&](void* frameMemory) {
+                uint8_t* dst[4];
+                int dstStride[4];
+                FFMPEGCommon::framePlanes(outputFormat, frameMemory, size.first, size.second, dst, dstStride);
+
+                sws_scale(sws_ctx, (uint8_t const * const *)pFrame->data, pFrame->linesize, 0, pFrame->height, dst, dstStride);
+            }, stream.ordinal);
+        }
+    }
+
+    sws_freeContext(sws_ctx);
+    av_frame_free(&pFrame);
+
+    // the demuxer may be waiting for room in the queue: it must not wait for this thread anymore
+    {
+        std::lock_guard<std::mutex> guard(stream.mutex);
+        stream.dead = true;
+
+        for (auto& packet : stream.packets) {
+            av_packet_free(&packet);
+        }
+
+        stream.packets.clear();
+    }
+
+    stream.changed.notify_all();
+}
@@ -0,0 +1,242 @@
+#include "FFMPEGThumbnailDecoder.h"
+
+#include "FFMPEGCommon.h"
+
+FFMPEGThumbnailDecoder::FFMPEGThumbnailDecoder(
+    BufferedFrameOutputDevice* const outputDev,
+    FrameAllocator* allocator,
+    Frame::TimestampType interval,
+    uint32_t maxWidth,
+    uint32_t maxHeight,
+    uint32_t maxConcurrentFiles
+) noexcept
+    : Decoder(
+        outputDev,
+        allocator
+    ),
+    m_Interval(std::max<Frame::TimestampType>(interval, 1)),
+    m_MaxWidth(maxWidth),
+    m_MaxHeight(maxHeight),
+    m_MaxConcurrentFiles((maxConcurrentFiles == 0) ? std::max(std::thread::hardware_concurrency(), 1u) : maxConcurrentFiles),
+    m_NextFile(0),
+    m_RunningWorkers(0),
+    m_ShouldClose(false) {
+
+    }
+
+FFMPEGThumbnailDecoder::~FFMPEGThumbnailDecoder() {
+    stop();
+    join();
+}
+
+void FFMPEGThumbnailDecoder::loadFile(const Decoder::FileNameType& filename) noexcept {
+    if (!isFinished()) {
+        std::cerr << "Cannot add " << filename << " while thumbnails are being extracted" << std::endl;
+        return;
+    }
+
+    m_Files.push_back(filename);
+}
+
+void FFMPEGThumbnailDecoder::play() noexcept {
+    join();
+
+    m_ShouldClose = false;
+    m_NextFile = 0;
+
+    const auto workersCount = std::min<size_t>(m_MaxConcurrentFiles, m_Files.size());
+    m_RunningWorkers = static_cast<uint32_t>(workersCount);
+
+    for (size_t w = 0; w < workersCount; ++w) {
+        m_Workers.emplace_back([this]() {
+            uint32_t index;
+            while ((!m_ShouldClose) && ((index = m_NextFile++) < m_Files.size())) {
+                extractThumbnails(index);
+            }
+
+            --m_RunningWorkers;
+        });
+    }
+}
+
+void FFMPEGThumbnailDecoder::stop() noexcept {
+    m_ShouldClose = true;
+}
+
+bool FFMPEGThumbnailDecoder::isFinished() const noexcept {
+    return m_RunningWorkers == 0;
+}
+
+void FFMPEGThumbnailDecoder::join() noexcept {
+    for (auto& worker : m_Workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    m_Workers.clear();
+}
+
+void FFMPEGThumbnailDecoder::extractThumbnails(Frame::SourceIndexType sourceIndex) noexcept {
+    const auto& filename = m_Files[sourceIndex];
+
+    AVFormatContext* pFormatCtx = NULL;
+    if (avformat_open_input(&pFormatCtx, filename.c_str(), NULL, NULL) < 0) {
+        std::cerr << "Could not open file " << filename << std::endl;
+        return;
+    }
+
+    if (avformat_find_stream_info(pFormatCtx, NULL) < 0) {
+        std::cerr << "Could not find stream information " << filename << std::endl;
+        avformat_close_input(&pFormatCtx);
+        return;
+    }
+
+    const AVCodec* pCodec = nullptr;
+    const int videoStream = av_find_best_stream(pFormatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, &pCodec, 0);
+    if ((videoStream < 0) || (pCodec == nullptr)) {
+        std::cerr << "No decodable video stream in " << filename << std::endl;
+        avformat_close_input(&pFormatCtx);
+        return;
+    }
+
+    // only packets of the selected stream are needed: let the demuxer skip everything else
+    for (unsigned int i = 0; i < pFormatCtx->nb_streams; ++i) {
+        if (static_cast<int>(i) != videoStream) {
+            pFormatCtx->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    AVStream* pStream = pFormatCtx->streams[videoStream];
+
+    AVCodecContext* pCodecCtx = avcodec_alloc_context3(pCodec);
+    if ((pCodecCtx == NULL) || (avcodec_parameters_to_context(pCodecCtx, pStream->codecpar) < 0)) {
+        std::cerr << "Could not copy codec context for " << filename << std::endl;
+        avcodec_free_context(&pCodecCtx);
+        avformat_close_input(&pFormatCtx);
+        return;
+    }
+
+    // the decoder drops every non-key frame and, as parallelism comes from decoding many files, uses one thread
+    pCodecCtx->skip_frame = AVDISCARD_NONKEY;
+    pCodecCtx->thread_count = 1;
+
+    if (avcodec_open2(pCodecCtx, pCodec, NULL) < 0) {
+        std::cerr << "Could not open codec for " << filename << std::endl;
+        avcodec_free_context(&pCodecCtx);
+        avformat_close_input(&pFormatCtx);
+        return;
+    }
+
+    AVFrame* pFrame = av_frame_alloc();
+    AVPacket* pPacket = av_packet_alloc();
+    if ((pFrame == NULL) || (pPacket == NULL)) {
+        std::cerr << "Could not allocate the frame and packet to decode " << filename << std::endl;
+        av_packet_free(&pPacket);
+        av_frame_free(&pFrame);
+        avcodec_free_context(&pCodecCtx);
+        avformat_close_input(&pFormatCtx);
+        return;
+    }
+
+    struct SwsContext* sws_ctx = NULL;
+
+    const auto outputFormat = this->getOutputDevice()->getPreferredPixelFormat();
+
+    const Frame::TimestampType startTime = (pStream->start_time == AV_NOPTS_VALUE) ? 0 :
+        av_rescale_q(pStream->start_time, pStream->time_base, AV_TIME_BASE_Q);
+
+    Frame::TimestampType target = startTime;
+    Frame::TimestampType lastEmitted = std::numeric_limits<Frame::TimestampType>::min();
+    bool seekable = true;
+
+    // decode the first keyframe that was not already emitted (and, when seeking is not possible, that reaches the target)
+    auto decodeNextKeyframe = [&]() -> bool {
+        auto accept = [&]() -> bool {
+            const auto pts = FFMPEGCommon::presentationTimestamp(pFrame, pStream->time_base);
+            return (pts > lastEmitted) && (seekable || (pts >= target));
+        };
+
+        while ((!m_ShouldClose) && (av_read_frame(pFormatCtx, pPacket) >= 0)) {
+            // skipping non-key packets here avoids even sending them to the decoder
+            const bool isKey = (pPacket->stream_index == videoStream) && ((pPacket->flags & AV_PKT_FLAG_KEY) != 0);
+            int ret = isKey ? avcodec_send_packet(pCodecCtx, pPacket) : AVERROR(EAGAIN);
+            av_packet_unref(pPacket);
+
+            while (ret >= 0) {
+                ret = avcodec_receive_frame(pCodecCtx, pFrame);
+                if ((ret >= 0) && accept()) {
+                    return true;
+                }
+            }
+        }
+
+        // drain frames buffered inside the decoder
+        avcodec_send_packet(pCodecCtx, NULL);
+        while (avcodec_receive_frame(pCodecCtx, pFrame) >= 0) {
+            if (accept()) {
+                return true;
+            }
+        }
+
+        return false;
+    };
+
+    while (!m_ShouldClose) {
+        if (seekable) {
+            const int64_t ts = av_rescale_q(target, AV_TIME_BASE_Q, pStream->time_base);
+            if (av_seek_frame(pFormatCtx, videoStream, ts, AVSEEK_FLAG_BACKWARD) >= 0) {
+                avcodec_flush_buffers(pCodecCtx);
+            } else if (target == startTime) {
+                // not seekable (e.g. a pipe): keep reading keyframes sequentially
+                seekable = false;
+            } else {
+                break;
+            }
+        }
+
+        if (!decodeNextKeyframe()) {
+            break;
+        }
+
+        const auto pts = FFMPEGCommon::presentationTimestamp(pFrame, pStream->time_base);
+        const auto size = FFMPEGCommon::fitInside(pFrame->width, pFrame->height, m_MaxWidth, m_MaxHeight);
+
+        // conversion and downscale happen in one pass, straight into the frame memory
+        sws_ctx = sws_getCachedContext(
+            sws_ctx,
+            pFrame->width,
+            pFrame->height,
+            static_cast<AVPixelFormat>(pFrame->format),
+            size.first,
+            size.second,
+            FFMPEGCommon::toAVPixelFormat(outputFormat),
+            SWS_AREA,
+            NULL,
+            NULL,
+            NULL
+        );
+
+        if (sws_ctx == NULL) {
+            std::cerr << "Could not create the scaling context for " << filename << std::endl;
+            break;
+        }
+
+        this->emitFrame(outputFormat, size.first, size.second, pts, [&](void* frameMemory) {
+            uint8_t* dst[4];
+            int dstStride[4];
+            FFMPEGCommon::framePlanes(outputFormat, frameMemory, size.first, size.second, dst, dstStride);
+
+            sws_scale(sws_ctx, (uint8_t const * const *)pFrame->data, pFrame->linesize, 0, pFrame->height, dst, dstStride);
+        }, sourceIndex);
+
+        lastEmitted = pts;
+        target = std::max(target, pts) + m_Interval;
+    }
+
+    sws_freeContext(sws_ctx);
+    av_packet_free(&pPacket);
+    av_frame_free(&pFrame);
+    avcodec_free_context(&pCodecCtx);
+    avformat_close_input(&pFormatCtx);
+}
@@ -1,29 +1,152 @@
 #include "FakeBufferedFrameOutputDevice.h"
 
 FakeBufferedFrameOutputDevice::FakeBufferedFrameOutputDevice(BufferedFrameOutputDevice::FrameCountType frameCount) noexcept
- : BufferedFrameOutputDevice(frameCount) {
-
+ : BufferedFrameOutputDevice(frameCount),
+ m_Frames(std::max<BufferedFrameOutputDevice::FrameCountType>(frameCount, 1)),
+ m_Head(0),
+ m_Count(0),
+ m_ShouldStop(false),
+ m_PresentedFrames(0),
+ m_AnchorRate(0.0),
+ m_Lateness(0) {
+    setQueuedFrames(0);
 }
 
 FakeBufferedFrameOutputDevice::~FakeBufferedFrameOutputDevice() {
-
+    interrupt();
 }
 
 void FakeBufferedFrameOutputDevice::enqueueFrame(Frame&& frame) noexcept {
-    //std::cout << "Frame enqueued, width: " << frame.getWidth() << ", height: " << frame.getHeight() << "";
+    bool wasEmpty = false;
+
+    {
+        std::unique_lock<std::mutex> lk(m_QueueMutex);
+        m_SlotFreed.wait(lk, [this]() {
+            return (m_ShouldStop) || (m_Count < m_Frames.size());
+        });
+
+        if (m_ShouldStop) {
+            return;
+        }
+
+        wasEmpty = (m_Count == 0);
+
+        m_Frames[(m_Head + m_Count) % m_Frames.size()].emplace(std::move(frame));
+        ++m_Count;
+
+        setQueuedFrames(static_cast<FrameCountType>(m_Count));
+    }
+
+    if (wasEmpty) {
+        m_FrameQueued.notify_one();
+    }
+}
+
+bool FakeBufferedFrameOutputDevice::waitPresentationTime(const Frame& frame) noexcept {
+    const double rate = getClockRate();
+    const auto now = std::chrono::steady_clock::now();
+    const auto pts = frame.getPresentationTimestamp();
+
+    m_Lateness = 0;
 
-    this->m_Frames.push_back(std::move(frame));
+    // a stopped clock consumes frames as soon as they come; the clock is anchored again on rate changes and discontinuities
+    if ((rate <= 0.0) || (!m_Anchor.has_value()) || (rate != m_AnchorRate) || (pts < m_Anchor->first)) {
+        m_Anchor = std::make_pair(pts, now);
+        m_AnchorRate = rate;
+        return !m_ShouldStop;
+    }
+
+    const auto elapsed = std::chrono::microseconds(static_cast<int64_t>(static_cast<double>(pts - m_Anchor->first) / rate));
+    const auto due = m_Anchor->second + elapsed;
 
+    if ((due - now) > std::chrono::seconds(1)) {
+        m_Anchor = std::make_pair(pts, now);
+        return !m_ShouldStop;
+    }
+
+    std::unique_lock<std::mutex> lk(m_QueueMutex);
+    const bool interrupted = m_Stopped.wait_until(lk, due, [this]() {
+        return m_ShouldStop.load();
+    });
+
+    m_Lateness = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - due).count();
+    return !interrupted;
 }
 
 void FakeBufferedFrameOutputDevice::exec() noexcept {
-    while (true) {
-        auto possibly_frame = m_Frames.pop_front();
-        if (possibly_frame.has_value()) {
-            //std::cout << "got a frame!" << std::endl;
-        } else {
-            //std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    while (!m_ShouldStop) {
+        std::optional<Frame> frame;
+
+        {
+            std::unique_lock<std::mutex> lk(m_QueueMutex);
+            m_FrameQueued.wait(lk, [this]() {
+                return (m_ShouldStop) || (m_Count > 0);
+            });
+
+            if (m_ShouldStop) {
+                break;
+            }
+
+            frame.swap(m_Frames[m_Head]);
         }
 
+        // the frame stays queued (and counted) until it is due
+        if (!getPresentationClock()) {
+            if (!waitPresentationTime(frame.value())) {
+                break;
+            }
+        } else if (!waitSharedPresentationTime(frame.value(), m_QueueMutex, m_Stopped, m_ShouldStop, m_Lateness)) {
+            break;
+        }
+
+        bool wasFull = false;
+        bool superseded = false;
+
+        {
+            std::lock_guard<std::mutex> guard(m_QueueMutex);
+            wasFull = (m_Count == m_Frames.size());
+
+            m_Head = (m_Head + 1) % m_Frames.size();
+            --m_Count;
+
+            setQueuedFrames(static_cast<FrameCountType>(m_Count));
+
+            // as other devices following the shared clock, a late device skips to the newest due frame
+            superseded = (getPresentationClock()) && (m_Count > 0) && (isDueOnPresentationClock(m_Frames[m_Head].value()));
+        }
+
+        if (wasFull) {
+            m_SlotFreed.notify_one();
+        }
+
+        if (superseded) {
+            reportDroppedFrames(1);
+            continue;
+        }
+
+        ++m_PresentedFrames;
+        reportPresentedFrame(frame.value(), m_Lateness);
+
+        // the frame memory goes back to its allocator here
+        frame.reset();
+    }
+}
+
+void FakeBufferedFrameOutputDevice::interrupt() noexcept {
+    {
+        std::lock_guard<std::mutex> guard(m_QueueMutex);
+        m_ShouldStop = true;
     }
-}
\ No newline at end of file
+
+    m_FrameQueued.notify_all();
+    m_SlotFreed.notify_all();
+    m_Stopped.notify_all();
+}
+
+bool FakeBufferedFrameOutputDevice::isFollowingPresentationClocks() const noexcept {
+    return true;
+}
+
+uint64_t FakeBufferedFrameOutputDevice::getPresentedFrames() const noexcept {
+    return m_PresentedFrames;
+}
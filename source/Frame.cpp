@@ -1,23 +1,50 @@
 #include "Frame.h"
 
-static const Frame::DeallocatorFunctionType defaultDeallocFn = [](void*) {};
+#include <type_traits>
+
+// frames are moved several times on their way to the screen: a move must never allocate nor throw
+static_assert(std::is_nothrow_move_constructible_v<Frame>);
+static_assert(std::is_nothrow_move_assignable_v<Frame>);
+static_assert(sizeof(Frame) <= 64);
 
 size_t Frame::getPixelSizeInBytes(PixelFormat pf) noexcept {
     switch (pf) {
         case Frame::PixelFormat::RGBA64:
             return sizeof(uint16_t) * 4;
+
+        case Frame::PixelFormat::RGBA32:
+            return sizeof(uint8_t) * 4;
+
+        case Frame::PixelFormat::NV12:
+            return sizeof(uint8_t);
     }
 
     // this MUST NOT happend
     return 0;
 }
 
+size_t Frame::getFrameSizeInBytes(PixelFormat pf, uint32_t width, uint32_t height) noexcept {
+    const size_t pixels = static_cast<size_t>(width) * height;
+
+    if (pf == Frame::PixelFormat::NV12) {
+        // chroma planes are rounded up for odd sizes, as ffmpeg does
+        const size_t chroma = static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+        return pixels + (chroma * 2);
+    }
+
+    return getPixelSizeInBytes(pf) * pixels;
+}
+
 Frame::Frame(PixelFormat pf, uint32_t width, uint32_t height) noexcept
  : m_PixelFormat(pf),
  m_Width(width),
  m_Height(height),
+ m_PresentationTimestamp(0),
+ m_SourceIndex(0),
+ m_DirtyRect{ 0, 0, width, height },
+ m_Slot(0),
  m_RawBuffer(nullptr),
- m_DeallocatorFn(defaultDeallocFn) {
+ m_Allocator(nullptr) {
 
 }
 
@@ -25,21 +52,31 @@ Frame::Frame(Frame&& src) noexcept
  : m_PixelFormat(src.m_PixelFormat),
  m_Width(src.m_Width),
  m_Height(src.m_Height),
+ m_PresentationTimestamp(src.m_PresentationTimestamp),
+ m_SourceIndex(src.m_SourceIndex),
+ m_DirtyRect(src.m_DirtyRect),
+ m_Slot(src.m_Slot),
  m_RawBuffer(src.m_RawBuffer),
- m_DeallocatorFn(src.m_DeallocatorFn) {
+ m_Allocator(src.m_Allocator) {
     src.m_RawBuffer = nullptr;
-    src.m_DeallocatorFn = defaultDeallocFn;
 }
 
 Frame& Frame::operator=(Frame&& src) noexcept {
     if (&src != this) {
+        if (isHoldingData()) {
+            m_Allocator->deallocate(m_RawBuffer, m_Slot);
+        }
+
         m_PixelFormat = src.m_PixelFormat;
         m_Width = src.m_Width;
         m_Height = src.m_Height;
+        m_PresentationTimestamp = src.m_PresentationTimestamp;
+        m_SourceIndex = src.m_SourceIndex;
+        m_DirtyRect = src.m_DirtyRect;
         m_RawBuffer = src.m_RawBuffer;
-        m_DeallocatorFn = src.m_DeallocatorFn;
+        m_Allocator = src.m_Allocator;
+        m_Slot = src.m_Slot;
         src.m_RawBuffer = nullptr;
-        src.m_DeallocatorFn = defaultDeallocFn;
     }
 
     return *this;
@@ -47,7 +84,7 @@ Frame& Frame::operator=(Frame&& src) noexcept {
 
 Frame::~Frame() {
     if (isHoldingData()) {
-        m_DeallocatorFn(m_RawBuffer);
+        m_Allocator->deallocate(m_RawBuffer, m_Slot);
     }
 }
 
@@ -63,24 +100,72 @@ uint32_t Frame::getHeight() const noexcept {
     return m_Height;
 }
 
+size_t Frame::getStride() const noexcept {
+    return getPixelSizeInBytes(getPixelFormat()) * getWidth();
+}
+
+size_t Frame::getSizeInBytes() const noexcept {
+    return getFrameSizeInBytes(getPixelFormat(), getWidth(), getHeight());
+}
+
+Frame::TimestampType Frame::getPresentationTimestamp() const noexcept {
+    return m_PresentationTimestamp;
+}
+
+void Frame::setPresentationTimestamp(TimestampType pts) noexcept {
+    m_PresentationTimestamp = pts;
+}
+
+Frame::SourceIndexType Frame::getSourceIndex() const noexcept {
+    return m_SourceIndex;
+}
+
+void Frame::setSourceIndex(SourceIndexType index) noexcept {
+    m_SourceIndex = index;
+}
+
+Frame::Rect Frame::getDirtyRect() const noexcept {
+    return m_DirtyRect;
+}
+
+void Frame::setDirtyRect(const Rect& rect) noexcept {
+    m_DirtyRect = rect;
+}
+
+void* Frame::getRawBuffer() const noexcept {
+    return m_RawBuffer;
+}
+
 bool Frame::isHoldingData() const noexcept {
     return m_RawBuffer != nullptr;
 }
 
 void Frame::storeFrameData(
-    const AllocatorFunctionType& allocatorFn,
-    const DeallocatorFunctionType& deallocatorFn,
-    const std::function<void(void*)>& fillerFn
+    FrameAllocator* allocator,
+    FrameFillerFunctionType fillerFn
 ) noexcept {
-    // decide the pixel size (in bytes)
-    size_t pixelSize = getPixelSizeInBytes(getPixelFormat());
-
-    // allocate bytes on the heap to store the data
-    m_RawBuffer = allocatorFn(pixelSize * getWidth() * getHeight());
+    // obtain memory to store the data, remembering who owns it so that the destructor can give it back
+    m_RawBuffer = allocator->allocate(getSizeInBytes(), m_Slot);
+    if (m_RawBuffer == nullptr) {
+        return;
+    }
 
-    // store the memory deallocator function so that it can be called on the destructor
-    m_DeallocatorFn = deallocatorFn;
+    m_Allocator = allocator;
 
     // allows the caller to fill the allocated buffer with pixel data in the specified format 
     fillerFn(m_RawBuffer);
+}
+
+void Frame::adoptFrameData(
+    void* buffer,
+    FrameAllocator* allocator,
+    FrameAllocator::SlotType slot
+) noexcept {
+    if (isHoldingData()) {
+        m_Allocator->deallocate(m_RawBuffer, m_Slot);
+    }
+
+    m_RawBuffer = buffer;
+    m_Allocator = allocator;
+    m_Slot = slot;
 }
\ No newline at end of file
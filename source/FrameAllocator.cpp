@@ -0,0 +1,109 @@
+#include "FrameAllocator.h"
+
+#include <unistd.h>
+#include <sys/mman.h>
+
+FrameAllocator::~FrameAllocator() {
+
+}
+
+HeapFrameAllocator::~HeapFrameAllocator() {
+
+}
+
+void* HeapFrameAllocator::allocate(size_t size, SlotType& slot) noexcept {
+    slot = 0;
+    return malloc(size);
+}
+
+void HeapFrameAllocator::deallocate(void* mem, SlotType slot) noexcept {
+    free(mem);
+}
+
+FramePool::FramePool(SlotType blocks, size_t blockSize, std::optional<NumaTopology::NodeType> node) noexcept
+ : m_BlockSize(blockSize),
+ m_Size(blockSize * blocks),
+ m_Memory(nullptr),
+ m_Node(node) {
+    // mapped rather than allocated so that pages can be placed before being touched
+    void* mem = mmap(nullptr, m_Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        std::cerr << "Could not allocate " << blocks << " frame blocks of " << blockSize << " bytes" << std::endl;
+        return;
+    }
+
+    m_Memory = static_cast<uint8_t*>(mem);
+
+    if (m_Node.has_value()) {
+        if (!NumaTopology::get().bindMemory(m_Memory, m_Size, m_Node.value())) {
+            m_Node.reset();
+        }
+
+        // first touch: every page is faulted in now, on the node, rather than while a frame is written
+        const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        for (size_t offset = 0; offset < m_Size; offset += pageSize) {
+            m_Memory[offset] = 0;
+        }
+    }
+
+    // blocks are handed out starting from the first one
+    m_FreeBlocks.reserve(blocks);
+    for (SlotType i = blocks; i > 0; --i) {
+        m_FreeBlocks.push_back(i - 1);
+    }
+}
+
+FramePool::~FramePool() {
+    if (m_Memory != nullptr) {
+        munmap(m_Memory, m_Size);
+    }
+}
+
+size_t FramePool::getBlockSize() const noexcept {
+    return m_BlockSize;
+}
+
+std::optional<NumaTopology::NodeType> FramePool::getNode() const noexcept {
+    return m_Node;
+}
+
+std::map<NumaTopology::NodeType, FrameAllocator::SlotType> FramePool::getResidentBlocks() const noexcept {
+    std::map<NumaTopology::NodeType, SlotType> resident;
+    if ((m_Memory == nullptr) || (m_BlockSize == 0)) {
+        return resident;
+    }
+
+    for (size_t offset = 0; offset < m_Size; offset += m_BlockSize) {
+        const auto node = NumaTopology::getMemoryNode(m_Memory + offset);
+        if (node.has_value()) {
+            ++resident[node.value()];
+        }
+    }
+
+    return resident;
+}
+
+void* FramePool::allocate(size_t size, SlotType& slot) noexcept {
+    if ((m_Memory == nullptr) || (size > m_BlockSize)) {
+        return nullptr;
+    }
+
+    std::unique_lock<std::mutex> lk(m_FreeMutex);
+    m_BlockFreed.wait(lk, [this]() {
+        return !m_FreeBlocks.empty();
+    });
+
+    slot = m_FreeBlocks.back();
+    m_FreeBlocks.pop_back();
+
+    return m_Memory + (m_BlockSize * slot);
+}
+
+void FramePool::deallocate(void* mem, SlotType slot) noexcept {
+    {
+        std::lock_guard<std::mutex> guard(m_FreeMutex);
+        m_FreeBlocks.push_back(slot);
+    }
+
+    m_BlockFreed.notify_one();
+}
@@ -0,0 +1,146 @@
+#include "FrameChangeDetector.h"
+
+// for memcmp
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// ffmpeg
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+/**
+ * @brief Check if two byte ranges hold the same data.
+ */
+static inline bool bytesEqual(const uint8_t* a, const uint8_t* b, size_t size) noexcept {
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 16 <= size; i += 16) {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != 0xFFFF) {
+            return false;
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 16 <= size; i += 16) {
+        if (vminvq_u8(vceqq_u8(vld1q_u8(a + i), vld1q_u8(b + i))) != 0xFF) {
+            return false;
+        }
+    }
+#endif
+
+    return std::memcmp(a + i, b + i, size - i) == 0;
+}
+
+FrameChangeDetector::FrameChangeDetector() noexcept
+ : m_Previous(NULL) {
+
+}
+
+FrameChangeDetector::~FrameChangeDetector() {
+    av_frame_free(&m_Previous);
+}
+
+void FrameChangeDetector::reset() noexcept {
+    if (m_Previous != NULL) {
+        av_frame_unref(m_Previous);
+    }
+}
+
+std::optional<Frame::Rect> FrameChangeDetector::compare(const AVFrame* frame) noexcept {
+    const uint32_t width = static_cast<uint32_t>(frame->width);
+    const uint32_t height = static_cast<uint32_t>(frame->height);
+    const Frame::Rect whole = { 0, 0, width, height };
+
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+
+    const bool comparable = (m_Previous != NULL) && (m_Previous->buf[0] != NULL) &&
+        (m_Previous->format == frame->format) && (m_Previous->width == frame->width) && (m_Previous->height == frame->height) &&
+        (descriptor != NULL) && ((descriptor->flags & AV_PIX_FMT_FLAG_HWACCEL) == 0);
+
+    if (!comparable) {
+        if (m_Previous == NULL) {
+            m_Previous = av_frame_alloc();
+        }
+
+        if (m_Previous != NULL) {
+            av_frame_unref(m_Previous);
+            av_frame_ref(m_Previous, frame);
+        }
+
+        return whole;
+    }
+
+    const uint32_t blocksX = (width + BlockSize - 1) / BlockSize;
+    const uint32_t blocksY = (height + BlockSize - 1) / BlockSize;
+
+    m_DirtyBlocks.assign(static_cast<size_t>(blocksX) * blocksY, 0);
+
+    // the block grid is defined on the first plane and mapped on chroma planes through the subsampling factors
+    const int planes = av_pix_fmt_count_planes(static_cast<AVPixelFormat>(frame->format));
+    for (int p = 0; p < planes; ++p) {
+        const bool chroma = (p == 1) || (p == 2);
+        const uint32_t shiftX = chroma ? descriptor->log2_chroma_w : 0;
+        const uint32_t shiftY = chroma ? descriptor->log2_chroma_h : 0;
+        const uint32_t planeWidth = (width + (1u << shiftX) - 1) >> shiftX;
+        const uint32_t planeHeight = (height + (1u << shiftY) - 1) >> shiftY;
+        const size_t rowBytes = static_cast<size_t>(std::max(av_image_get_linesize(static_cast<AVPixelFormat>(frame->format), frame->width, p), 0));
+
+        if ((planeWidth == 0) || (rowBytes == 0)) {
+            continue;
+        }
+
+        for (uint32_t y = 0; y < planeHeight; ++y) {
+            const uint32_t by = std::min((y << shiftY) / BlockSize, blocksY - 1);
+            const uint8_t* current = frame->data[p] + (static_cast<ptrdiff_t>(y) * frame->linesize[p]);
+            const uint8_t* previous = m_Previous->data[p] + (static_cast<ptrdiff_t>(y) * m_Previous->linesize[p]);
+
+            for (uint32_t bx = 0; bx < blocksX; ++bx) {
+                uint8_t& dirty = m_DirtyBlocks[(static_cast<size_t>(by) * blocksX) + bx];
+                if (dirty != 0) {
+                    continue;
+                }
+
+                const size_t begin = (static_cast<size_t>((bx * BlockSize) >> shiftX) * rowBytes) / planeWidth;
+                const size_t end = std::min((static_cast<size_t>(((bx + 1) * BlockSize) >> shiftX) * rowBytes) / planeWidth, rowBytes);
+                if ((begin < end) && (!bytesEqual(current + begin, previous + begin, end - begin))) {
+                    dirty = 1;
+                }
+            }
+        }
+    }
+
+    uint32_t minX = blocksX, minY = blocksY, maxX = 0, maxY = 0;
+    for (uint32_t by = 0; by < blocksY; ++by) {
+        for (uint32_t bx = 0; bx < blocksX; ++bx) {
+            if (m_DirtyBlocks[(static_cast<size_t>(by) * blocksX) + bx] != 0) {
+                minX = std::min(minX, bx);
+                minY = std::min(minY, by);
+                maxX = std::max(maxX, bx);
+                maxY = std::max(maxY, by);
+            }
+        }
+    }
+
+    // nothing changed: the previous reference is as good as the new one
+    if (minX == blocksX) {
+        return std::nullopt;
+    }
+
+    av_frame_unref(m_Previous);
+    av_frame_ref(m_Previous, frame);
+
+    const uint32_t x = minX * BlockSize;
+    const uint32_t y = minY * BlockSize;
+
+    return Frame::Rect{ x, y, std::min((maxX + 1) * BlockSize, width) - x, std::min((maxY + 1) * BlockSize, height) - y };
+}
@@ -0,0 +1,272 @@
+#include "FrameCompositor.h"
+#include "AlphaBlend.h"
+
+static inline bool isEmpty(const Frame::Rect& rect) noexcept {
+    return (rect.width == 0) || (rect.height == 0);
+}
+
+static inline bool isSame(const Frame::Rect& a, const Frame::Rect& b) noexcept {
+    return (a.x == b.x) && (a.y == b.y) && (a.width == b.width) && (a.height == b.height);
+}
+
+/**
+ * @brief Get the bounding rectangle of two rectangles (empty rectangles are ignored).
+ */
+static Frame::Rect unite(const Frame::Rect& a, const Frame::Rect& b) noexcept {
+    if (isEmpty(a)) {
+        return b;
+    } else if (isEmpty(b)) {
+        return a;
+    }
+
+    const uint32_t x0 = std::min(a.x, b.x);
+    const uint32_t y0 = std::min(a.y, b.y);
+    const uint32_t x1 = std::max(a.x + a.width, b.x + b.width);
+    const uint32_t y1 = std::max(a.y + a.height, b.y + b.height);
+
+    return Frame::Rect{ x0, y0, x1 - x0, y1 - y0 };
+}
+
+/**
+ * @brief Blend the non-transparent spans of a raster plane that lay inside a frame plane.
+ *
+ * @param dst the first sample of the frame plane
+ * @param stride the bytes between two rows of the frame plane
+ * @param width the samples of a row of the frame plane
+ * @param height the rows of the frame plane
+ * @param x the column of the frame plane the first sample of the raster plane is on
+ * @param y the row of the frame plane the first row of the raster plane is on
+ * @param sampleSize the bytes of a sample
+ * @param blendRow called with a frame row pointer, the index of the first raster sample and the number of samples
+ */
+template <typename BlendRowFn>
+static void blendPlane(uint8_t* dst, size_t stride, int32_t width, int32_t height, int32_t x, int32_t y, const OverlayImage::Plane& plane, size_t sampleSize, BlendRowFn blendRow) noexcept {
+    const int32_t x0 = std::max(x, 0);
+    const int32_t y0 = std::max(y, 0);
+    const int32_t x1 = std::min(x + static_cast<int32_t>(plane.width), width);
+    const int32_t y1 = std::min(y + static_cast<int32_t>(plane.height), height);
+
+    for (int32_t row = y0; row < y1; ++row) {
+        const OverlayImage::Span& span = plane.spans[row - y];
+        const int32_t begin = std::max(x0 - x, static_cast<int32_t>(span.begin));
+        const int32_t end = std::min(x1 - x, static_cast<int32_t>(span.end));
+        if (begin >= end) {
+            continue;
+        }
+
+        uint8_t* line = dst + (static_cast<size_t>(row) * stride) + (static_cast<size_t>(x + begin) * sampleSize);
+        blendRow(line, (static_cast<size_t>(row - y) * plane.width) + begin, static_cast<size_t>(end - begin));
+    }
+}
+
+FrameCompositor::FrameCompositor() noexcept
+ : m_NextLayer(0),
+ m_Removed{ 0, 0, 0, 0 },
+ m_LastWidth(0),
+ m_LastHeight(0),
+ m_Statistics{} {
+
+}
+
+FrameCompositor::~FrameCompositor() {
+
+}
+
+FrameCompositor::Layer* FrameCompositor::findLayer(LayerType layer) noexcept {
+    const auto entry = std::find_if(m_Layers.begin(), m_Layers.end(), [layer](const Layer& l) { return l.id == layer; });
+    return (entry != m_Layers.end()) ? &(*entry) : nullptr;
+}
+
+FrameCompositor::LayerType FrameCompositor::addLayer(std::shared_ptr<OverlayImage> image, int32_t x, int32_t y) noexcept {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    const LayerType id = m_NextLayer++;
+    m_Layers.push_back(Layer{ id, std::move(image), x, y, true, Frame::Rect{ 0, 0, 0, 0 }, nullptr, x, y });
+
+    return id;
+}
+
+void FrameCompositor::setLayerImage(LayerType layer, std::shared_ptr<OverlayImage> image) noexcept {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    Layer* entry = findLayer(layer);
+    if (entry != nullptr) {
+        entry->image = std::move(image);
+    }
+}
+
+void FrameCompositor::moveLayer(LayerType layer, int32_t x, int32_t y) noexcept {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    Layer* entry = findLayer(layer);
+    if (entry != nullptr) {
+        entry->x = x;
+        entry->y = y;
+    }
+}
+
+void FrameCompositor::setLayerVisible(LayerType layer, bool visible) noexcept {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    Layer* entry = findLayer(layer);
+    if (entry != nullptr) {
+        entry->visible = visible;
+    }
+}
+
+void FrameCompositor::removeLayer(LayerType layer) noexcept {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    const auto entry = std::find_if(m_Layers.begin(), m_Layers.end(), [layer](const Layer& l) { return l.id == layer; });
+    if (entry != m_Layers.end()) {
+        m_Removed = unite(m_Removed, entry->drawn);
+        m_Layers.erase(entry);
+    }
+}
+
+Frame::Rect FrameCompositor::blend(Frame& frame, const Layer& layer) noexcept {
+    const Frame::PixelFormat pf = frame.getPixelFormat();
+    const int32_t width = static_cast<int32_t>(frame.getWidth());
+    const int32_t height = static_cast<int32_t>(frame.getHeight());
+
+    // chroma samples of NV12 cover 2x2 pixels: the layer starts on one of them
+    const bool nv12 = (pf == Frame::PixelFormat::NV12);
+    const int32_t x = nv12 ? (layer.x & ~1) : layer.x;
+    const int32_t y = nv12 ? (layer.y & ~1) : layer.y;
+
+    const int32_t x0 = std::max(x, 0);
+    const int32_t y0 = std::max(y, 0);
+    const int32_t x1 = std::min(x + static_cast<int32_t>(layer.image->getWidth()), width);
+    const int32_t y1 = std::min(y + static_cast<int32_t>(layer.image->getHeight()), height);
+    if ((x0 >= x1) || (y0 >= y1)) {
+        return Frame::Rect{ 0, 0, 0, 0 };
+    }
+
+    const OverlayImage::Raster& raster = layer.image->getRaster(pf, height >= 720);
+    uint8_t* buffer = static_cast<uint8_t*>(frame.getRawBuffer());
+
+    switch (pf) {
+        case Frame::PixelFormat::RGBA32: {
+            const OverlayImage::Plane& plane = raster.planes[0];
+            blendPlane(buffer, frame.getStride(), width, height, x, y, plane, 4, [&plane](uint8_t* line, size_t sample, size_t count) {
+                AlphaBlend::blendRGBA32(line, plane.samples.data() + (sample * 4), count);
+            });
+            break;
+        }
+
+        case Frame::PixelFormat::RGBA64: {
+            const OverlayImage::Plane& plane = raster.planes[0];
+            blendPlane(buffer, frame.getStride(), width, height, x, y, plane, 8, [&plane](uint8_t* line, size_t sample, size_t count) {
+                AlphaBlend::blendRGBA64(reinterpret_cast<uint16_t*>(line), reinterpret_cast<const uint16_t*>(plane.samples.data()) + (sample * 4), count);
+            });
+            break;
+        }
+
+        case Frame::PixelFormat::NV12: {
+            const OverlayImage::Plane& luma = raster.planes[0];
+            blendPlane(buffer, frame.getStride(), width, height, x, y, luma, 1, [&luma](uint8_t* line, size_t sample, size_t count) {
+                AlphaBlend::blendSamples(line, luma.samples.data() + sample, luma.alpha.data() + sample, count);
+            });
+
+            // the chroma plane (Cb, Cr pairs) follows the luma plane
+            const OverlayImage::Plane& chroma = raster.planes[1];
+            const int32_t chromaStride = ((width + 1) / 2) * 2;
+            const int32_t chromaHeight = (height + 1) / 2;
+            uint8_t* chromaPlane = buffer + (static_cast<size_t>(width) * height);
+            blendPlane(chromaPlane, static_cast<size_t>(chromaStride), chromaStride, chromaHeight, x, y / 2, chroma, 1, [&chroma](uint8_t* line, size_t sample, size_t count) {
+                AlphaBlend::blendSamples(line, chroma.samples.data() + sample, chroma.alpha.data() + sample, count);
+            });
+            break;
+        }
+    }
+
+    return Frame::Rect{
+        static_cast<uint32_t>(x0),
+        static_cast<uint32_t>(y0),
+        static_cast<uint32_t>(x1 - x0),
+        static_cast<uint32_t>(y1 - y0)
+    };
+}
+
+void FrameCompositor::composite(Frame& frame) noexcept {
+    const auto start = std::chrono::steady_clock::now();
+
+    if (!frame.isHoldingData()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    const uint32_t width = frame.getWidth();
+    const uint32_t height = frame.getHeight();
+
+    // what layers covered in a frame of another size says nothing about this one
+    Frame::Rect dirty = frame.getDirtyRect();
+    if ((width != m_LastWidth) || (height != m_LastHeight)) {
+        dirty = Frame::Rect{ 0, 0, width, height };
+        m_LastWidth = width;
+        m_LastHeight = height;
+    }
+
+    dirty = unite(dirty, m_Removed);
+    m_Removed = Frame::Rect{ 0, 0, 0, 0 };
+
+    for (auto& layer : m_Layers) {
+        const bool shown = (layer.visible) && (layer.image);
+        const Frame::Rect drawn = shown ? blend(frame, layer) : Frame::Rect{ 0, 0, 0, 0 };
+        const OverlayImage* image = shown ? layer.image.get() : nullptr;
+
+        // both where the layer was and where it is now changed
+        if ((!isSame(drawn, layer.drawn)) || (image != layer.drawnImage)) {
+            dirty = unite(unite(dirty, layer.drawn), drawn);
+        }
+
+        layer.drawn = drawn;
+        layer.drawnImage = image;
+        layer.drawnX = layer.x;
+        layer.drawnY = layer.y;
+    }
+
+    // regions of removed layers may lay outside of the frame
+    const uint32_t x1 = std::min(dirty.x + dirty.width, width);
+    const uint32_t y1 = std::min(dirty.y + dirty.height, height);
+    frame.setDirtyRect(Frame::Rect{
+        std::min(dirty.x, x1),
+        std::min(dirty.y, y1),
+        x1 - std::min(dirty.x, x1),
+        y1 - std::min(dirty.y, y1)
+    });
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    ++m_Statistics.frames;
+    m_Statistics.lastTime = elapsed;
+    m_Statistics.maxTime = std::max<Frame::TimestampType>(m_Statistics.maxTime, elapsed);
+    if (elapsed > Budget) {
+        ++m_Statistics.overBudgetFrames;
+    }
+}
+
+bool FrameCompositor::hasPendingChanges() const noexcept {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    if (!isEmpty(m_Removed)) {
+        return true;
+    }
+
+    for (const auto& layer : m_Layers) {
+        const bool shown = (layer.visible) && (layer.image);
+        const OverlayImage* image = shown ? layer.image.get() : nullptr;
+
+        if ((image != layer.drawnImage) || ((shown) && ((layer.x != layer.drawnX) || (layer.y != layer.drawnY)))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+FrameCompositor::Statistics FrameCompositor::getStatistics() const noexcept {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    return m_Statistics;
+}
@@ -0,0 +1,379 @@
+#include "FrameEncoderPool.h"
+#include "AsyncFileWriter.h"
+
+#include "FFMPEGCommon.h"
+
+#include <cstdio>
+
+/**
+ * @brief The number of files each worker can be writing while it encodes the next frame.
+ */
+static constexpr size_t MaxPendingWrites = 4;
+
+/**
+ * @brief The JPEG quantizer scale (2 = best quality, 31 = worst).
+ */
+static constexpr int JpegQuality = 2;
+
+struct FrameEncoderPool::Encoder {
+    Encoder() noexcept
+     : codecCtx(NULL),
+     swsCtx(NULL),
+     frame(NULL),
+     pixelFormat(Frame::PixelFormat::RGBA32),
+     width(0),
+     height(0),
+     pts(0),
+     reportedBytes(0),
+     writer(MaxPendingWrites) {
+
+    }
+
+    ~Encoder() {
+        writer.flush();
+
+        av_frame_free(&frame);
+        sws_freeContext(swsCtx);
+        avcodec_free_context(&codecCtx);
+    }
+
+    AVCodecContext* codecCtx;
+
+    SwsContext* swsCtx;
+
+    /**
+     * @brief The frame pixels are converted to, in the pixel format of the encoder.
+     */
+    AVFrame* frame;
+
+    Frame::PixelFormat pixelFormat;
+
+    uint32_t width;
+
+    uint32_t height;
+
+    int64_t pts;
+
+    /**
+     * @brief The bytes written by the writer that have already been added to the statistics of the pool.
+     */
+    uint64_t reportedBytes;
+
+    AsyncFileWriter writer;
+};
+
+/**
+ * @brief Get the pixel format a frame is encoded in.
+ */
+static AVPixelFormat encodedPixelFormat(FrameEncoderPool::ImageFormat format, Frame::PixelFormat pf) noexcept {
+    if (format == FrameEncoderPool::ImageFormat::JPEG) {
+        return AV_PIX_FMT_YUVJ420P;
+    }
+
+    switch (pf) {
+        case Frame::PixelFormat::RGBA64:
+            return AV_PIX_FMT_RGBA64BE;
+
+        case Frame::PixelFormat::RGBA32:
+            return AV_PIX_FMT_RGBA;
+
+        case Frame::PixelFormat::NV12:
+            return AV_PIX_FMT_RGB24;
+    }
+
+    return AV_PIX_FMT_NONE;
+}
+
+FrameEncoderPool::FrameEncoderPool(ImageFormat format, const std::string& directory, BufferedFrameOutputDevice::FrameCountType frameCount, size_t workers) noexcept
+ : BufferedFrameOutputDevice(frameCount),
+ m_Format(format),
+ m_Directory(directory),
+ m_Frames(std::max<BufferedFrameOutputDevice::FrameCountType>(frameCount, 1)),
+ m_Head(0),
+ m_Count(0),
+ m_Finishing(false),
+ m_IsFinished(false),
+ m_EncodedFrames(0),
+ m_FailedFrames(0),
+ m_WrittenBytes(0) {
+    setPreferredFrameFormat(Frame::PixelFormat::RGBA32, 0, 0);
+    setQueuedFrames(0);
+
+    const size_t threads = (workers == 0) ? std::max<size_t>(std::thread::hardware_concurrency(), 1) : workers;
+    for (size_t i = 0; i < threads; ++i) {
+        m_Workers.emplace_back([this]() {
+            work();
+        });
+    }
+}
+
+FrameEncoderPool::~FrameEncoderPool() {
+    finish();
+}
+
+const char* FrameEncoderPool::getExtension(ImageFormat format) noexcept {
+    switch (format) {
+        case ImageFormat::PNG:
+            return "png";
+
+        case ImageFormat::JPEG:
+            return "jpg";
+
+        case ImageFormat::Raw:
+            return "raw";
+    }
+
+    return "";
+}
+
+void FrameEncoderPool::setSourceName(Frame::SourceIndexType index, const std::string& name) noexcept {
+    std::lock_guard<std::mutex> guard(m_QueueMutex);
+    m_SourceNames[index] = name;
+}
+
+void FrameEncoderPool::enqueueFrame(Frame&& frame) noexcept {
+    bool wasEmpty = false;
+
+    {
+        std::unique_lock<std::mutex> lk(m_QueueMutex);
+        m_SlotFreed.wait(lk, [this]() {
+            return (m_Finishing) || (m_Count < m_Frames.size());
+        });
+
+        // the frame memory goes back to its allocator
+        if (m_Finishing) {
+            return;
+        }
+
+        wasEmpty = (m_Count == 0);
+
+        m_Frames[(m_Head + m_Count) % m_Frames.size()].emplace(std::move(frame));
+        ++m_Count;
+
+        setQueuedFrames(static_cast<FrameCountType>(m_Count));
+    }
+
+    // every worker waiting is woken by a frame arriving on an empty queue: the ones not getting it go back to sleep
+    if (wasEmpty) {
+        m_FrameQueued.notify_all();
+    } else {
+        m_FrameQueued.notify_one();
+    }
+}
+
+void FrameEncoderPool::exec() noexcept {
+    std::unique_lock<std::mutex> lk(m_QueueMutex);
+    m_Finished.wait(lk, [this]() {
+        return m_IsFinished;
+    });
+}
+
+void FrameEncoderPool::finish() noexcept {
+    {
+        std::lock_guard<std::mutex> guard(m_QueueMutex);
+        m_Finishing = true;
+    }
+
+    m_FrameQueued.notify_all();
+    m_SlotFreed.notify_all();
+
+    for (auto& worker : m_Workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_QueueMutex);
+        m_IsFinished = true;
+    }
+
+    m_Finished.notify_all();
+}
+
+FrameEncoderPool::Statistics FrameEncoderPool::getStatistics() const noexcept {
+    Statistics statistics = {};
+    statistics.encodedFrames = m_EncodedFrames;
+    statistics.failedFrames = m_FailedFrames;
+    statistics.writtenBytes = m_WrittenBytes;
+    return statistics;
+}
+
+std::string FrameEncoderPool::getPath(const Frame& frame) noexcept {
+    const auto name = m_SourceNames.find(frame.getSourceIndex());
+
+    // timestamps are padded so that files of a source sort in presentation order
+    char timestamp[32];
+    std::snprintf(timestamp, sizeof(timestamp), "%012" PRId64, frame.getPresentationTimestamp());
+
+    return m_Directory + "/" +
+        ((name != m_SourceNames.cend()) ? name->second : std::to_string(frame.getSourceIndex())) +
+        "_" + timestamp + "." + getExtension(m_Format);
+}
+
+void FrameEncoderPool::work() noexcept {
+    Encoder encoder;
+
+    while (true) {
+        std::optional<Frame> frame;
+        std::string path;
+        bool wasFull = false;
+
+        {
+            std::unique_lock<std::mutex> lk(m_QueueMutex);
+            m_FrameQueued.wait(lk, [this]() {
+                return (m_Finishing) || (m_Count > 0);
+            });
+
+            // queued frames are encoded before stopping
+            if (m_Count == 0) {
+                break;
+            }
+
+            wasFull = (m_Count == m_Frames.size());
+
+            frame.swap(m_Frames[m_Head]);
+            m_Head = (m_Head + 1) % m_Frames.size();
+            --m_Count;
+
+            setQueuedFrames(static_cast<FrameCountType>(m_Count));
+
+            path = getPath(frame.value());
+        }
+
+        if (wasFull) {
+            m_SlotFreed.notify_one();
+        }
+
+        if (encode(encoder, frame, path)) {
+            ++m_EncodedFrames;
+        } else {
+            ++m_FailedFrames;
+        }
+
+        m_WrittenBytes += encoder.writer.getWrittenBytes() - encoder.reportedBytes;
+        encoder.reportedBytes = encoder.writer.getWrittenBytes();
+    }
+
+    encoder.writer.flush();
+
+    // frames whose file could not be written were counted as encoded
+    m_WrittenBytes += encoder.writer.getWrittenBytes() - encoder.reportedBytes;
+    m_EncodedFrames -= encoder.writer.getFailedWrites();
+    m_FailedFrames += encoder.writer.getFailedWrites();
+}
+
+bool FrameEncoderPool::encode(Encoder& encoder, std::optional<Frame>& frame, const std::string& path) noexcept {
+    if (m_Format == ImageFormat::Raw) {
+        return encoder.writer.write(path, std::move(frame.value()));
+    }
+
+    const Frame::PixelFormat pf = frame->getPixelFormat();
+    const uint32_t width = frame->getWidth();
+    const uint32_t height = frame->getHeight();
+
+    // the encoder is opened again only when frames change size or format (i.e. frames of another source)
+    if ((encoder.codecCtx == NULL) || (encoder.pixelFormat != pf) || (encoder.width != width) || (encoder.height != height)) {
+        av_frame_free(&encoder.frame);
+        avcodec_free_context(&encoder.codecCtx);
+
+        const AVCodec* codec = avcodec_find_encoder((m_Format == ImageFormat::PNG) ? AV_CODEC_ID_PNG : AV_CODEC_ID_MJPEG);
+        if (codec == NULL) {
+            std::cerr << "No " << getExtension(m_Format) << " encoder" << std::endl;
+            return false;
+        }
+
+        encoder.codecCtx = avcodec_alloc_context3(codec);
+        if (encoder.codecCtx == NULL) {
+            return false;
+        }
+
+        encoder.codecCtx->width = static_cast<int>(width);
+        encoder.codecCtx->height = static_cast<int>(height);
+        encoder.codecCtx->pix_fmt = encodedPixelFormat(m_Format, pf);
+        encoder.codecCtx->time_base = AVRational{ 1, 25 };
+
+        // the pool encodes frames in parallel: each encoder runs on its worker only
+        encoder.codecCtx->thread_count = 1;
+
+        if (m_Format == ImageFormat::JPEG) {
+            encoder.codecCtx->flags |= AV_CODEC_FLAG_QSCALE;
+            encoder.codecCtx->global_quality = FF_QP2LAMBDA * JpegQuality;
+            encoder.codecCtx->color_range = AVCOL_RANGE_JPEG;
+        }
+
+        if (avcodec_open2(encoder.codecCtx, codec, NULL) < 0) {
+            std::cerr << "Could not open the " << getExtension(m_Format) << " encoder for " << width << "x" << height << " frames" << std::endl;
+            avcodec_free_context(&encoder.codecCtx);
+            return false;
+        }
+
+        encoder.frame = av_frame_alloc();
+        if (encoder.frame == NULL) {
+            avcodec_free_context(&encoder.codecCtx);
+            return false;
+        }
+
+        encoder.frame->format = encoder.codecCtx->pix_fmt;
+        encoder.frame->width = encoder.codecCtx->width;
+        encoder.frame->height = encoder.codecCtx->height;
+        if (av_frame_get_buffer(encoder.frame, 0) < 0) {
+            av_frame_free(&encoder.frame);
+            avcodec_free_context(&encoder.codecCtx);
+            return false;
+        }
+
+        encoder.pixelFormat = pf;
+        encoder.width = width;
+        encoder.height = height;
+    }
+
+    if (av_frame_make_writable(encoder.frame) < 0) {
+        return false;
+    }
+
+    const AVPixelFormat srcFormat = FFMPEGCommon::toAVPixelFormat(pf);
+
+    encoder.swsCtx = sws_getCachedContext(
+        encoder.swsCtx,
+        static_cast<int>(width), static_cast<int>(height), srcFormat,
+        static_cast<int>(width), static_cast<int>(height), encoder.codecCtx->pix_fmt,
+        SWS_BILINEAR, NULL, NULL, NULL
+    );
+
+    if (encoder.swsCtx == NULL) {
+        std::cerr << "Could not convert frames for the " << getExtension(m_Format) << " encoder" << std::endl;
+        return false;
+    }
+
+    // planes of a frame are one after the other without padding
+    uint8_t* srcData[4] = { nullptr };
+    int srcLinesize[4] = { 0 };
+    av_image_fill_arrays(srcData, srcLinesize, static_cast<const uint8_t*>(frame->getRawBuffer()), srcFormat, static_cast<int>(width), static_cast<int>(height), 1);
+
+    sws_scale(encoder.swsCtx, srcData, srcLinesize, 0, static_cast<int>(height), encoder.frame->data, encoder.frame->linesize);
+
+    // the frame memory goes back to its allocator (and to decoders waiting for it) before encoding
+    frame.reset();
+
+    encoder.frame->pts = encoder.pts++;
+    encoder.frame->quality = encoder.codecCtx->global_quality;
+
+    AVPacket* packet = av_packet_alloc();
+    if (packet == NULL) {
+        return false;
+    }
+
+    int ret = avcodec_send_frame(encoder.codecCtx, encoder.frame);
+    if (ret >= 0) {
+        ret = avcodec_receive_packet(encoder.codecCtx, packet);
+    }
+
+    if (ret < 0) {
+        std::cerr << "Could not encode " << path << std::endl;
+        av_packet_free(&packet);
+        return false;
+    }
+
+    return encoder.writer.write(path, packet);
+}
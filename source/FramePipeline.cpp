@@ -0,0 +1,334 @@
+#include "FramePipeline.h"
+#include "AllocationTracker.h"
+
+#include "Stages/ResampleFrameStage.h"
+
+// ffmpeg
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+}
+
+FramePipeline::FramePipeline(std::vector<std::shared_ptr<FrameStage>> stages, size_t workers) noexcept
+ : m_Stages(std::move(stages)),
+ m_Workers(std::max<size_t>(workers, 1)),
+ m_Configured(false),
+ m_ShouldStop(false),
+ m_Busy(0),
+ m_QueueHead(0),
+ m_QueueCount(0) {
+    // a stage keeping state between frames forces frames to go through it one at a time
+    for (const auto& stage : m_Stages) {
+        if (!stage->isConcurrent()) {
+            m_Workers = 1;
+        }
+    }
+
+    // two frames per worker keep every worker busy while frames are being received
+    m_Processed.setCapacity(2 * m_Workers);
+    m_Queue.assign(2 * m_Workers, Job{ 0, NULL });
+
+    for (size_t i = 0; i < m_Workers; ++i) {
+        m_Scratch.push_back(av_frame_alloc());
+    }
+
+    // a single worker is the submitting thread itself
+    if (m_Workers > 1) {
+        for (size_t i = 0; i < m_Workers; ++i) {
+            m_Threads.emplace_back([this, i]() {
+                work(i);
+            });
+        }
+    }
+}
+
+FramePipeline::~FramePipeline() {
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        m_ShouldStop = true;
+    }
+
+    m_JobQueued.notify_all();
+
+    for (auto& thread : m_Threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < m_QueueCount; ++i) {
+        av_frame_free(&m_Queue[(m_QueueHead + i) % m_Queue.size()].frame);
+    }
+
+    for (auto& frame : m_Scratch) {
+        av_frame_free(&frame);
+    }
+
+    releaseChain();
+}
+
+void FramePipeline::releaseChain() noexcept {
+    // buffers still referenced by processed frames outlive their pool
+    for (auto& step : m_Chain) {
+        av_buffer_pool_uninit(&step.pool);
+    }
+
+    m_Chain.clear();
+    m_OwnedStages.clear();
+}
+
+bool FramePipeline::configure(const FrameStage::Format& input) noexcept {
+    releaseChain();
+
+    FrameStage::Format format = input;
+
+    auto append = [this, &format](FrameStage* stage) -> bool {
+        // a resample right after another one is done by a single stage
+        if (!m_Chain.empty()) {
+            auto fused = m_Chain.back().stage->fuse(*stage);
+            if (fused) {
+                format = m_Chain.back().input;
+                stage = fused.get();
+                m_OwnedStages.push_back(std::move(fused));
+                m_Chain.pop_back();
+            }
+        }
+
+        const auto output = stage->configure(format, m_Workers);
+        if (!output.has_value()) {
+            return false;
+        }
+
+        const bool unchanged = (output->pixelFormat == format.pixelFormat) && (output->width == format.width) && (output->height == format.height);
+        if ((unchanged) && (stage->getResampleTarget().has_value())) {
+            return true;
+        }
+
+        m_Chain.push_back(Step{ stage, format, output.value(), NULL });
+        format = output.value();
+        return true;
+    };
+
+    for (const auto& stage : m_Stages) {
+        if (!stage->accepts(format.pixelFormat)) {
+            std::unique_ptr<FrameStage> conversion(new ResampleFrameStage(0, 0, stage->getPreferredInput()));
+            FrameStage* converter = conversion.get();
+            m_OwnedStages.push_back(std::move(conversion));
+
+            if (!append(converter)) {
+                return false;
+            }
+        }
+
+        if (!append(stage.get())) {
+            return false;
+        }
+    }
+
+    for (auto& step : m_Chain) {
+        const auto access = step.stage->getAccess();
+        if ((access != FrameStage::Access::Output) && (access != FrameStage::Access::InPlace)) {
+            continue;
+        }
+
+        const int size = av_image_get_buffer_size(static_cast<AVPixelFormat>(step.output.pixelFormat), step.output.width, step.output.height, RowAlignment);
+        if (size <= 0) {
+            return false;
+        }
+
+        step.pool = av_buffer_pool_init(static_cast<size_t>(size), NULL);
+        if (step.pool == NULL) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FramePipeline::allocate(const Step& step, AVFrame* frame) noexcept {
+    frame->buf[0] = av_buffer_pool_get(step.pool);
+    if (frame->buf[0] == NULL) {
+        return false;
+    }
+
+    frame->format = step.output.pixelFormat;
+    frame->width = static_cast<int>(step.output.width);
+    frame->height = static_cast<int>(step.output.height);
+
+    return av_image_fill_arrays(
+        frame->data,
+        frame->linesize,
+        frame->buf[0]->data,
+        static_cast<AVPixelFormat>(step.output.pixelFormat),
+        frame->width,
+        frame->height,
+        RowAlignment
+    ) >= 0;
+}
+
+bool FramePipeline::run(AVFrame* frame, size_t worker) noexcept {
+    AVFrame* scratch = m_Scratch[worker];
+
+    for (const auto& step : m_Chain) {
+        bool processed = false;
+
+        switch (step.stage->getAccess()) {
+            case FrameStage::Access::View:
+                processed = step.stage->process(frame, frame, worker);
+                break;
+
+            case FrameStage::Access::InPlace:
+                // a frame still referenced elsewhere (i.e. by the codec) is copied first
+                if (!av_frame_is_writable(frame)) {
+                    if ((!allocate(step, scratch)) || (av_frame_copy(scratch, frame) < 0) || (av_frame_copy_props(scratch, frame) < 0)) {
+                        av_frame_unref(scratch);
+                        return false;
+                    }
+
+                    av_frame_unref(frame);
+                    av_frame_move_ref(frame, scratch);
+                }
+
+                processed = step.stage->process(frame, frame, worker);
+                break;
+
+            case FrameStage::Access::Output:
+                if ((!allocate(step, scratch)) || (av_frame_copy_props(scratch, frame) < 0)) {
+                    av_frame_unref(scratch);
+                    return false;
+                }
+
+                processed = step.stage->process(frame, scratch, worker);
+                av_frame_unref(frame);
+                av_frame_move_ref(frame, scratch);
+                break;
+
+            case FrameStage::Access::Allocates:
+                processed = step.stage->process(frame, scratch, worker);
+                av_frame_unref(frame);
+                av_frame_move_ref(frame, scratch);
+                break;
+        }
+
+        if (!processed) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FramePipeline::isFull() const noexcept {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    return m_Processed.isFull();
+}
+
+void FramePipeline::submit(const AVFrame* frame) noexcept {
+    std::unique_lock<std::mutex> lk(m_Mutex);
+
+    AVFrame* job = m_Processed.takeSpareFrame();
+    const uint64_t sequence = m_Processed.submit();
+
+    if ((job == NULL) || (av_frame_ref(job, frame) < 0)) {
+        m_Processed.complete(sequence, job, false);
+        return;
+    }
+
+    // the chain is rebuilt when the decoded format changes, once every frame being processed is done
+    const FrameStage::Format format = { frame->format, static_cast<uint32_t>(frame->width), static_cast<uint32_t>(frame->height) };
+    if ((!m_Input.has_value()) || (m_Input->pixelFormat != format.pixelFormat) || (m_Input->width != format.width) || (m_Input->height != format.height)) {
+        m_JobDone.wait(lk, [this]() {
+            return (m_QueueCount == 0) && (m_Busy == 0);
+        });
+
+        m_Input = format;
+        m_Configured = configure(format);
+        if (!m_Configured) {
+            std::cerr << "Could not configure the frame processing stages for " << format.width << "x" << format.height << " frames" << std::endl;
+        }
+    }
+
+    if (!m_Configured) {
+        m_Processed.complete(sequence, job, false);
+        return;
+    }
+
+    if (m_Threads.empty()) {
+        lk.unlock();
+        const bool processed = run(job, 0);
+        lk.lock();
+
+        m_Processed.complete(sequence, job, processed);
+        return;
+    }
+
+    m_Queue[(m_QueueHead + m_QueueCount) % m_Queue.size()] = Job{ sequence, job };
+    ++m_QueueCount;
+    lk.unlock();
+
+    m_JobQueued.notify_one();
+}
+
+void FramePipeline::work(size_t worker) noexcept {
+    // workers are part of the decoding hot path: they are checked like the decoding thread
+    AllocationTracker::watchThread();
+
+    std::unique_lock<std::mutex> lk(m_Mutex);
+
+    while (true) {
+        m_JobQueued.wait(lk, [this]() {
+            return (m_ShouldStop) || (m_QueueCount > 0);
+        });
+
+        if (m_ShouldStop) {
+            return;
+        }
+
+        const Job job = m_Queue[m_QueueHead];
+        m_QueueHead = (m_QueueHead + 1) % m_Queue.size();
+        --m_QueueCount;
+        ++m_Busy;
+
+        lk.unlock();
+
+        const bool processed = run(job.frame, worker);
+
+        lk.lock();
+
+        --m_Busy;
+        m_Processed.complete(job.sequence, job.frame, processed);
+
+        m_JobDone.notify_all();
+    }
+}
+
+bool FramePipeline::receive(AVFrame* frame, bool wait) noexcept {
+    std::unique_lock<std::mutex> lk(m_Mutex);
+
+    while (true) {
+        // frames dropped by a stage are skipped
+        if (m_Processed.receive(frame)) {
+            return true;
+        }
+
+        if ((!wait) || (m_Processed.isEmpty())) {
+            return false;
+        }
+
+        m_JobDone.wait(lk);
+    }
+}
+
+void FramePipeline::flush() noexcept {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    // frames still being processed are discarded when their worker completes them, queued ones right away
+    m_Processed.flush();
+
+    for (size_t i = 0; i < m_QueueCount; ++i) {
+        const Job& job = m_Queue[(m_QueueHead + i) % m_Queue.size()];
+        m_Processed.complete(job.sequence, job.frame, false);
+    }
+
+    m_QueueCount = 0;
+}
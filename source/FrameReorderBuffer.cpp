@@ -0,0 +1,109 @@
+#include "FrameReorderBuffer.h"
+
+// ffmpeg
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+FrameReorderBuffer::FrameReorderBuffer() noexcept
+ : m_SubmittedSequence(0),
+ m_NextSequence(0),
+ m_Slots(1, Slot{ nullptr, false }) {
+
+}
+
+FrameReorderBuffer::~FrameReorderBuffer() {
+    for (auto& slot : m_Slots) {
+        av_frame_free(&slot.frame);
+    }
+
+    for (auto& frame : m_SpareFrames) {
+        av_frame_free(&frame);
+    }
+}
+
+void FrameReorderBuffer::setCapacity(size_t capacity) noexcept {
+    m_Slots.assign(std::max<size_t>(capacity, 1), Slot{ nullptr, false });
+
+    // every pending sequence and every one being discarded after a flush can hold a frame
+    m_SpareFrames.reserve(2 * m_Slots.size());
+}
+
+bool FrameReorderBuffer::isFull() const noexcept {
+    return (m_SubmittedSequence - m_NextSequence) >= m_Slots.size();
+}
+
+bool FrameReorderBuffer::isEmpty() const noexcept {
+    return m_NextSequence == m_SubmittedSequence;
+}
+
+uint64_t FrameReorderBuffer::submit() noexcept {
+    return m_SubmittedSequence++;
+}
+
+AVFrame* FrameReorderBuffer::takeSpareFrame() noexcept {
+    if (m_SpareFrames.empty()) {
+        return av_frame_alloc();
+    }
+
+    AVFrame* frame = m_SpareFrames.back();
+    m_SpareFrames.pop_back();
+    return frame;
+}
+
+void FrameReorderBuffer::complete(uint64_t sequence, AVFrame* frame, bool completed) noexcept {
+    // sequences submitted before a flush are not waited for anymore
+    if ((!completed) || (sequence < m_NextSequence)) {
+        if (frame != nullptr) {
+            av_frame_unref(frame);
+            m_SpareFrames.push_back(frame);
+        }
+
+        frame = nullptr;
+    }
+
+    if (sequence >= m_NextSequence) {
+        Slot& slot = m_Slots[sequence % m_Slots.size()];
+        slot.frame = frame;
+        slot.completed = true;
+    }
+}
+
+bool FrameReorderBuffer::receive(AVFrame* frame) noexcept {
+    while (m_NextSequence != m_SubmittedSequence) {
+        Slot& slot = m_Slots[m_NextSequence % m_Slots.size()];
+        if (!slot.completed) {
+            return false;
+        }
+
+        AVFrame* completed = slot.frame;
+        slot = Slot{ nullptr, false };
+        ++m_NextSequence;
+
+        // the sequence has no frame: go on with the next one
+        if (completed == nullptr) {
+            continue;
+        }
+
+        av_frame_unref(frame);
+        av_frame_move_ref(frame, completed);
+        m_SpareFrames.push_back(completed);
+        return true;
+    }
+
+    return false;
+}
+
+void FrameReorderBuffer::flush() noexcept {
+    for (uint64_t sequence = m_NextSequence; sequence != m_SubmittedSequence; ++sequence) {
+        Slot& slot = m_Slots[sequence % m_Slots.size()];
+        if (slot.frame != nullptr) {
+            av_frame_unref(slot.frame);
+            m_SpareFrames.push_back(slot.frame);
+        }
+
+        slot = Slot{ nullptr, false };
+    }
+
+    m_NextSequence = m_SubmittedSequence;
+}
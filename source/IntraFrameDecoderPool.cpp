@@ -0,0 +1,198 @@
+#include "IntraFrameDecoderPool.h"
+#include "AllocationTracker.h"
+
+// ffmpeg
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+}
+
+IntraFrameDecoderPool::IntraFrameDecoderPool() noexcept
+ : m_ShouldStop(false),
+ m_NextWorker(0) {
+
+}
+
+IntraFrameDecoderPool::~IntraFrameDecoderPool() {
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        m_ShouldStop = true;
+    }
+
+    m_JobQueued.notify_all();
+
+    for (auto& worker : m_Workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+
+        for (size_t i = 0; i < worker->count; ++i) {
+            av_packet_free(&worker->jobs[(worker->head + i) % worker->jobs.size()].packet);
+        }
+
+        avcodec_free_context(&worker->context);
+    }
+
+    for (auto& packet : m_SparePackets) {
+        av_packet_free(&packet);
+    }
+}
+
+bool IntraFrameDecoderPool::isIntraOnly(const AVCodecParameters* codecpar) noexcept {
+    const AVCodecDescriptor* descriptor = avcodec_descriptor_get(codecpar->codec_id);
+
+    return (descriptor != NULL) && ((descriptor->props & AV_CODEC_PROP_INTRA_ONLY) != 0);
+}
+
+bool IntraFrameDecoderPool::open(const AVCodec* codec, const AVCodecParameters* codecpar, int lowres, size_t workers) noexcept {
+    // two packets per worker keep every worker busy while frames are being received
+    const size_t capacity = 2 * workers;
+
+    for (size_t i = 0; i < workers; ++i) {
+        std::unique_ptr<Worker> worker(new Worker());
+        worker->jobs.assign(capacity, Job{ 0, NULL });
+        worker->head = 0;
+        worker->count = 0;
+        worker->context = avcodec_alloc_context3(codec);
+        if (worker->context == NULL) {
+            return false;
+        }
+
+        // parallelism comes from the pool: every context decodes on its worker thread only
+        if (avcodec_parameters_to_context(worker->context, codecpar) < 0) {
+            avcodec_free_context(&worker->context);
+            return false;
+        }
+
+        worker->context->lowres = lowres;
+        worker->context->thread_count = 1;
+
+        if (avcodec_open2(worker->context, codec, NULL) < 0) {
+            avcodec_free_context(&worker->context);
+            return false;
+        }
+
+        m_Workers.push_back(std::move(worker));
+    }
+
+    m_Decoded.setCapacity(capacity);
+
+    // packets are queued, being decoded or being discarded after a flush
+    m_SparePackets.reserve(capacity + workers);
+
+    for (auto& worker : m_Workers) {
+        Worker* w = worker.get();
+        w->thread = std::thread([this, w]() {
+            work(*w);
+        });
+    }
+
+    return !m_Workers.empty();
+}
+
+bool IntraFrameDecoderPool::isFull() const noexcept {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    return m_Decoded.isFull();
+}
+
+void IntraFrameDecoderPool::submit(AVPacket* packet) noexcept {
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+
+        AVPacket* queued = NULL;
+        if (m_SparePackets.empty()) {
+            queued = av_packet_alloc();
+        } else {
+            queued = m_SparePackets.back();
+            m_SparePackets.pop_back();
+        }
+
+        if (queued == NULL) {
+            av_packet_unref(packet);
+            return;
+        }
+
+        av_packet_move_ref(queued, packet);
+
+        Worker& worker = *m_Workers[m_NextWorker];
+        worker.jobs[(worker.head + worker.count) % worker.jobs.size()] = Job{ m_Decoded.submit(), queued };
+        ++worker.count;
+        m_NextWorker = (m_NextWorker + 1) % m_Workers.size();
+    }
+
+    m_JobQueued.notify_all();
+}
+
+void IntraFrameDecoderPool::work(Worker& worker) noexcept {
+    // workers are part of the decoding hot path: they are checked like the decoding thread
+    AllocationTracker::watchThread();
+
+    std::unique_lock<std::mutex> lk(m_Mutex);
+
+    while (true) {
+        m_JobQueued.wait(lk, [this, &worker]() {
+            return (m_ShouldStop) || (worker.count > 0);
+        });
+
+        if (m_ShouldStop) {
+            return;
+        }
+
+        const Job job = worker.jobs[worker.head];
+        worker.head = (worker.head + 1) % worker.jobs.size();
+        --worker.count;
+
+        AVFrame* frame = m_Decoded.takeSpareFrame();
+
+        lk.unlock();
+
+        // intra-only decoders output the frame as soon as its packet has been sent
+        bool decoded = (frame != NULL) &&
+            (avcodec_send_packet(worker.context, job.packet) >= 0) &&
+            (avcodec_receive_frame(worker.context, frame) >= 0);
+
+        av_packet_unref(job.packet);
+
+        lk.lock();
+
+        m_SparePackets.push_back(job.packet);
+        m_Decoded.complete(job.sequence, frame, decoded);
+
+        m_FrameDecoded.notify_all();
+    }
+}
+
+bool IntraFrameDecoderPool::receive(AVFrame* frame, bool wait) noexcept {
+    std::unique_lock<std::mutex> lk(m_Mutex);
+
+    while (true) {
+        // packets that could not be decoded are skipped
+        if (m_Decoded.receive(frame)) {
+            return true;
+        }
+
+        if ((!wait) || (m_Decoded.isEmpty())) {
+            return false;
+        }
+
+        m_FrameDecoded.wait(lk);
+    }
+}
+
+void IntraFrameDecoderPool::flush() noexcept {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    for (auto& worker : m_Workers) {
+        for (size_t i = 0; i < worker->count; ++i) {
+            AVPacket* packet = worker->jobs[(worker->head + i) % worker->jobs.size()].packet;
+            av_packet_unref(packet);
+            m_SparePackets.push_back(packet);
+        }
+
+        worker->count = 0;
+    }
+
+    // jobs still being decoded are discarded when their worker completes them
+    m_Decoded.flush();
+}
@@ -0,0 +1,85 @@
+#include "LivePlayoutBuffer.h"
+
+LivePlayoutBuffer::LivePlayoutBuffer(Frame::TimestampType minDelay, Frame::TimestampType maxDelay, Frame::TimestampType catchUpThreshold) noexcept
+ : m_MinDelay(minDelay),
+ m_MaxDelay(std::max(minDelay, maxDelay)),
+ m_CatchUpThreshold(catchUpThreshold),
+ m_WindowStart(0),
+ m_Jitter(0.0) {
+
+}
+
+void LivePlayoutBuffer::reset() noexcept {
+    m_WindowMinimum.reset();
+    m_PreviousWindowMinimum.reset();
+    m_WindowStart = 0;
+    m_LastTransit.reset();
+    m_LateSince.reset();
+    m_Jitter = 0.0;
+}
+
+Frame::TimestampType LivePlayoutBuffer::schedule(Frame::TimestampType pts, Frame::TimestampType arrival) noexcept {
+    // the transit time is the arrival time relative to the timestamp: only its variations are meaningful
+    const Frame::TimestampType transit = arrival - pts;
+
+    // a timestamp discontinuity (the sender restarted, timestamps wrapped) invalidates every observation
+    if ((m_LastTransit.has_value()) && (std::abs(transit - m_LastTransit.value()) > DiscontinuityThreshold)) {
+        reset();
+    }
+
+    if (m_LastTransit.has_value()) {
+        // running estimate of the interarrival jitter (RFC 3550, section 6.4.1)
+        const double deviation = static_cast<double>(std::abs(transit - m_LastTransit.value()));
+        m_Jitter += (deviation - m_Jitter) / 16.0;
+    }
+
+    m_LastTransit = transit;
+
+    // the fastest recent frame tells where the live edge is: observations older than two windows are forgotten,
+    // so that the edge moves forward when the clock of the sender is slower than the local one
+    if ((!m_WindowMinimum.has_value()) || ((arrival - m_WindowStart) >= MinimumWindow)) {
+        m_PreviousWindowMinimum = m_WindowMinimum;
+        m_WindowMinimum = transit;
+        m_WindowStart = arrival;
+    } else if (transit < m_WindowMinimum.value()) {
+        m_WindowMinimum = transit;
+    }
+
+    Frame::TimestampType offset = m_WindowMinimum.value();
+    if (m_PreviousWindowMinimum.has_value()) {
+        offset = std::min(offset, m_PreviousWindowMinimum.value());
+    }
+
+    Frame::TimestampType playout = pts + offset + getPlayoutDelay();
+
+    // frames late for a while are not jitter: the edge is moved to this frame instead of dropping every frame
+    if (isBehindLiveEdge(playout, arrival)) {
+        if (!m_LateSince.has_value()) {
+            m_LateSince = arrival;
+        } else if ((arrival - m_LateSince.value()) >= ReanchorTime) {
+            m_WindowMinimum = transit;
+            m_PreviousWindowMinimum.reset();
+            m_WindowStart = arrival;
+            m_LateSince.reset();
+
+            playout = pts + transit + getPlayoutDelay();
+        }
+    } else {
+        m_LateSince.reset();
+    }
+
+    return playout;
+}
+
+bool LivePlayoutBuffer::isBehindLiveEdge(Frame::TimestampType playout, Frame::TimestampType now) const noexcept {
+    return (now - playout) > m_CatchUpThreshold;
+}
+
+Frame::TimestampType LivePlayoutBuffer::getPlayoutDelay() const noexcept {
+    // three times the jitter covers nearly every late frame
+    return std::clamp(static_cast<Frame::TimestampType>(3.0 * m_Jitter), m_MinDelay, m_MaxDelay);
+}
+
+Frame::TimestampType LivePlayoutBuffer::getJitter() const noexcept {
+    return static_cast<Frame::TimestampType>(m_Jitter);
+}
@@ -0,0 +1,112 @@
+#include "MailboxFrameOutputDevice.h"
+
+// eventfd
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+MailboxFrameOutputDevice::MailboxFrameOutputDevice() noexcept
+ : BufferedFrameOutputDevice(3),
+ m_BackSlot(0),
+ m_FrontSlot(1),
+ m_Pending(2),
+ m_WakeFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+ m_ShouldStop(false),
+ m_Dropped(0) {
+    if (m_WakeFd < 0) {
+        std::cerr << "Could not create eventfd for the mailbox output device" << std::endl;
+    }
+
+}
+
+MailboxFrameOutputDevice::~MailboxFrameOutputDevice() {
+    interrupt();
+
+    if (m_WakeFd >= 0) {
+        close(m_WakeFd);
+    }
+}
+
+static void signalEventFd(int fd) noexcept {
+    // a saturated counter (EAGAIN) still wakes the presenter up
+    const uint64_t one = 1;
+    ssize_t written = write(fd, &one, sizeof(one));
+    (void)written;
+}
+
+void MailboxFrameOutputDevice::enqueueFrame(Frame&& frame) noexcept {
+    m_Slots[m_BackSlot].emplace(std::move(frame));
+
+    // publish the new frame and take ownership of the previous pending slot
+    const uint32_t previous = m_Pending.exchange(m_BackSlot | FreshFlag, std::memory_order_acq_rel);
+    m_BackSlot = previous & SlotMask;
+
+    if ((previous & FreshFlag) != 0) {
+        ++m_Dropped;
+    }
+
+    // the slot now owned holds either a frame never presented or one the presenter is done with:
+    // in both cases its memory goes straight back to the allocator
+    m_Slots[m_BackSlot].reset();
+
+    signalEventFd(m_WakeFd);
+}
+
+const Frame* MailboxFrameOutputDevice::acquireLatestFrame() noexcept {
+    if ((m_Pending.load(std::memory_order_relaxed) & FreshFlag) == 0) {
+        return nullptr;
+    }
+
+    // give the presented frame back and take the fresh one
+    const uint32_t pending = m_Pending.exchange(m_FrontSlot, std::memory_order_acq_rel);
+    m_FrontSlot = pending & SlotMask;
+
+    return m_Slots[m_FrontSlot].has_value() ? &m_Slots[m_FrontSlot].value() : nullptr;
+}
+
+uint64_t MailboxFrameOutputDevice::getDroppedFrames() const noexcept {
+    return m_Dropped;
+}
+
+void MailboxFrameOutputDevice::present(const Frame& frame) noexcept {
+
+}
+
+void MailboxFrameOutputDevice::exec() noexcept {
+    if (m_WakeFd < 0) {
+        return;
+    }
+
+    pollfd pfd = {};
+    pfd.fd = m_WakeFd;
+    pfd.events = POLLIN;
+
+    // frames are dropped by the producer: they are reported by this thread
+    uint64_t reportedDrops = 0;
+
+    while (!m_ShouldStop) {
+        // sleep until something new is published: the counter is reset before looking at the mailbox
+        // so that a frame published in the meantime signals the eventfd again
+        if (poll(&pfd, 1, -1) > 0) {
+            uint64_t count = 0;
+            ssize_t readBytes = read(m_WakeFd, &count, sizeof(count));
+            (void)readBytes;
+        }
+
+        if (auto frame = acquireLatestFrame()) {
+            present(*frame);
+
+            // the latest frame is presented as soon as it is published: it is never late
+            const uint64_t dropped = m_Dropped;
+            reportDroppedFrames(dropped - reportedDrops);
+            reportedDrops = dropped;
+            reportPresentedFrame(*frame, 0);
+        }
+    }
+}
+
+void MailboxFrameOutputDevice::interrupt() noexcept {
+    m_ShouldStop = true;
+
+    signalEventFd(m_WakeFd);
+}
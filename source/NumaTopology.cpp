@@ -0,0 +1,190 @@
+#include "NumaTopology.h"
+
+#include <cstdio>
+
+// sched_getcpu, CPU_SET
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// MPOL_* (the system calls are used directly: no libnuma is required)
+#include <linux/mempolicy.h>
+
+/**
+ * @brief The largest node the masks given to the kernel can hold.
+ */
+static constexpr NumaTopology::NodeType MaxNodes = 1024;
+
+typedef unsigned long NodeMaskWord;
+
+static constexpr size_t NodeMaskWordBits = sizeof(NodeMaskWord) * 8;
+
+/**
+ * @brief Parse a sysfs CPU list (i.e. "0-15,32-47").
+ */
+static std::vector<uint32_t> parseCpuList(const std::string& list) noexcept {
+    std::vector<uint32_t> cpus;
+
+    std::istringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        uint32_t first = 0;
+        uint32_t last = 0;
+
+        const int parsed = std::sscanf(range.c_str(), "%u-%u", &first, &last);
+        if (parsed < 1) {
+            continue;
+        }
+
+        for (uint32_t cpu = first; cpu <= ((parsed == 2) ? last : first); ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return cpus;
+}
+
+static std::optional<std::string> readLine(const std::string& path) noexcept {
+    std::ifstream file(path);
+    std::string line;
+    if (!std::getline(file, line)) {
+        return std::nullopt;
+    }
+
+    return line;
+}
+
+const NumaTopology& NumaTopology::get() noexcept {
+    static const NumaTopology topology;
+    return topology;
+}
+
+NumaTopology::NumaTopology() noexcept {
+    const auto online = readLine("/sys/devices/system/node/online");
+
+    for (const auto node : parseCpuList(online.value_or(""))) {
+        const std::string path = "/sys/devices/system/node/node" + std::to_string(node);
+
+        Node entry;
+        entry.id = node;
+        entry.cpus = parseCpuList(readLine(path + "/cpulist").value_or(""));
+        entry.memory = 0;
+
+        // "Node 0 MemTotal:       65536000 kB"
+        std::ifstream meminfo(path + "/meminfo");
+        std::string line;
+        while (std::getline(meminfo, line)) {
+            unsigned long long kilobytes = 0;
+            unsigned int id = 0;
+            if (std::sscanf(line.c_str(), "Node %u MemTotal: %llu kB", &id, &kilobytes) == 2) {
+                entry.memory = static_cast<uint64_t>(kilobytes) * 1024;
+                break;
+            }
+        }
+
+        m_Nodes.push_back(std::move(entry));
+    }
+
+    // without sysfs (or NUMA support) every CPU is on node 0
+    if (m_Nodes.empty()) {
+        Node entry;
+        entry.id = 0;
+        entry.memory = 0;
+
+        const auto cpus = std::max<unsigned int>(std::thread::hardware_concurrency(), 1);
+        for (uint32_t cpu = 0; cpu < cpus; ++cpu) {
+            entry.cpus.push_back(cpu);
+        }
+
+        m_Nodes.push_back(std::move(entry));
+    }
+}
+
+const std::vector<NumaTopology::Node>& NumaTopology::getNodes() const noexcept {
+    return m_Nodes;
+}
+
+bool NumaTopology::isNuma() const noexcept {
+    return m_Nodes.size() > 1;
+}
+
+std::optional<NumaTopology::NodeType> NumaTopology::getNodeOfCpu(uint32_t cpu) const noexcept {
+    for (const auto& node : m_Nodes) {
+        if (std::find(node.cpus.cbegin(), node.cpus.cend(), cpu) != node.cpus.cend()) {
+            return node.id;
+        }
+    }
+
+    return std::nullopt;
+}
+
+std::optional<uint32_t> NumaTopology::getCurrentCpu() noexcept {
+    const int cpu = sched_getcpu();
+    if (cpu < 0) {
+        return std::nullopt;
+    }
+
+    return static_cast<uint32_t>(cpu);
+}
+
+bool NumaTopology::bindThread(NodeType node) const noexcept {
+    const auto entry = std::find_if(m_Nodes.cbegin(), m_Nodes.cend(), [node](const Node& n) { return n.id == node; });
+    if ((entry == m_Nodes.cend()) || (entry->cpus.empty()) || (node >= MaxNodes)) {
+        std::cerr << "NUMA node " << node << " has no CPUs" << std::endl;
+        return false;
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (const auto cpu : entry->cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+        std::cerr << "Could not bind the thread to the CPUs of NUMA node " << node << std::endl;
+        return false;
+    }
+
+    // preferred (instead of bound) so that allocations still succeed when the node is out of memory
+    NodeMaskWord mask[MaxNodes / NodeMaskWordBits] = {};
+    mask[node / NodeMaskWordBits] |= NodeMaskWord(1) << (node % NodeMaskWordBits);
+
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, MaxNodes) != 0) {
+        std::cerr << "Could not set the memory policy of the thread to NUMA node " << node << std::endl;
+    }
+
+    return true;
+}
+
+bool NumaTopology::bindMemory(void* mem, size_t size, NodeType node) const noexcept {
+    if (node >= MaxNodes) {
+        return false;
+    }
+
+    NodeMaskWord mask[MaxNodes / NodeMaskWordBits] = {};
+    mask[node / NodeMaskWordBits] |= NodeMaskWord(1) << (node % NodeMaskWordBits);
+
+    if (syscall(SYS_mbind, mem, size, MPOL_PREFERRED, mask, MaxNodes, MPOL_MF_MOVE) != 0) {
+        std::cerr << "Could not bind " << size << " bytes to NUMA node " << node << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+std::optional<NumaTopology::NodeType> NumaTopology::getMemoryNode(const void* address) noexcept {
+    const auto pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+
+    void* page = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(address) & ~(pageSize - 1));
+    int status = -1;
+
+    // without target nodes move_pages only reports where pages are
+    if ((syscall(SYS_move_pages, 0, 1, &page, nullptr, &status, 0) != 0) || (status < 0)) {
+        return std::nullopt;
+    }
+
+    return static_cast<NodeType>(status);
+}
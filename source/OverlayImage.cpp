@@ -0,0 +1,218 @@
+#include "OverlayImage.h"
+#include "AlphaBlend.h"
+
+#include <cmath>
+
+/**
+ * @brief The coefficients of a RGB to limited range YCbCr conversion.
+ */
+struct YCbCrMatrix {
+    float y[3];
+
+    float cb[3];
+
+    float cr[3];
+};
+
+static constexpr YCbCrMatrix BT601 = {
+    { 0.257f, 0.504f, 0.098f },
+    { -0.148f, -0.291f, 0.439f },
+    { 0.439f, -0.368f, -0.071f },
+};
+
+static constexpr YCbCrMatrix BT709 = {
+    { 0.183f, 0.614f, 0.062f },
+    { -0.101f, -0.339f, 0.439f },
+    { 0.439f, -0.399f, -0.040f },
+};
+
+static inline float convert(const float coefficients[3], float offset, const uint8_t* rgba) noexcept {
+    return offset + (coefficients[0] * rgba[0]) + (coefficients[1] * rgba[1]) + (coefficients[2] * rgba[2]);
+}
+
+static inline uint8_t toSample(float value) noexcept {
+    return static_cast<uint8_t>(std::min(std::max(std::lround(value), 0L), 255L));
+}
+
+/**
+ * @brief Record the span of samples with a non-zero alpha of every row of a plane.
+ *
+ * @param alphaOf the alpha of a sample given its row and column
+ */
+template <typename AlphaFn>
+static void findSpans(OverlayImage::Plane& plane, AlphaFn alphaOf) noexcept {
+    plane.spans.resize(plane.height);
+
+    for (uint32_t y = 0; y < plane.height; ++y) {
+        uint32_t begin = 0;
+        while ((begin < plane.width) && (alphaOf(y, begin) == 0)) {
+            ++begin;
+        }
+
+        uint32_t end = plane.width;
+        while ((end > begin) && (alphaOf(y, end - 1) == 0)) {
+            --end;
+        }
+
+        plane.spans[y] = OverlayImage::Span{ (begin < end) ? begin : 0, (begin < end) ? end : 0 };
+    }
+}
+
+OverlayImage::OverlayImage(const uint8_t* rgba, uint32_t width, uint32_t height) noexcept
+ : m_Image(rgba, rgba + (static_cast<size_t>(width) * height * 4)),
+ m_Width(width),
+ m_Height(height) {
+
+}
+
+OverlayImage::~OverlayImage() {
+
+}
+
+uint32_t OverlayImage::getWidth() const noexcept {
+    return m_Width;
+}
+
+uint32_t OverlayImage::getHeight() const noexcept {
+    return m_Height;
+}
+
+void OverlayImage::prepare(Frame::PixelFormat pf, bool bt709) noexcept {
+    getRaster(pf, bt709);
+}
+
+const OverlayImage::Raster& OverlayImage::getRaster(Frame::PixelFormat pf, bool bt709) noexcept {
+    const size_t index = (pf == Frame::PixelFormat::RGBA64) ? 0 :
+        (pf == Frame::PixelFormat::RGBA32) ? 1 :
+        (bt709 ? 3 : 2);
+
+    std::lock_guard<std::mutex> guard(m_RasterMutex);
+
+    if (!m_Rasters[index]) {
+        std::unique_ptr<Raster> raster(new Raster());
+        raster->format = pf;
+
+        switch (pf) {
+            case Frame::PixelFormat::RGBA64:
+                rasterizeRGBA64(*raster);
+                break;
+
+            case Frame::PixelFormat::RGBA32:
+                rasterizeRGBA32(*raster);
+                break;
+
+            case Frame::PixelFormat::NV12:
+                rasterizeNV12(*raster, bt709);
+                break;
+        }
+
+        m_Rasters[index] = std::move(raster);
+    }
+
+    return *m_Rasters[index];
+}
+
+void OverlayImage::rasterizeRGBA32(Raster& raster) const noexcept {
+    raster.planes.resize(1);
+
+    Plane& plane = raster.planes[0];
+    plane.width = m_Width;
+    plane.height = m_Height;
+    plane.samples.resize(m_Image.size());
+
+    for (size_t i = 0; i < m_Image.size(); i += 4) {
+        const uint8_t a = m_Image[i + 3];
+        for (size_t c = 0; c < 3; ++c) {
+            plane.samples[i + c] = AlphaBlend::premultiply(m_Image[i + c], a);
+        }
+
+        plane.samples[i + 3] = a;
+    }
+
+    findSpans(plane, [this](uint32_t y, uint32_t x) {
+        return m_Image[(((static_cast<size_t>(y) * m_Width) + x) * 4) + 3];
+    });
+}
+
+void OverlayImage::rasterizeRGBA64(Raster& raster) const noexcept {
+    raster.planes.resize(1);
+
+    Plane& plane = raster.planes[0];
+    plane.width = m_Width;
+    plane.height = m_Height;
+    plane.samples.resize(m_Image.size() * sizeof(uint16_t));
+
+    // samples of RGBA64 pixels are 16-bit (the full range of an 8-bit value times 257)
+    uint16_t* samples = reinterpret_cast<uint16_t*>(plane.samples.data());
+    for (size_t i = 0; i < m_Image.size(); i += 4) {
+        const uint32_t a = m_Image[i + 3];
+        for (size_t c = 0; c < 3; ++c) {
+            samples[i + c] = static_cast<uint16_t>(AlphaBlend::div255(m_Image[i + c] * a) * 257);
+        }
+
+        samples[i + 3] = static_cast<uint16_t>(a * 257);
+    }
+
+    findSpans(plane, [this](uint32_t y, uint32_t x) {
+        return m_Image[(((static_cast<size_t>(y) * m_Width) + x) * 4) + 3];
+    });
+}
+
+void OverlayImage::rasterizeNV12(Raster& raster, bool bt709) const noexcept {
+    const YCbCrMatrix& matrix = bt709 ? BT709 : BT601;
+
+    raster.planes.resize(2);
+
+    Plane& luma = raster.planes[0];
+    luma.width = m_Width;
+    luma.height = m_Height;
+    luma.samples.resize(static_cast<size_t>(m_Width) * m_Height);
+    luma.alpha.resize(luma.samples.size());
+
+    for (size_t i = 0; i < luma.samples.size(); ++i) {
+        const uint8_t* pixel = m_Image.data() + (i * 4);
+        luma.samples[i] = AlphaBlend::premultiply(toSample(convert(matrix.y, 16.0f, pixel)), pixel[3]);
+        luma.alpha[i] = pixel[3];
+    }
+
+    findSpans(luma, [&luma](uint32_t y, uint32_t x) {
+        return luma.alpha[(static_cast<size_t>(y) * luma.width) + x];
+    });
+
+    // chroma pairs (Cb, Cr) subsampled 2x2: premultiplied values are averaged, so that transparent pixels do not count
+    const uint32_t chromaWidth = (m_Width + 1) / 2;
+    Plane& chroma = raster.planes[1];
+    chroma.width = chromaWidth * 2;
+    chroma.height = (m_Height + 1) / 2;
+    chroma.samples.resize(static_cast<size_t>(chroma.width) * chroma.height);
+    chroma.alpha.resize(chroma.samples.size());
+
+    for (uint32_t cy = 0; cy < chroma.height; ++cy) {
+        for (uint32_t cx = 0; cx < chromaWidth; ++cx) {
+            float cb = 0.0f;
+            float cr = 0.0f;
+            uint32_t alpha = 0;
+            uint32_t count = 0;
+
+            for (uint32_t y = cy * 2; y < std::min(cy * 2 + 2, m_Height); ++y) {
+                for (uint32_t x = cx * 2; x < std::min(cx * 2 + 2, m_Width); ++x) {
+                    const uint8_t* pixel = m_Image.data() + (((static_cast<size_t>(y) * m_Width) + x) * 4);
+                    cb += convert(matrix.cb, 128.0f, pixel) * pixel[3];
+                    cr += convert(matrix.cr, 128.0f, pixel) * pixel[3];
+                    alpha += pixel[3];
+                    ++count;
+                }
+            }
+
+            const size_t sample = (static_cast<size_t>(cy) * chroma.width) + (cx * 2);
+            chroma.samples[sample] = toSample(cb / (255.0f * count));
+            chroma.samples[sample + 1] = toSample(cr / (255.0f * count));
+            chroma.alpha[sample] = static_cast<uint8_t>((alpha + (count / 2)) / count);
+            chroma.alpha[sample + 1] = chroma.alpha[sample];
+        }
+    }
+
+    findSpans(chroma, [&chroma](uint32_t y, uint32_t x) {
+        return chroma.alpha[(static_cast<size_t>(y) * chroma.width) + x];
+    });
+}
@@ -0,0 +1,319 @@
+#include "PresentationClock.h"
+
+// for memcpy
+#include <cstring>
+
+#include <chrono>
+
+// shm_open, mmap and futex
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/**
+ * @brief The layout of the shared memory: only fixed-size types and lock-free atomics, as SharedFrameRing.
+ *
+ * Timeline fields are atomics too, so that a reader racing with a writer can only read a mix of old and new
+ * values, that the sequence lock detects (and never a data race).
+ */
+struct PresentationClock::SharedState {
+    static constexpr uint32_t Magic = 0x454F4443; // "EODC"
+
+    static constexpr uint32_t Version = 1;
+
+    uint32_t magic;
+
+    uint32_t version;
+
+    /**
+     * @brief Odd while a writer is publishing a timeline; waiters sleep on it (and on nothing else).
+     */
+    alignas(64) std::atomic<uint32_t> sequence;
+
+    std::atomic<int64_t> anchorTime;
+
+    std::atomic<int64_t> anchorMedia;
+
+    std::atomic<uint64_t> rate;
+
+    std::atomic<uint32_t> barrierGeneration;
+
+    std::atomic<uint32_t> barrierExpected;
+
+    std::atomic<uint32_t> barrierArrived;
+
+    std::atomic<int64_t> barrierStartMedia;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared clock sequence must be lock-free");
+static_assert(std::atomic<int64_t>::is_always_lock_free, "shared clock timeline must be lock-free");
+
+static uint64_t rateToBits(double rate) noexcept {
+    uint64_t bits;
+    std::memcpy(&bits, &rate, sizeof(bits));
+    return bits;
+}
+
+static double bitsToRate(uint64_t bits) noexcept {
+    double rate;
+    std::memcpy(&rate, &bits, sizeof(rate));
+    return rate;
+}
+
+Frame::TimestampType PresentationClock::now() noexcept {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+PresentationClock::PresentationClock(const std::string& name, bool authority) noexcept
+ : m_Name(name),
+ m_Authority(authority),
+ m_Fd(-1),
+ m_State(nullptr) {
+    m_Fd = authority ?
+        shm_open(m_Name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600) :
+        shm_open(m_Name.c_str(), O_RDWR | O_CLOEXEC, 0);
+
+    if (m_Fd < 0) {
+        std::cerr << "Could not " << (authority ? "create" : "open") << " the presentation clock " << m_Name << std::endl;
+        return;
+    }
+
+    if ((authority) && (ftruncate(m_Fd, sizeof(SharedState)) != 0)) {
+        std::cerr << "Could not resize the presentation clock " << m_Name << std::endl;
+        return;
+    }
+
+    void* mapping = mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE, MAP_SHARED, m_Fd, 0);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Could not map the presentation clock " << m_Name << std::endl;
+        return;
+    }
+
+    auto state = reinterpret_cast<SharedState*>(mapping);
+
+    if (authority) {
+        // the mapping is zero-filled: a stopped timeline at timestamp 0, no barrier
+        state->magic = SharedState::Magic;
+        state->version = SharedState::Version;
+        state->rate.store(rateToBits(0.0), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    } else if ((state->magic != SharedState::Magic) || (state->version != SharedState::Version)) {
+        std::cerr << "The presentation clock " << m_Name << " has an unknown layout" << std::endl;
+        munmap(mapping, sizeof(SharedState));
+        return;
+    }
+
+    m_State = state;
+}
+
+PresentationClock::~PresentationClock() {
+    if (m_State != nullptr) {
+        munmap(m_State, sizeof(SharedState));
+    }
+
+    if (m_Fd >= 0) {
+        close(m_Fd);
+
+        if (m_Authority) {
+            shm_unlink(m_Name.c_str());
+        }
+    }
+}
+
+bool PresentationClock::isValid() const noexcept {
+    return m_State != nullptr;
+}
+
+bool PresentationClock::isAuthority() const noexcept {
+    return m_Authority;
+}
+
+PresentationClock::Timeline PresentationClock::getTimeline() const noexcept {
+    Timeline timeline = { 0, 0, 0.0 };
+    if (!isValid()) {
+        return timeline;
+    }
+
+    while (true) {
+        const uint32_t begin = m_State->sequence.load(std::memory_order_acquire);
+        if ((begin & 1) != 0) {
+            continue;
+        }
+
+        timeline.anchorTime = m_State->anchorTime.load(std::memory_order_relaxed);
+        timeline.anchorMedia = m_State->anchorMedia.load(std::memory_order_relaxed);
+        timeline.rate = bitsToRate(m_State->rate.load(std::memory_order_relaxed));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_State->sequence.load(std::memory_order_relaxed) == begin) {
+            return timeline;
+        }
+    }
+}
+
+uint32_t PresentationClock::getEpoch() const noexcept {
+    return isValid() ? m_State->sequence.load(std::memory_order_acquire) : 0;
+}
+
+bool PresentationClock::waitForChange(uint32_t epoch, Frame::TimestampType timeout) const noexcept {
+    if (!isValid()) {
+        return false;
+    }
+
+    timespec ts = {};
+    ts.tv_sec = static_cast<time_t>(timeout / 1000000);
+    ts.tv_nsec = static_cast<long>((timeout % 1000000) * 1000);
+
+    // the futex is shared between processes: no FUTEX_PRIVATE_FLAG
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_State->sequence), FUTEX_WAIT, epoch, &ts, NULL, 0);
+
+    return m_State->sequence.load(std::memory_order_acquire) != epoch;
+}
+
+void PresentationClock::wake() noexcept {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_State->sequence), FUTEX_WAKE, std::numeric_limits<int>::max(), NULL, NULL, 0);
+}
+
+Frame::TimestampType PresentationClock::getMediaTime(Frame::TimestampType time) const noexcept {
+    const Timeline timeline = getTimeline();
+    if ((timeline.rate <= 0.0) || (time <= timeline.anchorTime)) {
+        return timeline.anchorMedia;
+    }
+
+    return timeline.anchorMedia + static_cast<Frame::TimestampType>(static_cast<double>(time - timeline.anchorTime) * timeline.rate);
+}
+
+std::optional<Frame::TimestampType> PresentationClock::getPresentationTime(Frame::TimestampType pts) const noexcept {
+    const Timeline timeline = getTimeline();
+    if (timeline.rate <= 0.0) {
+        return std::nullopt;
+    }
+
+    return timeline.anchorTime + static_cast<Frame::TimestampType>(static_cast<double>(pts - timeline.anchorMedia) / timeline.rate);
+}
+
+void PresentationClock::publish(const Timeline& timeline) noexcept {
+    // the sequence is also the lock between writers of different processes: an odd value is owned
+    uint32_t sequence = m_State->sequence.load(std::memory_order_relaxed);
+    while (((sequence & 1) != 0) || (!m_State->sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire, std::memory_order_relaxed))) {
+        sequence = m_State->sequence.load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_State->anchorTime.store(timeline.anchorTime, std::memory_order_relaxed);
+    m_State->anchorMedia.store(timeline.anchorMedia, std::memory_order_relaxed);
+    m_State->rate.store(rateToBits(timeline.rate), std::memory_order_relaxed);
+
+    m_State->sequence.store(sequence + 2, std::memory_order_release);
+
+    wake();
+}
+
+void PresentationClock::setTimeline(const Timeline& timeline) noexcept {
+    if ((!isValid()) || (!m_Authority)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_WriterMutex);
+    publish(timeline);
+}
+
+void PresentationClock::pause() noexcept {
+    if ((!isValid()) || (!m_Authority)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_WriterMutex);
+    publish(Timeline{ now(), getMediaTime(now()), 0.0 });
+}
+
+void PresentationClock::resume(double rate, Frame::TimestampType delay) noexcept {
+    if ((!isValid()) || (!m_Authority)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_WriterMutex);
+
+    const Timeline timeline = getTimeline();
+    if (timeline.rate > 0.0) {
+        return;
+    }
+
+    publish(Timeline{ now() + delay, timeline.anchorMedia, rate });
+}
+
+void PresentationClock::armStart(uint32_t participants, Frame::TimestampType startMedia) noexcept {
+    if ((!isValid()) || (!m_Authority)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_WriterMutex);
+
+    // arrivals of the previous generation racing with this are dropped by the generation check in arrive
+    m_State->barrierExpected.store(0, std::memory_order_relaxed);
+    m_State->barrierArrived.store(0, std::memory_order_relaxed);
+    m_State->barrierStartMedia.store(startMedia, std::memory_order_relaxed);
+    m_State->barrierGeneration.fetch_add(1, std::memory_order_release);
+    m_State->barrierExpected.store(participants, std::memory_order_release);
+
+    publish(Timeline{ now(), startMedia, 0.0 });
+}
+
+PresentationClock::Barrier PresentationClock::getBarrier() const noexcept {
+    Barrier barrier = { 0, 0, 0, 0 };
+    if (!isValid()) {
+        return barrier;
+    }
+
+    barrier.generation = m_State->barrierGeneration.load(std::memory_order_acquire);
+    barrier.expected = m_State->barrierExpected.load(std::memory_order_acquire);
+    barrier.arrived = m_State->barrierArrived.load(std::memory_order_acquire);
+    barrier.startMedia = m_State->barrierStartMedia.load(std::memory_order_relaxed);
+    return barrier;
+}
+
+void PresentationClock::arrive(uint32_t generation, uint32_t count) noexcept {
+    if ((!isValid()) || (generation == 0) || (m_State->barrierGeneration.load(std::memory_order_acquire) != generation)) {
+        return;
+    }
+
+    const uint32_t arrived = m_State->barrierArrived.fetch_add(count, std::memory_order_acq_rel) + count;
+    const uint32_t expected = m_State->barrierExpected.load(std::memory_order_acquire);
+
+    // only the arrival completing the barrier starts the timeline, whatever the process it comes from
+    // (the barrier is disarmed once)
+    uint32_t armed = expected;
+    if ((expected == 0) || (arrived < expected) || (!m_State->barrierExpected.compare_exchange_strong(armed, 0, std::memory_order_acq_rel))) {
+        wake();
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_WriterMutex);
+
+    // the barrier could have been armed again in the meantime
+    if (m_State->barrierGeneration.load(std::memory_order_acquire) == generation) {
+        publish(Timeline{ now() + StartDelay, m_State->barrierStartMedia.load(std::memory_order_relaxed), 1.0 });
+    }
+}
+
+void PresentationClock::mirrorBarrier(uint32_t generation, Frame::TimestampType startMedia) noexcept {
+    if ((!isValid()) || (!m_Authority)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_WriterMutex);
+
+    if (m_State->barrierGeneration.load(std::memory_order_acquire) == generation) {
+        return;
+    }
+
+    m_State->barrierExpected.store(0, std::memory_order_relaxed);
+    m_State->barrierArrived.store(0, std::memory_order_relaxed);
+    m_State->barrierStartMedia.store(startMedia, std::memory_order_relaxed);
+    m_State->barrierGeneration.store(generation, std::memory_order_release);
+
+    wake();
+}
@@ -0,0 +1,236 @@
+#include "PresentationClockFollower.h"
+#include "PresentationClockProtocol.h"
+
+#include <cmath>
+// for memcpy
+#include <cstring>
+
+// unix datagram sockets
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * @brief Samples whose round trip exceeds the shortest one by more than this are not trusted (microseconds).
+ */
+static constexpr Frame::TimestampType RoundTripTolerance = 200;
+
+/**
+ * @brief The minimum number of samples before the drift is estimated (the offset alone is used before).
+ */
+static constexpr size_t MinimumDriftSamples = 8;
+
+PresentationClockFollower::PresentationClockFollower(PresentationClock& local, const std::string& serverPath) noexcept
+ : m_Local(local),
+ m_ServerPath(serverPath),
+ m_Socket(-1),
+ m_ShouldStop(false),
+ m_ReferenceTime(0),
+ m_Offset(0.0),
+ m_Slope(0.0),
+ m_RoundTrip(0),
+ m_Synchronized(false) {
+    if (!m_Local.isAuthority()) {
+        std::cerr << "A clock follower needs a local clock it can publish on" << std::endl;
+        return;
+    }
+
+    sockaddr_un server = {};
+    server.sun_family = AF_UNIX;
+
+    if (m_ServerPath.size() >= sizeof(server.sun_path)) {
+        std::cerr << "The clock socket path " << m_ServerPath << " is too long" << std::endl;
+        return;
+    }
+
+    std::memcpy(server.sun_path, m_ServerPath.c_str(), m_ServerPath.size() + 1);
+
+    m_Socket = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (m_Socket < 0) {
+        return;
+    }
+
+    // an autobound (abstract) address lets the server answer
+    sockaddr_un self = {};
+    self.sun_family = AF_UNIX;
+
+    if ((bind(m_Socket, reinterpret_cast<const sockaddr*>(&self), sizeof(sa_family_t)) != 0) ||
+        (connect(m_Socket, reinterpret_cast<const sockaddr*>(&server), sizeof(server)) != 0)) {
+        std::cerr << "Could not connect to the clock socket " << m_ServerPath << std::endl;
+        close(m_Socket);
+        m_Socket = -1;
+    }
+}
+
+PresentationClockFollower::~PresentationClockFollower() {
+    interrupt();
+
+    if (m_Socket >= 0) {
+        close(m_Socket);
+    }
+}
+
+bool PresentationClockFollower::isValid() const noexcept {
+    return (m_Socket >= 0) && (m_Local.isValid());
+}
+
+bool PresentationClockFollower::isSynchronized() const noexcept {
+    return m_Synchronized;
+}
+
+Frame::TimestampType PresentationClockFollower::getOffset() const noexcept {
+    const auto elapsed = static_cast<double>(PresentationClock::now() - m_ReferenceTime);
+    return static_cast<Frame::TimestampType>(std::llround(m_Offset + (m_Slope * elapsed)));
+}
+
+double PresentationClockFollower::getDrift() const noexcept {
+    return m_Slope * 1000000.0;
+}
+
+Frame::TimestampType PresentationClockFollower::getRoundTrip() const noexcept {
+    return m_RoundTrip;
+}
+
+void PresentationClockFollower::estimate() noexcept {
+    Frame::TimestampType shortest = std::numeric_limits<Frame::TimestampType>::max();
+    for (const auto& sample : m_Samples) {
+        shortest = std::min(shortest, sample.roundTrip);
+    }
+
+    // samples delayed on one way only are off by up to half their round trip: they are left out
+    std::vector<const Sample*> trusted;
+    for (const auto& sample : m_Samples) {
+        if (sample.roundTrip <= shortest + RoundTripTolerance) {
+            trusted.push_back(&sample);
+        }
+    }
+
+    const Frame::TimestampType reference = trusted.back()->time;
+
+    double meanTime = 0.0;
+    double meanOffset = 0.0;
+    for (const auto sample : trusted) {
+        meanTime += static_cast<double>(sample->time - reference);
+        meanOffset += static_cast<double>(sample->offset);
+    }
+
+    meanTime /= static_cast<double>(trusted.size());
+    meanOffset /= static_cast<double>(trusted.size());
+
+    double slope = 0.0;
+    if (trusted.size() >= MinimumDriftSamples) {
+        double covariance = 0.0;
+        double variance = 0.0;
+        for (const auto sample : trusted) {
+            const double dt = static_cast<double>(sample->time - reference) - meanTime;
+            covariance += dt * (static_cast<double>(sample->offset) - meanOffset);
+            variance += dt * dt;
+        }
+
+        if (variance > 0.0) {
+            slope = covariance / variance;
+        }
+    }
+
+    m_ReferenceTime = reference;
+    m_Offset = meanOffset - (slope * meanTime);
+    m_Slope = slope;
+    m_RoundTrip = shortest;
+    m_Synchronized = true;
+}
+
+bool PresentationClockFollower::synchronize() noexcept {
+    const auto localBarrier = m_Local.getBarrier();
+
+    PresentationClockProtocol::Request request = {};
+    request.magic = PresentationClockProtocol::Magic;
+    request.version = PresentationClockProtocol::Version;
+    request.barrierGeneration = localBarrier.generation;
+    request.arrived = localBarrier.arrived;
+    request.sendTime = PresentationClock::now();
+
+    if (send(m_Socket, &request, sizeof(request), 0) != static_cast<ssize_t>(sizeof(request))) {
+        return false;
+    }
+
+    pollfd pfd = {};
+    pfd.fd = m_Socket;
+    pfd.events = POLLIN;
+
+    // replies to earlier (timed out) requests are told apart by the echoed send time
+    PresentationClockProtocol::Reply reply;
+    while (true) {
+        if (poll(&pfd, 1, static_cast<int>(SyncInterval / 1000)) <= 0) {
+            return false;
+        }
+
+        const ssize_t received = recv(m_Socket, &reply, sizeof(reply), 0);
+        if ((received == static_cast<ssize_t>(sizeof(reply))) &&
+            (reply.magic == PresentationClockProtocol::Magic) &&
+            (reply.version == PresentationClockProtocol::Version) &&
+            (reply.requestSendTime == request.sendTime)) {
+            break;
+        }
+    }
+
+    const Frame::TimestampType receiveTime = PresentationClock::now();
+
+    Sample sample;
+    sample.time = request.sendTime + ((receiveTime - request.sendTime) / 2);
+    sample.offset = ((reply.receiveTime - request.sendTime) + (reply.sendTime - receiveTime)) / 2;
+    sample.roundTrip = (receiveTime - request.sendTime) - (reply.sendTime - reply.receiveTime);
+
+    m_Samples.push_back(sample);
+    if (m_Samples.size() > SampleWindow) {
+        m_Samples.pop_front();
+    }
+
+    estimate();
+
+    m_Local.mirrorBarrier(reply.barrierGeneration, reply.barrierStartMedia);
+
+    // server time = local time + offset(local time), with offset(t) = offset + slope * (t - reference):
+    // the anchor is moved to the local time the server reaches it at, and local time runs slower by the drift
+    const double slope = m_Slope;
+    const double localAnchor = (static_cast<double>(reply.anchorTime) - m_Offset + (slope * static_cast<double>(m_ReferenceTime))) / (1.0 + slope);
+
+    PresentationClock::Timeline timeline;
+    timeline.anchorTime = static_cast<Frame::TimestampType>(std::llround(localAnchor));
+    timeline.anchorMedia = reply.anchorMedia;
+    timeline.rate = reply.rate * (1.0 + slope);
+
+    // a timeline that moves by less than a few microseconds is not worth waking every device up
+    const bool changed = (!m_Published.has_value()) ||
+        (m_Published->anchorMedia != timeline.anchorMedia) ||
+        (std::abs(m_Published->rate - timeline.rate) > 1e-7) ||
+        (std::abs(m_Published->anchorTime - timeline.anchorTime) > 20);
+
+    if (changed) {
+        m_Local.setTimeline(timeline);
+        m_Published = timeline;
+    }
+
+    return true;
+}
+
+void PresentationClockFollower::exec() noexcept {
+    if (!isValid()) {
+        return;
+    }
+
+    while (!m_ShouldStop) {
+        const Frame::TimestampType start = PresentationClock::now();
+
+        synchronize();
+
+        const Frame::TimestampType elapsed = PresentationClock::now() - start;
+        if (elapsed < SyncInterval) {
+            std::this_thread::sleep_for(std::chrono::microseconds(SyncInterval - elapsed));
+        }
+    }
+}
+
+void PresentationClockFollower::interrupt() noexcept {
+    m_ShouldStop = true;
+}
@@ -0,0 +1,123 @@
+#include "PresentationClockServer.h"
+#include "PresentationClockProtocol.h"
+
+// for memcpy
+#include <cstring>
+
+// unix datagram sockets
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+PresentationClockServer::PresentationClockServer(PresentationClock& clock, const std::string& socketPath) noexcept
+ : m_Clock(clock),
+ m_SocketPath(socketPath),
+ m_Socket(-1),
+ m_ShouldStop(false) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+
+    if (m_SocketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "The clock socket path " << m_SocketPath << " is too long" << std::endl;
+        return;
+    }
+
+    std::memcpy(address.sun_path, m_SocketPath.c_str(), m_SocketPath.size() + 1);
+
+    m_Socket = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (m_Socket < 0) {
+        return;
+    }
+
+    // a socket left behind by a previous run would make bind fail
+    unlink(m_SocketPath.c_str());
+
+    if (bind(m_Socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Could not bind the clock socket " << m_SocketPath << std::endl;
+        close(m_Socket);
+        m_Socket = -1;
+    }
+}
+
+PresentationClockServer::~PresentationClockServer() {
+    interrupt();
+
+    if (m_Socket >= 0) {
+        close(m_Socket);
+        unlink(m_SocketPath.c_str());
+    }
+}
+
+bool PresentationClockServer::isValid() const noexcept {
+    return (m_Socket >= 0) && (m_Clock.isValid());
+}
+
+void PresentationClockServer::exec() noexcept {
+    if (!isValid()) {
+        return;
+    }
+
+    pollfd pfd = {};
+    pfd.fd = m_Socket;
+    pfd.events = POLLIN;
+
+    while (!m_ShouldStop) {
+        // the timeout is only needed to observe interrupt()
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+
+        PresentationClockProtocol::Request request;
+        sockaddr_un peer = {};
+        socklen_t peerLength = sizeof(peer);
+
+        const ssize_t received = recvfrom(m_Socket, &request, sizeof(request), 0, reinterpret_cast<sockaddr*>(&peer), &peerLength);
+
+        // t2 is taken as close to the reception as possible
+        const Frame::TimestampType receiveTime = PresentationClock::now();
+
+        if ((received != static_cast<ssize_t>(sizeof(request))) ||
+            (request.magic != PresentationClockProtocol::Magic) ||
+            (request.version != PresentationClockProtocol::Version)) {
+            continue;
+        }
+
+        const auto barrier = m_Clock.getBarrier();
+
+        // arrivals are cumulative: only the ones not counted yet are added
+        if ((request.barrierGeneration == barrier.generation) && (request.arrived > 0)) {
+            const std::string follower(reinterpret_cast<const char*>(&peer), peerLength);
+
+            auto& counted = m_Arrivals[follower];
+            if (counted.generation != barrier.generation) {
+                counted = FollowerArrivals{ barrier.generation, 0 };
+            }
+
+            if (request.arrived > counted.arrived) {
+                m_Clock.arrive(barrier.generation, request.arrived - counted.arrived);
+                counted.arrived = request.arrived;
+            }
+        }
+
+        const auto timeline = m_Clock.getTimeline();
+
+        PresentationClockProtocol::Reply reply = {};
+        reply.magic = PresentationClockProtocol::Magic;
+        reply.version = PresentationClockProtocol::Version;
+        reply.requestSendTime = request.sendTime;
+        reply.receiveTime = receiveTime;
+        reply.anchorTime = timeline.anchorTime;
+        reply.anchorMedia = timeline.anchorMedia;
+        reply.rate = timeline.rate;
+        reply.barrierGeneration = barrier.generation;
+        reply.barrierStartMedia = barrier.startMedia;
+        reply.sendTime = PresentationClock::now();
+
+        sendto(m_Socket, &reply, sizeof(reply), MSG_DONTWAIT, reinterpret_cast<const sockaddr*>(&peer), peerLength);
+    }
+}
+
+void PresentationClockServer::interrupt() noexcept {
+    m_ShouldStop = true;
+}
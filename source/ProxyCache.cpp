@@ -0,0 +1,448 @@
+#include "ProxyCache.h"
+
+#include "FFMPEGCommon.h"
+
+#include <cstdio>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Every resource used while transcoding an asset, freed when it goes out of scope.
+ */
+struct Transcoding {
+    Transcoding() noexcept
+     : inputCtx(NULL),
+     decoderCtx(NULL),
+     encoderCtx(NULL),
+     outputCtx(NULL),
+     swsCtx(NULL),
+     decoded(NULL),
+     scaled(NULL),
+     packet(NULL),
+     inputStream(-1) {
+
+    }
+
+    ~Transcoding() {
+        if ((outputCtx != NULL) && ((outputCtx->oformat->flags & AVFMT_NOFILE) == 0)) {
+            avio_closep(&outputCtx->pb);
+        }
+
+        avformat_free_context(outputCtx);
+        av_packet_free(&packet);
+        av_frame_free(&scaled);
+        av_frame_free(&decoded);
+        sws_freeContext(swsCtx);
+        avcodec_free_context(&encoderCtx);
+        avcodec_free_context(&decoderCtx);
+        avformat_close_input(&inputCtx);
+    }
+
+    AVFormatContext* inputCtx;
+
+    AVCodecContext* decoderCtx;
+
+    AVCodecContext* encoderCtx;
+
+    AVFormatContext* outputCtx;
+
+    SwsContext* swsCtx;
+
+    AVFrame* decoded;
+
+    AVFrame* scaled;
+
+    AVPacket* packet;
+
+    int inputStream;
+};
+
+/**
+ * @brief Get the modification time of a file.
+ *
+ * @return the size of the file, or an empty value if it does not exist
+ */
+static std::optional<uint64_t> fileStatus(const Decoder::FileNameType& filename, int64_t& mtime) noexcept {
+    struct stat status;
+    if (stat(filename.c_str(), &status) != 0) {
+        return std::nullopt;
+    }
+
+    mtime = static_cast<int64_t>(status.st_mtime);
+    return static_cast<uint64_t>(status.st_size);
+}
+
+ProxyCache::ProxyCache(const Options& options) noexcept
+ : m_Options(options),
+ m_Stopping(false),
+ m_Statistics{} {
+    m_Thread = std::thread([this]() {
+        transcodingLoop();
+    });
+}
+
+ProxyCache::~ProxyCache() {
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        m_Stopping = true;
+    }
+
+    m_Wakeup.notify_all();
+    m_Thread.join();
+}
+
+const ProxyCache::Options& ProxyCache::getOptions() const noexcept {
+    return m_Options;
+}
+
+Decoder::FileNameType ProxyCache::getProxyFilename(const Decoder::FileNameType& original) noexcept {
+    const auto slash = original.find_last_of('/');
+    const auto directory = (slash != Decoder::FileNameType::npos) ? original.substr(0, slash + 1) : Decoder::FileNameType();
+    const auto name = (slash != Decoder::FileNameType::npos) ? original.substr(slash + 1) : original;
+
+    return directory + "." + name + ".proxy.mkv";
+}
+
+ProxyCache::Entry* ProxyCache::track(const Decoder::FileNameType& original) noexcept {
+    const auto proxy = getProxyFilename(original);
+
+    int64_t originalTime = 0;
+    int64_t proxyTime = 0;
+    const auto bytes = fileStatus(proxy, proxyTime);
+    if ((!bytes.has_value()) || (!fileStatus(original, originalTime).has_value())) {
+        forget(original);
+        return nullptr;
+    }
+
+    // the asset changed after its proxy was written
+    if (proxyTime < originalTime) {
+        forget(original);
+        unlink(proxy.c_str());
+        return nullptr;
+    }
+
+    auto entry = m_Entries.find(original);
+    if (entry == m_Entries.end()) {
+        entry = m_Entries.emplace(original, Entry{ proxy, bytes.value(), proxyTime }).first;
+        m_Statistics.bytes += bytes.value();
+        ++m_Statistics.proxies;
+    }
+
+    return &entry->second;
+}
+
+void ProxyCache::forget(const Decoder::FileNameType& original) noexcept {
+    const auto entry = m_Entries.find(original);
+    if (entry != m_Entries.end()) {
+        m_Statistics.bytes -= entry->second.bytes;
+        --m_Statistics.proxies;
+        m_Entries.erase(entry);
+    }
+}
+
+std::optional<Decoder::FileNameType> ProxyCache::lookup(const Decoder::FileNameType& original) noexcept {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    Entry* entry = track(original);
+    if (entry == nullptr) {
+        return std::nullopt;
+    }
+
+    // the modification time of proxies records their use: it survives restarts and keeps them newer than their asset
+    utimensat(AT_FDCWD, entry->proxy.c_str(), NULL, 0);
+    entry->lastUse = static_cast<int64_t>(time(NULL));
+
+    return entry->proxy;
+}
+
+void ProxyCache::request(const Decoder::FileNameType& original) noexcept {
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+
+        const bool queued = (m_Transcoding == original) ||
+            (std::find(m_Requests.begin(), m_Requests.end(), original) != m_Requests.end());
+
+        if ((queued) || (track(original) != nullptr)) {
+            return;
+        }
+
+        m_Requests.push_back(original);
+        m_Statistics.pending = m_Requests.size();
+    }
+
+    m_Wakeup.notify_one();
+}
+
+ProxyCache::Statistics ProxyCache::getStatistics() const noexcept {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    return m_Statistics;
+}
+
+void ProxyCache::evict() noexcept {
+    while ((m_Statistics.bytes > m_Options.budget) && (!m_Entries.empty())) {
+        auto oldest = m_Entries.begin();
+        for (auto entry = m_Entries.begin(); entry != m_Entries.end(); ++entry) {
+            if (entry->second.lastUse < oldest->second.lastUse) {
+                oldest = entry;
+            }
+        }
+
+        // a decoder still reading the proxy keeps its data until the file is closed
+        unlink(oldest->second.proxy.c_str());
+        forget(oldest->first);
+        ++m_Statistics.evicted;
+    }
+}
+
+void ProxyCache::transcodingLoop() noexcept {
+    // the thread only runs when no other thread wants the CPU
+    struct sched_param parameters = {};
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &parameters) != 0) {
+        std::cerr << "Could not lower the priority of the proxy transcoding thread" << std::endl;
+    }
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    while (true) {
+        m_Wakeup.wait(lock, [this]() { return (m_Stopping) || (!m_Requests.empty()); });
+        if (m_Stopping) {
+            return;
+        }
+
+        m_Transcoding = m_Requests.front();
+        m_Requests.pop_front();
+        m_Statistics.pending = m_Requests.size();
+
+        const auto original = m_Transcoding;
+        const auto proxy = getProxyFilename(original);
+
+        // the proxy appears complete or not at all
+        const auto partial = proxy + ".part";
+
+        lock.unlock();
+        const bool transcoded = transcode(original, partial) && (rename(partial.c_str(), proxy.c_str()) == 0);
+        if (!transcoded) {
+            unlink(partial.c_str());
+        }
+        lock.lock();
+
+        m_Transcoding.clear();
+
+        if ((!transcoded) || (track(original) == nullptr)) {
+            if (!m_Stopping) {
+                std::cerr << "Could not make a proxy of " << original << std::endl;
+                ++m_Statistics.failed;
+            }
+
+            continue;
+        }
+
+        ++m_Statistics.transcoded;
+
+        // a proxy larger than the whole budget would only evict every other proxy
+        if (m_Entries[original].bytes > m_Options.budget) {
+            unlink(proxy.c_str());
+            forget(original);
+            ++m_Statistics.evicted;
+            continue;
+        }
+
+        // the new proxy has just been used
+        m_Entries[original].lastUse = static_cast<int64_t>(time(NULL));
+        evict();
+    }
+}
+
+bool ProxyCache::writePackets(AVCodecContext* encoderCtx, AVFormatContext* outputCtx) noexcept {
+    AVPacket* packet = av_packet_alloc();
+    if (packet == NULL) {
+        return false;
+    }
+
+    bool written = true;
+    while (avcodec_receive_packet(encoderCtx, packet) >= 0) {
+        av_packet_rescale_ts(packet, encoderCtx->time_base, outputCtx->streams[0]->time_base);
+        packet->stream_index = 0;
+
+        if (av_interleaved_write_frame(outputCtx, packet) < 0) {
+            written = false;
+            break;
+        }
+    }
+
+    av_packet_free(&packet);
+
+    return written;
+}
+
+bool ProxyCache::transcode(const Decoder::FileNameType& original, const Decoder::FileNameType& proxy) noexcept {
+    Transcoding t;
+
+    if ((avformat_open_input(&t.inputCtx, original.c_str(), NULL, NULL) < 0) || (avformat_find_stream_info(t.inputCtx, NULL) < 0)) {
+        return false;
+    }
+
+    t.inputStream = av_find_best_stream(t.inputCtx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (t.inputStream < 0) {
+        return false;
+    }
+
+    const AVStream* inputStream = t.inputCtx->streams[t.inputStream];
+    const AVCodec* decoder = avcodec_find_decoder(inputStream->codecpar->codec_id);
+    if (decoder == nullptr) {
+        return false;
+    }
+
+    t.decoderCtx = avcodec_alloc_context3(decoder);
+    if ((t.decoderCtx == NULL) || (avcodec_parameters_to_context(t.decoderCtx, inputStream->codecpar) < 0)) {
+        return false;
+    }
+
+    // proxies have even sizes (chroma is subsampled 2x2), no larger than the original
+    const auto size = FFMPEGCommon::fitInside(
+        t.decoderCtx->width,
+        t.decoderCtx->height,
+        std::min<uint32_t>(m_Options.maxWidth, t.decoderCtx->width),
+        std::min<uint32_t>(m_Options.maxHeight, t.decoderCtx->height)
+    );
+
+    const int width = std::max(static_cast<int>(size.first & ~1u), 2);
+    const int height = std::max(static_cast<int>(size.second & ~1u), 2);
+
+    // when the codec supports it, the decoder itself produces smaller frames
+    t.decoderCtx->lowres = FFMPEGCommon::lowresFactor(decoder, t.decoderCtx->width, t.decoderCtx->height, width, height);
+    if (avcodec_open2(t.decoderCtx, decoder, NULL) < 0) {
+        return false;
+    }
+
+    const AVCodec* encoder = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    if (encoder == nullptr) {
+        std::cerr << "No MJPEG encoder for proxies" << std::endl;
+        return false;
+    }
+
+    if ((avformat_alloc_output_context2(&t.outputCtx, NULL, "matroska", proxy.c_str()) < 0) || (t.outputCtx == NULL)) {
+        return false;
+    }
+
+    // timestamps of the original are kept as they are
+    t.encoderCtx = avcodec_alloc_context3(encoder);
+    if (t.encoderCtx == NULL) {
+        return false;
+    }
+
+    t.encoderCtx->width = width;
+    t.encoderCtx->height = height;
+    t.encoderCtx->pix_fmt = AV_PIX_FMT_YUVJ420P;
+    t.encoderCtx->time_base = inputStream->time_base;
+    t.encoderCtx->sample_aspect_ratio = inputStream->codecpar->sample_aspect_ratio;
+
+    // samples keep the transfer, primaries and matrix of the original (only the range becomes full, as in every JPEG):
+    // proxies of HDR assets are tagged as such, and are tone mapped at playback as their originals are
+    t.encoderCtx->color_primaries = inputStream->codecpar->color_primaries;
+    t.encoderCtx->color_trc = inputStream->codecpar->color_trc;
+    t.encoderCtx->colorspace = inputStream->codecpar->color_space;
+    t.encoderCtx->color_range = AVCOL_RANGE_JPEG;
+
+    t.encoderCtx->flags |= AV_CODEC_FLAG_QSCALE;
+    t.encoderCtx->global_quality = FF_QP2LAMBDA * m_Options.quality;
+    if ((t.outputCtx->oformat->flags & AVFMT_GLOBALHEADER) != 0) {
+        t.encoderCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    if (avcodec_open2(t.encoderCtx, encoder, NULL) < 0) {
+        return false;
+    }
+
+    AVStream* outputStream = avformat_new_stream(t.outputCtx, NULL);
+    if ((outputStream == NULL) || (avcodec_parameters_from_context(outputStream->codecpar, t.encoderCtx) < 0)) {
+        return false;
+    }
+
+    outputStream->time_base = inputStream->time_base;
+    outputStream->avg_frame_rate = inputStream->avg_frame_rate;
+    outputStream->sample_aspect_ratio = inputStream->sample_aspect_ratio;
+
+    if ((avio_open(&t.outputCtx->pb, proxy.c_str(), AVIO_FLAG_WRITE) < 0) || (avformat_write_header(t.outputCtx, NULL) < 0)) {
+        return false;
+    }
+
+    t.decoded = av_frame_alloc();
+    t.scaled = av_frame_alloc();
+    t.packet = av_packet_alloc();
+    if ((t.decoded == NULL) || (t.scaled == NULL) || (t.packet == NULL)) {
+        return false;
+    }
+
+    t.scaled->format = AV_PIX_FMT_YUVJ420P;
+    t.scaled->width = width;
+    t.scaled->height = height;
+    if (av_frame_get_buffer(t.scaled, 0) < 0) {
+        return false;
+    }
+
+    bool draining = false;
+    while (!m_Stopping) {
+        int ret = avcodec_receive_frame(t.decoderCtx, t.decoded);
+        if (ret == AVERROR_EOF) {
+            break;
+        } else if (ret == AVERROR(EAGAIN)) {
+            if (draining) {
+                break;
+            }
+
+            if (av_read_frame(t.inputCtx, t.packet) < 0) {
+                // end of file: get the frames still buffered inside the decoder
+                avcodec_send_packet(t.decoderCtx, NULL);
+                draining = true;
+                continue;
+            }
+
+            ret = (t.packet->stream_index == t.inputStream) ? avcodec_send_packet(t.decoderCtx, t.packet) : 0;
+            av_packet_unref(t.packet);
+
+            if ((ret < 0) && (ret != AVERROR(EAGAIN))) {
+                return false;
+            }
+
+            continue;
+        } else if (ret < 0) {
+            return false;
+        }
+
+        // the size of decoded frames can change mid-stream
+        t.swsCtx = sws_getCachedContext(
+            t.swsCtx,
+            t.decoded->width, t.decoded->height, static_cast<AVPixelFormat>(t.decoded->format),
+            width, height, AV_PIX_FMT_YUVJ420P,
+            SWS_BICUBIC, NULL, NULL, NULL
+        );
+
+        if ((t.swsCtx == NULL) || (av_frame_make_writable(t.scaled) < 0)) {
+            return false;
+        }
+
+        sws_scale(t.swsCtx, t.decoded->data, t.decoded->linesize, 0, t.decoded->height, t.scaled->data, t.scaled->linesize);
+        t.scaled->pts = t.decoded->best_effort_timestamp;
+        av_frame_unref(t.decoded);
+
+        if ((avcodec_send_frame(t.encoderCtx, t.scaled) < 0) || (!writePackets(t.encoderCtx, t.outputCtx))) {
+            return false;
+        }
+    }
+
+    if (m_Stopping) {
+        return false;
+    }
+
+    avcodec_send_frame(t.encoderCtx, NULL);
+    if (!writePackets(t.encoderCtx, t.outputCtx)) {
+        return false;
+    }
+
+    return av_write_trailer(t.outputCtx) >= 0;
+}
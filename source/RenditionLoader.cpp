@@ -0,0 +1,194 @@
+#include "RenditionLoader.h"
+
+#include "FFMPEGCommon.h"
+
+/**
+ * @brief Open a file and the decoder of its first video stream.
+ *
+ * @return true IIF the codec context is ready to decode
+ */
+static bool openVideoStream(const Decoder::FileNameType& filename, AVFormatContext*& formatCtx, AVCodecContext*& codecCtx, int& videoStream) noexcept {
+    if (avformat_open_input(&formatCtx, filename.c_str(), NULL, NULL) < 0) {
+        std::cerr << "Could not open the rendition " << filename << std::endl;
+        return false;
+    }
+
+    if (avformat_find_stream_info(formatCtx, NULL) < 0) {
+        std::cerr << "Could not find stream information " << filename << std::endl;
+        return false;
+    }
+
+    videoStream = av_find_best_stream(formatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (videoStream < 0) {
+        std::cerr << "No video stream in " << filename << std::endl;
+        return false;
+    }
+
+    const AVCodecParameters* codecpar = formatCtx->streams[videoStream]->codecpar;
+
+    const AVCodec* codec = avcodec_find_decoder(codecpar->codec_id);
+    if (codec == nullptr) {
+        std::cerr << "Unsupported codec for " << filename << std::endl;
+        return false;
+    }
+
+    codecCtx = avcodec_alloc_context3(codec);
+    if ((codecCtx == NULL) || (avcodec_parameters_to_context(codecCtx, codecpar) < 0) || (avcodec_open2(codecCtx, codec, NULL) < 0)) {
+        std::cerr << "Could not open codec for " << filename << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+RenditionLoader::RenditionLoader() noexcept
+ : m_Cancel(false),
+ m_Done(false),
+ m_Failed(false),
+ m_Prepared{ 0, NULL, NULL, -1, NULL, 0 } {
+
+}
+
+RenditionLoader::~RenditionLoader() {
+    cancel();
+}
+
+std::optional<RenditionLoader::Rendition> RenditionLoader::probe(const Decoder::FileNameType& filename) noexcept {
+    AVFormatContext* formatCtx = NULL;
+    if (avformat_open_input(&formatCtx, filename.c_str(), NULL, NULL) < 0) {
+        std::cerr << "Could not open the rendition " << filename << std::endl;
+        return std::nullopt;
+    }
+
+    std::optional<Rendition> rendition;
+    if (avformat_find_stream_info(formatCtx, NULL) >= 0) {
+        const int videoStream = av_find_best_stream(formatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+        if (videoStream >= 0) {
+            const AVCodecParameters* codecpar = formatCtx->streams[videoStream]->codecpar;
+            rendition = Rendition{
+                filename,
+                static_cast<uint32_t>(codecpar->width),
+                static_cast<uint32_t>(codecpar->height),
+                codecpar->bit_rate
+            };
+        }
+    }
+
+    avformat_close_input(&formatCtx);
+
+    return rendition;
+}
+
+void RenditionLoader::prepare(size_t index, const Decoder::FileNameType& filename, Frame::TimestampType from) noexcept {
+    cancel();
+
+    m_Cancel = false;
+    m_Done = false;
+    m_Failed = false;
+    m_Pending = index;
+    m_Prepared = Prepared{ index, NULL, NULL, -1, NULL, 0 };
+
+    // the thread inherits the placement of the decoding thread
+    m_Thread = std::thread([this, filename, from]() {
+        load(filename, from);
+    });
+}
+
+void RenditionLoader::load(Decoder::FileNameType filename, Frame::TimestampType from) noexcept {
+    Prepared& prepared = m_Prepared;
+
+    bool ready = openVideoStream(filename, prepared.formatCtx, prepared.codecCtx, prepared.videoStream);
+
+    AVPacket* packet = av_packet_alloc();
+    prepared.keyframe = av_frame_alloc();
+    ready = (ready) && (packet != NULL) && (prepared.keyframe != NULL);
+
+    if (ready) {
+        const AVRational timeBase = prepared.formatCtx->streams[prepared.videoStream]->time_base;
+
+        // without AVSEEK_FLAG_BACKWARD the demuxer goes to the first keyframe at or after the timestamp
+        ready = av_seek_frame(prepared.formatCtx, prepared.videoStream, av_rescale_q(from, AV_TIME_BASE_Q, timeBase), 0) >= 0;
+
+        bool decoded = false;
+        while ((ready) && (!decoded) && (!m_Cancel)) {
+            const int ret = avcodec_receive_frame(prepared.codecCtx, prepared.keyframe);
+            if (ret >= 0) {
+                // frames preceding the target (demuxers that can only seek backward) are skipped
+                prepared.pts = FFMPEGCommon::presentationTimestamp(prepared.keyframe, timeBase);
+                decoded = ((prepared.keyframe->flags & AV_FRAME_FLAG_KEY) != 0) && (prepared.pts >= from);
+                continue;
+            } else if (ret != AVERROR(EAGAIN)) {
+                ready = false;
+                break;
+            }
+
+            if (av_read_frame(prepared.formatCtx, packet) < 0) {
+                ready = false;
+                break;
+            }
+
+            if (packet->stream_index == prepared.videoStream) {
+                avcodec_send_packet(prepared.codecCtx, packet);
+            }
+
+            av_packet_unref(packet);
+        }
+
+        ready = (ready) && (decoded);
+    }
+
+    av_packet_free(&packet);
+
+    if (!ready) {
+        release(prepared);
+    }
+
+    m_Failed = !ready;
+    m_Done = true;
+}
+
+std::optional<size_t> RenditionLoader::getPending() const noexcept {
+    return m_Pending;
+}
+
+std::optional<Frame::TimestampType> RenditionLoader::getReadyTimestamp() const noexcept {
+    if ((!m_Pending.has_value()) || (!m_Done) || (m_Failed)) {
+        return std::nullopt;
+    }
+
+    return m_Prepared.pts;
+}
+
+bool RenditionLoader::take(Prepared& prepared) noexcept {
+    if (!getReadyTimestamp().has_value()) {
+        return false;
+    }
+
+    if (m_Thread.joinable()) {
+        m_Thread.join();
+    }
+
+    prepared = m_Prepared;
+    m_Prepared = Prepared{ 0, NULL, NULL, -1, NULL, 0 };
+    m_Pending.reset();
+
+    return true;
+}
+
+void RenditionLoader::cancel() noexcept {
+    m_Cancel = true;
+
+    if (m_Thread.joinable()) {
+        m_Thread.join();
+    }
+
+    release(m_Prepared);
+    m_Pending.reset();
+}
+
+void RenditionLoader::release(Prepared& prepared) noexcept {
+    av_frame_free(&prepared.keyframe);
+    avcodec_free_context(&prepared.codecCtx);
+    avformat_close_input(&prepared.formatCtx);
+    prepared.videoStream = -1;
+}
@@ -0,0 +1,363 @@
+#include "SharedMemoryFrameOutputDevice.h"
+
+// for memcpy
+#include <cstring>
+
+#include <chrono>
+
+// memfd, shm_open, mmap, eventfd and fd passing
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+static size_t roundUp(size_t value, size_t alignment) noexcept {
+    return ((value + alignment - 1) / alignment) * alignment;
+}
+
+SharedMemoryFrameOutputDevice::SharedMemoryFrameOutputDevice(
+    BufferedFrameOutputDevice::FrameCountType frameCount,
+    size_t maxFrameSize,
+    const std::string& name
+) noexcept
+ : BufferedFrameOutputDevice(frameCount),
+ m_Name(name),
+ m_MemoryFd(-1),
+ m_ReadyFd(-1),
+ m_ReleaseFd(-1),
+ m_Mapping(nullptr),
+ m_MappingSize(0),
+ m_MaxFrameSize(maxFrameSize),
+ m_NextSequence(1),
+ m_ShouldStop(false),
+ m_InFlight(frameCount) {
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    // slots are page aligned so that consumers can import them (e.g. as GPU host memory) one by one
+    const size_t slotStride = roundUp(maxFrameSize, pageSize);
+    const size_t dataOffset = roundUp(sizeof(SharedFrameRing::Header) + (sizeof(SharedFrameRing::SlotHeader) * frameCount), pageSize);
+    m_MappingSize = dataOffset + (slotStride * frameCount);
+
+    if ((!m_Name.empty()) && (m_Name[0] == '/')) {
+        m_MemoryFd = shm_open(m_Name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    } else {
+        m_MemoryFd = memfd_create(m_Name.c_str(), MFD_CLOEXEC);
+    }
+
+    if (m_MemoryFd < 0) {
+        std::cerr << "Could not create shared memory " << m_Name << std::endl;
+        return;
+    }
+
+    if (ftruncate(m_MemoryFd, static_cast<off_t>(m_MappingSize)) != 0) {
+        std::cerr << "Could not resize shared memory " << m_Name << " to " << m_MappingSize << " bytes" << std::endl;
+        return;
+    }
+
+    void* mapping = mmap(nullptr, m_MappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_MemoryFd, 0);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Could not map shared memory " << m_Name << std::endl;
+        return;
+    }
+
+    m_ReadyFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    m_ReleaseFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if ((m_ReadyFd < 0) || (m_ReleaseFd < 0)) {
+        std::cerr << "Could not create eventfd for " << m_Name << std::endl;
+        munmap(mapping, m_MappingSize);
+        return;
+    }
+
+    // the header is written before any consumer can access the memory: the mapping is zero-filled
+    auto header = SharedFrameRing::header(mapping);
+    header->magic = SharedFrameRing::Magic;
+    header->version = SharedFrameRing::Version;
+    header->slotCount = frameCount;
+    header->reserved = 0;
+    header->slotStride = slotStride;
+    header->dataOffset = dataOffset;
+    header->publishedSequence.store(0, std::memory_order_relaxed);
+
+    for (uint32_t i = 0; i < frameCount; ++i) {
+        SharedFrameRing::slot(mapping, i)->state.store(static_cast<uint32_t>(SharedFrameRing::SlotState::Free), std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_Mapping = mapping;
+}
+
+SharedMemoryFrameOutputDevice::~SharedMemoryFrameOutputDevice() {
+    interrupt();
+
+    // in-flight frames give their slot back to the ring, so the mapping must still be valid here
+    for (auto& frame : m_InFlight) {
+        frame.reset();
+    }
+
+    if (m_Mapping != nullptr) {
+        munmap(m_Mapping, m_MappingSize);
+    }
+
+    if (m_ReadyFd >= 0) {
+        close(m_ReadyFd);
+    }
+
+    if (m_ReleaseFd >= 0) {
+        close(m_ReleaseFd);
+    }
+
+    if (m_MemoryFd >= 0) {
+        close(m_MemoryFd);
+
+        if ((!m_Name.empty()) && (m_Name[0] == '/')) {
+            shm_unlink(m_Name.c_str());
+        }
+    }
+}
+
+bool SharedMemoryFrameOutputDevice::isValid() const noexcept {
+    return m_Mapping != nullptr;
+}
+
+int SharedMemoryFrameOutputDevice::getMemoryFileDescriptor() const noexcept {
+    return m_MemoryFd;
+}
+
+int SharedMemoryFrameOutputDevice::getReadyFileDescriptor() const noexcept {
+    return m_ReadyFd;
+}
+
+int SharedMemoryFrameOutputDevice::getReleaseFileDescriptor() const noexcept {
+    return m_ReleaseFd;
+}
+
+size_t SharedMemoryFrameOutputDevice::getMappingSize() const noexcept {
+    return m_MappingSize;
+}
+
+std::optional<uint32_t> SharedMemoryFrameOutputDevice::slotIndexOf(const void* mem) const noexcept {
+    if (!isValid()) {
+        return std::nullopt;
+    }
+
+    const auto header = SharedFrameRing::header(m_Mapping);
+    const auto base = reinterpret_cast<const uint8_t*>(SharedFrameRing::pixels(m_Mapping, 0));
+    const auto ptr = reinterpret_cast<const uint8_t*>(mem);
+
+    if ((ptr < base) || (ptr >= base + (header->slotStride * header->slotCount))) {
+        return std::nullopt;
+    }
+
+    const size_t offset = static_cast<size_t>(ptr - base);
+    if ((offset % header->slotStride) != 0) {
+        return std::nullopt;
+    }
+
+    return static_cast<uint32_t>(offset / header->slotStride);
+}
+
+void* SharedMemoryFrameOutputDevice::allocate(size_t size, SlotType& slot) noexcept {
+    if ((!isValid()) || (size > m_MaxFrameSize)) {
+        return nullptr;
+    }
+
+    const auto freeState = static_cast<uint32_t>(SharedFrameRing::SlotState::Free);
+    const auto writingState = static_cast<uint32_t>(SharedFrameRing::SlotState::Writing);
+
+    while (!m_ShouldStop) {
+        for (uint32_t i = 0; i < getFramesCount(); ++i) {
+            uint32_t expected = freeState;
+            if (SharedFrameRing::slot(m_Mapping, i)->state.compare_exchange_strong(expected, writingState, std::memory_order_acquire)) {
+                slot = i;
+                return SharedFrameRing::pixels(m_Mapping, i);
+            }
+        }
+
+        // the consumer is late: make room recycling a frame it will never look at
+        if (reclaimSupersededSlot()) {
+            continue;
+        }
+
+        // slots are freed by the exec loop: the timeout covers a notification sent between the scan and the wait
+        std::unique_lock<std::mutex> lk(m_SlotsMutex);
+        m_SlotFreed.wait_for(lk, std::chrono::milliseconds(5));
+    }
+
+    return nullptr;
+}
+
+void SharedMemoryFrameOutputDevice::deallocate(void* mem, SlotType slot) noexcept {
+    if ((!isValid()) || (slot >= getFramesCount())) {
+        return;
+    }
+
+    SharedFrameRing::slot(m_Mapping, slot)->state.store(static_cast<uint32_t>(SharedFrameRing::SlotState::Free), std::memory_order_release);
+    m_SlotFreed.notify_one();
+}
+
+void SharedMemoryFrameOutputDevice::enqueueFrame(Frame&& frame) noexcept {
+    if ((!isValid()) || (!frame.isHoldingData())) {
+        return;
+    }
+
+    const size_t size = frame.getSizeInBytes();
+
+    auto index = slotIndexOf(frame.getRawBuffer());
+    if (!index.has_value()) {
+        // the frame was not allocated by this device: copy it inside a shared slot
+        Frame copy(frame.getPixelFormat(), frame.getWidth(), frame.getHeight());
+        copy.setPresentationTimestamp(frame.getPresentationTimestamp());
+        copy.setSourceIndex(frame.getSourceIndex());
+        copy.setDirtyRect(frame.getDirtyRect());
+        copy.storeFrameData(this, [&frame, size](void* mem) {
+            std::memcpy(mem, frame.getRawBuffer(), size);
+        });
+
+        if (!copy.isHoldingData()) {
+            return;
+        }
+
+        index = slotIndexOf(copy.getRawBuffer());
+        frame = std::move(copy);
+    }
+
+    auto slot = SharedFrameRing::slot(m_Mapping, index.value());
+    slot->pixelFormat = static_cast<uint32_t>(frame.getPixelFormat());
+    slot->width = frame.getWidth();
+    slot->height = frame.getHeight();
+    slot->stride = frame.getStride();
+    slot->size = size;
+    slot->sequence = m_NextSequence++;
+    slot->pts = frame.getPresentationTimestamp();
+
+    const uint64_t sequence = slot->sequence;
+
+    // keep the frame alive (and the slot owned) until the consumer releases it
+    {
+        std::lock_guard<std::mutex> guard(m_InFlightMutex);
+        m_InFlight[index.value()].emplace(std::move(frame));
+    }
+
+    slot->state.store(static_cast<uint32_t>(SharedFrameRing::SlotState::Published), std::memory_order_release);
+    SharedFrameRing::header(m_Mapping)->publishedSequence.store(sequence, std::memory_order_release);
+
+    const uint64_t one = 1;
+    ssize_t written = write(m_ReadyFd, &one, sizeof(one));
+    (void)written;
+}
+
+void SharedMemoryFrameOutputDevice::reclaimSlot(uint32_t index) noexcept {
+    // the caller has moved the slot to Writing, so no other thread can reclaim it concurrently
+    std::optional<Frame> frame;
+
+    {
+        std::lock_guard<std::mutex> guard(m_InFlightMutex);
+        frame.swap(m_InFlight[index]);
+    }
+
+    // destroying the frame outside of the lock calls deallocate, that marks the slot as free
+    if (!frame.has_value()) {
+        SharedFrameRing::slot(m_Mapping, index)->state.store(static_cast<uint32_t>(SharedFrameRing::SlotState::Free), std::memory_order_release);
+        m_SlotFreed.notify_one();
+    }
+}
+
+bool SharedMemoryFrameOutputDevice::reclaimSupersededSlot() noexcept {
+    const auto publishedState = static_cast<uint32_t>(SharedFrameRing::SlotState::Published);
+    const auto writingState = static_cast<uint32_t>(SharedFrameRing::SlotState::Writing);
+    const uint64_t newest = SharedFrameRing::header(m_Mapping)->publishedSequence.load(std::memory_order_acquire);
+
+    std::optional<uint32_t> oldest;
+    uint64_t oldestSequence = newest;
+    for (uint32_t i = 0; i < getFramesCount(); ++i) {
+        auto slot = SharedFrameRing::slot(m_Mapping, i);
+        if ((slot->state.load(std::memory_order_acquire) == publishedState) && (slot->sequence < oldestSequence)) {
+            oldest = i;
+            oldestSequence = slot->sequence;
+        }
+    }
+
+    if (!oldest.has_value()) {
+        return false;
+    }
+
+    // the consumer may have started reading it in the meantime
+    uint32_t expected = publishedState;
+    if (!SharedFrameRing::slot(m_Mapping, oldest.value())->state.compare_exchange_strong(expected, writingState, std::memory_order_acq_rel)) {
+        return false;
+    }
+
+    reclaimSlot(oldest.value());
+    return true;
+}
+
+void SharedMemoryFrameOutputDevice::reclaimReleasedSlots() noexcept {
+    const auto releasedState = static_cast<uint32_t>(SharedFrameRing::SlotState::Released);
+    const auto writingState = static_cast<uint32_t>(SharedFrameRing::SlotState::Writing);
+
+    for (uint32_t i = 0; i < getFramesCount(); ++i) {
+        // the decoder thread may be reclaiming slots too: only the thread winning the exchange owns the slot
+        uint32_t expected = releasedState;
+        if (SharedFrameRing::slot(m_Mapping, i)->state.compare_exchange_strong(expected, writingState, std::memory_order_acq_rel)) {
+            reclaimSlot(i);
+        }
+    }
+}
+
+void SharedMemoryFrameOutputDevice::exec() noexcept {
+    if (!isValid()) {
+        return;
+    }
+
+    pollfd pfd = {};
+    pfd.fd = m_ReleaseFd;
+    pfd.events = POLLIN;
+
+    while (!m_ShouldStop) {
+        // the timeout is only needed to observe interrupt()
+        if (poll(&pfd, 1, 100) > 0) {
+            uint64_t count = 0;
+            ssize_t readBytes = read(m_ReleaseFd, &count, sizeof(count));
+            (void)readBytes;
+        }
+
+        reclaimReleasedSlots();
+    }
+}
+
+void SharedMemoryFrameOutputDevice::interrupt() noexcept {
+    m_ShouldStop = true;
+    m_SlotFreed.notify_all();
+}
+
+bool SharedMemoryFrameOutputDevice::sendFileDescriptors(int unixSocket) const noexcept {
+    if (!isValid()) {
+        return false;
+    }
+
+    const int fds[3] = { m_MemoryFd, m_ReadyFd, m_ReleaseFd };
+
+    uint64_t mappingSize = m_MappingSize;
+    iovec iov = {};
+    iov.iov_base = &mappingSize;
+    iov.iov_len = sizeof(mappingSize);
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    return sendmsg(unixSocket, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(mappingSize));
+}
@@ -0,0 +1,61 @@
+#include "Stages/CropFrameStage.h"
+
+// ffmpeg
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+}
+
+CropFrameStage::CropFrameStage(const Frame::Rect& rect) noexcept
+ : m_Rect(rect),
+ m_Clipped(rect) {
+
+}
+
+CropFrameStage::~CropFrameStage() {
+
+}
+
+FrameStage::Access CropFrameStage::getAccess() const noexcept {
+    return Access::View;
+}
+
+bool CropFrameStage::accepts(int pixelFormat) const noexcept {
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(pixelFormat));
+
+    // bitstream formats have no addressable pixels
+    return (descriptor != NULL) && ((descriptor->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM)) == 0);
+}
+
+int CropFrameStage::getPreferredInput() const noexcept {
+    return AV_PIX_FMT_YUV420P;
+}
+
+std::optional<FrameStage::Format> CropFrameStage::configure(const Format& input, size_t workers) noexcept {
+    if ((m_Rect.x >= input.width) || (m_Rect.y >= input.height)) {
+        return std::nullopt;
+    }
+
+    m_Clipped = Frame::Rect{
+        m_Rect.x,
+        m_Rect.y,
+        std::min(m_Rect.width, input.width - m_Rect.x),
+        std::min(m_Rect.height, input.height - m_Rect.y)
+    };
+
+    if ((m_Clipped.width == 0) || (m_Clipped.height == 0)) {
+        return std::nullopt;
+    }
+
+    return Format{ input.pixelFormat, m_Clipped.width, m_Clipped.height };
+}
+
+bool CropFrameStage::process(AVFrame* in, AVFrame* out, size_t worker) noexcept {
+    in->crop_left = m_Clipped.x;
+    in->crop_top = m_Clipped.y;
+    in->crop_right = static_cast<size_t>(in->width) - (m_Clipped.x + m_Clipped.width);
+    in->crop_bottom = static_cast<size_t>(in->height) - (m_Clipped.y + m_Clipped.height);
+
+    // unaligned cropping keeps the exact rectangle, at the cost of plane pointers not being SIMD-aligned
+    return av_frame_apply_cropping(in, AV_FRAME_CROP_UNALIGNED) >= 0;
+}
@@ -0,0 +1,109 @@
+#include "Stages/DeinterlaceFrameStage.h"
+
+// ffmpeg
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+/**
+ * @brief Replace every odd line of a plane with the average of its neighbours.
+ */
+template <typename SampleType>
+static void interpolateBottomField(uint8_t* data, int linesize, size_t samples, uint32_t lines) noexcept {
+    for (uint32_t y = 1; y < lines; y += 2) {
+        SampleType* line = reinterpret_cast<SampleType*>(data + (static_cast<ptrdiff_t>(y) * linesize));
+        const SampleType* above = reinterpret_cast<const SampleType*>(data + (static_cast<ptrdiff_t>(y - 1) * linesize));
+
+        // the last line of an even-height plane has nothing below it
+        if (y + 1 >= lines) {
+            std::copy(above, above + samples, line);
+            break;
+        }
+
+        const SampleType* below = reinterpret_cast<const SampleType*>(data + (static_cast<ptrdiff_t>(y + 1) * linesize));
+        for (size_t x = 0; x < samples; ++x) {
+            line[x] = static_cast<SampleType>((static_cast<uint32_t>(above[x]) + below[x] + 1) >> 1);
+        }
+    }
+}
+
+DeinterlaceFrameStage::DeinterlaceFrameStage() noexcept {
+
+}
+
+DeinterlaceFrameStage::~DeinterlaceFrameStage() {
+
+}
+
+FrameStage::Access DeinterlaceFrameStage::getAccess() const noexcept {
+    return Access::InPlace;
+}
+
+bool DeinterlaceFrameStage::accepts(int pixelFormat) const noexcept {
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(pixelFormat));
+    if ((descriptor == NULL) || ((descriptor->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BE)) != 0)) {
+        return false;
+    }
+
+    // every sample is a whole native-endian byte or word, so that samples can be averaged independently
+    for (int c = 0; c < descriptor->nb_components; ++c) {
+        const auto& comp = descriptor->comp[c];
+        if ((comp.shift != 0) || (comp.depth < 8) || (comp.depth > 16)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int DeinterlaceFrameStage::getPreferredInput() const noexcept {
+    return AV_PIX_FMT_YUV420P;
+}
+
+std::optional<FrameStage::Format> DeinterlaceFrameStage::configure(const Format& input, size_t workers) noexcept {
+    return input;
+}
+
+bool DeinterlaceFrameStage::process(AVFrame* in, AVFrame* out, size_t worker) noexcept {
+#if defined(AV_FRAME_FLAG_INTERLACED)
+    const bool interlaced = (in->flags & AV_FRAME_FLAG_INTERLACED) != 0;
+#else
+    const bool interlaced = in->interlaced_frame != 0;
+#endif
+
+    if (!interlaced) {
+        return true;
+    }
+
+    const AVPixelFormat format = static_cast<AVPixelFormat>(in->format);
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(format);
+    const bool words = descriptor->comp[0].depth > 8;
+
+    const int planes = av_pix_fmt_count_planes(format);
+    for (int plane = 0; plane < planes; ++plane) {
+        const int bytes = av_image_get_linesize(format, in->width, plane);
+        if (bytes <= 0) {
+            return false;
+        }
+
+        // the first and the last planes (luma and alpha) are never subsampled
+        const int shift = ((plane == 0) || (plane == 3)) ? 0 : descriptor->log2_chroma_h;
+        const uint32_t lines = (static_cast<uint32_t>(in->height) + (1u << shift) - 1) >> shift;
+
+        if (words) {
+            interpolateBottomField<uint16_t>(in->data[plane], in->linesize[plane], static_cast<size_t>(bytes) / sizeof(uint16_t), lines);
+        } else {
+            interpolateBottomField<uint8_t>(in->data[plane], in->linesize[plane], static_cast<size_t>(bytes), lines);
+        }
+    }
+
+#if defined(AV_FRAME_FLAG_INTERLACED)
+    in->flags &= ~AV_FRAME_FLAG_INTERLACED;
+#else
+    in->interlaced_frame = 0;
+#endif
+
+    return true;
+}
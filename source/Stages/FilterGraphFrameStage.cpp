@@ -0,0 +1,121 @@
+#include "Stages/FilterGraphFrameStage.h"
+
+// ffmpeg
+extern "C" {
+#include <libavfilter/avfilter.h>
+#include <libavfilter/buffersink.h>
+#include <libavfilter/buffersrc.h>
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+}
+
+FilterGraphFrameStage::FilterGraphFrameStage(const std::string& description) noexcept
+ : m_Description(description),
+ m_Graph(NULL),
+ m_Source(NULL),
+ m_Sink(NULL) {
+
+}
+
+FilterGraphFrameStage::~FilterGraphFrameStage() {
+    avfilter_graph_free(&m_Graph);
+}
+
+FrameStage::Access FilterGraphFrameStage::getAccess() const noexcept {
+    return Access::Allocates;
+}
+
+bool FilterGraphFrameStage::isConcurrent() const noexcept {
+    return false;
+}
+
+bool FilterGraphFrameStage::accepts(int pixelFormat) const noexcept {
+    // filters negotiate formats inside the graph, inserting conversions where needed
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(pixelFormat));
+    return (descriptor != NULL) && ((descriptor->flags & AV_PIX_FMT_FLAG_HWACCEL) == 0);
+}
+
+int FilterGraphFrameStage::getPreferredInput() const noexcept {
+    return AV_PIX_FMT_YUV420P;
+}
+
+std::optional<FrameStage::Format> FilterGraphFrameStage::configure(const Format& input, size_t workers) noexcept {
+    avfilter_graph_free(&m_Graph);
+    m_Source = NULL;
+    m_Sink = NULL;
+
+    m_Graph = avfilter_graph_alloc();
+    if (m_Graph == NULL) {
+        return std::nullopt;
+    }
+
+    // timestamps are carried in microseconds, as everywhere else in the player
+    const std::string sourceArgs =
+        "video_size=" + std::to_string(input.width) + "x" + std::to_string(input.height) +
+        ":pix_fmt=" + std::to_string(input.pixelFormat) +
+        ":time_base=1/" + std::to_string(AV_TIME_BASE) +
+        ":pixel_aspect=1/1";
+
+    if ((avfilter_graph_create_filter(&m_Source, avfilter_get_by_name("buffer"), "in", sourceArgs.c_str(), NULL, m_Graph) < 0) ||
+        (avfilter_graph_create_filter(&m_Sink, avfilter_get_by_name("buffersink"), "out", NULL, NULL, m_Graph) < 0)) {
+        std::cerr << "Could not create the endpoints of the filter graph \"" << m_Description << "\"" << std::endl;
+        return std::nullopt;
+    }
+
+    // the graph description is linked between the source (its input) and the sink (its output)
+    AVFilterInOut* outputs = avfilter_inout_alloc();
+    AVFilterInOut* inputs = avfilter_inout_alloc();
+    if ((outputs == NULL) || (inputs == NULL)) {
+        avfilter_inout_free(&outputs);
+        avfilter_inout_free(&inputs);
+        return std::nullopt;
+    }
+
+    outputs->name = av_strdup("in");
+    outputs->filter_ctx = m_Source;
+    outputs->pad_idx = 0;
+    outputs->next = NULL;
+
+    inputs->name = av_strdup("out");
+    inputs->filter_ctx = m_Sink;
+    inputs->pad_idx = 0;
+    inputs->next = NULL;
+
+    const bool parsed = avfilter_graph_parse_ptr(m_Graph, m_Description.c_str(), &inputs, &outputs, NULL) >= 0;
+    avfilter_inout_free(&outputs);
+    avfilter_inout_free(&inputs);
+
+    if ((!parsed) || (avfilter_graph_config(m_Graph, NULL) < 0)) {
+        std::cerr << "Could not configure the filter graph \"" << m_Description << "\"" << std::endl;
+        return std::nullopt;
+    }
+
+    return Format{
+        av_buffersink_get_format(m_Sink),
+        static_cast<uint32_t>(av_buffersink_get_w(m_Sink)),
+        static_cast<uint32_t>(av_buffersink_get_h(m_Sink))
+    };
+}
+
+bool FilterGraphFrameStage::process(AVFrame* in, AVFrame* out, size_t worker) noexcept {
+    // the timestamp the player relies on goes through the graph as the frame pts
+    in->pts = in->best_effort_timestamp;
+
+    // the reference is moved inside the graph, leaving in blank: it is reused to discard outputs
+    // past the first one (i.e. from field-rate deinterlacers)
+    if (av_buffersrc_add_frame_flags(m_Source, in, 0) < 0) {
+        return false;
+    }
+
+    if (av_buffersink_get_frame(m_Sink, out) < 0) {
+        return false;
+    }
+
+    out->best_effort_timestamp = out->pts;
+
+    while (av_buffersink_get_frame(m_Sink, in) >= 0) {
+        av_frame_unref(in);
+    }
+
+    return true;
+}
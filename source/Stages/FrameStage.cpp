@@ -0,0 +1,17 @@
+#include "Stages/FrameStage.h"
+
+FrameStage::FrameStage() noexcept {}
+
+FrameStage::~FrameStage() {}
+
+bool FrameStage::isConcurrent() const noexcept {
+    return true;
+}
+
+std::optional<FrameStage::Format> FrameStage::getResampleTarget() const noexcept {
+    return std::nullopt;
+}
+
+std::unique_ptr<FrameStage> FrameStage::fuse(const FrameStage& next) const noexcept {
+    return nullptr;
+}
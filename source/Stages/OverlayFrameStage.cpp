@@ -0,0 +1,150 @@
+#include "Stages/OverlayFrameStage.h"
+#include "AlphaBlend.h"
+
+// ffmpeg
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+OverlayFrameStage::OverlayFrameStage(const uint8_t* rgba, uint32_t width, uint32_t height, int32_t x, int32_t y) noexcept
+ : m_Image(rgba, rgba + (static_cast<size_t>(width) * height * 4)),
+ m_Width(width),
+ m_Height(height),
+ m_X(x),
+ m_Y(y),
+ m_Planes{} {
+
+}
+
+OverlayFrameStage::~OverlayFrameStage() {
+
+}
+
+FrameStage::Access OverlayFrameStage::getAccess() const noexcept {
+    return Access::InPlace;
+}
+
+bool OverlayFrameStage::accepts(int pixelFormat) const noexcept {
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(pixelFormat));
+    if ((descriptor == NULL) || (descriptor->nb_components != 3)) {
+        return false;
+    }
+
+    if ((descriptor->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_RGB)) != 0) {
+        return false;
+    }
+
+    // 8-bit YUV with one plane per component (yuv420p, yuv422p, yuv444p, ...)
+    for (int c = 0; c < 3; ++c) {
+        if ((descriptor->comp[c].plane != c) || (descriptor->comp[c].step != 1) || (descriptor->comp[c].depth != 8)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int OverlayFrameStage::getPreferredInput() const noexcept {
+    return AV_PIX_FMT_YUV420P;
+}
+
+std::optional<FrameStage::Format> OverlayFrameStage::configure(const Format& input, size_t workers) noexcept {
+    if ((m_Width == 0) || (m_Height == 0)) {
+        return std::nullopt;
+    }
+
+    const AVPixelFormat format = static_cast<AVPixelFormat>(input.pixelFormat);
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(format);
+
+    // the image is converted to the frame format once, with the matrix ffmpeg assumes for frames of that size
+    SwsContext* sws_ctx = sws_getContext(m_Width, m_Height, AV_PIX_FMT_RGBA, m_Width, m_Height, format, SWS_BICUBIC, NULL, NULL, NULL);
+    if (sws_ctx == NULL) {
+        std::cerr << "Could not create the scaling context for the overlay image" << std::endl;
+        return std::nullopt;
+    }
+
+    const int matrix = (input.height >= 720) ? SWS_CS_ITU709 : SWS_CS_ITU601;
+    sws_setColorspaceDetails(sws_ctx, sws_getCoefficients(SWS_CS_DEFAULT), 1, sws_getCoefficients(matrix), 0, 0, 1 << 16, 1 << 16);
+
+    uint8_t* dst[4] = { NULL, NULL, NULL, NULL };
+    int dstStride[4] = { 0, 0, 0, 0 };
+    for (int p = 0; p < 3; ++p) {
+        const int shiftX = (p == 0) ? 0 : descriptor->log2_chroma_w;
+        const int shiftY = (p == 0) ? 0 : descriptor->log2_chroma_h;
+
+        Plane& plane = m_Planes[p];
+        plane.width = (m_Width + (1u << shiftX) - 1) >> shiftX;
+        plane.height = (m_Height + (1u << shiftY) - 1) >> shiftY;
+        plane.x = (m_X >= 0) ? (m_X >> shiftX) : -((-m_X) >> shiftX);
+        plane.y = (m_Y >= 0) ? (m_Y >> shiftY) : -((-m_Y) >> shiftY);
+        plane.samples.resize(static_cast<size_t>(plane.width) * plane.height);
+        plane.alpha.resize(static_cast<size_t>(plane.width) * plane.height);
+
+        dst[p] = plane.samples.data();
+        dstStride[p] = static_cast<int>(plane.width);
+
+        // alpha at the resolution of the plane: the average over the image pixels covered by each sample
+        std::vector<uint32_t> sums(plane.alpha.size(), 0);
+        std::vector<uint32_t> counts(plane.alpha.size(), 0);
+        for (uint32_t y = 0; y < m_Height; ++y) {
+            for (uint32_t x = 0; x < m_Width; ++x) {
+                const size_t sample = (static_cast<size_t>(y >> shiftY) * plane.width) + (x >> shiftX);
+                sums[sample] += m_Image[(((static_cast<size_t>(y) * m_Width) + x) * 4) + 3];
+                ++counts[sample];
+            }
+        }
+
+        for (size_t i = 0; i < plane.alpha.size(); ++i) {
+            plane.alpha[i] = static_cast<uint8_t>((sums[i] + (counts[i] / 2)) / counts[i]);
+        }
+    }
+
+    const uint8_t* src[4] = { m_Image.data(), NULL, NULL, NULL };
+    const int srcStride[4] = { static_cast<int>(m_Width * 4), 0, 0, 0 };
+    sws_scale(sws_ctx, src, srcStride, 0, m_Height, dst, dstStride);
+    sws_freeContext(sws_ctx);
+
+    // samples are premultiplied once, so that blending a frame is a single multiply-add per sample
+    for (auto& plane : m_Planes) {
+        for (size_t i = 0; i < plane.samples.size(); ++i) {
+            plane.samples[i] = AlphaBlend::premultiply(plane.samples[i], plane.alpha[i]);
+        }
+    }
+
+    return input;
+}
+
+bool OverlayFrameStage::process(AVFrame* in, AVFrame* out, size_t worker) noexcept {
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(in->format));
+
+    for (int p = 0; p < 3; ++p) {
+        const Plane& plane = m_Planes[p];
+
+        const int shiftX = (p == 0) ? 0 : descriptor->log2_chroma_w;
+        const int shiftY = (p == 0) ? 0 : descriptor->log2_chroma_h;
+        const int32_t planeWidth = static_cast<int32_t>((static_cast<uint32_t>(in->width) + (1u << shiftX) - 1) >> shiftX);
+        const int32_t planeHeight = static_cast<int32_t>((static_cast<uint32_t>(in->height) + (1u << shiftY) - 1) >> shiftY);
+
+        // the part of the image that lays inside the frame
+        const int32_t x0 = std::max(plane.x, 0);
+        const int32_t y0 = std::max(plane.y, 0);
+        const int32_t x1 = std::min(plane.x + static_cast<int32_t>(plane.width), planeWidth);
+        const int32_t y1 = std::min(plane.y + static_cast<int32_t>(plane.height), planeHeight);
+
+        if (x0 >= x1) {
+            continue;
+        }
+
+        for (int32_t y = y0; y < y1; ++y) {
+            uint8_t* line = in->data[p] + (static_cast<ptrdiff_t>(y) * in->linesize[p]);
+            const size_t sample = (static_cast<size_t>(y - plane.y) * plane.width) + static_cast<size_t>(x0 - plane.x);
+
+            AlphaBlend::blendSamples(line + x0, plane.samples.data() + sample, plane.alpha.data() + sample, static_cast<size_t>(x1 - x0));
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,94 @@
+#include "Stages/ResampleFrameStage.h"
+
+#include "FFMPEGCommon.h"
+
+ResampleFrameStage::ResampleFrameStage(uint32_t width, uint32_t height, int pixelFormat, Decoder::ScalingFilter filter) noexcept
+ : m_Target{ pixelFormat, width, height },
+ m_Filter(filter),
+ m_Output{ AV_PIX_FMT_NONE, 0, 0 } {
+
+}
+
+ResampleFrameStage::~ResampleFrameStage() {
+    releaseContexts();
+}
+
+void ResampleFrameStage::releaseContexts() noexcept {
+    for (auto& context : m_Contexts) {
+        sws_freeContext(context);
+    }
+
+    m_Contexts.clear();
+}
+
+FrameStage::Access ResampleFrameStage::getAccess() const noexcept {
+    return Access::Output;
+}
+
+bool ResampleFrameStage::accepts(int pixelFormat) const noexcept {
+    return sws_isSupportedInput(static_cast<AVPixelFormat>(pixelFormat)) > 0;
+}
+
+int ResampleFrameStage::getPreferredInput() const noexcept {
+    return AV_PIX_FMT_YUV420P;
+}
+
+std::optional<FrameStage::Format> ResampleFrameStage::configure(const Format& input, size_t workers) noexcept {
+    m_Output = Format{
+        (m_Target.pixelFormat != AV_PIX_FMT_NONE) ? m_Target.pixelFormat : input.pixelFormat,
+        (m_Target.width != 0) ? m_Target.width : input.width,
+        (m_Target.height != 0) ? m_Target.height : input.height
+    };
+
+    if (sws_isSupportedOutput(static_cast<AVPixelFormat>(m_Output.pixelFormat)) <= 0) {
+        return std::nullopt;
+    }
+
+    // contexts are (re)created by each worker on its first frame
+    releaseContexts();
+    m_Contexts.resize(workers, NULL);
+
+    return m_Output;
+}
+
+std::optional<FrameStage::Format> ResampleFrameStage::getResampleTarget() const noexcept {
+    return m_Target;
+}
+
+std::unique_ptr<FrameStage> ResampleFrameStage::fuse(const FrameStage& next) const noexcept {
+    const auto target = next.getResampleTarget();
+    if (!target.has_value()) {
+        return nullptr;
+    }
+
+    // the second stage wins on everything it changes
+    return std::unique_ptr<FrameStage>(new ResampleFrameStage(
+        (target->width != 0) ? target->width : m_Target.width,
+        (target->height != 0) ? target->height : m_Target.height,
+        (target->pixelFormat != AV_PIX_FMT_NONE) ? target->pixelFormat : m_Target.pixelFormat,
+        m_Filter
+    ));
+}
+
+bool ResampleFrameStage::process(AVFrame* in, AVFrame* out, size_t worker) noexcept {
+    m_Contexts[worker] = sws_getCachedContext(
+        m_Contexts[worker],
+        in->width,
+        in->height,
+        static_cast<AVPixelFormat>(in->format),
+        out->width,
+        out->height,
+        static_cast<AVPixelFormat>(out->format),
+        FFMPEGCommon::toSwsFlags(m_Filter),
+        NULL,
+        NULL,
+        NULL
+    );
+
+    if (m_Contexts[worker] == NULL) {
+        std::cerr << "Could not create the scaling context for a resample stage" << std::endl;
+        return false;
+    }
+
+    return sws_scale(m_Contexts[worker], (uint8_t const * const *)in->data, in->linesize, 0, in->height, out->data, out->linesize) > 0;
+}
@@ -0,0 +1,237 @@
+#include "StatisticsServer.h"
+#include "FFMPEGDecoder.h"
+
+// for memcpy
+#include <cstring>
+#include <sstream>
+
+// unix stream sockets, eventfd
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * @brief Write a string as a JSON string.
+ */
+static void writeString(std::ostringstream& out, const std::string& value) noexcept {
+    out << '"';
+    for (const char c : value) {
+        if ((c == '"') || (c == '\\')) {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) >= 0x20) {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+/**
+ * @brief Write an optional value, null when it is empty.
+ */
+template <typename T>
+static void writeOptional(std::ostringstream& out, const std::optional<T>& value) noexcept {
+    if (value.has_value()) {
+        out << value.value();
+    } else {
+        out << "null";
+    }
+}
+
+/**
+ * @brief Write the statistics only FFMPEG decoders have, as fields of the object of the decoder.
+ */
+static void writeFFMPEGStatistics(std::ostringstream& out, FFMPEGDecoder& decoder) noexcept {
+    const auto placement = decoder.getPlacementStatistics();
+    out << ",\"placement\":{\"node\":";
+    writeOptional(out, placement.node);
+    out << ",\"cpu\":";
+    writeOptional(out, placement.cpu);
+    out << ",\"cpuNode\":";
+    writeOptional(out, placement.cpuNode);
+    out << ",\"offNodeFrames\":" << placement.offNodeFrames << "}";
+
+    const auto power = decoder.getPowerStatistics();
+    out << ",\"power\":{\"wakeupsPerSecond\":" << power.wakeupsPerSecond
+        << ",\"cpuTimePerPlayedSecond\":" << power.cpuTimePerPlayedSecond
+        << ",\"playedTime\":" << power.playedTime
+        << ",\"bursts\":" << power.bursts << "}";
+
+    const auto rendition = decoder.getRenditionStatistics();
+    out << ",\"rendition\":{\"active\":";
+    if (rendition.active.has_value()) {
+        writeString(out, rendition.active.value());
+    } else {
+        out << "null";
+    }
+
+    out << ",\"width\":" << rendition.width
+        << ",\"height\":" << rendition.height
+        << ",\"load\":" << rendition.load
+        << ",\"switches\":" << rendition.switches
+        << ",\"switching\":" << (rendition.switching ? "true" : "false") << "}";
+}
+
+StatisticsServer::StatisticsServer(const std::string& socketPath) noexcept
+ : m_SocketPath(socketPath),
+ m_Socket(-1),
+ m_WakeFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+ m_ShouldStop(false) {
+    if (m_WakeFd < 0) {
+        std::cerr << "Could not create eventfd for the statistics server" << std::endl;
+        return;
+    }
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+
+    if (m_SocketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "The statistics socket path " << m_SocketPath << " is too long" << std::endl;
+        return;
+    }
+
+    std::memcpy(address.sun_path, m_SocketPath.c_str(), m_SocketPath.size() + 1);
+
+    m_Socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_Socket < 0) {
+        return;
+    }
+
+    // a socket left behind by a previous run would make bind fail
+    unlink(m_SocketPath.c_str());
+
+    if ((bind(m_Socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) || (listen(m_Socket, 4) != 0)) {
+        std::cerr << "Could not bind the statistics socket " << m_SocketPath << std::endl;
+        close(m_Socket);
+        m_Socket = -1;
+    }
+}
+
+StatisticsServer::~StatisticsServer() {
+    interrupt();
+
+    if (m_Socket >= 0) {
+        close(m_Socket);
+        unlink(m_SocketPath.c_str());
+    }
+
+    if (m_WakeFd >= 0) {
+        close(m_WakeFd);
+    }
+}
+
+bool StatisticsServer::isValid() const noexcept {
+    return (m_Socket >= 0) && (m_WakeFd >= 0);
+}
+
+void StatisticsServer::addDecoder(const std::string& name, const Decoder& decoder) noexcept {
+    m_Decoders.push_back(DecoderEntry{ name, &decoder, nullptr });
+}
+
+void StatisticsServer::addDecoder(const std::string& name, FFMPEGDecoder& decoder) noexcept {
+    m_Decoders.push_back(DecoderEntry{ name, &decoder, &decoder });
+}
+
+void StatisticsServer::addOutputDevice(const std::string& name, const BufferedFrameOutputDevice& device) noexcept {
+    m_OutputDevices.emplace_back(name, &device);
+}
+
+std::string StatisticsServer::report() const noexcept {
+    std::ostringstream out;
+
+    const auto now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    out << "{\"time\":" << now << ",\"decoders\":{";
+
+    for (size_t i = 0; i < m_Decoders.size(); ++i) {
+        const auto statistics = m_Decoders[i].decoder->getStatistics();
+
+        out << ((i > 0) ? "," : "");
+        writeString(out, m_Decoders[i].name);
+        out << ":{\"decodedFrames\":" << statistics.decodedFrames
+            << ",\"emittedFrames\":" << statistics.emittedFrames
+            << ",\"skippedFrames\":" << statistics.skippedFrames
+            << ",\"decodeRate\":" << statistics.decodeRate
+            << ",\"convertRate\":" << statistics.convertRate
+            << ",\"pts\":" << statistics.pts
+            << ",\"time\":" << statistics.time;
+
+        if (m_Decoders[i].ffmpegDecoder != nullptr) {
+            writeFFMPEGStatistics(out, *m_Decoders[i].ffmpegDecoder);
+        }
+
+        out << "}";
+    }
+
+    out << "},\"outputDevices\":{";
+
+    for (size_t i = 0; i < m_OutputDevices.size(); ++i) {
+        const auto statistics = m_OutputDevices[i].second->getStatistics();
+
+        out << ((i > 0) ? "," : "");
+        writeString(out, m_OutputDevices[i].first);
+        out << ":{\"presentedFrames\":" << statistics.presentedFrames
+            << ",\"droppedFrames\":" << statistics.droppedFrames
+            << ",\"queuedFrames\":" << m_OutputDevices[i].second->getQueuedFrames()
+            << ",\"residentBytes\":" << statistics.residentBytes
+            << ",\"pts\":" << statistics.pts
+            << ",\"maxLateness\":" << statistics.maxLateness
+            << ",\"lateness\":[";
+
+        for (size_t b = 0; b < BufferedFrameOutputDevice::LatenessBuckets; ++b) {
+            out << ((b > 0) ? "," : "") << statistics.lateness[b];
+        }
+
+        out << "],\"time\":" << statistics.time << "}";
+    }
+
+    out << "}}\n";
+
+    return out.str();
+}
+
+void StatisticsServer::exec() noexcept {
+    if (!isValid()) {
+        return;
+    }
+
+    pollfd pfds[2] = {};
+    pfds[0].fd = m_Socket;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = m_WakeFd;
+    pfds[1].events = POLLIN;
+
+    while (!m_ShouldStop) {
+        // nothing wakes the thread up but a client or interrupt()
+        if (poll(pfds, 2, -1) <= 0) {
+            continue;
+        }
+
+        if ((pfds[0].revents & POLLIN) == 0) {
+            continue;
+        }
+
+        const int client = accept4(m_Socket, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (client < 0) {
+            continue;
+        }
+
+        // the document fits in the socket buffer: a client that does not read it gets a truncated one
+        const std::string document = report();
+        ssize_t sentBytes = send(client, document.data(), document.size(), MSG_NOSIGNAL);
+        (void)sentBytes;
+
+        close(client);
+    }
+}
+
+void StatisticsServer::interrupt() noexcept {
+    m_ShouldStop = true;
+
+    if (m_WakeFd >= 0) {
+        // a saturated counter (EAGAIN) still wakes exec up
+        const uint64_t one = 1;
+        ssize_t written = write(m_WakeFd, &one, sizeof(one));
+        (void)written;
+    }
+}
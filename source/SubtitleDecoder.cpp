@@ -0,0 +1,252 @@
+#include "SubtitleDecoder.h"
+
+#include "FFMPEGCommon.h"
+
+#include <cmath>
+#include <iterator>
+#include <limits>
+
+SubtitleDecoder::SubtitleDecoder() noexcept
+ : m_CodecCtx(NULL),
+ m_ScaleCtx(NULL),
+ m_Stream(-1),
+ m_VideoWidth(0),
+ m_VideoHeight(0),
+ m_OutputWidth(0),
+ m_OutputHeight(0),
+ m_Shown(nullptr) {
+
+}
+
+SubtitleDecoder::~SubtitleDecoder() {
+    close();
+
+    sws_freeContext(m_ScaleCtx);
+}
+
+bool SubtitleDecoder::open(AVFormatContext* formatCtx, uint32_t videoWidth, uint32_t videoHeight, uint32_t outputWidth, uint32_t outputHeight, std::shared_ptr<FrameCompositor> compositor) noexcept {
+    close();
+
+    const int stream = av_find_best_stream(formatCtx, AVMEDIA_TYPE_SUBTITLE, -1, -1, NULL, 0);
+    if ((stream < 0) || (!compositor)) {
+        return false;
+    }
+
+    const AVCodecParameters* codecpar = formatCtx->streams[stream]->codecpar;
+
+    // text subtitles would need a text renderer
+    const AVCodecDescriptor* descriptor = avcodec_descriptor_get(codecpar->codec_id);
+    if ((descriptor == NULL) || ((descriptor->props & AV_CODEC_PROP_BITMAP_SUB) == 0)) {
+        std::cerr << "Only bitmap subtitles can be shown" << std::endl;
+        return false;
+    }
+
+    const AVCodec* codec = avcodec_find_decoder(codecpar->codec_id);
+    if (codec == NULL) {
+        std::cerr << "Unsupported subtitle codec" << std::endl;
+        return false;
+    }
+
+    m_CodecCtx = avcodec_alloc_context3(codec);
+    if ((m_CodecCtx == NULL) || (avcodec_parameters_to_context(m_CodecCtx, codecpar) < 0)) {
+        avcodec_free_context(&m_CodecCtx);
+        return false;
+    }
+
+    // decoded subtitles are timed in AV_TIME_BASE units from the packet timestamps
+    m_CodecCtx->pkt_timebase = formatCtx->streams[stream]->time_base;
+
+    if (avcodec_open2(m_CodecCtx, codec, NULL) < 0) {
+        std::cerr << "Could not open the subtitle codec" << std::endl;
+        avcodec_free_context(&m_CodecCtx);
+        return false;
+    }
+
+    // cue positions are relative to the size the subtitles have been authored for, when known
+    m_VideoWidth = (m_CodecCtx->width > 0) ? static_cast<uint32_t>(m_CodecCtx->width) : videoWidth;
+    m_VideoHeight = (m_CodecCtx->height > 0) ? static_cast<uint32_t>(m_CodecCtx->height) : videoHeight;
+    m_OutputWidth = outputWidth;
+    m_OutputHeight = outputHeight;
+
+    m_Stream = stream;
+    m_Compositor = std::move(compositor);
+    m_Layer = m_Compositor->addLayer(nullptr, 0, 0);
+    m_Shown = nullptr;
+
+    return true;
+}
+
+void SubtitleDecoder::close() noexcept {
+    if (m_Layer.has_value()) {
+        m_Compositor->removeLayer(m_Layer.value());
+        m_Layer.reset();
+    }
+
+    m_Compositor.reset();
+    m_Cues.clear();
+    m_Shown = nullptr;
+    m_Stream = -1;
+
+    avcodec_free_context(&m_CodecCtx);
+}
+
+int SubtitleDecoder::getStream() const noexcept {
+    return m_Stream;
+}
+
+std::shared_ptr<OverlayImage> SubtitleDecoder::rasterize(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t scaledWidth, uint32_t scaledHeight) noexcept {
+    if ((width == scaledWidth) && (height == scaledHeight)) {
+        return std::make_shared<OverlayImage>(rgba, width, height);
+    }
+
+    m_ScaleCtx = sws_getCachedContext(
+        m_ScaleCtx,
+        static_cast<int>(width), static_cast<int>(height), AV_PIX_FMT_RGBA,
+        static_cast<int>(scaledWidth), static_cast<int>(scaledHeight), AV_PIX_FMT_RGBA,
+        SWS_BICUBIC, NULL, NULL, NULL
+    );
+
+    if (m_ScaleCtx == NULL) {
+        return nullptr;
+    }
+
+    std::vector<uint8_t> scaled(static_cast<size_t>(scaledWidth) * scaledHeight * 4);
+
+    const uint8_t* src[4] = { rgba, NULL, NULL, NULL };
+    const int srcStride[4] = { static_cast<int>(width * 4), 0, 0, 0 };
+    uint8_t* dst[4] = { scaled.data(), NULL, NULL, NULL };
+    const int dstStride[4] = { static_cast<int>(scaledWidth * 4), 0, 0, 0 };
+    sws_scale(m_ScaleCtx, src, srcStride, 0, static_cast<int>(height), dst, dstStride);
+
+    return std::make_shared<OverlayImage>(scaled.data(), scaledWidth, scaledHeight);
+}
+
+void SubtitleDecoder::decode(const AVPacket* packet) noexcept {
+    if (m_CodecCtx == NULL) {
+        return;
+    }
+
+    AVSubtitle subtitle;
+    int decoded = 0;
+    if ((avcodec_decode_subtitle2(m_CodecCtx, &subtitle, &decoded, packet) < 0) || (decoded == 0)) {
+        return;
+    }
+
+    Frame::TimestampType pts = 0;
+    if (subtitle.pts != AV_NOPTS_VALUE) {
+        pts = subtitle.pts;
+    } else if (packet->pts != AV_NOPTS_VALUE) {
+        pts = av_rescale_q(packet->pts, m_CodecCtx->pkt_timebase, AV_TIME_BASE_Q);
+    }
+
+    Cue cue;
+    cue.start = pts + (static_cast<Frame::TimestampType>(subtitle.start_display_time) * 1000);
+    cue.x = 0;
+    cue.y = 0;
+
+    // without an end time (PGS) a cue lasts until the next one, that may be an empty one clearing the screen
+    if ((subtitle.end_display_time > subtitle.start_display_time) && (subtitle.end_display_time != UINT32_MAX)) {
+        cue.end = pts + (static_cast<Frame::TimestampType>(subtitle.end_display_time) * 1000);
+    } else if (packet->duration > 0) {
+        cue.end = cue.start + av_rescale_q(packet->duration, m_CodecCtx->pkt_timebase, AV_TIME_BASE_Q);
+    }
+
+    // every bitmap of the cue is drawn on a single image covering them all
+    int x0 = std::numeric_limits<int>::max();
+    int y0 = std::numeric_limits<int>::max();
+    int x1 = std::numeric_limits<int>::min();
+    int y1 = std::numeric_limits<int>::min();
+    for (unsigned r = 0; r < subtitle.num_rects; ++r) {
+        const AVSubtitleRect* rect = subtitle.rects[r];
+        if ((rect->type == SUBTITLE_BITMAP) && (rect->w > 0) && (rect->h > 0)) {
+            x0 = std::min(x0, rect->x);
+            y0 = std::min(y0, rect->y);
+            x1 = std::max(x1, rect->x + rect->w);
+            y1 = std::max(y1, rect->y + rect->h);
+        }
+    }
+
+    if ((x0 < x1) && (y0 < y1) && (m_VideoWidth > 0) && (m_VideoHeight > 0)) {
+        const uint32_t width = static_cast<uint32_t>(x1 - x0);
+        const uint32_t height = static_cast<uint32_t>(y1 - y0);
+
+        std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4, 0);
+        for (unsigned r = 0; r < subtitle.num_rects; ++r) {
+            const AVSubtitleRect* rect = subtitle.rects[r];
+            if ((rect->type != SUBTITLE_BITMAP) || (rect->w <= 0) || (rect->h <= 0)) {
+                continue;
+            }
+
+            // palettized pixels: the palette holds native-endian 0xAARRGGBB colors
+            const uint32_t* palette = reinterpret_cast<const uint32_t*>(rect->data[1]);
+            for (int y = 0; y < rect->h; ++y) {
+                const uint8_t* indices = rect->data[0] + (static_cast<ptrdiff_t>(y) * rect->linesize[0]);
+                uint8_t* pixel = rgba.data() + ((((static_cast<size_t>(rect->y - y0 + y) * width) + static_cast<size_t>(rect->x - x0))) * 4);
+
+                for (int x = 0; x < rect->w; ++x, pixel += 4) {
+                    const uint32_t color = (indices[x] < rect->nb_colors) ? palette[indices[x]] : 0;
+                    pixel[0] = static_cast<uint8_t>(color >> 16);
+                    pixel[1] = static_cast<uint8_t>(color >> 8);
+                    pixel[2] = static_cast<uint8_t>(color);
+                    pixel[3] = static_cast<uint8_t>(color >> 24);
+                }
+            }
+        }
+
+        // cues are scaled as frames are
+        const double scaleX = static_cast<double>(m_OutputWidth) / m_VideoWidth;
+        const double scaleY = static_cast<double>(m_OutputHeight) / m_VideoHeight;
+        const uint32_t scaledWidth = std::max<uint32_t>(static_cast<uint32_t>(std::lround(width * scaleX)), 1);
+        const uint32_t scaledHeight = std::max<uint32_t>(static_cast<uint32_t>(std::lround(height * scaleY)), 1);
+
+        cue.image = rasterize(rgba.data(), width, height, scaledWidth, scaledHeight);
+        cue.x = static_cast<int32_t>(std::lround(x0 * scaleX));
+        cue.y = static_cast<int32_t>(std::lround(y0 * scaleY));
+    }
+
+    avsubtitle_free(&subtitle);
+
+    // cues mostly arrive in order
+    auto position = m_Cues.end();
+    while ((position != m_Cues.begin()) && (std::prev(position)->start > cue.start)) {
+        --position;
+    }
+
+    m_Cues.insert(position, std::move(cue));
+}
+
+void SubtitleDecoder::flush() noexcept {
+    if (m_CodecCtx != NULL) {
+        avcodec_flush_buffers(m_CodecCtx);
+    }
+
+    m_Cues.clear();
+}
+
+void SubtitleDecoder::show(Frame::TimestampType pts) noexcept {
+    if (!m_Layer.has_value()) {
+        return;
+    }
+
+    // a cue is over when the next one starts or when its end time comes
+    while ((m_Cues.size() > 1) && (m_Cues[1].start <= pts)) {
+        m_Cues.pop_front();
+    }
+
+    while ((!m_Cues.empty()) && (m_Cues.front().end.has_value()) && (m_Cues.front().end.value() <= pts)) {
+        m_Cues.pop_front();
+    }
+
+    const Cue* cue = ((!m_Cues.empty()) && (m_Cues.front().start <= pts)) ? &m_Cues.front() : nullptr;
+    const OverlayImage* image = (cue != nullptr) ? cue->image.get() : nullptr;
+    if (image == m_Shown) {
+        return;
+    }
+
+    if (cue != nullptr) {
+        m_Compositor->moveLayer(m_Layer.value(), cue->x, cue->y);
+    }
+
+    m_Compositor->setLayerImage(m_Layer.value(), (cue != nullptr) ? cue->image : nullptr);
+    m_Shown = image;
+}
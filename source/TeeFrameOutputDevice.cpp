@@ -0,0 +1,217 @@
+#include "TeeFrameOutputDevice.h"
+
+TeeFrameOutputDevice::TeeFrameOutputDevice(BufferedFrameOutputDevice::FrameCountType frameCount) noexcept
+ : BufferedFrameOutputDevice(frameCount),
+ m_ShouldStop(false) {
+
+}
+
+TeeFrameOutputDevice::~TeeFrameOutputDevice() {
+    interrupt();
+
+    // queued frames reference shared blocks: release them while blocks are still there
+    for (auto& sink : m_Sinks) {
+        std::lock_guard<std::mutex> guard(sink->mutex);
+        sink->queue.clear();
+    }
+}
+
+TeeFrameOutputDevice::SinkIndexType TeeFrameOutputDevice::addSink(BufferedFrameOutputDevice* sink, DropPolicy policy, size_t queueSize) noexcept {
+    std::unique_ptr<Sink> newSink(new Sink());
+    newSink->device = sink;
+    newSink->policy = policy;
+    newSink->queueSize = (queueSize == 0) ? getFramesCount() : queueSize;
+    newSink->dropped = 0;
+
+    newSink->device->setClockRate(getClockRate());
+
+    m_Sinks.push_back(std::move(newSink));
+    return static_cast<SinkIndexType>(m_Sinks.size() - 1);
+}
+
+uint64_t TeeFrameOutputDevice::getDroppedFrames(SinkIndexType sink) const noexcept {
+    return (sink < m_Sinks.size()) ? m_Sinks[sink]->dropped.load() : 0;
+}
+
+uint32_t TeeFrameOutputDevice::getPreferredWidth() const noexcept {
+    uint32_t width = 0;
+    for (const auto& sink : m_Sinks) {
+        const auto preferred = sink->device->getPreferredWidth();
+        if (preferred == 0) {
+            return 0;
+        }
+
+        width = std::max(width, preferred);
+    }
+
+    return width;
+}
+
+uint32_t TeeFrameOutputDevice::getPreferredHeight() const noexcept {
+    uint32_t height = 0;
+    for (const auto& sink : m_Sinks) {
+        const auto preferred = sink->device->getPreferredHeight();
+        if (preferred == 0) {
+            return 0;
+        }
+
+        height = std::max(height, preferred);
+    }
+
+    return height;
+}
+
+Frame::PixelFormat TeeFrameOutputDevice::getPreferredPixelFormat() const noexcept {
+    return m_Sinks.empty() ? BufferedFrameOutputDevice::getPreferredPixelFormat() : m_Sinks.front()->device->getPreferredPixelFormat();
+}
+
+void TeeFrameOutputDevice::setClockRate(double rate) noexcept {
+    BufferedFrameOutputDevice::setClockRate(rate);
+
+    for (auto& sink : m_Sinks) {
+        sink->device->setClockRate(rate);
+    }
+}
+
+void* TeeFrameOutputDevice::allocate(size_t size, SlotType& slot) noexcept {
+    return nullptr;
+}
+
+void TeeFrameOutputDevice::deallocate(void* mem, SlotType slot) noexcept {
+    SharedBlock* block = nullptr;
+
+    {
+        std::lock_guard<std::mutex> guard(m_BlocksMutex);
+        block = m_Blocks[slot].get();
+    }
+
+    if (block->references.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    // the last reference is gone: the original frame gives memory back to the decoder allocator
+    block->frame.reset();
+
+    std::lock_guard<std::mutex> guard(m_BlocksMutex);
+    m_FreeBlocks.push_back(slot);
+}
+
+void TeeFrameOutputDevice::enqueueFrame(Frame&& frame) noexcept {
+    if ((m_Sinks.empty()) || (!frame.isHoldingData())) {
+        return;
+    }
+
+    SlotType slot = 0;
+    SharedBlock* block = nullptr;
+
+    {
+        std::lock_guard<std::mutex> guard(m_BlocksMutex);
+        if (m_FreeBlocks.empty()) {
+            m_Blocks.emplace_back(new SharedBlock());
+            m_FreeBlocks.push_back(static_cast<SlotType>(m_Blocks.size() - 1));
+        }
+
+        slot = m_FreeBlocks.back();
+        m_FreeBlocks.pop_back();
+        block = m_Blocks[slot].get();
+    }
+
+    // every sink holds a reference before any of them can release it
+    block->references.store(static_cast<uint32_t>(m_Sinks.size()), std::memory_order_relaxed);
+    block->frame.emplace(std::move(frame));
+
+    const Frame& shared = block->frame.value();
+
+    for (auto& sink : m_Sinks) {
+        Frame view(shared.getPixelFormat(), shared.getWidth(), shared.getHeight());
+        view.setPresentationTimestamp(shared.getPresentationTimestamp());
+        view.setSourceIndex(shared.getSourceIndex());
+        view.setDirtyRect(shared.getDirtyRect());
+        view.adoptFrameData(shared.getRawBuffer(), this, slot);
+
+        // dropped frames are destroyed outside of the sink lock
+        std::optional<Frame> dropped;
+
+        {
+            std::unique_lock<std::mutex> lk(sink->mutex);
+
+            if (sink->queue.size() >= sink->queueSize) {
+                switch (sink->policy) {
+                    case DropPolicy::Block:
+                        sink->changed.wait(lk, [this, &sink]() {
+                            return (m_ShouldStop) || (sink->queue.size() < sink->queueSize);
+                        });
+                        break;
+
+                    case DropPolicy::DropOldest:
+                        dropped.emplace(std::move(sink->queue.front()));
+                        sink->queue.pop_front();
+                        ++sink->dropped;
+                        break;
+
+                    case DropPolicy::DropNewest:
+                        dropped.emplace(std::move(view));
+                        ++sink->dropped;
+                        break;
+                }
+            }
+
+            if (view.isHoldingData()) {
+                sink->queue.push_back(std::move(view));
+            }
+        }
+
+        sink->changed.notify_all();
+    }
+}
+
+void TeeFrameOutputDevice::forward(Sink& sink) noexcept {
+    while (true) {
+        std::optional<Frame> frame;
+
+        {
+            std::unique_lock<std::mutex> lk(sink.mutex);
+            sink.changed.wait(lk, [this, &sink]() {
+                return (m_ShouldStop) || (!sink.queue.empty());
+            });
+
+            if (m_ShouldStop) {
+                return;
+            }
+
+            frame.emplace(std::move(sink.queue.front()));
+            sink.queue.pop_front();
+        }
+
+        // room has been made for a decoder waiting on a full queue
+        sink.changed.notify_all();
+
+        // this is the only place where a slow sink can block, and it only blocks its own queue
+        sink.device->enqueueFrame(std::move(frame.value()));
+    }
+}
+
+void TeeFrameOutputDevice::exec() noexcept {
+    std::vector<std::thread> forwarders;
+    forwarders.reserve(m_Sinks.size());
+
+    for (auto& sink : m_Sinks) {
+        forwarders.emplace_back([this, &sink]() {
+            forward(*sink);
+        });
+    }
+
+    for (auto& forwarder : forwarders) {
+        forwarder.join();
+    }
+}
+
+void TeeFrameOutputDevice::interrupt() noexcept {
+    m_ShouldStop = true;
+
+    for (auto& sink : m_Sinks) {
+        // taking the lock makes sure no thread is between the predicate check and the wait
+        std::lock_guard<std::mutex> guard(sink->mutex);
+        sink->changed.notify_all();
+    }
+}
@@ -0,0 +1,456 @@
+#include "ToneMapper.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// ffmpeg
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/mastering_display_metadata.h>
+}
+
+/*
+ * Four pixels at a time: the same kernel runs on SSE2, NEON or plain floats.
+ */
+#if defined(__SSE2__)
+typedef __m128 Vec4;
+
+static inline Vec4 load4(const float* v) noexcept { return _mm_loadu_ps(v); }
+static inline Vec4 splat4(float v) noexcept { return _mm_set1_ps(v); }
+static inline Vec4 add4(Vec4 a, Vec4 b) noexcept { return _mm_add_ps(a, b); }
+static inline Vec4 sub4(Vec4 a, Vec4 b) noexcept { return _mm_sub_ps(a, b); }
+static inline Vec4 mul4(Vec4 a, Vec4 b) noexcept { return _mm_mul_ps(a, b); }
+static inline Vec4 sqrt4(Vec4 a) noexcept { return _mm_sqrt_ps(a); }
+static inline Vec4 clamp4(Vec4 a) noexcept { return _mm_min_ps(_mm_max_ps(a, _mm_setzero_ps()), _mm_set1_ps(1.0f)); }
+
+static inline void index4(Vec4 a, float scale, int32_t* out) noexcept {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(a, _mm_set1_ps(scale)), _mm_set1_ps(0.5f))));
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+typedef float32x4_t Vec4;
+
+static inline Vec4 load4(const float* v) noexcept { return vld1q_f32(v); }
+static inline Vec4 splat4(float v) noexcept { return vdupq_n_f32(v); }
+static inline Vec4 add4(Vec4 a, Vec4 b) noexcept { return vaddq_f32(a, b); }
+static inline Vec4 sub4(Vec4 a, Vec4 b) noexcept { return vsubq_f32(a, b); }
+static inline Vec4 mul4(Vec4 a, Vec4 b) noexcept { return vmulq_f32(a, b); }
+static inline Vec4 sqrt4(Vec4 a) noexcept { return vsqrtq_f32(a); }
+static inline Vec4 clamp4(Vec4 a) noexcept { return vminq_f32(vmaxq_f32(a, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f)); }
+
+static inline void index4(Vec4 a, float scale, int32_t* out) noexcept {
+    vst1q_s32(out, vcvtq_s32_f32(vaddq_f32(vmulq_f32(a, vdupq_n_f32(scale)), vdupq_n_f32(0.5f))));
+}
+#else
+struct Vec4 {
+    float v[4];
+};
+
+template <typename Fn>
+static inline Vec4 apply4(Fn fn) noexcept {
+    Vec4 r;
+    for (int i = 0; i < 4; ++i) {
+        r.v[i] = fn(i);
+    }
+
+    return r;
+}
+
+static inline Vec4 load4(const float* v) noexcept { return apply4([v](int i) { return v[i]; }); }
+static inline Vec4 splat4(float v) noexcept { return apply4([v](int) { return v; }); }
+static inline Vec4 add4(Vec4 a, Vec4 b) noexcept { return apply4([&](int i) { return a.v[i] + b.v[i]; }); }
+static inline Vec4 sub4(Vec4 a, Vec4 b) noexcept { return apply4([&](int i) { return a.v[i] - b.v[i]; }); }
+static inline Vec4 mul4(Vec4 a, Vec4 b) noexcept { return apply4([&](int i) { return a.v[i] * b.v[i]; }); }
+static inline Vec4 sqrt4(Vec4 a) noexcept { return apply4([&](int i) { return std::sqrt(a.v[i]); }); }
+static inline Vec4 clamp4(Vec4 a) noexcept { return apply4([&](int i) { return std::min(std::max(a.v[i], 0.0f), 1.0f); }); }
+
+static inline void index4(Vec4 a, float scale, int32_t* out) noexcept {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<int32_t>((a.v[i] * scale) + 0.5f);
+    }
+}
+#endif
+
+/*
+ * SMPTE ST 2084 (PQ) constants.
+ */
+static constexpr double PQ_M1 = 2610.0 / 16384.0;
+static constexpr double PQ_M2 = (2523.0 / 4096.0) * 128.0;
+static constexpr double PQ_C1 = 3424.0 / 4096.0;
+static constexpr double PQ_C2 = (2413.0 / 4096.0) * 32.0;
+static constexpr double PQ_C3 = (2392.0 / 4096.0) * 32.0;
+
+static double pqToNits(double e) noexcept {
+    const double p = std::pow(std::max(e, 0.0), 1.0 / PQ_M2);
+    return 10000.0 * std::pow(std::max(p - PQ_C1, 0.0) / (PQ_C2 - (PQ_C3 * p)), 1.0 / PQ_M1);
+}
+
+static double nitsToPq(double nits) noexcept {
+    const double p = std::pow(std::max(nits, 0.0) / 10000.0, PQ_M1);
+    return std::pow((PQ_C1 + (PQ_C2 * p)) / (1.0 + (PQ_C3 * p)), PQ_M2);
+}
+
+/**
+ * @brief ARIB STD-B67 (HLG) inverse OETF: the normalized scene light of a signal value.
+ */
+static double hlgToScene(double e) noexcept {
+    constexpr double a = 0.17883277;
+    constexpr double b = 0.28466892;
+    constexpr double c = 0.55991073;
+
+    if (e <= 0.5) {
+        return (e * e) / 3.0;
+    }
+
+    return (std::exp((e - c) / a) + b) / 12.0;
+}
+
+/**
+ * @brief The Hable filmic curve, before white point normalization.
+ */
+static double hable(double x) noexcept {
+    constexpr double A = 0.15, B = 0.50, C = 0.10, D = 0.20, E = 0.02, F = 0.30;
+    return (((x * ((A * x) + (C * B))) + (D * E)) / ((x * ((A * x) + B)) + (D * F))) - (E / F);
+}
+
+bool ToneMapper::isApplicable(const AVFrame* frame, Frame::PixelFormat pf) noexcept {
+    if ((pf != Frame::PixelFormat::RGBA32) && (pf != Frame::PixelFormat::NV12)) {
+        return false;
+    }
+
+    if ((frame->color_trc != AVCOL_TRC_SMPTE2084) && (frame->color_trc != AVCOL_TRC_ARIB_STD_B67)) {
+        return false;
+    }
+
+    if ((frame->width <= 0) || (frame->height <= 0)) {
+        return false;
+    }
+
+    // little-endian YUV with every component stored in 16 bits (planar or semi-planar, i.e. yuv420p10 or p010)
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+    if ((descriptor == NULL) || (descriptor->nb_components < 3)) {
+        return false;
+    }
+
+    if ((descriptor->flags & (AV_PIX_FMT_FLAG_BE | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_BITSTREAM)) != 0) {
+        return false;
+    }
+
+    for (int c = 0; c < 3; ++c) {
+        if ((descriptor->comp[c].depth <= 8) || (descriptor->comp[c].depth > 16) || (descriptor->comp[c].step < 2)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+ToneMapper::ToneMapper(Curve curve) noexcept
+ : m_Curve(curve),
+ m_Prepared(false),
+ m_Transfer(Transfer::PQ),
+ m_Peak(DefaultPeak),
+ m_PreparedCurve(curve),
+ m_Linearize{},
+ m_Tone{},
+ m_YOffset(0.0f),
+ m_YScale(1.0f),
+ m_COffset(0.0f),
+ m_CScale(1.0f),
+ m_CrR(0.0f),
+ m_CbG(0.0f),
+ m_CrG(0.0f),
+ m_CbB(0.0f),
+ m_Gamut{} {
+
+}
+
+void ToneMapper::setCurve(Curve curve) noexcept {
+    m_Curve = curve;
+}
+
+ToneMapper::Curve ToneMapper::getCurve() const noexcept {
+    return m_Curve;
+}
+
+void ToneMapper::prepare(const AVFrame* frame) noexcept {
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+
+    // YUV to R'G'B' for the frame range and matrix
+    const int depth = descriptor->comp[0].depth;
+    if (frame->color_range == AVCOL_RANGE_JPEG) {
+        m_YOffset = 0.0f;
+        m_YScale = 1.0f / static_cast<float>((1 << depth) - 1);
+        m_COffset = static_cast<float>(1 << (depth - 1));
+        m_CScale = m_YScale;
+    } else {
+        const float unit = static_cast<float>(1 << (depth - 8));
+        m_YOffset = 16.0f * unit;
+        m_YScale = 1.0f / (219.0f * unit);
+        m_COffset = 128.0f * unit;
+        m_CScale = 1.0f / (224.0f * unit);
+    }
+
+    const bool bt709Matrix = (frame->colorspace == AVCOL_SPC_BT709);
+    const float kr = bt709Matrix ? 0.2126f : 0.2627f;
+    const float kb = bt709Matrix ? 0.0722f : 0.0593f;
+    const float kg = 1.0f - kr - kb;
+    m_CrR = 2.0f * (1.0f - kr);
+    m_CbB = 2.0f * (1.0f - kb);
+    m_CbG = -(kb * m_CbB) / kg;
+    m_CrG = -(kr * m_CrR) / kg;
+
+    // linear BT.2020 to linear BT.709 (sources tagged with BT.709 primaries are left alone)
+    if (frame->color_primaries == AVCOL_PRI_BT709) {
+        m_Gamut = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+    } else {
+        m_Gamut = {
+            1.6605f, -0.5876f, -0.0728f,
+            -0.1246f, 1.1329f, -0.0083f,
+            -0.0182f, -0.1006f, 1.1187f
+        };
+    }
+
+    // the content peak: HLG is scene-referred and always displayed on a nominal 1000 nits display
+    const Transfer transfer = (frame->color_trc == AVCOL_TRC_ARIB_STD_B67) ? Transfer::HLG : Transfer::PQ;
+    float peak = DefaultPeak;
+    if (transfer == Transfer::PQ) {
+        const AVFrameSideData* cll = av_frame_get_side_data(frame, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL);
+        const AVFrameSideData* mastering = av_frame_get_side_data(frame, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA);
+
+        if ((cll != NULL) && (reinterpret_cast<const AVContentLightMetadata*>(cll->data)->MaxCLL > 0)) {
+            peak = static_cast<float>(reinterpret_cast<const AVContentLightMetadata*>(cll->data)->MaxCLL);
+        } else if ((mastering != NULL) && (reinterpret_cast<const AVMasteringDisplayMetadata*>(mastering->data)->has_luminance)) {
+            peak = static_cast<float>(av_q2d(reinterpret_cast<const AVMasteringDisplayMetadata*>(mastering->data)->max_luminance));
+        }
+
+        peak = std::min(std::max(peak, ReferenceWhite), 10000.0f);
+    }
+
+    if ((m_Prepared) && (m_Transfer == transfer) && (m_Peak == peak) && (m_PreparedCurve == m_Curve)) {
+        return;
+    }
+
+    m_Prepared = true;
+    m_Transfer = transfer;
+    m_Peak = peak;
+    m_PreparedCurve = m_Curve;
+
+    // signal to linear light, normalized to the content peak
+    for (size_t i = 0; i < LinearizeTableSize; ++i) {
+        const double e = static_cast<double>(i) / static_cast<double>(LinearizeTableSize - 1);
+
+        double linear = 0.0;
+        if (transfer == Transfer::PQ) {
+            linear = pqToNits(e) / peak;
+        } else {
+            // the HLG system gamma (1.2 at 1000 nits) is applied per component, approximating the OOTF
+            linear = std::pow(hlgToScene(e), 1.2);
+        }
+
+        m_Linearize[i] = static_cast<float>(std::min(linear, 1.0));
+    }
+
+    // linear light to SDR: the tone curve brings the content peak to SDR white, then BT.1886 display encoding
+    const double white = static_cast<double>(peak) / ReferenceWhite;
+    const double sourcePq = nitsToPq(peak);
+    const double maxLuminance = nitsToPq(ReferenceWhite) / sourcePq;
+    const double knee = std::max((1.5 * maxLuminance) - 0.5, 0.0);
+
+    for (size_t i = 0; i < ToneTableSize; ++i) {
+        const double root = static_cast<double>(i) / static_cast<double>(ToneTableSize - 1);
+        const double nits = root * root * peak;
+        const double l = nits / ReferenceWhite;
+
+        double sdr = l;
+        if (white > 1.0) {
+            switch (m_Curve) {
+                case Curve::Reinhard:
+                    sdr = (l * (1.0 + (l / (white * white)))) / (1.0 + l);
+                    break;
+
+                case Curve::Hable:
+                    sdr = hable(2.0 * l) / hable(2.0 * white);
+                    break;
+
+                case Curve::BT2390: {
+                    double e = nitsToPq(nits) / sourcePq;
+                    if ((e > knee) && (knee < 1.0)) {
+                        const double t = (e - knee) / (1.0 - knee);
+                        const double t2 = t * t;
+                        const double t3 = t2 * t;
+                        e = (((2.0 * t3) - (3.0 * t2) + 1.0) * knee) + ((t3 - (2.0 * t2) + t) * (1.0 - knee)) + (((-2.0 * t3) + (3.0 * t2)) * maxLuminance);
+                    }
+
+                    sdr = pqToNits(e * sourcePq) / ReferenceWhite;
+                    break;
+                }
+            }
+        }
+
+        const double encoded = std::pow(std::min(std::max(sdr, 0.0), 1.0), 1.0 / 2.4);
+        m_Tone[i] = static_cast<uint8_t>(std::lround(encoded * 255.0));
+    }
+}
+
+void ToneMapper::mapRow(const AVFrame* frame, uint32_t srcRow, uint32_t width, uint8_t* r, uint8_t* g, uint8_t* b) noexcept {
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+
+    const uint8_t* rows[3];
+    int shifts[3];
+    for (int c = 0; c < 3; ++c) {
+        const auto& comp = descriptor->comp[c];
+        const uint32_t row = (c == 0) ? srcRow : (srcRow >> descriptor->log2_chroma_h);
+        rows[c] = frame->data[comp.plane] + (static_cast<ptrdiff_t>(row) * frame->linesize[comp.plane]);
+        shifts[c] = comp.shift;
+    }
+
+    const uint32_t mask = (1u << descriptor->comp[0].depth) - 1;
+
+    const Vec4 yOffset = splat4(m_YOffset), yScale = splat4(m_YScale);
+    const Vec4 cOffset = splat4(m_COffset), cScale = splat4(m_CScale);
+    const Vec4 crR = splat4(m_CrR), cbG = splat4(m_CbG), crG = splat4(m_CrG), cbB = splat4(m_CbB);
+
+    Vec4 gamut[9];
+    for (size_t i = 0; i < 9; ++i) {
+        gamut[i] = splat4(m_Gamut[i]);
+    }
+
+    alignas(16) float samples[3][4];
+    alignas(16) float linear[3][4];
+    alignas(16) int32_t index[3][4];
+
+    for (uint32_t x = 0; x < width; x += 4) {
+        const uint32_t count = std::min<uint32_t>(4, width - x);
+
+        // gather: the tail of the row repeats its last pixel
+        for (uint32_t i = 0; i < 4; ++i) {
+            const uint32_t column = x + std::min(i, count - 1);
+            for (int c = 0; c < 3; ++c) {
+                uint16_t sample;
+                std::memcpy(&sample, rows[c] + m_Columns[c][column], sizeof(sample));
+                samples[c][i] = static_cast<float>((sample >> shifts[c]) & mask);
+            }
+        }
+
+        // YUV to normalized R'G'B'
+        const Vec4 y = mul4(sub4(load4(samples[0]), yOffset), yScale);
+        const Vec4 cb = mul4(sub4(load4(samples[1]), cOffset), cScale);
+        const Vec4 cr = mul4(sub4(load4(samples[2]), cOffset), cScale);
+
+        index4(clamp4(add4(y, mul4(cr, crR))), LinearizeTableSize - 1, index[0]);
+        index4(clamp4(add4(y, add4(mul4(cb, cbG), mul4(cr, crG)))), LinearizeTableSize - 1, index[1]);
+        index4(clamp4(add4(y, mul4(cb, cbB))), LinearizeTableSize - 1, index[2]);
+
+        for (int c = 0; c < 3; ++c) {
+            for (int i = 0; i < 4; ++i) {
+                linear[c][i] = m_Linearize[index[c][i]];
+            }
+        }
+
+        // primaries conversion in linear light
+        const Vec4 lr = load4(linear[0]), lg = load4(linear[1]), lb = load4(linear[2]);
+        for (int c = 0; c < 3; ++c) {
+            const Vec4 v = clamp4(add4(mul4(lr, gamut[(c * 3) + 0]), add4(mul4(lg, gamut[(c * 3) + 1]), mul4(lb, gamut[(c * 3) + 2]))));
+            index4(sqrt4(v), ToneTableSize - 1, index[c]);
+        }
+
+        for (uint32_t i = 0; i < count; ++i) {
+            r[x + i] = m_Tone[index[0][i]];
+            g[x + i] = m_Tone[index[1][i]];
+            b[x + i] = m_Tone[index[2][i]];
+        }
+    }
+}
+
+bool ToneMapper::map(const AVFrame* frame, Frame::PixelFormat pf, uint32_t width, uint32_t height, void* dst) noexcept {
+    if ((!isApplicable(frame, pf)) || (width == 0) || (height == 0)) {
+        return false;
+    }
+
+    prepare(frame);
+
+    // byte offset (inside a row) of the samples read by every output column
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+    const uint32_t srcWidth = static_cast<uint32_t>(frame->width);
+    const uint32_t srcHeight = static_cast<uint32_t>(frame->height);
+    for (int c = 0; c < 3; ++c) {
+        const auto& comp = descriptor->comp[c];
+        const int subsampling = (c == 0) ? 0 : descriptor->log2_chroma_w;
+
+        m_Columns[c].resize(width);
+        for (uint32_t x = 0; x < width; ++x) {
+            const uint32_t srcX = static_cast<uint32_t>((static_cast<uint64_t>(x) * srcWidth) / width);
+            m_Columns[c][x] = ((srcX >> subsampling) * comp.step) + comp.offset;
+        }
+    }
+
+    m_Rows.resize(static_cast<size_t>(width) * 6);
+    uint8_t* planes[2][3];
+    for (int row = 0; row < 2; ++row) {
+        for (int c = 0; c < 3; ++c) {
+            planes[row][c] = m_Rows.data() + (static_cast<size_t>((row * 3) + c) * width);
+        }
+    }
+
+    auto sourceRow = [=](uint32_t y) {
+        return static_cast<uint32_t>((static_cast<uint64_t>(y) * srcHeight) / height);
+    };
+
+    if (pf == Frame::PixelFormat::RGBA32) {
+        uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+        for (uint32_t y = 0; y < height; ++y) {
+            mapRow(frame, sourceRow(y), width, planes[0][0], planes[0][1], planes[0][2]);
+
+            for (uint32_t x = 0; x < width; ++x) {
+                out[0] = planes[0][0][x];
+                out[1] = planes[0][1][x];
+                out[2] = planes[0][2][x];
+                out[3] = 0xFF;
+                out += 4;
+            }
+        }
+
+        return true;
+    }
+
+    // NV12: rows are mapped in pairs, chroma (BT.709, limited range) is the average of each 2x2 block
+    uint8_t* luma = reinterpret_cast<uint8_t*>(dst);
+    uint8_t* chroma = luma + (static_cast<size_t>(width) * height);
+    const uint32_t chromaWidth = (width + 1) / 2;
+
+    for (uint32_t y = 0; y < height; y += 2) {
+        const uint32_t pair = (y + 1 < height) ? 2 : 1;
+        for (uint32_t row = 0; row < pair; ++row) {
+            mapRow(frame, sourceRow(y + row), width, planes[row][0], planes[row][1], planes[row][2]);
+
+            uint8_t* out = luma + (static_cast<size_t>(y + row) * width);
+            for (uint32_t x = 0; x < width; ++x) {
+                const int32_t r = planes[row][0][x], g = planes[row][1][x], b = planes[row][2][x];
+                out[x] = static_cast<uint8_t>((((47 * r) + (157 * g) + (16 * b) + 128) >> 8) + 16);
+            }
+        }
+
+        uint8_t* out = chroma + (static_cast<size_t>(y / 2) * chromaWidth * 2);
+        for (uint32_t cx = 0; cx < chromaWidth; ++cx) {
+            const uint32_t x0 = cx * 2;
+            const uint32_t x1 = std::min(x0 + 1, width - 1);
+            const uint8_t* const* bottom = planes[pair - 1];
+
+            const int32_t r = (planes[0][0][x0] + planes[0][0][x1] + bottom[0][x0] + bottom[0][x1] + 2) >> 2;
+            const int32_t g = (planes[0][1][x0] + planes[0][1][x1] + bottom[1][x0] + bottom[1][x1] + 2) >> 2;
+            const int32_t b = (planes[0][2][x0] + planes[0][2][x1] + bottom[2][x0] + bottom[2][x1] + 2) >> 2;
+
+            out[(cx * 2) + 0] = static_cast<uint8_t>((((-26 * r) - (87 * g) + (113 * b) + 128) >> 8) + 128);
+            out[(cx * 2) + 1] = static_cast<uint8_t>((((112 * r) - (102 * g) - (10 * b) + 128) >> 8) + 128);
+        }
+    }
+
+    return true;
+}
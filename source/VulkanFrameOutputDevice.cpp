@@ -0,0 +1,1246 @@
+#include "VulkanFrameOutputDevice.h"
+#include "PresentationClock.h"
+
+// for memcpy
+#include <cstring>
+
+// SPIR-V compiled from source/shaders at build time
+static const uint32_t YCbCrVertexShader[] = {
+#include "shaders/ycbcr.vert.inc"
+};
+
+static const uint32_t YCbCrFragmentShader[] = {
+#include "shaders/ycbcr.frag.inc"
+};
+
+static size_t roundUp(size_t value, size_t alignment) noexcept {
+    return ((value + alignment - 1) / alignment) * alignment;
+}
+
+static VkFormat imageFormatOf(Frame::PixelFormat pf) noexcept {
+    switch (pf) {
+        case Frame::PixelFormat::RGBA64:
+            return VK_FORMAT_R16G16B16A16_UNORM;
+
+        case Frame::PixelFormat::RGBA32:
+            return VK_FORMAT_R8G8B8A8_UNORM;
+
+        case Frame::PixelFormat::NV12:
+            return VK_FORMAT_G8_B8R8_2PLANE_420_UNORM;
+    }
+
+    // this MUST NOT happend
+    return VK_FORMAT_UNDEFINED;
+}
+
+static void transition(
+    VkCommandBuffer cmd,
+    VkImage image,
+    VkImageLayout oldLayout,
+    VkImageLayout newLayout,
+    VkAccessFlags srcAccess,
+    VkAccessFlags dstAccess,
+    VkPipelineStageFlags srcStage,
+    VkPipelineStageFlags dstStage
+) noexcept {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+VulkanFrameOutputDevice::VulkanFrameOutputDevice(
+    BufferedFrameOutputDevice::FrameCountType frameCount,
+    size_t maxFrameSize
+) noexcept
+ : BufferedFrameOutputDevice(frameCount),
+ m_Instance(VK_NULL_HANDLE),
+ m_PhysicalDevice(VK_NULL_HANDLE),
+ m_Device(VK_NULL_HANDLE),
+ m_QueueFamily(0),
+ m_Queue(VK_NULL_HANDLE),
+ m_Valid(false),
+ m_StagingBuffer(VK_NULL_HANDLE),
+ m_StagingMemory(VK_NULL_HANDLE),
+ m_Staging(nullptr),
+ m_SliceSize(0),
+ m_SliceCount(0),
+ m_Timeline(VK_NULL_HANDLE),
+ m_TimelineValue(0),
+ m_CommandPool(VK_NULL_HANDLE),
+ m_CommandBuffers{},
+ m_ReadbackCommandBuffer(VK_NULL_HANDLE),
+ m_SubmittedValues{},
+ m_Submissions(0),
+ m_Conversion(VK_NULL_HANDLE),
+ m_Sampler(VK_NULL_HANDLE),
+ m_SetLayout(VK_NULL_HANDLE),
+ m_DescriptorPool(VK_NULL_HANDLE),
+ m_PipelineLayout(VK_NULL_HANDLE),
+ m_RenderPass(VK_NULL_HANDLE),
+ m_Pipeline(VK_NULL_HANDLE),
+ m_Targets{},
+ m_TargetWidth(0),
+ m_TargetHeight(0),
+ m_ShouldStop(false),
+ m_PresentedFrames(0),
+ m_AnchorRate(0.0),
+ m_Lateness(0) {
+    if ((!createDevice()) || (!createStaging(frameCount, maxFrameSize))) {
+        return;
+    }
+
+    // without the conversion NV12 cannot be sampled: frames are converted by the decoder instead
+    if (!createConversion()) {
+        std::cerr << "YCbCr sampling is not available: frames will be uploaded as RGBA" << std::endl;
+    }
+
+    setPreferredFrameFormat(isConvertingYCbCr() ? Frame::PixelFormat::NV12 : Frame::PixelFormat::RGBA32, 0, 0);
+
+    m_Valid = true;
+}
+
+VulkanFrameOutputDevice::~VulkanFrameOutputDevice() {
+    interrupt();
+
+    if (m_Device != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(m_Device);
+    }
+
+    // submitted frames give their slice back, so the staging memory must still be mapped here
+    for (auto& frame : m_Submitted) {
+        frame.reset();
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_QueueMutex);
+        m_Frames.clear();
+    }
+
+    if (m_Device != VK_NULL_HANDLE) {
+        destroyTargets();
+
+        vkDestroyPipeline(m_Device, m_Pipeline, NULL);
+        vkDestroyRenderPass(m_Device, m_RenderPass, NULL);
+        vkDestroyPipelineLayout(m_Device, m_PipelineLayout, NULL);
+        vkDestroyDescriptorPool(m_Device, m_DescriptorPool, NULL);
+        vkDestroyDescriptorSetLayout(m_Device, m_SetLayout, NULL);
+        vkDestroySampler(m_Device, m_Sampler, NULL);
+        vkDestroySamplerYcbcrConversion(m_Device, m_Conversion, NULL);
+
+        vkDestroyCommandPool(m_Device, m_CommandPool, NULL);
+        vkDestroySemaphore(m_Device, m_Timeline, NULL);
+
+        if (m_Staging != nullptr) {
+            vkUnmapMemory(m_Device, m_StagingMemory);
+        }
+
+        vkDestroyBuffer(m_Device, m_StagingBuffer, NULL);
+        vkFreeMemory(m_Device, m_StagingMemory, NULL);
+
+        vkDestroyDevice(m_Device, NULL);
+    }
+
+    if (m_Instance != VK_NULL_HANDLE) {
+        vkDestroyInstance(m_Instance, NULL);
+    }
+}
+
+bool VulkanFrameOutputDevice::createDevice() noexcept {
+    VkApplicationInfo appInfo = {};
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = "EODPlayer";
+    appInfo.apiVersion = VK_API_VERSION_1_2;
+
+    // no surface is used: the instance does not need any extension
+    VkInstanceCreateInfo instanceInfo = {};
+    instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceInfo.pApplicationInfo = &appInfo;
+
+    if (vkCreateInstance(&instanceInfo, NULL, &m_Instance) != VK_SUCCESS) {
+        std::cerr << "Could not create a Vulkan 1.2 instance" << std::endl;
+        return false;
+    }
+
+    uint32_t physicalDeviceCount = 0;
+    vkEnumeratePhysicalDevices(m_Instance, &physicalDeviceCount, NULL);
+    std::vector<VkPhysicalDevice> physicalDevices(physicalDeviceCount);
+    vkEnumeratePhysicalDevices(m_Instance, &physicalDeviceCount, physicalDevices.data());
+
+    // hardware devices are preferred, software rasterizers (lavapipe) are picked when nothing else is available
+    bool ycbcrSupported = false;
+    for (const auto physicalDevice : physicalDevices) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        if (properties.apiVersion < VK_API_VERSION_1_2) {
+            continue;
+        }
+
+        VkPhysicalDeviceVulkan12Features features12 = {};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+        VkPhysicalDeviceVulkan11Features features11 = {};
+        features11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+        features11.pNext = &features12;
+
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &features11;
+
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+        if (features12.timelineSemaphore != VK_TRUE) {
+            continue;
+        }
+
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, NULL);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+        // graphics queues also support transfers
+        std::optional<uint32_t> family;
+        for (uint32_t i = 0; i < familyCount; ++i) {
+            if ((families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0) {
+                family = i;
+                break;
+            }
+        }
+
+        if (!family.has_value()) {
+            continue;
+        }
+
+        const bool software = properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+        if ((m_PhysicalDevice == VK_NULL_HANDLE) || (!software)) {
+            m_PhysicalDevice = physicalDevice;
+            m_QueueFamily = family.value();
+            ycbcrSupported = features11.samplerYcbcrConversion == VK_TRUE;
+        }
+
+        if (!software) {
+            break;
+        }
+    }
+
+    if (m_PhysicalDevice == VK_NULL_HANDLE) {
+        std::cerr << "No Vulkan device supports timeline semaphores" << std::endl;
+        return false;
+    }
+
+    const float priority = 1.0f;
+    VkDeviceQueueCreateInfo queueInfo = {};
+    queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo.queueFamilyIndex = m_QueueFamily;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &priority;
+
+    VkPhysicalDeviceVulkan12Features features12 = {};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features12.timelineSemaphore = VK_TRUE;
+
+    VkPhysicalDeviceVulkan11Features features11 = {};
+    features11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    features11.pNext = &features12;
+    features11.samplerYcbcrConversion = ycbcrSupported ? VK_TRUE : VK_FALSE;
+
+    VkDeviceCreateInfo deviceInfo = {};
+    deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceInfo.pNext = &features11;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+
+    if (vkCreateDevice(m_PhysicalDevice, &deviceInfo, NULL, &m_Device) != VK_SUCCESS) {
+        std::cerr << "Could not create the Vulkan device" << std::endl;
+        return false;
+    }
+
+    vkGetDeviceQueue(m_Device, m_QueueFamily, 0, &m_Queue);
+
+    VkSemaphoreTypeCreateInfo timelineType = {};
+    timelineType.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineType.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineType.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &timelineType;
+
+    if (vkCreateSemaphore(m_Device, &semaphoreInfo, NULL, &m_Timeline) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = m_QueueFamily;
+
+    if (vkCreateCommandPool(m_Device, &poolInfo, NULL, &m_CommandPool) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkCommandBuffer commandBuffers[InFlightSubmissions + 1];
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = m_CommandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = InFlightSubmissions + 1;
+
+    if (vkAllocateCommandBuffers(m_Device, &allocInfo, commandBuffers) != VK_SUCCESS) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < InFlightSubmissions; ++i) {
+        m_CommandBuffers[i] = commandBuffers[i];
+    }
+
+    m_ReadbackCommandBuffer = commandBuffers[InFlightSubmissions];
+
+    return true;
+}
+
+std::optional<uint32_t> VulkanFrameOutputDevice::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const noexcept {
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(m_PhysicalDevice, &memoryProperties);
+
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+        if (((typeBits & (1u << i)) != 0) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)) {
+            return i;
+        }
+    }
+
+    return std::nullopt;
+}
+
+bool VulkanFrameOutputDevice::createStaging(size_t frameCount, size_t maxFrameSize) noexcept {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
+
+    // every slice starts at an offset good for buffer to image copies of any format
+    const size_t alignment = std::max<size_t>(static_cast<size_t>(properties.limits.optimalBufferCopyOffsetAlignment), 16);
+    m_SliceSize = roundUp(maxFrameSize, alignment);
+    m_SliceCount = frameCount;
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = static_cast<VkDeviceSize>(m_SliceSize * m_SliceCount);
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(m_Device, &bufferInfo, NULL, &m_StagingBuffer) != VK_SUCCESS) {
+        std::cerr << "Could not create a staging buffer of " << (m_SliceSize * m_SliceCount) << " bytes" << std::endl;
+        return false;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(m_Device, m_StagingBuffer, &requirements);
+
+    // coherent memory makes decoded pixels visible to transfers without flushes; cached memory is preferred
+    // since the same memory is also read back on the host
+    auto memoryType = findMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    if (!memoryType.has_value()) {
+        memoryType = findMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+
+    if (!memoryType.has_value()) {
+        return false;
+    }
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = memoryType.value();
+
+    if ((vkAllocateMemory(m_Device, &allocInfo, NULL, &m_StagingMemory) != VK_SUCCESS) ||
+        (vkBindBufferMemory(m_Device, m_StagingBuffer, m_StagingMemory, 0) != VK_SUCCESS)) {
+        std::cerr << "Could not allocate " << requirements.size << " bytes of staging memory" << std::endl;
+        return false;
+    }
+
+    void* mapping = nullptr;
+    if (vkMapMemory(m_Device, m_StagingMemory, 0, VK_WHOLE_SIZE, 0, &mapping) != VK_SUCCESS) {
+        return false;
+    }
+
+    m_Staging = reinterpret_cast<uint8_t*>(mapping);
+
+    // the lowest slices are handed out first
+    for (uint32_t i = 0; i < m_SliceCount; ++i) {
+        m_FreeSlices.push_back(static_cast<uint32_t>(m_SliceCount) - 1 - i);
+    }
+
+    return true;
+}
+
+bool VulkanFrameOutputDevice::createConversion() noexcept {
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(m_PhysicalDevice, VK_FORMAT_G8_B8R8_2PLANE_420_UNORM, &formatProperties);
+
+    const VkFormatFeatureFlags features = formatProperties.optimalTilingFeatures;
+    const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    if ((features & required) != required) {
+        return false;
+    }
+
+    // the chroma siting of ffmpeg 4:2:0 frames (left, between the two lines) is used when the format allows it
+    const VkChromaLocation xOffset = ((features & VK_FORMAT_FEATURE_COSITED_CHROMA_SAMPLES_BIT) != 0) ? VK_CHROMA_LOCATION_COSITED_EVEN : VK_CHROMA_LOCATION_MIDPOINT;
+    const VkFilter chromaFilter = ((features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_YCBCR_CONVERSION_LINEAR_FILTER_BIT) != 0) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+    VkSamplerYcbcrConversionCreateInfo conversionInfo = {};
+    conversionInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO;
+    conversionInfo.format = VK_FORMAT_G8_B8R8_2PLANE_420_UNORM;
+    conversionInfo.ycbcrModel = VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_709;
+    conversionInfo.ycbcrRange = VK_SAMPLER_YCBCR_RANGE_ITU_NARROW;
+    conversionInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+    conversionInfo.xChromaOffset = xOffset;
+    conversionInfo.yChromaOffset = VK_CHROMA_LOCATION_MIDPOINT;
+    conversionInfo.chromaFilter = chromaFilter;
+    conversionInfo.forceExplicitReconstruction = VK_FALSE;
+
+    if (vkCreateSamplerYcbcrConversion(m_Device, &conversionInfo, NULL, &m_Conversion) != VK_SUCCESS) {
+        m_Conversion = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkSamplerYcbcrConversionInfo samplerConversion = {};
+    samplerConversion.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO;
+    samplerConversion.conversion = m_Conversion;
+
+    // without separate reconstruction filters the sampler filter MUST match the chroma filter
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.pNext = &samplerConversion;
+    samplerInfo.magFilter = chromaFilter;
+    samplerInfo.minFilter = chromaFilter;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+    if (vkCreateSampler(m_Device, &samplerInfo, NULL, &m_Sampler) != VK_SUCCESS) {
+        return false;
+    }
+
+    // samplers with a YCbCr conversion can only be used as immutable samplers
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    binding.pImmutableSamplers = &m_Sampler;
+
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount = 1;
+    setLayoutInfo.pBindings = &binding;
+
+    if (vkCreateDescriptorSetLayout(m_Device, &setLayoutInfo, NULL, &m_SetLayout) != VK_SUCCESS) {
+        return false;
+    }
+
+    // a multi-planar descriptor can take more than one slot of the pool (one per plane at most)
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = InFlightSubmissions * 3;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = InFlightSubmissions;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+
+    if (vkCreateDescriptorPool(m_Device, &poolInfo, NULL, &m_DescriptorPool) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkDescriptorSetLayout setLayouts[InFlightSubmissions];
+    VkDescriptorSet sets[InFlightSubmissions];
+    for (uint32_t i = 0; i < InFlightSubmissions; ++i) {
+        setLayouts[i] = m_SetLayout;
+    }
+
+    VkDescriptorSetAllocateInfo setInfo = {};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = m_DescriptorPool;
+    setInfo.descriptorSetCount = InFlightSubmissions;
+    setInfo.pSetLayouts = setLayouts;
+
+    if (vkAllocateDescriptorSets(m_Device, &setInfo, sets) != VK_SUCCESS) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < InFlightSubmissions; ++i) {
+        m_Targets[i].descriptorSet = sets[i];
+    }
+
+    VkPipelineLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &m_SetLayout;
+
+    if (vkCreatePipelineLayout(m_Device, &layoutInfo, NULL, &m_PipelineLayout) != VK_SUCCESS) {
+        return false;
+    }
+
+    // the converted image is left ready to be sampled (or read back) by whoever presents it
+    VkAttachmentDescription attachment = {};
+    attachment.format = VK_FORMAT_R8G8B8A8_UNORM;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference colorReference = {};
+    colorReference.attachment = 0;
+    colorReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorReference;
+
+    VkSubpassDependency dependencies[2] = {};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].srcAccessMask = 0;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &attachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.pDependencies = dependencies;
+
+    if (vkCreateRenderPass(m_Device, &renderPassInfo, NULL, &m_RenderPass) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkShaderModuleCreateInfo vertexInfo = {};
+    vertexInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    vertexInfo.codeSize = sizeof(YCbCrVertexShader);
+    vertexInfo.pCode = YCbCrVertexShader;
+
+    VkShaderModuleCreateInfo fragmentInfo = {};
+    fragmentInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    fragmentInfo.codeSize = sizeof(YCbCrFragmentShader);
+    fragmentInfo.pCode = YCbCrFragmentShader;
+
+    VkShaderModule vertexModule = VK_NULL_HANDLE;
+    VkShaderModule fragmentModule = VK_NULL_HANDLE;
+    if ((vkCreateShaderModule(m_Device, &vertexInfo, NULL, &vertexModule) != VK_SUCCESS) ||
+        (vkCreateShaderModule(m_Device, &fragmentInfo, NULL, &fragmentModule) != VK_SUCCESS)) {
+        vkDestroyShaderModule(m_Device, vertexModule, NULL);
+        return false;
+    }
+
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vertexModule;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = fragmentModule;
+    stages[1].pName = "main";
+
+    VkPipelineVertexInputStateCreateInfo vertexInput = {};
+    vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    // the frame size can change: viewport and scissor are set when recording
+    VkPipelineViewportStateCreateInfo viewport = {};
+    viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterization = {};
+    rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterization.cullMode = VK_CULL_MODE_NONE;
+    rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterization.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState blendAttachment = {};
+    blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo blend = {};
+    blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    blend.attachmentCount = 1;
+    blend.pAttachments = &blendAttachment;
+
+    const VkDynamicState dynamicStates[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic = {};
+    dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic.dynamicStateCount = 2;
+    dynamic.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = stages;
+    pipelineInfo.pVertexInputState = &vertexInput;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewport;
+    pipelineInfo.pRasterizationState = &rasterization;
+    pipelineInfo.pMultisampleState = &multisample;
+    pipelineInfo.pColorBlendState = &blend;
+    pipelineInfo.pDynamicState = &dynamic;
+    pipelineInfo.layout = m_PipelineLayout;
+    pipelineInfo.renderPass = m_RenderPass;
+    pipelineInfo.subpass = 0;
+
+    const bool created = vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &m_Pipeline) == VK_SUCCESS;
+
+    vkDestroyShaderModule(m_Device, vertexModule, NULL);
+    vkDestroyShaderModule(m_Device, fragmentModule, NULL);
+
+    if (!created) {
+        m_Pipeline = VK_NULL_HANDLE;
+    }
+
+    return created;
+}
+
+bool VulkanFrameOutputDevice::isValid() const noexcept {
+    return m_Valid;
+}
+
+bool VulkanFrameOutputDevice::isConvertingYCbCr() const noexcept {
+    return m_Pipeline != VK_NULL_HANDLE;
+}
+
+bool VulkanFrameOutputDevice::createImage(VkFormat format, uint32_t width, uint32_t height, VkImageUsageFlags usage, VkImage& image, VkDeviceMemory& memory) noexcept {
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = { width, height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = usage;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(m_Device, &imageInfo, NULL, &image) != VK_SUCCESS) {
+        image = VK_NULL_HANDLE;
+        return false;
+    }
+
+    // planes of a non-disjoint multi-planar image share a single allocation
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(m_Device, image, &requirements);
+
+    const auto memoryType = findMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (!memoryType.has_value()) {
+        return false;
+    }
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = memoryType.value();
+
+    if (vkAllocateMemory(m_Device, &allocInfo, NULL, &memory) != VK_SUCCESS) {
+        memory = VK_NULL_HANDLE;
+        return false;
+    }
+
+    return vkBindImageMemory(m_Device, image, memory, 0) == VK_SUCCESS;
+}
+
+bool VulkanFrameOutputDevice::createTargets(Frame::PixelFormat pf, uint32_t width, uint32_t height) noexcept {
+    const bool convert = pf == Frame::PixelFormat::NV12;
+    const VkFormat format = imageFormatOf(pf);
+
+    VkSamplerYcbcrConversionInfo viewConversion = {};
+    viewConversion.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO;
+    viewConversion.conversion = m_Conversion;
+
+    for (auto& target : m_Targets) {
+        // RGBA uploads are presented as they are, so they are read back directly
+        const VkImageUsageFlags uploadUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | (convert ? 0 : VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+        if (!createImage(format, width, height, uploadUsage, target.upload, target.uploadMemory)) {
+            return false;
+        }
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.pNext = convert ? &viewConversion : NULL;
+        viewInfo.image = target.upload;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(m_Device, &viewInfo, NULL, &target.uploadView) != VK_SUCCESS) {
+            target.uploadView = VK_NULL_HANDLE;
+            return false;
+        }
+
+        if (!convert) {
+            continue;
+        }
+
+        const VkImageUsageFlags outputUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        if (!createImage(VK_FORMAT_R8G8B8A8_UNORM, width, height, outputUsage, target.output, target.outputMemory)) {
+            return false;
+        }
+
+        viewInfo.pNext = NULL;
+        viewInfo.image = target.output;
+        viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+
+        if (vkCreateImageView(m_Device, &viewInfo, NULL, &target.outputView) != VK_SUCCESS) {
+            target.outputView = VK_NULL_HANDLE;
+            return false;
+        }
+
+        VkFramebufferCreateInfo framebufferInfo = {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = m_RenderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &target.outputView;
+        framebufferInfo.width = width;
+        framebufferInfo.height = height;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(m_Device, &framebufferInfo, NULL, &target.framebuffer) != VK_SUCCESS) {
+            target.framebuffer = VK_NULL_HANDLE;
+            return false;
+        }
+
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.imageView = target.uploadView;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = target.descriptorSet;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &imageInfo;
+
+        vkUpdateDescriptorSets(m_Device, 1, &write, 0, NULL);
+    }
+
+    m_TargetFormat = pf;
+    m_TargetWidth = width;
+    m_TargetHeight = height;
+
+    return true;
+}
+
+void VulkanFrameOutputDevice::destroyTargets() noexcept {
+    for (auto& target : m_Targets) {
+        vkDestroyFramebuffer(m_Device, target.framebuffer, NULL);
+        vkDestroyImageView(m_Device, target.outputView, NULL);
+        vkDestroyImage(m_Device, target.output, NULL);
+        vkFreeMemory(m_Device, target.outputMemory, NULL);
+        vkDestroyImageView(m_Device, target.uploadView, NULL);
+        vkDestroyImage(m_Device, target.upload, NULL);
+        vkFreeMemory(m_Device, target.uploadMemory, NULL);
+
+        // descriptor sets live as long as the pool
+        const VkDescriptorSet descriptorSet = target.descriptorSet;
+        target = Target{};
+        target.descriptorSet = descriptorSet;
+    }
+
+    m_TargetFormat.reset();
+    m_Presented.reset();
+}
+
+std::optional<uint32_t> VulkanFrameOutputDevice::slotIndexOf(const void* mem) const noexcept {
+    if (m_Staging == nullptr) {
+        return std::nullopt;
+    }
+
+    const auto ptr = reinterpret_cast<const uint8_t*>(mem);
+    if ((ptr < m_Staging) || (ptr >= m_Staging + (m_SliceSize * m_SliceCount))) {
+        return std::nullopt;
+    }
+
+    const size_t offset = static_cast<size_t>(ptr - m_Staging);
+    if ((offset % m_SliceSize) != 0) {
+        return std::nullopt;
+    }
+
+    return static_cast<uint32_t>(offset / m_SliceSize);
+}
+
+void* VulkanFrameOutputDevice::allocate(size_t size, SlotType& slot) noexcept {
+    if ((!isValid()) || (size > m_SliceSize)) {
+        return nullptr;
+    }
+
+    std::unique_lock<std::mutex> lk(m_SlicesMutex);
+
+    m_SliceFreed.wait(lk, [this]() {
+        return (m_ShouldStop) || (!m_FreeSlices.empty());
+    });
+
+    if (m_ShouldStop) {
+        return nullptr;
+    }
+
+    slot = m_FreeSlices.back();
+    m_FreeSlices.pop_back();
+
+    return m_Staging + (m_SliceSize * slot);
+}
+
+void VulkanFrameOutputDevice::deallocate(void* mem, SlotType slot) noexcept {
+    if ((!isValid()) || (slot >= m_SliceCount)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_SlicesMutex);
+        m_FreeSlices.push_back(slot);
+    }
+
+    m_SliceFreed.notify_one();
+}
+
+void VulkanFrameOutputDevice::enqueueFrame(Frame&& frame) noexcept {
+    if ((!isValid()) || (!frame.isHoldingData())) {
+        return;
+    }
+
+    if (!slotIndexOf(frame.getRawBuffer()).has_value()) {
+        // the frame was not allocated by this device: copy it inside a staging slice
+        const size_t size = frame.getSizeInBytes();
+
+        Frame copy(frame.getPixelFormat(), frame.getWidth(), frame.getHeight());
+        copy.setPresentationTimestamp(frame.getPresentationTimestamp());
+        copy.setSourceIndex(frame.getSourceIndex());
+        copy.setDirtyRect(frame.getDirtyRect());
+        copy.storeFrameData(this, [&frame, size](void* mem) {
+            std::memcpy(mem, frame.getRawBuffer(), size);
+        });
+
+        if (!copy.isHoldingData()) {
+            return;
+        }
+
+        frame = std::move(copy);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_QueueMutex);
+        m_Frames.push_back(std::move(frame));
+
+        setQueuedFrames(static_cast<FrameCountType>(m_Frames.size()));
+    }
+
+    m_QueueCV.notify_one();
+}
+
+bool VulkanFrameOutputDevice::waitTimeline(uint64_t value) noexcept {
+    VkSemaphoreWaitInfo waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &m_Timeline;
+    waitInfo.pValues = &value;
+
+    return vkWaitSemaphores(m_Device, &waitInfo, std::numeric_limits<uint64_t>::max()) == VK_SUCCESS;
+}
+
+bool VulkanFrameOutputDevice::waitPresentationTime(const Frame& frame) noexcept {
+    const double rate = getClockRate();
+    const auto now = std::chrono::steady_clock::now();
+    const auto pts = frame.getPresentationTimestamp();
+
+    m_Lateness = 0;
+
+    // a stopped clock shows frames as soon as they come (frame stepping); the clock is anchored again
+    // on rate changes and discontinuities (seeks, loops, a new file)
+    if ((rate <= 0.0) || (!m_Anchor.has_value()) || (rate != m_AnchorRate) || (pts < m_Anchor->first)) {
+        m_Anchor = std::make_pair(pts, now);
+        m_AnchorRate = rate;
+        return !m_ShouldStop;
+    }
+
+    const auto elapsed = std::chrono::microseconds(static_cast<int64_t>(static_cast<double>(pts - m_Anchor->first) / rate));
+    const auto due = m_Anchor->second + elapsed;
+
+    // a frame far in the future is a discontinuity too
+    if ((due - now) > std::chrono::seconds(1)) {
+        m_Anchor = std::make_pair(pts, now);
+        return !m_ShouldStop;
+    }
+
+    std::unique_lock<std::mutex> lk(m_QueueMutex);
+    const bool interrupted = m_QueueCV.wait_until(lk, due, [this]() {
+        return m_ShouldStop.load();
+    });
+
+    m_Lateness = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - due).count();
+    return !interrupted;
+}
+
+bool VulkanFrameOutputDevice::isNextFrameDue() noexcept {
+    std::lock_guard<std::mutex> guard(m_QueueMutex);
+    return (!m_Frames.empty()) && (isDueOnPresentationClock(m_Frames.front()));
+}
+
+bool VulkanFrameOutputDevice::upload(Frame&& frame) noexcept {
+    const Frame::PixelFormat pf = frame.getPixelFormat();
+    const uint32_t width = frame.getWidth();
+    const uint32_t height = frame.getHeight();
+
+    // 4:2:0 images MUST have an even size
+    if ((pf == Frame::PixelFormat::NV12) && ((!isConvertingYCbCr()) || ((width % 2) != 0) || ((height % 2) != 0))) {
+        std::cerr << "Cannot upload a " << width << "x" << height << " NV12 frame" << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(m_SubmitMutex);
+
+    const uint32_t index = static_cast<uint32_t>(m_Submissions % InFlightSubmissions);
+
+    // the command buffer and images of this index are reused: the submission using them MUST be complete
+    if (!waitTimeline(m_SubmittedValues[index])) {
+        return false;
+    }
+
+    m_Submitted[index].reset();
+
+    if ((!m_TargetFormat.has_value()) || (m_TargetFormat.value() != pf) || (m_TargetWidth != width) || (m_TargetHeight != height)) {
+        vkQueueWaitIdle(m_Queue);
+
+        for (auto& submitted : m_Submitted) {
+            submitted.reset();
+        }
+
+        destroyTargets();
+
+        if (!createTargets(pf, width, height)) {
+            std::cerr << "Could not create images for " << width << "x" << height << " frames" << std::endl;
+            destroyTargets();
+            return false;
+        }
+    }
+
+    const Target& target = m_Targets[index];
+    const VkDeviceSize offset = static_cast<VkDeviceSize>(reinterpret_cast<const uint8_t*>(frame.getRawBuffer()) - m_Staging);
+    const VkCommandBuffer cmd = m_CommandBuffers[index];
+
+    vkResetCommandBuffer(cmd, 0);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(cmd, &beginInfo);
+
+    // previous contents are never needed: the whole image is overwritten
+    transition(cmd, target.upload, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkBufferImageCopy regions[2] = {};
+    uint32_t regionCount = 1;
+
+    regions[0].bufferOffset = offset;
+    regions[0].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    regions[0].imageSubresource.layerCount = 1;
+    regions[0].imageExtent = { width, height, 1 };
+
+    if (pf == Frame::PixelFormat::NV12) {
+        // luma, then interleaved chroma at half resolution right after it
+        regions[0].imageSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_0_BIT;
+
+        regions[1].bufferOffset = offset + (static_cast<VkDeviceSize>(width) * height);
+        regions[1].imageSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_1_BIT;
+        regions[1].imageSubresource.layerCount = 1;
+        regions[1].imageExtent = { width / 2, height / 2, 1 };
+        regionCount = 2;
+    }
+
+    vkCmdCopyBufferToImage(cmd, m_StagingBuffer, target.upload, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regionCount, regions);
+
+    transition(cmd, target.upload, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkImage presented = target.upload;
+
+    if (pf == Frame::PixelFormat::NV12) {
+        VkRenderPassBeginInfo renderPassBegin = {};
+        renderPassBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassBegin.renderPass = m_RenderPass;
+        renderPassBegin.framebuffer = target.framebuffer;
+        renderPassBegin.renderArea.extent = { width, height };
+
+        VkViewport viewport = {};
+        viewport.width = static_cast<float>(width);
+        viewport.height = static_cast<float>(height);
+        viewport.maxDepth = 1.0f;
+
+        VkRect2D scissor = {};
+        scissor.extent = { width, height };
+
+        vkCmdBeginRenderPass(cmd, &renderPassBegin, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &target.descriptorSet, 0, NULL);
+        vkCmdSetViewport(cmd, 0, 1, &viewport);
+        vkCmdSetScissor(cmd, 0, 1, &scissor);
+        vkCmdDraw(cmd, 3, 1, 0, 0);
+        vkCmdEndRenderPass(cmd);
+
+        presented = target.output;
+    }
+
+    if (vkEndCommandBuffer(cmd) != VK_SUCCESS) {
+        return false;
+    }
+
+    const uint64_t signalValue = m_TimelineValue + 1;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmd;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &m_Timeline;
+
+    if (vkQueueSubmit(m_Queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        std::cerr << "Could not submit a frame upload" << std::endl;
+        return false;
+    }
+
+    // the staging slice is released once the copy reading it has completed
+    m_TimelineValue = signalValue;
+    m_Submitted[index].emplace(std::move(frame));
+    m_SubmittedValues[index] = signalValue;
+    m_Presented = index;
+    ++m_Submissions;
+
+    present(presented, width, height, signalValue);
+
+    return true;
+}
+
+void VulkanFrameOutputDevice::present(VkImage image, uint32_t width, uint32_t height, uint64_t timelineValue) noexcept {
+    ++m_PresentedFrames;
+}
+
+void VulkanFrameOutputDevice::exec() noexcept {
+    if (!isValid()) {
+        return;
+    }
+
+    while (!m_ShouldStop) {
+        std::optional<Frame> frame;
+
+        {
+            std::unique_lock<std::mutex> lk(m_QueueMutex);
+            m_QueueCV.wait(lk, [this]() {
+                return (m_ShouldStop) || (!m_Frames.empty());
+            });
+
+            if (m_ShouldStop) {
+                break;
+            }
+
+            frame.emplace(std::move(m_Frames.front()));
+            m_Frames.pop_front();
+
+            setQueuedFrames(static_cast<FrameCountType>(m_Frames.size()));
+        }
+
+        if (!getPresentationClock()) {
+            if (!waitPresentationTime(frame.value())) {
+                break;
+            }
+        } else {
+            if (!waitSharedPresentationTime(frame.value(), m_QueueMutex, m_QueueCV, m_ShouldStop, m_Lateness)) {
+                break;
+            }
+
+            // showing every frame late would keep this screen behind the others: it skips to the newest due frame
+            if (isNextFrameDue()) {
+                reportDroppedFrames(1);
+                continue;
+            }
+        }
+
+        reportPresentedFrame(frame.value(), m_Lateness);
+        upload(std::move(frame.value()));
+    }
+}
+
+void VulkanFrameOutputDevice::interrupt() noexcept {
+    {
+        std::lock_guard<std::mutex> slicesGuard(m_SlicesMutex);
+        std::lock_guard<std::mutex> queueGuard(m_QueueMutex);
+        m_ShouldStop = true;
+    }
+
+    m_SliceFreed.notify_all();
+    m_QueueCV.notify_all();
+}
+
+bool VulkanFrameOutputDevice::isFollowingPresentationClocks() const noexcept {
+    return true;
+}
+
+uint64_t VulkanFrameOutputDevice::getPresentedFrames() const noexcept {
+    return m_PresentedFrames;
+}
+
+bool VulkanFrameOutputDevice::readPresentedImage(std::vector<uint8_t>& pixels, uint32_t& width, uint32_t& height) noexcept {
+    if (!isValid()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(m_SubmitMutex);
+
+    if ((!m_Presented.has_value()) || (!m_TargetFormat.has_value())) {
+        return false;
+    }
+
+    const Target& target = m_Targets[m_Presented.value()];
+    const bool converted = m_TargetFormat.value() == Frame::PixelFormat::NV12;
+    const Frame::PixelFormat presentedFormat = converted ? Frame::PixelFormat::RGBA32 : m_TargetFormat.value();
+    const VkImage image = converted ? target.output : target.upload;
+    const size_t size = Frame::getFrameSizeInBytes(presentedFormat, m_TargetWidth, m_TargetHeight);
+
+    // the pixels are copied in a scratch buffer, as every staging slice could be owned by the decoder
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = static_cast<VkDeviceSize>(size);
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer buffer = VK_NULL_HANDLE;
+    if (vkCreateBuffer(m_Device, &bufferInfo, NULL, &buffer) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(m_Device, buffer, &requirements);
+
+    const auto memoryType = findMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = memoryType.value_or(0);
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if ((!memoryType.has_value()) ||
+        (vkAllocateMemory(m_Device, &allocInfo, NULL, &memory) != VK_SUCCESS) ||
+        (vkBindBufferMemory(m_Device, buffer, memory, 0) != VK_SUCCESS)) {
+        vkDestroyBuffer(m_Device, buffer, NULL);
+        vkFreeMemory(m_Device, memory, NULL);
+        return false;
+    }
+
+    const VkCommandBuffer cmd = m_ReadbackCommandBuffer;
+    vkResetCommandBuffer(cmd, 0);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(cmd, &beginInfo);
+
+    transition(cmd, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkBufferImageCopy region = {};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = { m_TargetWidth, m_TargetHeight, 1 };
+
+    vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+
+    transition(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    vkEndCommandBuffer(cmd);
+
+    // the readback is ordered after the upload on the queue, and is waited for with the next timeline value
+    const uint64_t signalValue = m_TimelineValue + 1;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmd;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &m_Timeline;
+
+    bool read = false;
+    if (vkQueueSubmit(m_Queue, 1, &submitInfo, VK_NULL_HANDLE) == VK_SUCCESS) {
+        m_TimelineValue = signalValue;
+
+        void* mapping = nullptr;
+        if ((waitTimeline(signalValue)) && (vkMapMemory(m_Device, memory, 0, VK_WHOLE_SIZE, 0, &mapping) == VK_SUCCESS)) {
+            pixels.resize(size);
+            std::memcpy(pixels.data(), mapping, size);
+            vkUnmapMemory(m_Device, memory);
+
+            width = m_TargetWidth;
+            height = m_TargetHeight;
+            read = true;
+        }
+    }
+
+    vkDestroyBuffer(m_Device, buffer, NULL);
+    vkFreeMemory(m_Device, memory, NULL);
+
+    return read;
+}
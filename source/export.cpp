@@ -0,0 +1,254 @@
+#include "FFMPEGDecoder.h"
+#include "FrameEncoderPool.h"
+#include "RenditionLoader.h"
+
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * @brief The settings of an export, read from the command line.
+ */
+struct ExportOptions {
+    uint32_t every = 1;
+
+    FrameEncoderPool::ImageFormat format = FrameEncoderPool::ImageFormat::PNG;
+
+    std::string directory = ".";
+
+    /**
+     * @brief The number of files decoded at the same time (0 = a quarter of the hardware threads).
+     */
+    size_t decoders = 0;
+
+    /**
+     * @brief The number of encoding threads (0 = number of hardware threads).
+     */
+    size_t encoders = 0;
+
+    /**
+     * @brief The number of frames waiting to be encoded (0 = two per encoding thread).
+     */
+    BufferedFrameOutputDevice::FrameCountType queue = 0;
+
+    std::vector<Decoder::FileNameType> files;
+};
+
+/**
+ * @brief The frame memory of an export: a frame pool counting the frames it could not give memory to.
+ *
+ * Decoders drop the frames their allocator cannot provide memory for: counting them makes the export fail
+ * instead of silently missing frames.
+ */
+class ExportFramePool : public FramePool {
+
+public:
+    ExportFramePool(SlotType blocks, size_t blockSize) noexcept
+     : FramePool(blocks, blockSize),
+     m_FailedAllocations(0) {
+
+    }
+
+    ~ExportFramePool() override = default;
+
+    void* allocate(size_t size, SlotType& slot) noexcept override {
+        void* mem = FramePool::allocate(size, slot);
+        if (mem == nullptr) {
+            ++m_FailedAllocations;
+        }
+
+        return mem;
+    }
+
+    uint64_t getFailedAllocations() const noexcept {
+        return m_FailedAllocations;
+    }
+
+private:
+    std::atomic<uint64_t> m_FailedAllocations;
+};
+
+static void usage(const char* program) noexcept {
+    std::cerr << "Usage: " << program << " [--every N] [--format png|jpeg|raw] [--output DIRECTORY]"
+        << " [--decoders N] [--encoders N] [--queue N] FILE..." << std::endl;
+}
+
+static bool parseOptions(int argc, char * argv[], ExportOptions& options) noexcept {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+        if (arg[0] != '-') {
+            options.files.push_back(arg);
+            continue;
+        }
+
+        if (value == nullptr) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+
+        if (std::strcmp(arg, "--every") == 0) {
+            options.every = static_cast<uint32_t>(std::max<unsigned long>(std::strtoul(value, nullptr, 10), 1));
+        } else if (std::strcmp(arg, "--format") == 0) {
+            if (std::strcmp(value, "png") == 0) {
+                options.format = FrameEncoderPool::ImageFormat::PNG;
+            } else if ((std::strcmp(value, "jpeg") == 0) || (std::strcmp(value, "jpg") == 0)) {
+                options.format = FrameEncoderPool::ImageFormat::JPEG;
+            } else if (std::strcmp(value, "raw") == 0) {
+                options.format = FrameEncoderPool::ImageFormat::Raw;
+            } else {
+                std::cerr << "Unknown format " << value << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(arg, "--output") == 0) {
+            options.directory = value;
+        } else if (std::strcmp(arg, "--decoders") == 0) {
+            options.decoders = std::strtoul(value, nullptr, 10);
+        } else if (std::strcmp(arg, "--encoders") == 0) {
+            options.encoders = std::strtoul(value, nullptr, 10);
+        } else if (std::strcmp(arg, "--queue") == 0) {
+            options.queue = static_cast<BufferedFrameOutputDevice::FrameCountType>(std::strtoul(value, nullptr, 10));
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+
+        ++i;
+    }
+
+    return !options.files.empty();
+}
+
+/**
+ * @brief Get the name of a file without its directory and extension.
+ */
+static std::string baseName(const std::string& path) noexcept {
+    const auto slash = path.find_last_of('/');
+    std::string name = (slash == std::string::npos) ? path : path.substr(slash + 1);
+
+    const auto dot = name.find_last_of('.');
+    if ((dot != std::string::npos) && (dot > 0)) {
+        name.erase(dot);
+    }
+
+    return name;
+}
+
+/**
+ * Entry point of the frame export tool: writes every Nth frame of many files as image files.
+ *
+ * Files are decoded concurrently (each by its own decoder, pulling frames on a decoding thread) and frames are
+ * handed to a pool of encoders through a bounded queue: decoding and encoding run on every core, and frame memory
+ * comes from a pool sized for the frames that can be in flight at the same time.
+ *
+ * @param   argc    command line arguments counter.
+ * @param   argv    command line arguments.
+ *
+ * @return          execution exit code.
+ */
+int main(int argc, char * argv[])
+{
+    ExportOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    const size_t encoders = (options.encoders == 0) ? threads : options.encoders;
+    const size_t decoders = std::min<size_t>((options.decoders == 0) ? std::max<size_t>(threads / 4, 1) : options.decoders, options.files.size());
+    const auto queue = (options.queue == 0) ? static_cast<BufferedFrameOutputDevice::FrameCountType>(encoders * 2) : options.queue;
+
+    // frames are exported at their size, in RGBA32, inside the largest width and height of the files
+    uint32_t maxWidth = 0;
+    uint32_t maxHeight = 0;
+    for (const auto& file : options.files) {
+        const auto rendition = RenditionLoader::probe(file);
+        if (rendition.has_value()) {
+            maxWidth = std::max(maxWidth, rendition->width);
+            maxHeight = std::max(maxHeight, rendition->height);
+        }
+    }
+
+    const size_t blockSize = Frame::getFrameSizeInBytes(Frame::PixelFormat::RGBA32, maxWidth, maxHeight);
+    if (blockSize == 0) {
+        std::cerr << "No file can be exported" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // a frame being decoded by each decoder, the queue and a frame being converted by each encoder:
+    // when every block is in use decoders wait for encoders
+    ExportFramePool framePool(static_cast<FrameAllocator::SlotType>(decoders + queue + encoders), blockSize);
+
+    FrameEncoderPool encoderPool(options.format, options.directory, queue, encoders);
+
+    // frames larger than a block (files that could not be probed, size changes within a file) are scaled down to fit
+    encoderPool.setPreferredFrameFormat(Frame::PixelFormat::RGBA32, maxWidth, maxHeight);
+
+    // files with the same name (in different directories) are told apart by their position on the command line
+    std::set<std::string> names;
+    for (size_t i = 0; i < options.files.size(); ++i) {
+        std::string name = baseName(options.files[i]);
+        if (!names.insert(name).second) {
+            name += "-" + std::to_string(i);
+        }
+
+        encoderPool.setSourceName(static_cast<Frame::SourceIndexType>(i), name);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::atomic<size_t> nextFile(0);
+    std::atomic<uint64_t> decodedFrames(0);
+
+    std::vector<std::thread> decodingThreads;
+    for (size_t d = 0; d < decoders; ++d) {
+        decodingThreads.emplace_back([&]() {
+            for (size_t i = nextFile++; i < options.files.size(); i = nextFile++) {
+                FFMPEGDecoder decoder(&encoderPool, &framePool);
+
+                // frames are pulled once, in order: nothing is ever shown again, so no frame is cached
+                decoder.setFrameCache(0, DecodedFrameCache::StorageMode::Native);
+
+                // cores are shared among decoders and encoders: each decoder keeps to its thread
+                decoder.setIntraOnlyWorkers(1);
+                decoder.setFrameStride(options.every);
+                decoder.loadFile(options.files[i]);
+
+                for (auto& frame : decoder.frames()) {
+                    frame.setSourceIndex(static_cast<Frame::SourceIndexType>(i));
+                    encoderPool.enqueueFrame(std::move(frame));
+                    ++decodedFrames;
+                }
+            }
+        });
+    }
+
+    for (auto& thread : decodingThreads) {
+        thread.join();
+    }
+
+    encoderPool.finish();
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    const auto statistics = encoderPool.getStatistics();
+
+    std::cout << "Exported " << statistics.encodedFrames << " frames (" << statistics.writtenBytes << " bytes) of "
+        << options.files.size() << " files in " << elapsed << "ms";
+    if (elapsed > 0) {
+        std::cout << ", " << (statistics.encodedFrames * 1000 / static_cast<uint64_t>(elapsed)) << " frames/s";
+    }
+    std::cout << std::endl;
+
+    if (framePool.getFailedAllocations() != 0) {
+        std::cerr << framePool.getFailedAllocations() << " frames have been dropped as they did not fit in the frame memory" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (statistics.failedFrames != 0) {
+        std::cerr << statistics.failedFrames << " of " << decodedFrames.load() << " frames could not be exported" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
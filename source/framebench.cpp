@@ -0,0 +1,295 @@
+#include "Frame.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+/**
+ * @brief The number of timed iterations of each benchmark.
+ */
+static constexpr size_t Iterations = 10000000;
+
+/**
+ * @brief The number of frames moves are shuffled between (a few queue slots, as in a buffered output device).
+ */
+static constexpr size_t QueuedFrames = 8;
+
+static constexpr uint32_t BenchWidth = 16;
+
+static constexpr uint32_t BenchHeight = 16;
+
+/**
+ * @brief The frame as it was before it referenced its allocator: both callbacks were std::function objects,
+ * the deallocator was stored inside the frame and copied by every move.
+ *
+ * Kept here, and only here, to measure what the allocator handle saves.
+ */
+class StdFunctionFrame {
+
+public:
+    typedef std::function<void*(size_t)>  AllocatorFunctionType;
+
+    typedef std::function<void(void*)>  DeallocatorFunctionType;
+
+    typedef std::function<void(void*)>  FrameFillerFunctionType;
+
+    StdFunctionFrame(Frame::PixelFormat pf, uint32_t width, uint32_t height) noexcept
+     : m_PixelFormat(pf),
+     m_Width(width),
+     m_Height(height),
+     m_PresentationTimestamp(0),
+     m_RawBuffer(nullptr),
+     m_DeallocatorFn(defaultDeallocFn) {
+
+    }
+
+    StdFunctionFrame(const StdFunctionFrame&) = delete;
+
+    StdFunctionFrame(StdFunctionFrame&& src) noexcept
+     : m_PixelFormat(src.m_PixelFormat),
+     m_Width(src.m_Width),
+     m_Height(src.m_Height),
+     m_PresentationTimestamp(src.m_PresentationTimestamp),
+     m_RawBuffer(src.m_RawBuffer),
+     m_DeallocatorFn(src.m_DeallocatorFn) {
+        src.m_RawBuffer = nullptr;
+        src.m_DeallocatorFn = defaultDeallocFn;
+    }
+
+    StdFunctionFrame& operator=(const StdFunctionFrame&) = delete;
+
+    StdFunctionFrame& operator=(StdFunctionFrame&& src) noexcept {
+        if (&src != this) {
+            if (isHoldingData()) {
+                m_DeallocatorFn(m_RawBuffer);
+            }
+
+            m_PixelFormat = src.m_PixelFormat;
+            m_Width = src.m_Width;
+            m_Height = src.m_Height;
+            m_PresentationTimestamp = src.m_PresentationTimestamp;
+            m_RawBuffer = src.m_RawBuffer;
+            m_DeallocatorFn = src.m_DeallocatorFn;
+            src.m_RawBuffer = nullptr;
+            src.m_DeallocatorFn = defaultDeallocFn;
+        }
+
+        return *this;
+    }
+
+    ~StdFunctionFrame() {
+        if (isHoldingData()) {
+            m_DeallocatorFn(m_RawBuffer);
+        }
+    }
+
+    void* getRawBuffer() const noexcept {
+        return m_RawBuffer;
+    }
+
+    bool isHoldingData() const noexcept {
+        return m_RawBuffer != nullptr;
+    }
+
+    void storeFrameData(
+        const AllocatorFunctionType& allocatorFn,
+        const DeallocatorFunctionType& deallocatorFn,
+        const FrameFillerFunctionType& fillerFn
+    ) noexcept {
+        m_RawBuffer = allocatorFn(Frame::getFrameSizeInBytes(m_PixelFormat, m_Width, m_Height));
+        if (m_RawBuffer == nullptr) {
+            return;
+        }
+
+        m_DeallocatorFn = deallocatorFn;
+
+        fillerFn(m_RawBuffer);
+    }
+
+private:
+    static const DeallocatorFunctionType defaultDeallocFn;
+
+    Frame::PixelFormat m_PixelFormat;
+
+    uint32_t m_Width;
+
+    uint32_t m_Height;
+
+    Frame::TimestampType m_PresentationTimestamp;
+
+    void* m_RawBuffer;
+
+    DeallocatorFunctionType m_DeallocatorFn;
+};
+
+const StdFunctionFrame::DeallocatorFunctionType StdFunctionFrame::defaultDeallocFn = [](void*) {};
+
+/**
+ * @brief An allocator that always hands out the same block: the benchmarks time the frame, not the memory.
+ */
+class BenchFrameAllocator : public FrameAllocator {
+
+public:
+    BenchFrameAllocator() noexcept
+     : m_Block{},
+     m_Deallocations(0) {
+
+    }
+
+    ~BenchFrameAllocator() override = default;
+
+    void* allocate(size_t size, SlotType& slot) noexcept override {
+        slot = 0;
+        return (size <= sizeof(m_Block)) ? m_Block : nullptr;
+    }
+
+    void deallocate(void* mem, SlotType slot) noexcept override {
+        ++m_Deallocations;
+    }
+
+    /**
+     * @brief The allocate function as it was given to the frame before the allocator handle.
+     */
+    void* allocate(size_t size) noexcept {
+        SlotType slot;
+        return allocate(size, slot);
+    }
+
+    void deallocate(void* mem) noexcept {
+        deallocate(mem, 0);
+    }
+
+    uint64_t getDeallocations() const noexcept {
+        return m_Deallocations;
+    }
+
+private:
+    uint8_t m_Block[BenchWidth * BenchHeight * 8];
+
+    uint64_t m_Deallocations;
+};
+
+/**
+ * @brief Time a benchmark and print the mean duration of one of its iterations.
+ *
+ * @param name the name printed for the benchmark
+ * @param benchmark runs the Iterations iterations and returns a value depending on all of them
+ */
+template <typename BenchmarkType>
+static void run(const char* name, BenchmarkType benchmark) noexcept {
+    const auto start = std::chrono::steady_clock::now();
+    const uintptr_t result = benchmark();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    const double ns = std::chrono::duration<double, std::nano>(elapsed).count() / Iterations;
+
+    // the result is printed so that the compiler cannot drop the work
+    std::cout << name << ": " << ns << " ns (" << (result & 0xFF) << ")" << std::endl;
+}
+
+/**
+ * @brief Move filled frames around a few queue slots, as the decoder, the queue and the output device do.
+ *
+ * Every iteration is three moves: one construction and two assignments.
+ */
+template <typename FrameType, typename FillerType>
+static uintptr_t moveFrames(FillerType fill) noexcept {
+    std::vector<FrameType> slots;
+    slots.reserve(QueuedFrames);
+    for (size_t i = 0; i < QueuedFrames; ++i) {
+        slots.emplace_back(Frame::PixelFormat::RGBA32, BenchWidth, BenchHeight);
+        fill(slots.back());
+    }
+
+    for (size_t i = 0; i < Iterations; ++i) {
+        FrameType moved(std::move(slots[i % QueuedFrames]));
+        slots[i % QueuedFrames] = std::move(slots[(i + 1) % QueuedFrames]);
+        slots[(i + 1) % QueuedFrames] = std::move(moved);
+    }
+
+    uintptr_t result = 0;
+    for (const auto& frame : slots) {
+        result += reinterpret_cast<uintptr_t>(frame.getRawBuffer());
+    }
+
+    return result;
+}
+
+/**
+ * @brief Microbenchmark of Frame moves and storeFrameData against the std::function frame they replaced.
+ *
+ * The filler captures as many references as the decoder converter does, so that it does not fit the
+ * small buffer of std::function: that is the heap allocation per frame the FunctionRef filler removed.
+ *
+ * @return EXIT_SUCCESS IIF every frame has been given back to its allocator
+ */
+int main(int argc, char * argv[])
+{
+    BenchFrameAllocator allocator;
+
+    const StdFunctionFrame::AllocatorFunctionType allocatorFn = [&allocator](size_t size) {
+        return allocator.allocate(size);
+    };
+    const StdFunctionFrame::DeallocatorFunctionType deallocatorFn = [&allocator](void* mem) {
+        allocator.deallocate(mem);
+    };
+
+    bool converted = false;
+    uint32_t value = 0;
+    uint64_t filled = 0;
+    const size_t size = Frame::getFrameSizeInBytes(Frame::PixelFormat::RGBA32, BenchWidth, BenchHeight);
+
+    run("Frame move", [&]() {
+        return moveFrames<Frame>([&allocator](Frame& frame) {
+            frame.storeFrameData(&allocator, [](void*) {});
+        });
+    });
+
+    run("std::function frame move", [&]() {
+        return moveFrames<StdFunctionFrame>([&](StdFunctionFrame& frame) {
+            frame.storeFrameData(allocatorFn, deallocatorFn, [](void*) {});
+        });
+    });
+
+    run("Frame storeFrameData", [&]() {
+        uintptr_t result = 0;
+        for (size_t i = 0; i < Iterations; ++i) {
+            Frame frame(Frame::PixelFormat::RGBA32, BenchWidth, BenchHeight);
+            frame.storeFrameData(&allocator, [&](void* mem) {
+                std::memset(mem, static_cast<int>(value), 1);
+                converted = (size != 0);
+                ++filled;
+                ++value;
+            });
+            result += reinterpret_cast<uintptr_t>(frame.getRawBuffer());
+        }
+
+        return result;
+    });
+
+    run("std::function frame storeFrameData", [&]() {
+        uintptr_t result = 0;
+        for (size_t i = 0; i < Iterations; ++i) {
+            StdFunctionFrame frame(Frame::PixelFormat::RGBA32, BenchWidth, BenchHeight);
+            frame.storeFrameData(allocatorFn, deallocatorFn, [&](void* mem) {
+                std::memset(mem, static_cast<int>(value), 1);
+                converted = (size != 0);
+                ++filled;
+                ++value;
+            });
+            result += reinterpret_cast<uintptr_t>(frame.getRawBuffer());
+        }
+
+        return result;
+    });
+
+    // one deallocation per filled frame: the moves did not leak nor release a frame twice
+    const uint64_t expected = (2 * QueuedFrames) + filled;
+    if ((!converted) || (allocator.getDeallocations() != expected)) {
+        std::cerr << "Frames have been released " << allocator.getDeallocations() << " times instead of " << expected << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -1,8 +1,65 @@
 #include "FFMPEGDecoder.h"
 #include "FakeBufferedFrameOutputDevice.h"
+#include "AllocationCheckingFrameOutputDevice.h"
+#include "AllocationTracker.h"
+#include "FrameCompositor.h"
+#include "StatisticsServer.h"
+#include "Stages/OverlayFrameStage.h"
 
-#include <queue>
 #include <cassert>
+#include <cstdlib>
+#include <unistd.h>
+
+/**
+ * @brief The number of frames checked for allocations after the warm-up (EOD_ALLOCATION_CHECK test mode).
+ */
+static constexpr uint64_t AllocationCheckedFrames = 240;
+
+/**
+ * @brief The number of intra-only decoders and frame stage workers of the EOD_ALLOCATION_CHECK test mode.
+ */
+static constexpr size_t AllocationCheckWorkers = 2;
+
+/**
+ * @brief The longest time the EOD_ALLOCATION_CHECK test mode can take (warm-up and checked frames are played in real time).
+ */
+static constexpr std::chrono::seconds AllocationCheckTimeout(120);
+
+/**
+ * @brief Decode until the decoder to sink path is warmed up and check it does not allocate anymore.
+ *
+ * @return the exit code: EXIT_FAILURE if the player allocated on a watched thread
+ */
+static int checkAllocations(FFMPEGDecoder& decoder, AllocationCheckingFrameOutputDevice& output) noexcept {
+    decoder.play();
+
+    // the sink may run until the process exits: its thread is never joined
+    std::thread presenter([&output]() { output.exec(); });
+    presenter.detach();
+
+    // the check fails if the file ends (or cannot be played) before enough frames have been checked
+    const auto deadline = std::chrono::steady_clock::now() + AllocationCheckTimeout;
+    while (!output.waitForCompletion(std::chrono::milliseconds(100))) {
+        if (!decoder.isRunning()) {
+            std::cerr << "The decoder stopped after " << output.getEnqueuedFrames() << " frames: the file is too short or cannot be played" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (std::chrono::steady_clock::now() > deadline) {
+            std::cerr << "The allocation check timed out after " << output.getEnqueuedFrames() << " frames" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    const uint64_t violations = AllocationTracker::getViolations();
+
+    std::cerr << "Allocations after warm-up: " << violations << " by the player, "
+        << AllocationTracker::getLibraryAllocations() << " by libraries" << std::endl;
+
+    AllocationTracker::report(STDERR_FILENO);
+
+    return (violations == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
 
 /**
  * Entry point.
@@ -26,40 +83,166 @@ int main(int argc, char * argv[])
         return EXIT_FAILURE;
     }
 
-    size_t sizeInBytesOfLargestFrame = Frame::getPixelSizeInBytes(Frame::PixelFormat::RGBA64) * 1920 * 1080;
+    constexpr uint32_t maxFrameWidth = 1920;
+    constexpr uint32_t maxFrameHeight = 1080;
+
+    size_t sizeInBytesOfLargestFrame = Frame::getFrameSizeInBytes(Frame::PixelFormat::RGBA64, maxFrameWidth, maxFrameHeight);
 
-    std::queue<void*> fullHDFreeFramesMemory;
-    for (size_t i = 0; i < 24; ++i) {
-        fullHDFreeFramesMemory.push(malloc(sizeInBytesOfLargestFrame));
+    // EOD_NUMA_NODE=<node> keeps decoding, presentation and frame memory on one NUMA node
+    std::optional<NumaTopology::NodeType> numaNode;
+    const char* numaNodeVariable = std::getenv("EOD_NUMA_NODE");
+    if (numaNodeVariable != nullptr) {
+        numaNode = static_cast<NumaTopology::NodeType>(std::strtoul(numaNodeVariable, nullptr, 10));
+
+        // the output device runs on this thread
+        NumaTopology::get().bindThread(numaNode.value());
     }
+
+    // frames are decoded in pre-allocated full HD blocks
+    FramePool fullHDFramesPool(24, sizeInBytesOfLargestFrame, numaNode);
     
     auto debugOutput = new FakeBufferedFrameOutputDevice(8);
 
+    // content above full HD is scaled down by the decoder, so that every frame fits in a block of the pool
+    debugOutput->setPreferredFrameFormat(Frame::PixelFormat::RGBA64, maxFrameWidth, maxFrameHeight);
+
+    // the file to play is the first argument
+    const Decoder::FileNameType filename = (argc > 1) ? argv[1] : "";
+
+    // EOD_ALLOCATION_CHECK=<warm-up frames> turns the player into a test of the steady-state zero-allocation guarantee
+    const char* allocationCheck = std::getenv("EOD_ALLOCATION_CHECK");
+    if ((allocationCheck != nullptr) && (filename.empty())) {
+        std::cerr << "Usage: EOD_ALLOCATION_CHECK=<warm-up frames> " << argv[0] << " FILE" << std::endl;
+
+        return EXIT_FAILURE;
+    } else if ((allocationCheck != nullptr) && (AllocationTracker::isEnabled())) {
+        const uint64_t warmupFrames = std::max<uint64_t>(std::strtoull(allocationCheck, nullptr, 10), 1);
+
+        auto checkingOutput = new AllocationCheckingFrameOutputDevice(debugOutput, warmupFrames, AllocationCheckedFrames);
+
+        FFMPEGDecoder decoder(
+            checkingOutput,
+            &fullHDFramesPool
+        );
+
+        // the check covers the worker threads too: intra-only files are decoded in parallel and every frame goes through a stage
+        const std::vector<uint8_t> overlay(16 * 16 * 4, 0x80);
+        decoder.setIntraOnlyWorkers(AllocationCheckWorkers);
+        decoder.setFrameStages({ std::make_shared<OverlayFrameStage>(overlay.data(), 16, 16, 0, 0) }, AllocationCheckWorkers);
+
+        decoder.loadFile(filename);
+
+        const int result = checkAllocations(decoder, *checkingOutput);
+
+        // the sink thread is still running: nothing is torn down
+        std::_Exit(result);
+    } else if (allocationCheck != nullptr) {
+        std::cerr << "EOD_ALLOCATION_CHECK needs a build with EOD_ALLOCATION_TRACKING" << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
     FFMPEGDecoder decoder(
         debugOutput,
-        [&](size_t sz) -> void* {
-            /*
-            assert(sz <= sizeInBytesOfLargestFrame);
-
-            assert(!fullHDFreeFramesMemory.empty());
-
-            auto result = fullHDFreeFramesMemory.front();
-            fullHDFreeFramesMemory.pop();
-            return result;
-            */ return malloc(sz);
-        },
-        [&](void* mem) {
-            //fullHDFreeFramesMemory.push(mem);
-            free(mem);
-        }
+        &fullHDFramesPool
     );
 
-    decoder.loadFile("");
+    decoder.setPlacement(numaNode);
+
+    // EOD_POWER_PACING decodes in bursts (fanless boxes)
+    if (std::getenv("EOD_POWER_PACING") != nullptr) {
+        decoder.setPacing(FFMPEGDecoder::PacingOptions());
+    }
+
+    // EOD_PROXY_CACHE=<MiB> plays heavy assets from proxies taking at most that space on disk
+    const char* proxyCacheVariable = std::getenv("EOD_PROXY_CACHE");
+    if (proxyCacheVariable != nullptr) {
+        ProxyCache::Options options;
+        options.budget = std::strtoull(proxyCacheVariable, nullptr, 10) * 1024 * 1024;
+        decoder.setProxyCache(std::make_shared<ProxyCache>(options));
+    }
+
+    // EOD_SUBTITLES shows the bitmap subtitles of played files
+    if (std::getenv("EOD_SUBTITLES") != nullptr) {
+        decoder.setCompositor(std::make_shared<FrameCompositor>());
+        decoder.setSubtitles(true);
+    }
+
+    // EOD_LIVE=<url> plays a live input (i.e. one of the loopback stand-ins of FFMPEGDecoder::LiveOptions)
+    const char* liveVariable = std::getenv("EOD_LIVE");
+
+    // EOD_RENDITIONS=<file>:<file>:... plays the renditions of an asset, switching between them
+    const char* renditionsVariable = std::getenv("EOD_RENDITIONS");
+    if (liveVariable != nullptr) {
+        decoder.loadFile(liveVariable, FFMPEGDecoder::LiveOptions());
+    } else if (renditionsVariable != nullptr) {
+        std::vector<Decoder::FileNameType> renditions;
+
+        std::istringstream files(renditionsVariable);
+        std::string file;
+        while (std::getline(files, file, ':')) {
+            if (!file.empty()) {
+                renditions.push_back(file);
+            }
+        }
+
+        decoder.loadRenditions(renditions, FFMPEGDecoder::RenditionOptions());
+    } else {
+        decoder.loadFile(filename);
+    }
+
     decoder.play();
+
+    // live latency is reported once per second, so that a stand-in run shows how the jitter buffer behaves
+    std::atomic_bool reportLatency(liveVariable != nullptr);
+    std::thread latencyThread;
+    if (reportLatency) {
+        latencyThread = std::thread([&decoder, &reportLatency]() {
+            while (reportLatency) {
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+
+                const auto statistics = decoder.getLiveStatistics();
+                std::cerr << "Live: receive to present " << statistics.receiveToPresentLatency
+                    << "us, playout delay " << statistics.playoutDelay
+                    << "us, jitter " << statistics.jitter
+                    << "us, dropped " << statistics.droppedFrames;
+
+                if (statistics.glassToGlassLatency.has_value()) {
+                    std::cerr << ", glass to glass " << statistics.glassToGlassLatency.value() << "us";
+                }
+
+                std::cerr << std::endl;
+            }
+        });
+    }
+
+    // EOD_STATISTICS_SOCKET=<path> exports live statistics to a monitoring agent
+    std::unique_ptr<StatisticsServer> statisticsServer;
+    std::thread statisticsThread;
+    const char* statisticsSocket = std::getenv("EOD_STATISTICS_SOCKET");
+    if (statisticsSocket != nullptr) {
+        statisticsServer.reset(new StatisticsServer(statisticsSocket));
+        statisticsServer->addDecoder("decoder", decoder);
+        statisticsServer->addOutputDevice("output", *debugOutput);
+
+        statisticsThread = std::thread([&statisticsServer]() {
+            statisticsServer->exec();
+        });
+    }
     
     // this is a blocking call
     debugOutput->exec();
 
+    if (statisticsThread.joinable()) {
+        statisticsServer->interrupt();
+        statisticsThread.join();
+    }
+
+    if (latencyThread.joinable()) {
+        reportLatency = false;
+        latencyThread.join();
+    }
+
     delete debugOutput;
 
     glfwTerminate();
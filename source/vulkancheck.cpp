@@ -0,0 +1,182 @@
+#include "VulkanFrameOutputDevice.h"
+
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * @brief The size of the frames presented by the check (even, so that NV12 chroma planes are not rounded).
+ */
+static constexpr uint32_t CheckWidth = 64;
+
+static constexpr uint32_t CheckHeight = 32;
+
+/**
+ * @brief The largest difference allowed between a converted NV12 pixel and the expected color.
+ */
+static constexpr int ConversionTolerance = 4;
+
+/**
+ * @brief Present a frame and read back the presented image.
+ *
+ * @param fill writes the pixels of the frame
+ * @return true IIF the frame has been presented and its image read back
+ */
+template <typename FillerType>
+static bool presentAndRead(
+    VulkanFrameOutputDevice& device,
+    Frame::PixelFormat pf,
+    Frame::TimestampType pts,
+    FillerType fill,
+    std::vector<uint8_t>& pixels
+) noexcept {
+    const uint64_t presented = device.getPresentedFrames();
+
+    Frame frame(pf, CheckWidth, CheckHeight);
+    frame.setPresentationTimestamp(pts);
+    frame.storeFrameData(&device, [&fill](void* frameMemory) {
+        fill(reinterpret_cast<uint8_t*>(frameMemory));
+    });
+
+    if (!frame.isHoldingData()) {
+        std::cerr << "The device did not give memory for the frame" << std::endl;
+        return false;
+    }
+
+    device.enqueueFrame(std::move(frame));
+
+    // a software rasterizer is slow, but not this slow
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (device.getPresentedFrames() == presented) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            std::cerr << "The frame has not been presented" << std::endl;
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    if ((!device.readPresentedImage(pixels, width, height)) || (width != CheckWidth) || (height != CheckHeight)) {
+        std::cerr << "Could not read back the presented image" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief RGBA32 frames are copied as they are: the read back pixels must be identical.
+ */
+static bool checkRGBA32(VulkanFrameOutputDevice& device) noexcept {
+    auto pattern = [](uint32_t x, uint32_t y, uint32_t c) -> uint8_t {
+        return static_cast<uint8_t>((x * 7) + (y * 13) + (c * 61));
+    };
+
+    std::vector<uint8_t> pixels;
+    const bool presented = presentAndRead(device, Frame::PixelFormat::RGBA32, 0, [&pattern](uint8_t* mem) {
+        for (uint32_t y = 0; y < CheckHeight; ++y) {
+            for (uint32_t x = 0; x < CheckWidth; ++x) {
+                for (uint32_t c = 0; c < 4; ++c) {
+                    mem[(((y * CheckWidth) + x) * 4) + c] = pattern(x, y, c);
+                }
+            }
+        }
+    }, pixels);
+
+    if (!presented) {
+        return false;
+    }
+
+    for (uint32_t y = 0; y < CheckHeight; ++y) {
+        for (uint32_t x = 0; x < CheckWidth; ++x) {
+            for (uint32_t c = 0; c < 4; ++c) {
+                const uint8_t value = pixels[(((y * CheckWidth) + x) * 4) + c];
+                if (value != pattern(x, y, c)) {
+                    std::cerr << "RGBA32: pixel " << x << "," << y << " component " << c << " is " << static_cast<int>(value)
+                        << " instead of " << static_cast<int>(pattern(x, y, c)) << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief NV12 frames are converted by the sampler: the left half is narrow range black, the right half narrow range white.
+ */
+static bool checkNV12(VulkanFrameOutputDevice& device) noexcept {
+    std::vector<uint8_t> pixels;
+    const bool presented = presentAndRead(device, Frame::PixelFormat::NV12, 40000, [](uint8_t* mem) {
+        for (uint32_t y = 0; y < CheckHeight; ++y) {
+            for (uint32_t x = 0; x < CheckWidth; ++x) {
+                mem[(y * CheckWidth) + x] = (x < CheckWidth / 2) ? 16 : 235;
+            }
+        }
+
+        // neutral chroma: every pixel is grey
+        std::memset(mem + (CheckWidth * CheckHeight), 128, CheckWidth * (CheckHeight / 2));
+    }, pixels);
+
+    if (!presented) {
+        return false;
+    }
+
+    for (uint32_t y = 0; y < CheckHeight; ++y) {
+        for (uint32_t x = 0; x < CheckWidth; ++x) {
+            const int expected = (x < CheckWidth / 2) ? 0 : 255;
+
+            for (uint32_t c = 0; c < 3; ++c) {
+                const int value = pixels[(((y * CheckWidth) + x) * 4) + c];
+                if (std::abs(value - expected) > ConversionTolerance) {
+                    std::cerr << "NV12: pixel " << x << "," << y << " component " << c << " is " << value
+                        << " instead of " << expected << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Present known frames on the Vulkan output device and check the pixels of the presented images.
+ *
+ * Run it on the lavapipe software rasterizer on hosts without a GPU:
+ *
+ *     VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json EODVulkanCheck
+ *
+ * @return EXIT_SUCCESS IIF every presented image holds the expected pixels
+ */
+int main(int argc, char * argv[])
+{
+    VulkanFrameOutputDevice device(2, Frame::getFrameSizeInBytes(Frame::PixelFormat::RGBA64, CheckWidth, CheckHeight));
+    if (!device.isValid()) {
+        std::cerr << "Could not create the Vulkan output device" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::thread presenter([&device]() {
+        device.exec();
+    });
+
+    bool passed = checkRGBA32(device);
+    std::cerr << "RGBA32: " << (passed ? "passed" : "failed") << std::endl;
+
+    // without the YCbCr conversion the device never receives NV12 frames
+    if (device.isConvertingYCbCr()) {
+        const bool converted = checkNV12(device);
+        std::cerr << "NV12: " << (converted ? "passed" : "failed") << std::endl;
+        passed = passed && converted;
+    } else {
+        std::cerr << "NV12: skipped, YCbCr sampling is not available" << std::endl;
+    }
+
+    device.interrupt();
+    presenter.join();
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}